@@ -4,6 +4,7 @@
  */
 
 #include "evs_event_extractor.h"
+#include "hv_subframe_decoder.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -12,10 +13,57 @@
 // 内部辅助函数
 // ============================================================================
 
+/**
+ * @brief 向事件数组写入一个事件，缓冲区满时只计数
+ * 依赖调用处的局部变量：events, event_idx, max_events, dropped, timestamp
+ */
+#define EVS_EMIT_EVENT(ex, ey, ep)                          \
+    do {                                                    \
+        if (event_idx < max_events) {                       \
+            events[event_idx].x = (uint16_t)(ex);           \
+            events[event_idx].y = (uint16_t)(ey);           \
+            events[event_idx].polarity = (int8_t)(ep);      \
+            events[event_idx].reserved = 0;                 \
+            events[event_idx].timestamp = timestamp;        \
+            event_idx++;                                    \
+        } else {                                            \
+            dropped++;                                      \
+        }                                                   \
+    } while (0)
+
+/**
+ * @brief 解码子帧像素区到事件数组
+ * @param pixels 像素区指针（子帧头之后）
+ * @param x_offset 子帧X偏移
+ * @param y_offset 子帧Y偏移
+ * @param timestamp 子帧时间戳（微秒）
+ * @param events 事件数组
+ * @param event_count 当前事件计数指针（输入/输出）
+ * @param max_events 最大事件数
+ * @return 因缓冲区满而丢弃的事件数
+ */
+static uint32_t decode_subframe_pixels(
+    const uint64_t* pixels,
+    int x_offset,
+    int y_offset,
+    uint64_t timestamp,
+    EVSEvent_t* events,
+    uint32_t* event_count,
+    uint32_t max_events)
+{
+    uint32_t event_idx = *event_count;
+    uint32_t dropped = 0;
+    
+    HV_SUBFRAME_DECODE_SPARSE(pixels, x_offset, y_offset, hv_subframe_row_is_zero, EVS_EMIT_EVENT);
+    
+    *event_count = event_idx;
+    return dropped;
+}
+
 /**
  * @brief 处理单个子帧数据
+ * 坐标偏移由子帧头中的子帧编号决定
  * @param pixelBufferPtr 像素缓冲区指针
- * @param subframe 子帧编号 (0-3)
  * @param events 事件数组
  * @param event_count 当前事件计数指针
  * @param max_events 最大事件数
@@ -23,92 +71,28 @@
  */
 static uint32_t process_subframe(
     const uint64_t* pixelBufferPtr,
-    uint32_t subframe,
     EVSEvent_t* events,
     uint32_t* event_count,
     uint32_t max_events)
 {
     uint32_t initial_count = *event_count;
     
-    // 解析时间戳
-    uint64_t buffer = pixelBufferPtr[0];
-    uint64_t timestamp = (buffer >> 24) & 0xFFFFFFFFFF;
-    uint64_t header_vec = buffer & 0xFFFFFF;
+    // 解析子帧头（时间戳、子帧编号）
+    hv_subframe_header_t hdr;
+    hv_subframe_parse_header(pixelBufferPtr, &hdr);
     
-    if (header_vec != 0xFFFF) {
-        fprintf(stderr, "[EVS Extractor] Warning: Invalid header vector 0x%lx\n", header_vec);
+    if (!hdr.header_valid) {
+        fprintf(stderr, "[EVS Extractor] Warning: Invalid header vector 0x%lx\n",
+                (unsigned long)(pixelBufferPtr[0] & 0xFFFFFF));
     }
     
-    // 验证子帧编号
-    buffer = pixelBufferPtr[1];
-    (void)(buffer >> 44);  // 子帧ID已通过参数传入，此处仅跳过
-    timestamp /= 200;  // 转换为微秒
+    uint32_t dropped = decode_subframe_pixels(
+        pixelBufferPtr + HV_SUBFRAME_HEADER_WORDS,
+        hdr.x_offset, hdr.y_offset, hdr.timestamp,
+        events, event_count, max_events);
     
-    // 计算子帧偏移量
-    int x_offset = 0, y_offset = 0;
-    switch (subframe) {
-    case 0:
-        x_offset = 0;
-        y_offset = 0;
-        break;
-    case 1:
-        x_offset = 1;
-        y_offset = 0;
-        break;
-    case 2:
-        x_offset = 0;
-        y_offset = 1;
-        break;
-    case 3:
-        x_offset = 1;
-        y_offset = 1;
-        break;
-    }
-    
-    // 跳过头部，指向像素数据
-    pixelBufferPtr += 2;
-    
-    int y = y_offset;
-    
-    // 遍历子帧像素
-    for (int i = 0; i < EVS_SUB_HEIGHT; i++) {
-        int x = x_offset;
-        
-        for (int j = 0; j < EVS_SUB_WIDTH / 32; j++) {
-            buffer = pixelBufferPtr[j];
-            
-            // 每个64位包含32个2位像素
-            for (int k = 0; k < 64; k += 2) {
-                uint64_t pix = (buffer >> k) & 0x3;
-                
-                // 检查边界
-                if (x >= EVS_OUTPUT_WIDTH || y >= EVS_OUTPUT_HEIGHT) {
-                    x += 2;
-                    continue;
-                }
-                
-                // 如果有事件（pix > 0）
-                if (pix > 0) {
-                    if (*event_count >= max_events) {
-                        fprintf(stderr, "[EVS Extractor] Warning: Max events reached\n");
-                        return *event_count - initial_count;
-                    }
-                    
-                    events[*event_count].x = (uint16_t)x;
-                    events[*event_count].y = (uint16_t)y;
-                    events[*event_count].polarity = (int8_t)(pix >> 1);
-                    events[*event_count].reserved = 0;
-                    events[*event_count].timestamp = timestamp;
-                    
-                    (*event_count)++;
-                }
-                
-                x += 2;  // 2像素间隔
-            }
-        }
-        
-        pixelBufferPtr += EVS_SUB_WIDTH / 32;
-        y += 2;  // 2像素间隔
+    if (dropped > 0) {
+        fprintf(stderr, "[EVS Extractor] Warning: Max events reached, dropped %u events\n", dropped);
     }
     
     return *event_count - initial_count;
@@ -144,7 +128,6 @@ int evs_extract_events(
     for (int sub = 0; sub < 32; sub++) {
         process_subframe(
             pixelBufferPtr,
-            sub,
             packet->events,
             &packet->event_count,
             max_events
@@ -176,9 +159,7 @@ int evs_extract_subframe_direct(
     }
     
     const uint64_t* pixelBufferPtr = (const uint64_t*)subframe_data;
-    uint32_t event_idx = *current_count;
-    uint32_t extracted = 0;
-    uint32_t dropped = 0;
+    uint32_t initial_count = *current_count;
     
     // 初始化输出参数
     if (dropped_count) {
@@ -186,85 +167,28 @@ int evs_extract_subframe_direct(
     }
     
     // 解析时间戳（前2个64位字）
-    uint64_t buffer = pixelBufferPtr[0];
-    uint64_t timestamp = (buffer >> 24) & 0xFFFFFFFFFF;
-    uint64_t header_vec = buffer & 0xFFFFFF;
+    hv_subframe_header_t hdr;
+    hv_subframe_parse_header(pixelBufferPtr, &hdr);
     
-    if (header_vec != 0xFFFF) {
-        fprintf(stderr, "[EVS Extractor] Warning: Invalid header vector 0x%lx\n", header_vec);
+    if (!hdr.header_valid) {
+        fprintf(stderr, "[EVS Extractor] Warning: Invalid header vector 0x%lx\n",
+                (unsigned long)(pixelBufferPtr[0] & 0xFFFFFF));
     }
     
-    // 验证子帧编号
-    buffer = pixelBufferPtr[1];
-    (void)(buffer >> 44);  // 子帧ID已通过参数传入
-    timestamp /= 200;  // 转换为微秒
-    
-    // 跳过头部
-    pixelBufferPtr += 2;
-    
     // 计算子帧偏移量（基于子帧ID）
-    int x_offset = 0, y_offset = 0;
-    switch (subframe_id) {
-    case 0:
-        x_offset = 0;
-        y_offset = 0;
-        break;
-    case 1:
-        x_offset = 1;
-        y_offset = 0;
-        break;
-    case 2:
-        x_offset = 0;
-        y_offset = 1;
-        break;
-    case 3:
-        x_offset = 1;
-        y_offset = 1;
-        break;
-    default:
+    if (subframe_id < 0 || subframe_id > 3) {
         fprintf(stderr, "[EVS Extractor] Error: Invalid subframe_id %d\n", subframe_id);
         return -1;
     }
-    
-    int y = y_offset;
-    
-    // 处理像素数据
-    for (int i = 0; i < EVS_SUB_HEIGHT; i++) {
-        int x = x_offset;
-        for (int j = 0; j < EVS_SUB_WIDTH / 32; j++) {
-            buffer = pixelBufferPtr[j];
-            for (int k = 0; k < 64; k += 2) {
-                uint64_t pix = (buffer >> k) & 0x3;
-                
-                if (x >= EVS_OUTPUT_WIDTH || y >= EVS_OUTPUT_HEIGHT) {
-                    x += 2;
-                    continue;
-                }
-                
-                if (pix > 0) {
-                    // 检查缓冲区是否还有空间
-                    if (event_idx >= max_events) {
-                        // 缓冲区满，只统计不写入
-                        dropped++;
-                    } else {
-                        // 直接写入目标缓冲区（零拷贝）
-                        events[event_idx].x = x;
-                        events[event_idx].y = y;
-                        events[event_idx].polarity = (pix >> 1);
-                        events[event_idx].timestamp = timestamp;
-                        
-                        event_idx++;
-                        extracted++;
-                    }
-                }
-                x += 2;
-            }
-        }
-        pixelBufferPtr += EVS_SUB_WIDTH / 32;
-        y += 2;
-    }
-    
-    *current_count = event_idx;
+    int x_offset = subframe_id & 0x1;
+    int y_offset = subframe_id >> 1;
+    
+    // 处理像素数据，直接写入目标缓冲区（零拷贝）
+    uint32_t dropped = decode_subframe_pixels(
+        pixelBufferPtr + HV_SUBFRAME_HEADER_WORDS,
+        x_offset, y_offset, hdr.timestamp,
+        events, current_count, max_events);
+    uint32_t extracted = *current_count - initial_count;
     
     // 输出丢失数量
     if (dropped_count) {
@@ -20,6 +20,7 @@
 #include "packet_protocol.h"
 #include "evs_event_extractor.h"
 #include "evt2_decoder.h"
+#include "hv_metrics.h"
 
 // ============================================================================
 // 配置参数
@@ -28,7 +29,8 @@
 #define LISTEN_PORT         8888
 #define MAX_CLIENTS         4
 #define RECV_TIMEOUT_SEC    10
-#define STATS_PRINT_INTERVAL 100
+#define STATS_PRINT_INTERVAL_SEC  10     // 控制台统计输出间隔（秒）
+#define METRICS_WRITE_INTERVAL_MS 1000   // 指标文件写出间隔（毫秒）
 
 // ============================================================================
 // 全局变量
@@ -37,6 +39,18 @@
 static volatile bool g_running = true;
 static ReceiverStats_t g_stats;
 
+// 运行指标：接收端为单线程，只使用一个分片
+static hv_metrics_registry_t* g_metrics = NULL;
+static hv_metrics_shard_t* g_metrics_shard = NULL;
+static const char* g_metrics_path = NULL;   // 为NULL时不写出指标文件
+
+static struct {
+    int packets, bytes, events, positive_events, negative_events;
+    int evt2_payload_bytes, evt2_decoded_bytes;
+    int packets_dropped, sequence_errors, checksum_errors;
+    int packet_time, evt2_decode_time;
+} g_metric_ids;
+
 // ============================================================================
 // 信号处理
 // ============================================================================
@@ -51,6 +65,71 @@ static void signal_handler(int sig)
 // 辅助函数
 // ============================================================================
 
+/**
+ * @brief 创建指标注册表并注册接收端指标
+ */
+static int metrics_init(void)
+{
+    g_metrics = hv_metrics_create(NULL);
+    if (!g_metrics) {
+        return -1;
+    }
+    g_metric_ids.packets = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_packets_total", "Packets received with a valid checksum");
+    g_metric_ids.bytes = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_bytes_total", "Bytes received including headers");
+    g_metric_ids.events = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_events_total", "Events received");
+    g_metric_ids.positive_events = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_positive_events_total", "Decoded ON events");
+    g_metric_ids.negative_events = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_negative_events_total", "Decoded OFF events");
+    g_metric_ids.evt2_payload_bytes = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_evt2_payload_bytes_total", "EVT2 encoded payload bytes");
+    g_metric_ids.evt2_decoded_bytes = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_evt2_decoded_bytes_total", "Raw event bytes represented by EVT2 payloads");
+    g_metric_ids.packets_dropped = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_packets_dropped_total", "Packets missing from the sequence");
+    g_metric_ids.sequence_errors = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_sequence_errors_total", "Sequence number discontinuities");
+    g_metric_ids.checksum_errors = hv_metrics_register(g_metrics, HV_METRIC_COUNTER,
+        "evs_receiver_checksum_errors_total", "Packets with an invalid header or checksum");
+    g_metric_ids.packet_time = hv_metrics_register(g_metrics, HV_METRIC_HISTOGRAM,
+        "evs_receiver_packet_seconds", "Time from header received to packet processed");
+    g_metric_ids.evt2_decode_time = hv_metrics_register(g_metrics, HV_METRIC_HISTOGRAM,
+        "evs_receiver_evt2_decode_seconds", "EVT2 decode time per packet");
+    g_metrics_shard = hv_metrics_acquire_shard(g_metrics);
+    return 0;
+}
+
+/**
+ * @brief 写出指标文件（未指定路径时不写）
+ */
+static void metrics_write(void)
+{
+    if (g_metrics_path && hv_metrics_write_prometheus_file(g_metrics, g_metrics_path) < 0) {
+        fprintf(stderr, "[Receiver] Failed to write metrics file: %s\n", g_metrics_path);
+        g_metrics_path = NULL;
+    }
+}
+
+/**
+ * @brief 打印累计统计
+ */
+static void print_receiver_stats(const char* title)
+{
+    printf("\n========== %s ==========\n", title);
+    printf("Total Packets: %u\n", g_stats.total_packets_received);
+    printf("Total Events: %u\n", g_stats.total_events_received);
+    printf("Total Bytes: %lu (%.2f MB)\n",
+           g_stats.total_bytes_received,
+           g_stats.total_bytes_received / (1024.0 * 1024.0));
+    printf("Packets Dropped: %u\n", g_stats.packets_dropped);
+    printf("Sequence Errors: %u\n", g_stats.sequence_errors);
+    printf("Checksum Errors: %u\n", g_stats.checksum_errors);
+    printf("=========================================\n\n");
+}
+
 /**
  * @brief 接收完整数据（处理部分接收）
  */
@@ -85,8 +164,6 @@ static int process_event_packet(const PacketHeader_t* header, const uint8_t* pay
 {
     uint32_t event_count = ntohl(header->event_count);
     uint32_t payload_size = ntohl(header->payload_size);
-    uint32_t sequence_num = ntohl(header->sequence_num);
-    uint32_t device_id = ntohl(header->device_id);
     
     // 验证数据大小
     if (payload_size != event_count * sizeof(EVSEvent_t)) {
@@ -108,10 +185,9 @@ static int process_event_packet(const PacketHeader_t* header, const uint8_t* pay
         }
     }
     
-    printf("[RAW Packet #%u] Device=%u, Events=%u (Pos=%u, Neg=%u), Timestamp=%u.%06u\n",
-           sequence_num, device_id, event_count,
-           positive_events, negative_events,
-           ntohl(header->timestamp_sec), ntohl(header->timestamp_usec));
+    // 逐包统计只计入指标，不打印
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.positive_events, positive_events);
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.negative_events, negative_events);
     
     return 0;
 }
@@ -124,8 +200,6 @@ static int process_evt2_packet(const PacketHeader_t* header, const uint8_t* payl
 {
     uint32_t event_count = ntohl(header->event_count);
     uint32_t payload_size = ntohl(header->payload_size);
-    uint32_t sequence_num = ntohl(header->sequence_num);
-    uint32_t device_id = ntohl(header->device_id);
     
     // 分配解码后的事件缓冲区
     EVSEvent_t* decoded_events = (EVSEvent_t*)malloc(event_count * sizeof(EVSEvent_t));
@@ -135,6 +209,7 @@ static int process_evt2_packet(const PacketHeader_t* header, const uint8_t* payl
     }
     
     // 解码EVT2数据
+    uint64_t decode_start = hv_metrics_now_ns();
     uint32_t actual_event_count = 0;
     int ret = evt2_decoder_decode(
         decoder,
@@ -144,6 +219,8 @@ static int process_evt2_packet(const PacketHeader_t* header, const uint8_t* payl
         event_count,
         &actual_event_count
     );
+    hv_metrics_histogram_observe(g_metrics_shard, g_metric_ids.evt2_decode_time,
+                                 hv_metrics_now_ns() - decode_start);
     
     if (ret < 0) {
         fprintf(stderr, "[Receiver] Failed to decode EVT2 data\n");
@@ -163,13 +240,12 @@ static int process_evt2_packet(const PacketHeader_t* header, const uint8_t* payl
         }
     }
     
-    double compression_ratio = 100.0 * (1.0 - (double)payload_size / (event_count * sizeof(EVSEvent_t)));
-    
-    printf("[EVT2 Packet #%u] Device=%u, Events=%u (Pos=%u, Neg=%u), EVT2=%u bytes (%.1f%% compression), Timestamp=%u.%06u\n",
-           sequence_num, device_id, actual_event_count,
-           positive_events, negative_events,
-           payload_size, compression_ratio,
-           ntohl(header->timestamp_sec), ntohl(header->timestamp_usec));
+    // 逐包统计只计入指标，不打印；压缩率 = 1 - payload_bytes / decoded_bytes
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.positive_events, positive_events);
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.negative_events, negative_events);
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.evt2_payload_bytes, payload_size);
+    hv_metrics_counter_add(g_metrics_shard, g_metric_ids.evt2_decoded_bytes,
+                           (uint64_t)actual_event_count * sizeof(EVSEvent_t));
     
     free(decoded_events);
     return 0;
@@ -217,8 +293,9 @@ static void handle_client(int client_fd, struct sockaddr_in* client_addr)
         return;
     }
     
-    uint32_t packet_count = 0;
     uint32_t expected_sequence = 0;
+    uint64_t last_print_ns = hv_metrics_now_ns();
+    uint64_t last_metrics_ns = 0;
     
     while (g_running) {
         // 接收数据包头
@@ -227,11 +304,13 @@ static void handle_client(int client_fd, struct sockaddr_in* client_addr)
         if (received < 0) {
             break;
         }
+        uint64_t packet_start = hv_metrics_now_ns();
         
         // 验证数据包头
         if (packet_header_validate(&header) < 0) {
             fprintf(stderr, "[Receiver] Invalid packet header\n");
             g_stats.checksum_errors++;
+            hv_metrics_counter_add(g_metrics_shard, g_metric_ids.checksum_errors, 1);
             continue;
         }
         
@@ -245,6 +324,11 @@ static void handle_client(int client_fd, struct sockaddr_in* client_addr)
                    expected_sequence, sequence_num, sequence_num - expected_sequence);
             g_stats.sequence_errors++;
             g_stats.packets_dropped += (sequence_num - expected_sequence);
+            hv_metrics_counter_add(g_metrics_shard, g_metric_ids.sequence_errors, 1);
+            // 序列号回退（发送端重启等）不计为丢包，避免单调计数器出现巨大跳变
+            if ((int32_t)(sequence_num - expected_sequence) > 0) {
+                hv_metrics_counter_add(g_metrics_shard, g_metric_ids.packets_dropped, sequence_num - expected_sequence);
+            }
             expected_sequence = sequence_num;
         }
         expected_sequence++;
@@ -273,6 +357,7 @@ static void handle_client(int client_fd, struct sockaddr_in* client_addr)
             fprintf(stderr, "[Receiver] Checksum error: expected 0x%08X, got 0x%08X\n",
                    calculated_checksum, received_checksum);
             g_stats.checksum_errors++;
+            hv_metrics_counter_add(g_metrics_shard, g_metric_ids.checksum_errors, 1);
             if (payload) free(payload);
             continue;
         }
@@ -305,23 +390,28 @@ static void handle_client(int client_fd, struct sockaddr_in* client_addr)
         // 更新统计
         g_stats.total_packets_received++;
         g_stats.total_bytes_received += sizeof(header) + payload_size;
-        packet_count++;
+        hv_metrics_counter_add(g_metrics_shard, g_metric_ids.packets, 1);
+        hv_metrics_counter_add(g_metrics_shard, g_metric_ids.bytes, sizeof(header) + payload_size);
+        if (packet_type == PACKET_TYPE_RAW_EVENTS || packet_type == PACKET_TYPE_EVT2_DATA) {
+            hv_metrics_counter_add(g_metrics_shard, g_metric_ids.events, ntohl(header.event_count));
+        }
+        
+        uint64_t now = hv_metrics_now_ns();
+        hv_metrics_histogram_observe(g_metrics_shard, g_metric_ids.packet_time, now - packet_start);
         
-        // 定期打印统计
-        if (packet_count % STATS_PRINT_INTERVAL == 0) {
-            printf("\n========== Receiver Statistics ==========\n");
-            printf("Total Packets: %u\n", g_stats.total_packets_received);
-            printf("Total Events: %u\n", g_stats.total_events_received);
-            printf("Total Bytes: %lu (%.2f MB)\n",
-                   g_stats.total_bytes_received,
-                   g_stats.total_bytes_received / (1024.0 * 1024.0));
-            printf("Packets Dropped: %u\n", g_stats.packets_dropped);
-            printf("Sequence Errors: %u\n", g_stats.sequence_errors);
-            printf("Checksum Errors: %u\n", g_stats.checksum_errors);
-            printf("=========================================\n\n");
+        // 按时间间隔写出指标文件和打印统计，不随包数增长
+        if (now - last_metrics_ns >= METRICS_WRITE_INTERVAL_MS * 1000000ULL) {
+            last_metrics_ns = now;
+            metrics_write();
+        }
+        if (now - last_print_ns >= STATS_PRINT_INTERVAL_SEC * 1000000000ULL) {
+            last_print_ns = now;
+            print_receiver_stats("Receiver Statistics");
         }
     }
     
+    metrics_write();
+    
     // 打印解码器统计
     printf("\n[Receiver] EVT2 Decoder Statistics:\n");
     evt2_decoder_print_stats(decoder);
@@ -345,12 +435,23 @@ int main(int argc, char* argv[])
     if (argc >= 2) {
         listen_port = atoi(argv[1]);
     }
+    if (argc >= 3) {
+        g_metrics_path = argv[2];
+    }
     
     printf("========================================\n");
     printf("EVS TCP Receiver\n");
     printf("Listening on port: %d\n", listen_port);
+    if (g_metrics_path) {
+        printf("Metrics file: %s\n", g_metrics_path);
+    }
     printf("========================================\n\n");
     
+    if (metrics_init() < 0) {
+        fprintf(stderr, "[Receiver] Failed to create metrics registry\n");
+        return 1;
+    }
+    
     // 注册信号处理
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -416,16 +517,9 @@ int main(int argc, char* argv[])
     close(listen_fd);
     
     // 打印最终统计
-    printf("\n========== Final Statistics ==========\n");
-    printf("Total Packets Received: %u\n", g_stats.total_packets_received);
-    printf("Total Events Received: %u\n", g_stats.total_events_received);
-    printf("Total Bytes Received: %lu (%.2f MB)\n",
-           g_stats.total_bytes_received,
-           g_stats.total_bytes_received / (1024.0 * 1024.0));
-    printf("Packets Dropped: %u\n", g_stats.packets_dropped);
-    printf("Sequence Errors: %u\n", g_stats.sequence_errors);
-    printf("Checksum Errors: %u\n", g_stats.checksum_errors);
-    printf("======================================\n");
+    print_receiver_stats("Final Statistics");
+    metrics_write();
+    hv_metrics_destroy(g_metrics);
     
     printf("[Receiver] Exit\n");
     return 0;
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_APS_RECORDER_H
+#define HV_APS_RECORDER_H
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+#include "hv_image_frame.h"
+#include "hv_thread_placement.h"
+#include "hv_metrics.h"
+
+namespace hv {
+
+/**
+ * APS录制格式
+ */
+enum class ApsRecordFormat {
+    MJPG,      // cv::VideoWriter编码为MJPG（AVI）
+    RawNV12    // 原样写入NV12帧，不编码，供事后离线编码
+};
+
+/**
+ * APS录制统计
+ */
+struct ApsRecorderStats {
+    uint64_t frames_written = 0;    // 已写入文件的帧数
+    uint64_t frames_dropped = 0;    // 队列满或尺寸不符而丢弃的帧数
+    uint64_t bytes_written = 0;     // 原始格式写入的字节数（MJPG为编码前的NV12字节数）
+    size_t queued_frames = 0;       // 当前队列中的帧数
+    size_t max_queued_frames = 0;   // 本次录制中队列的最大深度
+};
+
+/**
+ * HV_APS_Recorder类 - APS图像录制
+ * pushFrame把帧复制到录制器自己的缓冲池后立即返回，编码和写文件在独立的写入线程中进行，
+ * 相机的图像线程不会因编码或磁盘变慢而阻塞；队列满时丢弃新帧并计数。
+ * 每帧的序号和到达时刻另写到索引文件（<filename>.csv）
+ */
+class HV_APS_Recorder {
+public:
+    HV_APS_Recorder();
+
+    /**
+     * 析构函数，停止录制
+     */
+    ~HV_APS_Recorder();
+
+    /**
+     * 开始录制
+     * RawNV12格式的文件是连续的768x608 NV12帧，可直接用
+     * ffmpeg -f rawvideo -pix_fmt nv12 -s 768x608 -r <fps> -i <filename> 编码
+     * @param filename 输出文件名
+     * @param format 录制格式
+     * @param fps MJPG文件标注的帧率（RawNV12格式只用于提示）
+     * @param queue_frames 队列深度（帧数），决定录制器缓冲池大小（每帧约684KB）
+     * @return 是否成功开始录制
+     */
+    bool startRecording(const std::string& filename, ApsRecordFormat format = ApsRecordFormat::MJPG,
+                        double fps = 30.0, size_t queue_frames = 16);
+
+    /**
+     * 停止录制，等待队列中的帧写入完成后关闭文件
+     */
+    void stopRecording();
+
+    /**
+     * 检查是否正在录制
+     * @return 是否正在录制
+     */
+    bool isRecording() const;
+
+    /**
+     * 提交一帧，从不阻塞（只复制一次NV12数据）
+     * 可以直接在HV_Camera的图像帧回调中调用
+     * @param frame 图像帧
+     * @return 是否已入队（未在录制、队列满或尺寸不符时返回false）
+     */
+    bool pushFrame(const ImageFrame& frame);
+
+    /**
+     * 获取可直接传给HV_Camera::startImageFrameCapture的回调
+     * @return 调用pushFrame的帧回调
+     */
+    std::function<void(const ImageFrame&)> frameCallback();
+
+    /**
+     * 获取录制统计
+     * @return 统计信息
+     */
+    ApsRecorderStats getStats() const;
+
+    /**
+     * 设置写入线程的放置配置，在下次开始录制时生效
+     * @param role 线程角色（只支持Writer）
+     * @param placement 放置配置
+     * @return 是否设置成功（其他角色返回false）
+     */
+    bool setThreadPlacement(ThreadRole role, const ThreadPlacement& placement);
+
+    /**
+     * 获取写入线程实际生效的放置情况
+     * @return 每个已启动过的线程一项
+     */
+    std::vector<AppliedThreadPlacement> getThreadPlacementReport() const;
+
+    /**
+     * 获取运行指标快照（写入与丢弃帧数、队列深度、写入耗时与卡顿次数）
+     * @return 指标快照
+     */
+    MetricsSnapshot getMetricsSnapshot() const;
+
+    /**
+     * 开始定期把运行指标写出为Prometheus文本文件
+     * @param path 输出文件路径
+     * @param interval_ms 写出间隔（毫秒）
+     */
+    void startMetricsExport(const std::string& path, unsigned interval_ms = 1000);
+
+    /**
+     * 停止写出指标文件
+     */
+    void stopMetricsExport();
+
+private:
+    std::atomic<bool> recording_;
+    ApsRecordFormat format_;
+
+    // 录制器自己的缓冲池：队列中的帧不占用相机的接收缓冲
+    std::shared_ptr<ImageBufferPool> pool_;
+    std::deque<ImageFrame> queue_;
+    size_t max_queued_frames_;
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::atomic<bool> size_mismatch_reported_;
+
+    // 输出文件，仅写入线程访问
+    std::string output_filename_;
+    std::ofstream raw_file_;
+    cv::VideoWriter video_writer_;
+    std::ofstream index_file_;
+    cv::Mat bgr_;
+
+    std::thread writer_thread_;
+
+    std::atomic<uint64_t> frames_written_;
+    std::atomic<uint64_t> frames_dropped_;
+    std::atomic<uint64_t> bytes_written_;
+
+    // 线程放置
+    std::map<ThreadRole, ThreadPlacement> thread_placements_;          // 由placement_mutex_保护
+    std::map<std::string, AppliedThreadPlacement> applied_placements_; // 线程名 -> 实际生效的放置情况
+    mutable std::mutex placement_mutex_;
+
+    void writerThreadFunc();
+    void writeFrame(const ImageFrame& frame);
+
+    // 运行指标：提交端和写入线程各用一个分片
+    struct MetricIds {
+        int written_frames, dropped_frames, written_bytes, write_stalls;
+        int queued_frames;
+        int write_time;
+    };
+    static const uint64_t WRITE_STALL_THRESHOLD_US = 33000;  // 单帧写入超过一帧间隔（30fps）计为一次卡顿
+    MetricsRegistry metrics_;
+    MetricsExporter metrics_exporter_;   // 在metrics_之后声明，先于注册表析构
+    MetricIds metric_ids_;
+    MetricsShard push_metrics_;
+    MetricsShard writer_metrics_;
+    void registerMetrics();
+
+    // 禁止拷贝构造和赋值
+    HV_APS_Recorder(const HV_APS_Recorder&) = delete;
+    HV_APS_Recorder& operator=(const HV_APS_Recorder&) = delete;
+};
+
+} // namespace hv
+
+#endif // HV_APS_RECORDER_H
@@ -23,15 +23,31 @@
 #include <vector>
 #include <memory>
 #include <queue>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 // 引入Metavision事件数据结构
 #include <metavision/sdk/base/events/event_cd.h>
 #include <metavision/sdk/base/events/event2d.h>
 
+#include "hv_subframe_decoder.h"
+#include "hv_spsc_ring.h"
+#include "hv_device_selector.h"
+#include "hv_thread_placement.h"
+#include "hv_metrics.h"
+#include "hv_clock_sync.h"
+#include "hv_image_frame.h"
+
 // 前向声明，避免包含完整的USB设备头文件
 namespace hv {
     class USBDevice;
+    class USBContext;
+    class USBTransport;
 }
 
 // 定义常量
@@ -54,9 +70,152 @@ using EventCD = Metavision::EventCD;
 // 事件回调函数类型
 typedef std::function<void(const std::vector<EventCD>&)> EventCallback;
 
-// 图像回调函数类型
+// 紧凑事件包回调函数类型（按子帧分组，结构数组布局）
+typedef std::function<void(const EventPacket&)> EventPacketCallback;
+
+// 全幅ON/OFF位平面回调函数类型
+typedef std::function<void(const EventBitplaneFrame&)> EventBitplaneCallback;
+
+// 事件批次时间回调函数类型（在每个批次的事件回调之前调用）
+typedef std::function<void(const EventBatchTime&)> EventTimeCallback;
+
+// 事件订阅ID，0表示无效
+typedef uint64_t SubscriptionId;
+
+/**
+ * 订阅者队列满时的投递方式
+ */
+enum class DeliveryMode {
+    Lossless,   // 等待订阅者处理，不丢弃（会反压解码线程）
+    Lossy       // 丢弃订阅者队列中最老的批次，不影响其他订阅者
+};
+
+/**
+ * 订阅者统计
+ */
+struct SubscriberStats {
+    uint64_t delivered_batches = 0;     // 已回调的批次数
+    uint64_t dropped_batches = 0;       // Lossy模式下丢弃的批次数
+    size_t queued_batches = 0;          // 当前排队的批次数
+};
+
+/**
+ * 事件缓存队列满时的处理策略
+ */
+enum class QueueOverflowPolicy {
+    DropOldest,     // 丢弃最老的未解码数据（默认）
+    DropNewest,     // 丢弃新接收的数据
+    Block,          // 阻塞USB接收，直到有空闲缓冲（数据积压在设备端）
+    Decimate        // 空闲缓冲不足1/4时每N个子帧组只解码一个
+};
+
+/**
+ * 事件缓存队列统计
+ */
+struct EventQueueStats {
+    uint64_t received_buffers = 0;      // 收到的USB缓冲数（含不完整的缓冲）
+    uint64_t incomplete_buffers = 0;    // 不足一个子帧组的短传输数（数据仍交给解析器，不丢弃）
+    uint64_t dropped_newest = 0;        // 没有空闲缓冲而丢弃的新数据（缓冲数），DropOldest策略下处理线程跟不上时仍可能出现
+    uint64_t dropped_oldest = 0;        // 积压过多而丢弃的最老数据（缓冲数）
+    uint64_t decimated_groups = 0;      // 抽取模式下跳过解码的子帧组数
+    uint64_t invalid_subframes = 0;     // 子帧头校验失败（数据错位）次数，每次随后向后查找子帧头重新同步
+    uint64_t lost_subframes = 0;        // 按子帧编号跳变推算的丢失子帧数
+    uint64_t discarded_subframes = 0;   // 所在子帧组不完整而未解码的有效子帧数
+    uint64_t skipped_bytes = 0;         // 重新同步时跳过的字节数
+    uint64_t timestamp_discontinuities = 0; // 子帧时间戳回退或跳变超过1秒的次数
+    uint64_t blocked_us = 0;            // Block策略下USB接收累计阻塞时间（微秒）
+    uint64_t busy_poll_us = 0;          // 低延迟模式下处理线程忙等待数据的累计时间（微秒）
+    size_t queued_buffers = 0;          // 当前等待解码的缓冲数
+    size_t capacity_buffers = 0;        // 缓冲总数（内存预算 / 传输大小）
+    int usb_stream_error = 0;           // 异步传输因设备断开或端点持续出错而终止时的libusb_transfer_status，0表示正常
+};
+
+/**
+ * 采集启停耗时统计（微秒），-1表示尚未测得，每次启动采集时重新测量
+ */
+struct CaptureTimingStats {
+    int64_t event_start_us = -1;        // 启动事件采集函数的耗时
+    int64_t event_first_data_us = -1;   // 启动事件采集到第一个子帧组解码完成
+    int64_t event_stop_us = -1;         // stopEventCapture耗时（含等待线程退出、解码积压数据）
+    int64_t image_start_us = -1;        // startImageCapture耗时
+    int64_t image_first_frame_us = -1;  // 启动图像采集到第一帧图像回调
+    int64_t image_stop_us = -1;         // stopImageCapture耗时
+};
+
+/**
+ * 一个处理阶段的延迟分布（微秒），由指标直方图在桶内插值估算（误差约为数值的1/5以内）
+ */
+struct LatencyPercentiles {
+    uint64_t count = 0;                 // 观测次数（子帧组数）
+    double mean_us = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+};
+
+/**
+ * 事件数据各处理阶段的延迟，以子帧组（128KB）为单位，从所在USB传输完成时刻起算，每次启动采集时清零
+ */
+struct EventLatencyStats {
+    LatencyPercentiles queue_wait;      // 传输完成到开始解码（缓冲队列和解码任务队列中的等待）
+    LatencyPercentiles decode;          // 解码一个子帧组
+    LatencyPercentiles reorder_wait;    // 解码完成到开始回调（并行解码时等待前序子帧组）
+    LatencyPercentiles callback;        // 用户回调（含时间回调和向订阅者分发）
+    LatencyPercentiles end_to_end;      // 传输完成到回调返回
+};
+
+// 图像回调函数类型（BGR）
 typedef std::function<void(const cv::Mat&)> ImageCallback;
 
+// 零拷贝图像帧回调函数类型（NV12）
+typedef std::function<void(const ImageFrame&)> ImageFrameCallback;
+
+/**
+ * 共享事件批次中的一段连续事件，引用相机内部分发给订阅者的同一批次，不复制；
+ * 持有期间批次不会归还复用
+ */
+struct EventSlice {
+    std::shared_ptr<const std::vector<EventCD>> batch;
+    size_t offset = 0;
+    size_t count = 0;
+
+    const EventCD* begin() const {
+        return batch->data() + offset;
+    }
+
+    const EventCD* end() const {
+        return begin() + count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+};
+
+/**
+ * 一帧APS图像及上一帧到本帧之间的事件
+ * 事件时间范围为(begin_us, end_us]，end_us为本帧的ImageFrame::deviceTimestampUs()；
+ * 位平面输出模式下批次内事件不按时间排序，整批归入包含其最晚事件的帧
+ */
+struct ImageEventPair {
+    ImageFrame frame;
+    int64_t begin_us = -1;          // 上一帧的设备时间戳，启动后第一帧为-1（取缓存中本帧之前的全部事件）
+    int64_t end_us = -1;            // 本帧的设备时间戳，时钟映射尚未建立时为-1（此时不附带事件）
+    std::vector<EventSlice> events; // 按时间先后排列
+    bool complete = false;          // 区间内的事件是否全部给出（见startImageEventPairCapture）
+
+    size_t eventCount() const {
+        size_t total = 0;
+        for (const EventSlice& slice : events) {
+            total += slice.size();
+        }
+        return total;
+    }
+};
+
+// 图像与事件配对回调函数类型
+typedef std::function<void(const ImageEventPair&)> ImageEventPairCallback;
+
 /**
  * HV_Camera类 - 用于获取DVS相机的事件数据和图像数据
  */
@@ -69,6 +228,32 @@ public:
      */
     HV_Camera(uint16_t vendor_id, uint16_t product_id);
     
+    /**
+     * 构造函数，同一主机连接多台相机时按端口路径或序列号选择设备
+     * 所有相机默认共享同一个libusb上下文和USB事件线程，解码线程等仍为每台相机独立
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     * @param selector 设备选择条件
+     * @param context libusb上下文，为空时使用进程内默认共享的上下文
+     */
+    HV_Camera(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+              std::shared_ptr<USBContext> context = nullptr);
+
+    /**
+     * 构造函数，使用指定的USB传输实现
+     * 例如传入ReplayTransport，把HV_EVS_Recorder录制的原始文件当作相机回放，采集、解码等流程与真实设备相同
+     * @param transport 传输实现
+     */
+    explicit HV_Camera(std::unique_ptr<USBTransport> transport);
+    
+    /**
+     * 枚举所有匹配VID/PID的相机
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     * @return 设备信息列表（端口路径、序列号等）
+     */
+    static std::vector<DeviceInfo> listDevices(uint16_t vendor_id, uint16_t product_id);
+    
     /**
      * 析构函数
      */
@@ -91,6 +276,12 @@ public:
      */
     void close();
     
+    /**
+     * 获取已打开相机的设备信息
+     * @return 设备信息，未打开时各字段为空
+     */
+    DeviceInfo getDeviceInfo() const;
+    
     /**
      * 启动事件数据采集
      * @param callback 事件回调函数
@@ -98,34 +289,316 @@ public:
      */
     bool startEventCapture(EventCallback callback);
     
+    /**
+     * 以紧凑事件包形式启动事件数据采集
+     * 每个子帧的时间戳只存储一次，事件打包为32位x/y/p，回调数据量约为EventCD的1/4；
+     * 需要逐事件结构时可调用EventPacket::toEvents()转换为EventCD
+     * @param callback 事件包回调函数，每个128KB子帧组回调一次
+     * @return 是否成功启动
+     */
+    bool startEventPacketCapture(EventPacketCallback callback);
+    
+    /**
+     * 以全幅位平面形式启动事件数据采集
+     * 每组4个交织子帧输出一帧768x608的ON/OFF位掩码及各子帧时间戳，不逐事件展开，
+     * 适合直接在稠密图像上处理的场景（帧累积、可视化等）
+     * @param callback 位平面回调函数，每个128KB子帧组回调一次
+     * @return 是否成功启动
+     */
+    bool startEventBitplaneCapture(EventBitplaneCallback callback);
+    
     /**
      * 停止事件数据采集
+     * 取消排队的USB传输，等待接收、处理和解码线程处理完已接收的数据并退出后返回；
+     * 返回后可以立即重新启动采集
      */
     void stopEventCapture();
     
     /**
      * 启动图像数据采集
-     * @param callback 图像回调函数
+     * 每帧按setImageOutputFormat设置的格式转换后回调（默认全分辨率BGR）；
+     * 不需要转换时使用startImageFrameCapture
+     * @param callback 图像回调函数，图像内存在下一帧时复用，需要保留时应clone()
      * @return 是否成功启动
      */
     bool startImageCapture(ImageCallback callback);
     
+    /**
+     * 以零拷贝帧启动图像数据采集
+     * USB传输直接写入预分配的NV12缓冲池，回调得到引用该缓冲的ImageFrame，不复制、不做颜色转换；
+     * 持有ImageFrame期间缓冲不会被复用，同时持有过多帧时新到达的帧因没有空闲缓冲而丢弃
+     * @param callback 帧回调函数，可以为nullptr（只使用getLatestFrame/getLatestImage）
+     * @return 是否成功启动
+     */
+    bool startImageFrameCapture(ImageFrameCallback callback);
+    
+    /**
+     * 以图像与事件配对的形式启动图像数据采集
+     * 每帧APS图像与上一帧到本帧之间的事件一起回调；事件取自解码后分发给订阅者的同一共享批次，不复制。
+     * 需同时进行事件采集（任一startEvent*Capture），帧时间戳依赖事件流估计的设备时钟映射。
+     * 图像线程等待事件处理追上本帧时间戳（至多50ms）后回调；以下情况complete为false：
+     * 启动后第一帧、时钟映射尚未建立、等待超时、缓存的批次数超过history_batches而丢弃了区间内的批次、
+     * 设备时间倒退（设备重启等）后的第一帧。40位时间戳回绕（约91.6分钟一次）已按展开后的时间处理，不影响配对
+     * @param callback 配对回调函数，在图像线程中执行
+     * @param history_batches 缓存的事件批次数上限（每个128KB子帧组一个批次）
+     * @return 是否成功启动
+     */
+    bool startImageEventPairCapture(ImageEventPairCallback callback, size_t history_batches = 256);
+    
     /**
      * 停止图像数据采集
+     * 取消排队的USB传输，等待图像线程退出后返回
      */
     void stopImageCapture();
     
     /**
-     * 获取最新的图像
+     * 获取最新的图像（按setImageOutputFormat设置的格式，默认全分辨率BGR）
+     * 只在调用时转换最新一帧，同一帧重复获取时不再转换；返回的图像与其他调用者共享，不应修改，
+     * 需要修改时应clone()。尚未收到图像时返回全黑图像
      * @return 图像数据
      */
     cv::Mat getLatestImage() const;
     
+    /**
+     * 设置APS图像输出格式和区域
+     * 作用于startImageCapture的回调图像和getLatestImage，可在采集进行中修改，从下一帧起生效。
+     * Gray输出亮度平面区域的副本，零拷贝访问用startImageFrameCapture和ImageFrame::y()；
+     * BGRHalf/BGRQuarter的降采样与颜色转换在同一遍SIMD内核中完成；区域向内对齐到2像素（BGRQuarter为4像素）
+     * @param format 输出格式
+     * @param roi 源图像中的区域，默认全幅
+     * @return 区域超出768x608或对齐后为空时返回false，设置不变
+     */
+    bool setImageOutputFormat(ImageOutputFormat format, const cv::Rect& roi = cv::Rect());
+    
+    /**
+     * 获取APS图像输出配置（区域为对齐后的实际区域）
+     */
+    ImageOutputConfig getImageOutputConfig() const;
+    
+    /**
+     * 设置APS帧从曝光到USB传输完成的延迟（读出和传输时间）
+     * APS数据不带设备时间戳，ImageFrame::deviceTimestampUs()由传输完成时刻换算后减去该延迟，默认0
+     * @param offset_us 延迟（微秒）
+     */
+    void setImageTimestampOffset(int64_t offset_us);
+    
+    /**
+     * 获取最新的零拷贝图像帧（NV12）
+     * @return 图像帧，尚未收到图像时为空
+     */
+    ImageFrame getLatestFrame() const;
+    
     /**
      * 清空事件数据队列
-     * 用于在开始录制前清空缓存的事件数据
+     * 用于在开始录制前清空缓存的事件数据；采集进行中时由处理线程在下一次取数据时完成清空
      */
     void clearEventQueue();
+    
+    /**
+     * 设置事件解码线程数
+     * 大于1时，每个128KB子帧组作为独立任务由解码线程池并行处理，
+     * 结果按到达顺序重排后串行回调，保证事件按时间戳顺序输出
+     * @param num_threads 解码线程数（1为单线程解码，默认）
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setDecodeThreads(size_t num_threads);
+    
+    /**
+     * 获取事件解码线程数
+     * @return 解码线程数
+     */
+    size_t getDecodeThreads() const;
+    
+    /**
+     * 启用/禁用SIMD稀疏解码
+     * 启用时根据CPU能力选择AVX2/SSE2(x86)或NEON(aarch64)稀疏解码路径，禁用时使用标量逐像素解码；
+     * 两种路径输出的事件完全一致
+     * @param enable 是否启用SIMD解码
+     * @return 实际是否使用SIMD解码
+     */
+    bool setSIMDDecodeEnabled(bool enable);
+    
+    /**
+     * 查询当前是否使用SIMD解码
+     * @return 是否使用SIMD解码
+     */
+    bool isSIMDDecodeEnabled() const;
+    
+    /**
+     * 设置事件端点异步传输队列深度
+     * 大于0时在事件端点上保持该数量的USB传输同时排队（libusb异步传输），持续占满USB3带宽；
+     * 为0时使用同步批量传输（每次只有一个传输，重新提交期间总线空闲）；
+     * Block溢出策略总是使用同步批量传输，等待空闲缓冲只阻塞本相机的接收线程
+     * @param depth 排队传输数量（默认4，最大32）
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setTransferQueueDepth(size_t depth);
+    
+    /**
+     * 获取事件端点异步传输队列深度
+     * @return 排队传输数量，0表示同步传输
+     */
+    size_t getTransferQueueDepth() const;
+    
+    /**
+     * 设置事件端点单次USB传输的大小
+     * 数据在整个传输完成后才交给处理线程，传输越小首个子帧组等待越短，但每字节的传输和调度开销越大
+     * @param bytes 传输大小（字节），按128KB（一个子帧组）向下取整，范围128KB ~ 2MB，默认512KB
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setEventTransferSize(size_t bytes);
+    
+    /**
+     * 获取事件端点单次USB传输的大小
+     * @return 传输大小（字节）
+     */
+    size_t getEventTransferSize() const;
+    
+    /**
+     * 启用/禁用低延迟采集模式
+     * 启用时传输大小设为一个子帧组（128KB），每个子帧组到达后立即解码；处理线程忙等待新数据而不休眠，
+     * 持续占用一个CPU核心（忙等待时间见EventQueueStats::busy_poll_us）。禁用时恢复512KB传输和休眠等待。
+     * 启用后仍可用setEventTransferSize调整传输大小
+     * @param enable 是否启用
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setLowLatencyMode(bool enable);
+    
+    /**
+     * 查询是否启用低延迟采集模式
+     * @return 是否启用
+     */
+    bool isLowLatencyMode() const;
+    
+    /**
+     * 设置事件缓存队列内存预算
+     * 缓冲块在首次启动采集时按预算一次性分配，之后不再增长
+     * @param bytes 内存预算（字节），按传输大小取整，最少8块，最多4096块
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setEventQueueMemoryBudget(size_t bytes);
+    
+    /**
+     * 获取事件缓存队列内存预算
+     * @return 内存预算（字节）
+     */
+    size_t getEventQueueMemoryBudget() const;
+    
+    /**
+     * 设置事件缓存队列满时的处理策略
+     * @param policy 处理策略
+     * @param decimation Decimate策略下每N个子帧组解码一个（N >= 2）
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setQueueOverflowPolicy(QueueOverflowPolicy policy, size_t decimation = 2);
+    
+    /**
+     * 获取事件缓存队列满时的处理策略
+     * @return 处理策略
+     */
+    QueueOverflowPolicy getQueueOverflowPolicy() const;
+    
+    /**
+     * 获取事件缓存队列统计（丢弃计数等），每次启动采集时清零
+     * @return 统计信息
+     */
+    EventQueueStats getEventQueueStats() const;
+    
+    /**
+     * 获取事件数据各处理阶段（队列等待、解码、重排等待、用户回调）的延迟分位数，每次启动采集时清零
+     * 同一数据也以hv_camera_event_*_seconds直方图出现在指标中（自相机创建起累计）
+     * @return 延迟统计
+     */
+    EventLatencyStats getEventLatencyStats() const;
+    
+    /**
+     * 设置事件批次时间回调
+     * 在startEventCapture/startEventPacketCapture/startEventBitplaneCapture的回调之前、
+     * 于同一线程中调用，给出该批次首个子帧的设备时间戳及其映射到CLOCK_MONOTONIC的主机时间；
+     * 订阅者（subscribeEvents）的批次不附带时间，可用getClockMapping()自行换算
+     * @param callback 时间回调，传nullptr取消
+     * @return 是否设置成功（事件采集进行中时不可修改）
+     */
+    bool setEventTimeCallback(EventTimeCallback callback);
+    
+    /**
+     * 获取当前设备时钟到主机时钟（CLOCK_MONOTONIC）的映射，每个USB传输处理完后更新
+     * 可用ClockMapping::deviceUsToHostNs把EventCD::t换算为主机时间；每次启动采集时重新估计
+     * @return 映射快照，尚未收到数据时valid为false
+     */
+    ClockMapping getClockMapping() const;
+    
+    /**
+     * 订阅事件数据
+     * 每个订阅者拥有独立的有界队列和回调线程，慢订阅者不会阻塞其他订阅者（Lossless除外）；
+     * 事件批次以只读共享方式分发给所有订阅者，不复制。可在采集前或采集中随时订阅，
+     * 只使用订阅时可以 startEventCapture(nullptr) 启动采集
+     * 数据包/位平面输出模式下也分发EventCD批次（仅在有订阅者时展开，位平面模式按行优先排列）
+     * @param callback 事件回调函数，在订阅者自己的线程中执行
+     * @param mode 队列满时的投递方式
+     * @param queue_batches 队列容量（批次数，每个128KB子帧组一个批次）
+     * @return 订阅ID，失败返回0
+     */
+    SubscriptionId subscribeEvents(EventCallback callback, DeliveryMode mode = DeliveryMode::Lossy,
+                                   size_t queue_batches = 64);
+    
+    /**
+     * 取消订阅
+     * 订阅者线程处理完已排队的批次后退出
+     * @param id 订阅ID
+     * @return 是否找到该订阅
+     */
+    bool unsubscribeEvents(SubscriptionId id);
+    
+    /**
+     * 获取订阅者统计
+     * @param id 订阅ID
+     * @param stats 输出统计信息
+     * @return 是否找到该订阅
+     */
+    bool getSubscriberStats(SubscriptionId id, SubscriberStats& stats) const;
+    
+    /**
+     * 获取最近一次采集的启动、首帧数据和停止耗时
+     * @return 耗时统计
+     */
+    CaptureTimingStats getCaptureTimingStats() const;
+    
+    /**
+     * 设置采集线程的放置配置（CPU亲和性、SCHED_FIFO/RR优先级、nice值）
+     * 在线程下次启动时由线程自身应用；UsbReceive在异步传输时作用于共享libusb上下文的事件线程，
+     * 多台相机共享上下文时以最后启动采集的相机配置为准
+     * @param role 线程角色（UsbReceive、Processing、Decode、Image）
+     * @param placement 放置配置
+     * @return 是否设置成功（Writer不是相机线程，返回false）
+     */
+    bool setThreadPlacement(ThreadRole role, const ThreadPlacement& placement);
+    
+    /**
+     * 获取各采集线程实际生效的放置情况（线程启动时应用后从内核读回），包括应用失败的原因
+     * @return 每个已启动过的线程一项
+     */
+    std::vector<AppliedThreadPlacement> getThreadPlacementReport() const;
+    
+    /**
+     * 获取运行指标快照（USB传输字节数与耗时、队列深度、丢弃计数、每子帧解码耗时等）
+     * 指标自相机创建起单调累计，不随启停采集清零；读取不阻塞采集线程
+     * @return 指标快照
+     */
+    MetricsSnapshot getMetricsSnapshot() const;
+    
+    /**
+     * 开始定期把运行指标写出为Prometheus文本文件（先写临时文件再重命名）
+     * 设备已打开时样本带有device="<USB端口路径>"标签，便于区分多台相机
+     * @param path 输出文件路径
+     * @param interval_ms 写出间隔（毫秒）
+     */
+    void startMetricsExport(const std::string& path, unsigned interval_ms = 1000);
+    
+    /**
+     * 停止写出指标文件，停止前写出一次最终值
+     */
+    void stopMetricsExport();
 
 private:
     // USB设备
@@ -134,43 +607,321 @@ private:
     uint8_t image_endpoint_; // 图像数据端点
     
     // 线程控制
-    bool event_running_;
-    bool image_running_;
+    std::atomic<bool> event_running_;
+    std::atomic<bool> image_running_;
+    std::thread event_thread_;        // 同步传输时的USB接收线程
+    std::thread processing_thread_;
+    std::thread image_thread_;
     
     // 回调函数
     EventCallback event_callback_;
-    ImageCallback image_callback_;
+    EventPacketCallback event_packet_callback_;
+    EventBitplaneCallback event_bitplane_callback_;
+    EventTimeCallback event_time_callback_;
     
-    // 最新图像缓存
-    cv::Mat latest_image_;
+    // 事件输出形式
+    enum class EventOutput {
+        Events,     // std::vector<EventCD>
+        Packets,    // EventPacket
+        Bitplanes   // EventBitplaneFrame
+    };
+    EventOutput event_output_ = EventOutput::Events;
+    ImageCallback image_callback_;
+    ImageFrameCallback image_frame_callback_;
+    ImageEventPairCallback image_pair_callback_;
+    std::atomic<int64_t> image_timestamp_offset_us_{0};
     
-    // 互斥锁
+    // 最新图像帧（引用池中缓冲，不复制）和输出配置，由image_mutex_保护
+    ImageFrame latest_frame_;
+    ImageOutputConfig image_output_;
     mutable std::mutex image_mutex_;
     
-    // 事件数据缓存相关
-    struct EventDataBuffer {
-        std::unique_ptr<uint8_t[]> data;
-        size_t size;
-        EventDataBuffer(size_t s) : data(std::make_unique<uint8_t[]>(s)), size(s) {}
+    // getLatestImage的最近一次转换结果，同一帧、同一配置重复获取时直接返回
+    mutable cv::Mat latest_bgr_;
+    mutable uint64_t latest_bgr_sequence_ = UINT64_MAX;
+    mutable ImageOutputConfig latest_bgr_output_;
+    mutable std::mutex latest_bgr_mutex_;    // 加锁顺序：latest_bgr_mutex_ -> image_mutex_
+    
+    // 图像接收缓冲池：异步传输时2个排队传输，另有1个待处理帧、1个处理中帧和1个最新帧，
+    // 其余供调用者持有；处理不及时丢弃较旧的待处理帧
+    static const size_t IMAGE_TRANSFER_COUNT = 2;
+    static const size_t IMAGE_POOL_SIZE = 8;
+    std::shared_ptr<ImageBufferPool> image_pool_;
+    std::vector<unsigned char*> image_transfer_buffers_; // 排队中的传输缓冲，由image_frame_mutex_保护
+    unsigned char* ready_image_ = nullptr;             // 待处理帧，由image_frame_mutex_保护
+    int64_t ready_image_ns_ = 0;                       // 待处理帧的传输完成时刻
+    uint64_t image_sequence_ = 0;                      // 仅图像线程访问
+    std::mutex image_frame_mutex_;
+    std::condition_variable image_frame_cv_;
+    bool image_async_ = false;
+    
+    // 异步传输终止原因（libusb_transfer_status），由处理线程/图像线程在空闲时检查，每次启动采集时清零
+    std::atomic<bool> event_async_{false};
+    // DropOldest策略在空闲缓冲不多于该数量时丢弃最老数据：同步接收只需保留1块，
+    // 异步传输时每个排队的传输完成都要取一个空闲缓冲块，需保留排队深度+1块
+    std::atomic<size_t> drop_oldest_reserve_{1};
+    std::atomic<int> event_stream_error_{0};
+    std::atomic<int> image_stream_error_{0};
+    static const uint64_t STREAM_CHECK_INTERVAL_NS = 100000000ULL;
+    
+    // 启停耗时测量
+    std::chrono::steady_clock::time_point event_start_time_;
+    std::chrono::steady_clock::time_point image_start_time_;
+    std::atomic<bool> event_first_pending_{false};
+    std::atomic<bool> image_first_pending_{false};
+    std::atomic<int64_t> event_start_us_{-1};
+    std::atomic<int64_t> event_first_data_us_{-1};
+    std::atomic<int64_t> event_stop_us_{-1};
+    std::atomic<int64_t> image_start_us_{-1};
+    std::atomic<int64_t> image_first_frame_us_{-1};
+    std::atomic<int64_t> image_stop_us_{-1};
+    
+    // 事件数据缓存相关：固定数量的预分配缓冲块（slab），USB接收线程直接写入，
+    // 通过两个无锁环形队列在接收线程和处理线程之间传递块索引，避免逐次分配和拷贝
+    struct EventSlab {
+        unsigned char* data = nullptr;
+        bool device_memory = false;    // 是否由libusb_dev_mem_alloc分配
+        int bytes = 0;                 // 本次传输的有效字节数
+        int64_t completed_ns = 0;      // 传输完成时刻（CLOCK_MONOTONIC纳秒）
+        bool discontinuity = false;    // 接收端在此之前丢弃过数据，解析器需重新同步
+        std::atomic<int> pending_groups{0}; // 并行解码时尚未解码完成的子帧组数
     };
     
-    std::queue<std::unique_ptr<EventDataBuffer>> event_data_queue_;
+    std::unique_ptr<EventSlab[]> event_slabs_;         // event_slab_count_+1块，最后一块为队列满时的丢弃缓冲
+    size_t event_slab_count_ = 0;                      // 已分配的缓冲块数（不含丢弃缓冲）
+    size_t event_slab_bytes_ = 0;                      // 已分配缓冲块的大小
+    SPSCRing<uint32_t> filled_slabs_{MAX_EVENT_SLAB_COUNT}; // 接收线程 -> 处理线程
+    SPSCRing<uint32_t> free_slabs_{MAX_EVENT_SLAB_COUNT};   // 处理线程/解码线程 -> 接收线程
+    std::mutex slab_release_mutex_;              // 串行化free_slabs_的生产者（并行解码时有多个）
+    std::atomic<bool> processing_waiting_{false};
+    std::atomic<bool> clear_queue_requested_{false};
+    
+    // 队列内存预算与满队列策略
+    size_t event_queue_budget_ = DEFAULT_EVENT_SLAB_COUNT * HV_BUF_LEN;
+    size_t event_transfer_bytes_ = HV_BUF_LEN;   // 单次USB传输大小，也是缓冲块大小
+    bool low_latency_ = false;                   // 处理线程忙等待新数据
+    QueueOverflowPolicy overflow_policy_ = QueueOverflowPolicy::DropOldest;
+    size_t decimation_ = 2;
+    uint64_t decimation_counter_ = 0;            // 仅处理线程访问
+    std::mutex free_slab_mutex_;                 // Block策略下接收线程等待空闲缓冲
+    std::condition_variable free_slab_cv_;
+    std::atomic<bool> producer_waiting_{false};
+    
+    // 队列统计
+    std::atomic<uint64_t> received_buffers_{0};
+    std::atomic<uint64_t> incomplete_buffers_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> decimated_groups_{0};
+    std::atomic<uint64_t> invalid_subframes_{0};
+    std::atomic<uint64_t> lost_subframes_{0};
+    std::atomic<uint64_t> discarded_subframes_{0};
+    std::atomic<uint64_t> skipped_bytes_{0};
+    std::atomic<uint64_t> timestamp_discontinuities_{0};
+    bool receive_discontinuity_ = false;         // 仅USB接收线程或异步传输回调访问
+    
+    // 子帧流解析：校验子帧头和编号序列，错位时重新同步，仅处理线程访问
+    SubframeStreamParser stream_parser_;
+    SubframeStreamStats published_stream_stats_; // 已累加到上面统计中的解析器统计
+    
+    // 设备时钟映射：估计器仅处理线程访问，快照供getClockMapping读取
+    DeviceClockEstimator clock_estimator_;
+    ClockMapping clock_mapping_;
+    mutable std::mutex clock_mutex_;
+    std::atomic<uint64_t> blocked_us_{0};
+    std::atomic<uint64_t> busy_poll_us_{0};
+    std::unordered_map<const unsigned char*, uint32_t> slab_lookup_; // 缓冲区地址 -> 块索引
+    
+    // 异步传输
+    size_t transfer_queue_depth_ = 4;
+    static const size_t MAX_TRANSFER_QUEUE_DEPTH = 32;
     std::mutex event_queue_mutex_;
     std::condition_variable event_queue_cv_;
-    bool event_processing_running_;
-    static const size_t MAX_QUEUE_SIZE = 6000; // 最大缓存队列大小
+    std::atomic<bool> event_processing_running_;
+    static const size_t DEFAULT_EVENT_SLAB_COUNT = 64;  // 默认缓冲块数量（64 x 512KB = 32MB）
+    static const size_t MIN_EVENT_SLAB_COUNT = 8;
+    static const size_t MAX_EVENT_SLAB_COUNT = 4096;
+    static const size_t EVENT_GROUP_BYTES = HV_SUBFRAME_GROUP_BYTE_SIZE; // 传输大小的粒度（128KB）
+    static const size_t MAX_EVENT_TRANSFER_GROUPS = 16;  // 传输大小上限（2MB）
+    
+    // 一个子帧组的解码结果，按回调类型使用其中之一
+    struct DecodedGroup {
+        std::vector<EventCD> events;
+        EventPacket packet;
+        std::unique_ptr<EventBitplaneFrame> bitplane; // 仅位平面模式下分配
+        EventBatchTime time;
+        int64_t decode_start_ns = 0;    // CLOCK_MONOTONIC，与time.arrival_ns同一时钟
+        int64_t decode_end_ns = 0;
+    };
     
     // 性能优化：预分配事件数组
-    std::vector<EventCD> reusable_event_array_;
+    DecodedGroup reusable_group_;
     static const size_t ESTIMATED_EVENTS_PER_FRAME = 10000; // 预估每帧事件数
+    
+    // 子帧解码路径
+    SubframeDecodePath decode_path_ = SubframeDecodePath::Scalar;
+    
+    // 并行解码：每个子帧组为一个任务，按序号重排后回调
+    struct DecodeTask {
+        uint64_t seq;
+        uint32_t slab;
+        size_t offset;
+        EventBatchTime time;
+    };
+    size_t decode_threads_ = 1;
+    std::vector<std::thread> decode_workers_;
+    std::deque<DecodeTask> decode_tasks_;
+    std::mutex decode_task_mutex_;
+    std::condition_variable decode_task_cv_;   // 有新任务
+    std::condition_variable decode_space_cv_;  // 有空闲任务槽
+    uint64_t decode_next_seq_ = 0;
+    size_t decode_in_flight_ = 0;              // 已分发但未回调的子帧组数
+    bool decode_workers_running_ = false;
+    static const size_t MAX_DECODE_TASKS_PER_THREAD = 4;
+    
+    std::map<uint64_t, DecodedGroup> reorder_results_;
+    std::vector<DecodedGroup> reorder_pool_;
+    std::mutex reorder_mutex_;
+    uint64_t reorder_next_seq_ = 0;
+    bool reorder_delivering_ = false;
 
+    // 事件订阅者
+    typedef std::shared_ptr<const std::vector<EventCD>> EventBatch;
+    struct EventSubscriber {
+        SubscriptionId id = 0;
+        EventCallback callback;
+        DeliveryMode mode = DeliveryMode::Lossy;
+        size_t capacity = 0;
+        std::deque<EventBatch> queue;
+        std::mutex mutex;
+        std::condition_variable data_cv;
+        std::condition_variable space_cv;
+        bool running = true;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+        std::thread thread;
+    };
+    typedef std::vector<std::shared_ptr<EventSubscriber>> SubscriberList;
+    std::shared_ptr<const SubscriberList> subscribers_;   // 写时复制，atomic_load/atomic_store访问
+    mutable std::mutex subscribe_mutex_;                  // 串行化订阅/取消订阅
+    SubscriptionId next_subscription_id_ = 1;
+    
+    // 已分发批次的事件数组池，批次释放后归还复用
+    struct EventBatchPool {
+        std::mutex mutex;
+        std::vector<std::vector<EventCD>*> free;
+        ~EventBatchPool() {
+            for (auto* events : free) {
+                delete events;
+            }
+        }
+    };
+    std::shared_ptr<EventBatchPool> batch_pool_;
+    static const size_t MAX_POOLED_BATCHES = 256;
+    
+    // 图像与事件配对：事件回调线程追加已分发的批次，图像线程按帧时间戳切分，由pair_mutex_保护。
+    // 时间均为展开40位回绕后的设备tick（EventCD::t展开为距批次首个子帧最近的值），跨回绕仍单调
+    struct PairHistoryEntry {
+        EventBatch batch;
+        int64_t ref_ticks = 0;      // 批次首个子帧的展开时间戳（EventBatchTime::device_ticks）
+        int64_t first_ticks = 0;    // 批次内最早、最晚事件的展开时间戳
+        int64_t last_ticks = 0;
+        bool sorted = true;         // 批次内事件按时间排序（位平面模式下不排序）
+    };
+    static const int64_t PAIR_NO_TICKS = INT64_MIN;
+    std::atomic<bool> pair_enabled_{false};
+    std::deque<PairHistoryEntry> pair_history_;
+    size_t pair_history_capacity_ = 256;
+    int64_t pair_watermark_ticks_ = PAIR_NO_TICKS;  // 已分发的事件覆盖到的设备时间
+    int64_t pair_evicted_ticks_ = PAIR_NO_TICKS;    // 因超出容量丢弃的批次中最晚的事件时间
+    uint64_t pair_epoch_ = 0;                       // 设备时间倒退（设备重启、重新估计时钟）时加一，清空缓存
+    int64_t pair_prev_ticks_ = PAIR_NO_TICKS;       // 上一帧，仅图像线程访问
+    int64_t pair_prev_us_ = -1;
+    uint64_t pair_prev_epoch_ = 0;
+    std::mutex pair_mutex_;
+    std::condition_variable pair_cv_;
+    static const int PAIR_WAIT_MS = 50;
+    
     // 线程函数
-    void eventThreadFunc();           // USB接收线程
+    void eventThreadFunc();           // USB接收线程（同步传输）
+    unsigned char* onEventTransfer(unsigned char* buffer, int bytes, bool success); // 异步传输完成回调
     void eventProcessingThreadFunc(); // 事件处理线程
     void imageThreadFunc();
+    unsigned char* onImageTransfer(unsigned char* buffer, int bytes, bool success); // 图像异步传输完成回调
+    void processImageFrame(const ImageFrame& frame);
+    void checkAsyncStream(uint8_t endpoint, std::atomic<int>& error, MetricsShard& metrics, const char* name);
+    int64_t imageDeviceUs(int64_t completed_ns) const;
+    void deliverImageEventPair(const ImageFrame& frame);
+    void recordPairBatch(const EventBatch& batch, const EventBatchTime& time);
+    bool startImageStream(ImageCallback callback, ImageFrameCallback frame_callback,
+                          ImageEventPairCallback pair_callback, size_t history_batches);
+    bool allocateImageBuffers();
+    void freeImageBuffers();
     
     // 处理事件数据
-    void processEventData(uint8_t* dataPtr);
+    void processEventData(const uint8_t* dataPtr, const EventBatchTime& time);
+    void processEventSlab(uint32_t slab);
+    void publishStreamStats();
+    EventBatchTime timeEventGroup(const uint8_t* dataPtr, int64_t completed_ns);
+    
+    // 缓冲块管理
+    size_t eventSlabCount() const;
+    bool allocateEventSlabs();
+    void freeEventSlabs();
+    void resetEventSlabs();
+    bool acquireEventSlab(uint32_t& slab);
+    void publishEventSlab(uint32_t slab, int bytes, int64_t completed_ns);
+    void releaseEventSlab(uint32_t slab);
+    void drainFilledSlabs();
+    void decodeEventGroup(const uint8_t* dataPtr, DecodedGroup& group) const;
+    void decodeTimed(const uint8_t* dataPtr, DecodedGroup& group, const MetricsShard& metrics) const;
+    void deliverEventGroup(DecodedGroup& group);
+    EventBatch makeEventBatch(std::vector<EventCD>& events);
+    void publishEventBatch(const SubscriberList& subscribers, const EventBatch& batch);
+    void subscriberThreadFunc(std::shared_ptr<EventSubscriber> subscriber);
+    void stopSubscriber(const std::shared_ptr<EventSubscriber>& subscriber);
+    bool startEventStream(EventOutput output, EventCallback callback,
+                          EventPacketCallback packet_callback, EventBitplaneCallback bitplane_callback);
+    
+    // 并行解码
+    void startDecodeWorkers();
+    void stopDecodeWorkers();
+    void dispatchEventGroup(uint32_t slab, size_t offset, const EventBatchTime& time);
+    void decodeEventGroupInOrder(const uint8_t* dataPtr, const EventBatchTime& time);
+    bool reserveDecodeSeq(std::unique_lock<std::mutex>& lock, uint64_t& seq); // 需持有decode_task_mutex_
+    DecodedGroup acquireDecodedGroup();
+    void decodeWorkerFunc(size_t index);
+    void deliverInOrder(uint64_t seq, DecodedGroup&& group);
+    
+    // 线程放置
+    std::map<ThreadRole, ThreadPlacement> thread_placements_;          // 由placement_mutex_保护
+    std::map<std::string, AppliedThreadPlacement> applied_placements_; // 线程名 -> 实际生效的放置情况
+    mutable std::mutex placement_mutex_;
+    void applyThreadPlacement(ThreadRole role, const std::string& name);  // 由线程自身在启动时调用
+    void applyUsbThreadPlacement();
+    
+    // 运行指标：每个写入线程使用自己的分片，热路径上只做无锁原子加
+    struct MetricIds {
+        int usb_transfers, usb_transfer_errors, usb_stream_failures, usb_bytes, incomplete_buffers, busy_poll_us;
+        int dropped_newest, dropped_oldest, decimated_groups, processed_buffers, decoded_groups;
+        int invalid_subframes, lost_subframes, discarded_subframes, skipped_bytes, timestamp_discontinuities;
+        int image_frames, image_dropped_frames, image_incomplete_pairs;
+        int queued_buffers, free_buffers, clock_drift, clock_jitter, transfer_bytes;
+        int usb_transfer_time, decode_subframe_time, block_wait_time, image_convert_time;
+        int queue_wait_time, decode_group_time, reorder_wait_time, callback_time, end_to_end_time;
+    };
+    MetricsRegistry metrics_;
+    MetricsExporter metrics_exporter_;   // 在metrics_之后声明，先于注册表析构
+    MetricIds metric_ids_;
+    MetricsShard usb_metrics_;           // USB接收线程或异步传输回调（libusb事件线程）
+    MetricsShard processing_metrics_;
+    MetricsShard image_metrics_;
+    std::vector<MetricsShard> decode_metrics_; // 每个解码线程一个
+    MetricsShard delivery_metrics_;      // 回调线程（串行回调，可能是处理线程或任一解码线程）
+    std::vector<MetricSample> latency_baseline_; // 启动采集时的各阶段延迟直方图，用于按次清零
+    mutable std::mutex latency_mutex_;
+    std::chrono::steady_clock::time_point last_event_transfer_; // 仅异步传输回调访问
+    void registerMetrics();
     
     // 禁止拷贝构造和赋值
     HV_Camera(const HV_Camera&) = delete;
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_CLOCK_SYNC_H
+#define HV_CLOCK_SYNC_H
+
+/*
+ * 设备时钟到主机时钟的映射（仅头文件）
+ *
+ * 子帧时间戳是40位设备计数（200个tick为1μs，约91.6分钟回绕一次），与主机时间无关。
+ * DeviceClockEstimator以“子帧时间戳 - USB传输完成时刻（CLOCK_MONOTONIC）”为样本，
+ * 在滑动窗口上做线性回归估计设备时钟相对主机的频率（漂移），并取样本的下包络作为偏移：
+ * 传输完成时刻总是晚于数据产生时刻，下包络对应延迟最小的样本，
+ * 因此映射得到的主机时间不晚于数据实际到达主机的时间。
+ */
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "hv_subframe_decoder.h"
+
+namespace hv {
+
+/**
+ * 一批事件的两种时间基准
+ */
+struct EventBatchTime {
+    int64_t device_ticks = 0;   // 批次首个子帧的设备时间戳（tick，已展开40位回绕）
+    int64_t device_us = 0;      // 同上，微秒；未回绕时与EventCD::t相同
+    int64_t host_ns = -1;       // device_ticks映射到CLOCK_MONOTONIC的时间（纳秒），映射尚未建立时为-1
+    int64_t arrival_ns = 0;     // 收齐该批次数据的USB传输完成时刻（CLOCK_MONOTONIC纳秒）
+};
+
+/**
+ * 把40位原始时间戳展开为距ref_ticks（已展开）最近的值
+ */
+inline int64_t unwrapTicks(uint64_t raw_ticks, int64_t ref_ticks) {
+    const uint64_t delta = (raw_ticks - static_cast<uint64_t>(ref_ticks)) & HV_SUBFRAME_TIMESTAMP_MASK;
+    const int64_t half = static_cast<int64_t>((HV_SUBFRAME_TIMESTAMP_MASK + 1) / 2);
+    const int64_t signed_delta = static_cast<int64_t>(delta) >= half
+        ? static_cast<int64_t>(delta) - 2 * half : static_cast<int64_t>(delta);
+    return ref_ticks + signed_delta;
+}
+
+/**
+ * 某一时刻的时钟映射估计
+ * host_ns = ref_host_ns + (device_ticks - ref_ticks) * ns_per_tick
+ */
+struct ClockMapping {
+    bool valid = false;             // 至少有一个样本
+    bool fitted = false;            // 样本足够，斜率为拟合值；否则为标称值
+    int64_t ref_ticks = 0;          // 参考点（展开后的设备时间戳）
+    int64_t ref_host_ns = 0;        // 参考点对应的主机时间
+    double ns_per_tick = 1000.0 / HV_SUBFRAME_TICKS_PER_US;
+    double drift_ppm = 0;           // 设备时钟相对标称频率的偏差，正值表示设备时钟偏快
+    double jitter_ns = 0;           // 各桶最小延迟样本相对拟合直线的残差标准差
+    uint64_t wraps = 0;             // 40位计数器回绕次数
+    uint64_t resets = 0;            // 设备时间与主机时间不一致（设备重启等）而重新估计的次数
+    size_t samples = 0;             // 参与拟合的样本数（桶数）
+
+    /**
+     * 设备时间戳（tick，已展开）映射为主机时间（纳秒）
+     */
+    int64_t toHostNs(int64_t device_ticks) const {
+        return ref_host_ns + static_cast<int64_t>(std::llround(static_cast<double>(device_ticks - ref_ticks) * ns_per_tick));
+    }
+
+    /**
+     * 把40位原始时间戳展开为距参考点最近的值
+     */
+    int64_t unwrap(uint64_t raw_ticks) const {
+        return unwrapTicks(raw_ticks, ref_ticks);
+    }
+
+    /**
+     * 事件时间戳（EventCD::t，微秒）映射为主机时间（纳秒），映射尚未建立时返回-1
+     */
+    int64_t deviceUsToHostNs(int64_t device_us) const {
+        if (!valid) {
+            return -1;
+        }
+        return toHostNs(unwrap(static_cast<uint64_t>(device_us) * HV_SUBFRAME_TICKS_PER_US));
+    }
+
+    /**
+     * 主机时间（CLOCK_MONOTONIC纳秒）映射为设备时间戳（微秒，与EventCD::t同一基准，按40位计数回绕），
+     * 映射尚未建立时返回-1
+     */
+    int64_t hostNsToDeviceUs(int64_t host_ns) const {
+        if (!valid) {
+            return -1;
+        }
+        const int64_t ticks = ref_ticks + static_cast<int64_t>(std::llround(static_cast<double>(host_ns - ref_host_ns) / ns_per_tick));
+        return static_cast<int64_t>((static_cast<uint64_t>(ticks) & HV_SUBFRAME_TIMESTAMP_MASK) / HV_SUBFRAME_TICKS_PER_US);
+    }
+};
+
+/**
+ * 设备时钟估计器，非线程安全
+ *
+ * USB传输延迟抖动远大于时钟漂移，直接对每个传输做回归误差很大；
+ * 因此先按SAMPLE_INTERVAL_NS分桶，每桶只保留延迟最小的样本，再对这些样本做回归。
+ */
+class DeviceClockEstimator {
+public:
+    static const size_t DEFAULT_WINDOW = 600;       // 滑动窗口桶数（默认覆盖约60秒）
+    static const size_t MIN_FIT_SAMPLES = 16;       // 少于该桶数时使用标称斜率
+    static const int64_t SAMPLE_INTERVAL_NS = 100000000LL; // 每桶时长（100ms）
+    static constexpr double MAX_DRIFT_PPM = 1000;   // 拟合斜率偏离标称值超过该值时视为异常，使用标称斜率
+    static const int64_t MAX_STEP_ERROR_NS = 1000000000LL; // 相邻样本设备时间与主机时间增量相差超过1秒时重新估计
+
+    explicit DeviceClockEstimator(size_t window = DEFAULT_WINDOW)
+        : window_(window < MIN_FIT_SAMPLES ? MIN_FIT_SAMPLES : window) {
+        samples_.reserve(window_);
+    }
+
+    void reset() {
+        const uint64_t wraps = mapping_.wraps;
+        const uint64_t resets = mapping_.resets;
+        clearWindow();
+        have_last_ = false;
+        mapping_ = ClockMapping();
+        mapping_.wraps = wraps;
+        mapping_.resets = resets;
+    }
+
+    /**
+     * 展开40位原始时间戳（相对最近一次样本），不修改状态
+     */
+    int64_t unwrap(uint64_t raw_ticks) const {
+        if (!have_last_) {
+            return static_cast<int64_t>(raw_ticks & HV_SUBFRAME_TIMESTAMP_MASK);
+        }
+        ClockMapping ref;
+        ref.ref_ticks = last_ticks_;
+        return ref.unwrap(raw_ticks);
+    }
+
+    /**
+     * 加入一个样本
+     * @param raw_ticks 子帧的40位原始时间戳
+     * @param host_ns 包含该子帧的USB传输完成时刻（CLOCK_MONOTONIC纳秒）
+     * @return 展开后的设备时间戳
+     */
+    int64_t addSample(uint64_t raw_ticks, int64_t host_ns) {
+        raw_ticks &= HV_SUBFRAME_TIMESTAMP_MASK;
+        int64_t ticks = static_cast<int64_t>(raw_ticks);
+        if (have_last_) {
+            ticks = unwrap(raw_ticks);
+            if (ticks > last_ticks_ && raw_ticks < (static_cast<uint64_t>(last_ticks_) & HV_SUBFRAME_TIMESTAMP_MASK)) {
+                mapping_.wraps++;
+            }
+            // 设备时间与主机时间的增量明显不一致（时间戳跳变、设备重启）时丢弃旧样本
+            const double device_step_ns = static_cast<double>(ticks - last_ticks_) * (1000.0 / HV_SUBFRAME_TICKS_PER_US);
+            if (std::fabs(device_step_ns - static_cast<double>(host_ns - last_host_ns_)) > MAX_STEP_ERROR_NS) {
+                clearWindow();
+                mapping_.resets++;
+            }
+        }
+        have_last_ = true;
+        last_ticks_ = ticks;
+        last_host_ns_ = host_ns;
+
+        const Sample sample{ticks, host_ns};
+        if (!have_bucket_) {
+            have_bucket_ = true;
+            bucket_start_ns_ = host_ns;
+            bucket_best_ = sample;
+        } else if (host_ns - bucket_start_ns_ >= SAMPLE_INTERVAL_NS) {
+            // 上一个桶结束：其最小延迟样本进入窗口，重新拟合
+            pushSample(bucket_best_);
+            bucket_start_ns_ = host_ns;
+            bucket_best_ = sample;
+            fit();
+            return ticks;
+        } else if (lowerThan(sample, bucket_best_)) {
+            bucket_best_ = sample;
+        }
+
+        if (samples_.size() < MIN_FIT_SAMPLES) {
+            fit();
+        } else if (mapping_.toHostNs(ticks) > host_ns) {
+            // 新样本低于当前下包络，立即下移偏移，保证映射结果不晚于到达时刻
+            mapping_.ref_host_ns -= mapping_.toHostNs(ticks) - host_ns;
+        }
+        return ticks;
+    }
+
+    /**
+     * 获取当前映射
+     */
+    const ClockMapping& mapping() const {
+        return mapping_;
+    }
+
+private:
+    struct Sample {
+        int64_t ticks;
+        int64_t host_ns;
+    };
+
+    const size_t window_;
+    std::vector<Sample> samples_;   // 各桶的最小延迟样本，环形缓冲
+    size_t head_ = 0;               // 窗口已满时最老样本的位置
+    bool have_bucket_ = false;
+    int64_t bucket_start_ns_ = 0;
+    Sample bucket_best_{0, 0};      // 当前桶内延迟最小的样本
+    bool have_last_ = false;
+    int64_t last_ticks_ = 0;
+    int64_t last_host_ns_ = 0;
+    ClockMapping mapping_;
+
+    // 以标称斜率比较两个样本的传输延迟
+    static bool lowerThan(const Sample& a, const Sample& b) {
+        const double nominal = 1000.0 / HV_SUBFRAME_TICKS_PER_US;
+        return static_cast<double>(a.host_ns - b.host_ns) < nominal * static_cast<double>(a.ticks - b.ticks);
+    }
+
+    void clearWindow() {
+        samples_.clear();
+        head_ = 0;
+        have_bucket_ = false;
+    }
+
+    void pushSample(const Sample& sample) {
+        if (samples_.size() < window_) {
+            samples_.push_back(sample);
+        } else {
+            samples_[head_] = sample;
+            head_ = (head_ + 1) % window_;
+        }
+    }
+
+    template <typename F>
+    void forEachSample(F f) const {
+        for (const Sample& s : samples_) {
+            f(s);
+        }
+        if (have_bucket_) {
+            f(bucket_best_);
+        }
+    }
+
+    void fit() {
+        const double nominal = 1000.0 / HV_SUBFRAME_TICKS_PER_US;
+        const size_t n = samples_.size() + (have_bucket_ ? 1 : 0);
+        // 以最新样本为原点计算，避免大数相减损失精度
+        const int64_t ref_ticks = last_ticks_;
+        const int64_t ref_host_ns = last_host_ns_;
+
+        double slope = nominal;
+        double jitter = 0;
+        bool fitted = false;
+        if (samples_.size() >= MIN_FIT_SAMPLES) {
+            double sx = 0, sy = 0;
+            forEachSample([&](const Sample& s) {
+                sx += static_cast<double>(s.ticks - ref_ticks);
+                sy += static_cast<double>(s.host_ns - ref_host_ns);
+            });
+            const double mx = sx / n, my = sy / n;
+            double sxx = 0, sxy = 0;
+            forEachSample([&](const Sample& s) {
+                const double dx = static_cast<double>(s.ticks - ref_ticks) - mx;
+                const double dy = static_cast<double>(s.host_ns - ref_host_ns) - my;
+                sxx += dx * dx;
+                sxy += dx * dy;
+            });
+            if (sxx > 0) {
+                const double fitted_slope = sxy / sxx;
+                if (std::fabs(fitted_slope / nominal - 1.0) * 1e6 <= MAX_DRIFT_PPM) {
+                    slope = fitted_slope;
+                    fitted = true;
+                }
+            }
+            double sr = 0;
+            forEachSample([&](const Sample& s) {
+                const double r = static_cast<double>(s.host_ns - ref_host_ns) - my
+                               - slope * (static_cast<double>(s.ticks - ref_ticks) - mx);
+                sr += r * r;
+            });
+            jitter = std::sqrt(sr / n);
+        }
+
+        // 偏移取下包络：所有样本中“主机时间 - 斜率 × 设备时间”的最小值
+        double min_offset = 0;   // 最新样本自身的偏移为0
+        forEachSample([&](const Sample& s) {
+            const double offset = static_cast<double>(s.host_ns - ref_host_ns)
+                                - slope * static_cast<double>(s.ticks - ref_ticks);
+            min_offset = std::min(min_offset, offset);
+        });
+
+        mapping_.valid = true;
+        mapping_.fitted = fitted;
+        mapping_.ref_ticks = ref_ticks;
+        mapping_.ref_host_ns = ref_host_ns + static_cast<int64_t>(std::llround(min_offset));
+        mapping_.ns_per_tick = slope;
+        mapping_.drift_ppm = (nominal / slope - 1.0) * 1e6;
+        mapping_.jitter_ns = jitter;
+        mapping_.samples = n;
+    }
+};
+
+} // namespace hv
+
+#endif // HV_CLOCK_SYNC_H
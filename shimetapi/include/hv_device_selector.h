@@ -0,0 +1,63 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_DEVICE_SELECTOR_H
+#define HV_DEVICE_SELECTOR_H
+
+#include <cstdint>
+#include <string>
+
+namespace hv {
+
+/**
+ * 同一主机上连接多台相同VID/PID相机时，用于选择具体设备的条件
+ * 两个字段都为空时选择第一台匹配VID/PID的设备；都不为空时两者都须匹配
+ */
+struct DeviceSelector {
+    std::string port_path;      // USB物理端口路径，格式为"总线-端口.端口..."，如"2-1.3"，与sysfs中的设备名一致
+    std::string serial_number;  // 设备序列号（iSerialNumber字符串描述符）
+
+    bool empty() const {
+        return port_path.empty() && serial_number.empty();
+    }
+
+    static DeviceSelector byPortPath(const std::string& path) {
+        DeviceSelector selector;
+        selector.port_path = path;
+        return selector;
+    }
+
+    static DeviceSelector bySerialNumber(const std::string& serial) {
+        DeviceSelector selector;
+        selector.serial_number = serial;
+        return selector;
+    }
+};
+
+/**
+ * 枚举到的USB设备信息
+ */
+struct DeviceInfo {
+    uint16_t vendor_id = 0;
+    uint16_t product_id = 0;
+    uint8_t bus = 0;            // 总线号
+    uint8_t address = 0;        // 设备地址（每次插拔会变化）
+    std::string port_path;      // USB物理端口路径，插在同一端口上时保持不变
+    std::string serial_number;  // 序列号，设备无序列号或无权限读取时为空
+};
+
+} // namespace hv
+
+#endif // HV_DEVICE_SELECTOR_H
@@ -21,6 +21,8 @@
 #include <metavision/sdk/base/utils/timestamp.h>
 #include <metavision/sdk/base/events/event_cd.h>
 
+#include "hv_subframe_decoder.h"
+
 // 优化的事件编码格式：使用64位来存储事件
 // timestamp : 43位 (支持更长的时间戳)
 // x坐标    : 10位 (支持0-1023像素)
@@ -120,4 +122,28 @@ inline void decode_hv_events_batch(const std::vector<HVEventsFormat>& encoded_ev
     }
 }
 
+/**
+ * 子帧解码输出策略：直接输出编码后的事件
+ * 用法：hv::decodeSubframeGroup(data, policy)
+ */
+struct HVEventsFormatPolicy {
+    static constexpr bool kDecodePixels = true;
+
+    std::vector<HVEventsFormat>& encoded_events;
+    Metavision::timestamp timestamp = 0;
+
+    explicit HVEventsFormatPolicy(std::vector<HVEventsFormat>& out) : encoded_events(out) {}
+
+    bool beginSubframe(const hv::SubframeHeader& hdr) {
+        timestamp = static_cast<Metavision::timestamp>(hdr.timestamp);
+        return true;
+    }
+
+    void emit(int x, int y, int p) {
+        encoded_events.push_back(0);
+        encode_hv_event(encoded_events.back(), static_cast<unsigned short>(x),
+                        static_cast<unsigned short>(y), static_cast<short>(p), timestamp);
+    }
+};
+
 #endif // HV_EVENTS_FORMAT_H
\ No newline at end of file
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_EVS_RECORDER_H
+#define HV_EVS_RECORDER_H
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <deque>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+
+#include "hv_thread_placement.h"
+#include "hv_metrics.h"
+#include "hv_record_writer.h"
+
+// 定义常量
+#define HV_BUF_LEN (4096 * 128)
+#define HV_SUB_FULL_BYTE_SIZE (32768)
+#define HV_SUB_VALID_BYTE_SIZE (29200)
+
+namespace hv {
+
+// 前向声明
+class USBDevice;
+class USBTransport;
+class BufferPool;
+
+/**
+ * 录制分段配置
+ * 启用分段后文件名依次为<stem>_0000<ext>、<stem>_0001<ext>…，每段只包含完整的USB缓冲，可单独解析；
+ * 每段结束时向清单<stem>_segments.csv追加一行（段号、文件名、字节数、缓冲数、首末子帧的设备时间戳）
+ */
+struct RecordSegmentOptions {
+    uint64_t max_bytes = 0;          // 每段最大字节数，0表示不按大小分段
+    unsigned max_seconds = 0;        // 每段最长时间（秒），0表示不按时间分段
+    uint64_t preallocate_bytes = 0;  // 每段预分配的字节数，0表示按max_bytes预分配
+
+    bool enabled() const {
+        return max_bytes > 0 || max_seconds > 0;
+    }
+};
+
+/**
+ * 触发录制（飞行记录仪）配置
+ * 启用后不再录制全部数据：写入线程把最近的USB缓冲保留在内存环中，触发时把环中数据和触发后
+ * post_trigger_seconds内的数据写入<stem>_trigger_0000<ext>、<stem>_trigger_0001<ext>…，
+ * 每个片段结束时向<stem>_triggers.csv追加一行（列与分段清单相同）
+ */
+struct FlightRecorderOptions {
+    bool enabled = false;
+    double pre_trigger_seconds = 5.0;    // 触发前保留的时长
+    double post_trigger_seconds = 5.0;   // 触发后继续写入的时长，片段写入期间再次触发时从该次触发起延长
+    size_t ring_buffers = 512;           // 内存环最多保留的512KB缓冲数（默认256MB），实际保留时长取两者中较短者
+    uint64_t event_rate_threshold = 0;   // 事件率（事件/秒）升至该值时自动触发，0表示只由trigger()触发
+};
+
+/**
+ * HV_EVS_Recorder类 - 将事件端点的原始数据直接录制到文件
+ * 录制线程负责USB接收，写入线程负责写文件，两者通过队列解耦，接收缓冲本身经队列传递，不复制；
+ * 写入线程把多个缓冲拼成对齐的大块，经io_uring/O_DIRECT提交（见hv_record_writer.h）
+ */
+class HV_EVS_Recorder {
+public:
+    /**
+     * 构造函数
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     */
+    HV_EVS_Recorder(uint16_t vendor_id, uint16_t product_id);
+
+    /**
+     * 构造函数，使用指定的USB传输实现（如ReplayTransport）
+     * @param transport 传输实现
+     */
+    explicit HV_EVS_Recorder(std::unique_ptr<USBTransport> transport);
+
+    /**
+     * 析构函数
+     */
+    ~HV_EVS_Recorder();
+
+    /**
+     * 打开设备
+     * @return 是否成功打开设备
+     */
+    bool open();
+
+    /**
+     * 检查设备是否已打开
+     * @return 设备是否已打开
+     */
+    bool isOpen() const;
+
+    /**
+     * 关闭设备
+     */
+    void close();
+
+    /**
+     * 开始录制
+     * @param filename 输出文件名
+     * @param enable_timestamp_analysis 是否同时输出子帧时间戳分析CSV
+     * @return 是否成功开始录制
+     */
+    bool startRecording(const std::string& filename, bool enable_timestamp_analysis = false);
+
+    /**
+     * 停止录制，等待队列中的数据写入完成
+     * @return 本次录制的数据是否全部写入（写入、切换分段或关闭文件失败时返回false，原因见getWriteError()）
+     */
+    bool stopRecording();
+
+    /**
+     * 检查是否正在录制
+     * @return 是否正在录制
+     */
+    bool isRecording() const;
+
+    /**
+     * 检查本次录制是否发生写入错误
+     * 写入、切换分段或创建片段文件失败后录制线程继续接收，但之后的数据不再写入文件（计入hv_recorder_write_errors_total），
+     * 清单中也不再记录未能创建的文件；应停止录制并检查磁盘
+     * @return 是否发生写入错误，开始录制时清除
+     */
+    bool hasWriteError() const;
+
+    /**
+     * 获取本次录制的第一个写入错误
+     * @return 错误信息，没有错误时为空
+     */
+    std::string getWriteError() const;
+
+    /**
+     * 获取录制统计
+     * @param total_bytes 输出：总字节数
+     * @param total_frames 输出：总缓冲数
+     * @param avg_transfer_time 输出：平均USB传输时间（微秒）
+     */
+    void getRecordingStats(uint64_t& total_bytes, uint64_t& total_frames, uint64_t& avg_transfer_time) const;
+
+    /**
+     * 设置文件写入配置（后端、在途写请求数、每次提交的块大小），在下次开始录制时生效
+     * 默认Auto：优先io_uring + O_DIRECT，不可用时依次退回O_DIRECT同步写入、经页缓存写入
+     * @param options 写入配置
+     * @return 是否设置成功（录制进行中时返回false）
+     */
+    bool setWriteOptions(const RecordWriterOptions& options);
+
+    /**
+     * 获取本次（或上次）录制实际使用的写入后端
+     * @return 写入后端，尚未开始录制时为Auto
+     */
+    RecordWriteBackend getWriteBackend() const;
+
+    /**
+     * 设置录制分段（按大小和/或时间切换到新文件），在下次开始录制时生效
+     * 切换在写入线程中完成（写完当前段、创建并预分配下一段），期间接收到的数据在缓冲池中排队，录制线程不暂停
+     * @param options 分段配置，max_bytes和max_seconds都为0时不分段（默认）
+     * @return 是否设置成功（录制进行中时返回false）
+     */
+    bool setSegmentOptions(const RecordSegmentOptions& options);
+
+    /**
+     * 设置触发录制模式，在下次开始录制时生效
+     * 启用后startRecording的文件名只作为片段文件名的前缀，分段配置中只有preallocate_bytes起作用；
+     * 每个片段文件在上一个片段结束时预先创建并预分配，写入器在整个录制期间只打开一次；
+     * 接收缓冲池在setBufferCount的数量之外再加上ring_buffers个缓冲
+     * @param options 触发录制配置
+     * @return 是否设置成功（录制进行中或配置无效时返回false）
+     */
+    bool setFlightRecorderOptions(const FlightRecorderOptions& options);
+
+    /**
+     * 触发一次片段写入（触发录制模式），可在任意线程调用，立即返回
+     * 片段的写入在写入线程中进行，接收不中断
+     * @return 是否已提交（未在触发录制模式下录制时返回false）
+     */
+    bool trigger();
+
+    /**
+     * 设置USB接收缓冲数量（每个512KB），在下次开始录制时生效
+     * 缓冲直接经写入队列交给写入线程，写完后归还，因此缓冲数即写入队列的最大深度；
+     * 全部缓冲都在排队时录制线程等待写入线程归还（计入hv_recorder_pool_exhausted_total），不再分配新内存
+     * @param buffers 缓冲数量（至少2，默认64，即32MB）
+     * @return 是否设置成功（录制进行中或数量过少时返回false）
+     */
+    bool setBufferCount(size_t buffers);
+
+    /**
+     * 设置录制线程的放置配置（CPU亲和性、SCHED_FIFO/RR优先级、nice值），在下次开始录制时生效
+     * @param role 线程角色（UsbReceive为录制线程，Writer为写入线程）
+     * @param placement 放置配置
+     * @return 是否设置成功（其他角色返回false）
+     */
+    bool setThreadPlacement(ThreadRole role, const ThreadPlacement& placement);
+
+    /**
+     * 获取录制线程实际生效的放置情况（线程启动时应用后从内核读回），包括应用失败的原因
+     * @return 每个已启动过的线程一项
+     */
+    std::vector<AppliedThreadPlacement> getThreadPlacementReport() const;
+
+    /**
+     * 获取运行指标快照（USB传输字节数与耗时、写入队列深度、丢弃计数、写入耗时与卡顿次数等）
+     * 指标自录制器创建起单调累计，不随启停录制清零
+     * @return 指标快照
+     */
+    MetricsSnapshot getMetricsSnapshot() const;
+
+    /**
+     * 开始定期把运行指标写出为Prometheus文本文件（先写临时文件再重命名）
+     * @param path 输出文件路径
+     * @param interval_ms 写出间隔（毫秒）
+     */
+    void startMetricsExport(const std::string& path, unsigned interval_ms = 1000);
+
+    /**
+     * 停止写出指标文件，停止前写出一次最终值
+     */
+    void stopMetricsExport();
+
+private:
+    // 写入队列中的数据块，data是缓冲池中的缓冲，写入线程写完后归还缓冲池
+    struct DataBuffer {
+        unsigned char* data;
+        size_t size;
+        std::chrono::steady_clock::time_point arrival;   // USB传输完成时刻
+        DataBuffer(unsigned char* d, size_t s, std::chrono::steady_clock::time_point t)
+            : data(d), size(s), arrival(t) {}
+    };
+
+    // 写入线程的退出统计
+    struct WriterLoopStats {
+        uint64_t processed_buffers = 0;
+        uint64_t total_write_time = 0;
+        uint64_t write_stalls = 0;
+    };
+
+    // 性能统计
+    struct Stats {
+        std::atomic<uint64_t> total_bytes;
+        std::atomic<uint64_t> total_frames;
+        std::atomic<uint64_t> total_transfer_time;
+        std::atomic<uint64_t> max_transfer_time;
+        std::atomic<uint64_t> min_transfer_time;
+    };
+
+    // USB设备
+    std::unique_ptr<USBDevice> usb_device_;
+    uint8_t event_endpoint_;
+
+    // 线程控制
+    std::atomic<bool> recording_;
+    std::atomic<bool> writer_running_;
+    bool timestamp_analysis_enabled_;
+
+    std::unique_ptr<BufferPool> usb_buffer_pool_;
+    size_t buffer_count_;                     // 下次开始录制时的缓冲数量
+    static const size_t DEFAULT_BUFFER_COUNT = 64;
+    Stats stats_;
+
+    // 输出文件
+    std::string output_filename_;
+    RecordWriter output_writer_;              // 开始录制后仅写入线程访问
+    RecordWriterOptions write_options_;
+    std::atomic<RecordWriteBackend> write_backend_;
+    std::atomic<bool> write_failed_;          // 本次录制发生过写入错误，开始录制时清除
+    std::string write_error_;                 // 第一个写入错误，由write_error_mutex_保护
+    mutable std::mutex write_error_mutex_;
+
+    // 录制分段，开始录制后仅写入线程访问（停止时在写入线程退出后收尾）
+    struct SegmentState {
+        uint32_t index = 0;
+        std::string filename;
+        bool opened = false;             // 文件已成功创建，未能创建的段不写入清单
+        uint64_t bytes = 0;
+        uint64_t buffers = 0;
+        bool have_timestamp = false;
+        uint64_t first_timestamp = 0;    // 设备时间戳（微秒）
+        uint64_t last_timestamp = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+    RecordSegmentOptions segment_options_;
+    SegmentState segment_;
+    std::string manifest_filename_;
+    std::ofstream manifest_file_;
+
+    // 触发录制，flight_仅写入线程访问
+    struct FlightState {
+        std::deque<DataBuffer> ring;                         // 按到达顺序保留的缓冲
+        bool clip_active = false;
+        std::chrono::steady_clock::time_point clip_end;      // 到达时刻不晚于此的缓冲写入当前片段
+        uint32_t next_clip = 0;
+        std::chrono::steady_clock::time_point rate_window_start;
+        uint64_t rate_window_events = 0;
+        bool rate_above = false;                             // 事件率高于阈值，降回阈值以下后才能再次触发
+    };
+    FlightRecorderOptions flight_options_;
+    std::atomic<bool> flight_mode_;                          // 本次录制是否为触发录制，开始录制时确定
+    std::atomic<bool> trigger_requested_;
+    FlightState flight_;
+
+    std::thread recording_thread_;
+    std::thread writer_thread_;
+
+    // 写入队列
+    std::queue<DataBuffer> write_queue_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+
+    // 时间戳分析
+    std::string timestamp_filename_;
+    std::ofstream timestamp_file_;
+    std::mutex timestamp_mutex_;
+
+    // 线程放置
+    std::map<ThreadRole, ThreadPlacement> thread_placements_;          // 由placement_mutex_保护
+    std::map<std::string, AppliedThreadPlacement> applied_placements_; // 线程名 -> 实际生效的放置情况
+    mutable std::mutex placement_mutex_;
+
+    // 线程函数
+    void recordingThreadFunc();
+    void writerThreadFunc();
+
+    void applyThreadPlacement(ThreadRole role, const std::string& name);  // 由线程自身在启动时调用
+
+    // 运行指标：录制线程和写入线程各用一个分片
+    struct MetricIds {
+        int usb_transfers, usb_transfer_errors, usb_bytes, pool_exhausted;
+        int written_buffers, written_bytes, write_stalls, write_submissions, write_errors;
+        int segments, triggers, trigger_clips;
+        int queued_buffers, free_buffers, flight_ring_buffers, event_rate;
+        int usb_transfer_time, pool_wait_time, write_time, segment_switch_time;
+    };
+    static const uint64_t WRITE_STALL_THRESHOLD_US = 10000;  // 单次写入超过10ms计为一次写入卡顿
+    MetricsRegistry metrics_;
+    MetricsExporter metrics_exporter_;   // 在metrics_之后声明，先于注册表析构
+    MetricIds metric_ids_;
+    MetricsShard usb_metrics_;
+    MetricsShard writer_metrics_;
+    void registerMetrics();
+    void analyzeTimestamps(const unsigned char* buffer, size_t block_index);
+    std::string segmentFilename(uint32_t index) const;
+    bool segmentFull(size_t next_bytes) const;
+    void beginSegment(uint32_t index);
+    void trackSegment(const unsigned char* data, size_t size);
+    bool rotateSegment();
+    void writeManifestEntry();
+    void reportWriteError(const std::string& message);
+    void writeBuffer(const DataBuffer& buffer, WriterLoopStats& loop_stats);
+    void flightPush(const DataBuffer& buffer, WriterLoopStats& loop_stats);
+    void flightService(std::chrono::steady_clock::time_point now, WriterLoopStats& loop_stats);
+    void flightTrigger(std::chrono::steady_clock::time_point now, const char* source);
+    void flightCloseClip(bool last);
+    void flightFinish(WriterLoopStats& loop_stats);
+    void initTimestampFile();
+    void closeTimestampFile();
+
+    // 禁止拷贝构造和赋值
+    HV_EVS_Recorder(const HV_EVS_Recorder&) = delete;
+    HV_EVS_Recorder& operator=(const HV_EVS_Recorder&) = delete;
+};
+
+} // namespace hv
+
+#endif // HV_EVS_RECORDER_H
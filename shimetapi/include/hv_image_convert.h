@@ -0,0 +1,235 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_IMAGE_CONVERT_H
+#define HV_IMAGE_CONVERT_H
+
+/*
+ * NV12降采样转BGR（仅头文件）
+ *
+ * 按输出行处理：先对2x2（或4x4）亮度块求平均、取出对应的色度，再逐行转换为BGR，
+ * 中间结果只有几行，留在L1缓存中，不生成全分辨率的中间图像。
+ * 1/2分辨率时色度平面与输出分辨率相同，直接使用；1/4分辨率时对2x2色度求平均。
+ * 颜色转换为BT.601有限范围（与cv::COLOR_YUV2BGR_NV12一致，低于16的亮度按16处理），6位定点，
+ * 与浮点计算相差不超过4个灰度级（含降采样取整）；
+ * aarch64使用NEON，x86使用SSE2，其他平台逐像素计算，各路径输出一致；
+ * 包含前定义 HV_IMAGE_CONVERT_SCALAR 时只使用逐像素路径（供自检对比，见sample/hv_image_convert_selfcheck）。
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(__aarch64__) && !defined(HV_IMAGE_CONVERT_SCALAR)
+#define HV_IMAGE_CONVERT_NEON
+#elif defined(__SSE2__) && !defined(HV_IMAGE_CONVERT_SCALAR)
+#define HV_IMAGE_CONVERT_SSE2
+#endif
+
+/* BT.601有限范围系数（×64） */
+#define HV_YUV_CY   (75)   /* 1.164 */
+#define HV_YUV_CVR  (102)  /* 1.596 */
+#define HV_YUV_CVG  (52)   /* 0.813 */
+#define HV_YUV_CUG  (25)   /* 0.391 */
+#define HV_YUV_CUB  (129)  /* 2.018 */
+
+/* hv_nv12_to_bgr_scaled所需临时缓冲字节数 */
+#define HV_IMAGE_SCALE_SCRATCH_BYTES(roi_width) ((size_t)(roi_width) * 4)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint8_t hv_yuv_clamp(int v)
+{
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/**
+ * @brief 两行求2x2块平均（四舍五入），输出n个像素，读取每行2n个像素
+ */
+static inline void hv_image_average2x2_row(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n)
+{
+    int i = 0;
+#if defined(HV_IMAGE_CONVERT_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t sum = vaddq_u16(vpaddlq_u8(vld1q_u8(r0 + 2 * i)), vpaddlq_u8(vld1q_u8(r1 + 2 * i)));
+        vst1_u8(out + i, vrshrn_n_u16(sum, 2));
+    }
+#elif defined(HV_IMAGE_CONVERT_SSE2)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    const __m128i two = _mm_set1_epi16(2);
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(r0 + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(r1 + 2 * i));
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+                                    _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (uint8_t)((r0[2 * i] + r0[2 * i + 1] + r1[2 * i] + r1[2 * i + 1] + 2) >> 2);
+    }
+}
+
+/**
+ * @brief 拆分交织的UV行，n为UV对数
+ */
+static inline void hv_image_deinterleave_row(const uint8_t* uv, uint8_t* u, uint8_t* v, int n)
+{
+    int i = 0;
+#if defined(HV_IMAGE_CONVERT_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x2_t pair = vld2_u8(uv + 2 * i);
+        vst1_u8(u + i, pair.val[0]);
+        vst1_u8(v + i, pair.val[1]);
+    }
+#elif defined(HV_IMAGE_CONVERT_SSE2)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(uv + 2 * i));
+        __m128i lo = _mm_and_si128(a, mask);
+        __m128i hi = _mm_srli_epi16(a, 8);
+        _mm_storel_epi64((__m128i*)(u + i), _mm_packus_epi16(lo, lo));
+        _mm_storel_epi64((__m128i*)(v + i), _mm_packus_epi16(hi, hi));
+    }
+#endif
+    for (; i < n; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+/**
+ * @brief 每像素一组YUV的行转换为BGR（交织输出，3n字节）
+ */
+static inline void hv_image_yuv_to_bgr_row(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                                           uint8_t* bgr, int n)
+{
+    int i = 0;
+#if defined(HV_IMAGE_CONVERT_NEON)
+    const uint8x8_t c16 = vdup_n_u8(16);
+    const int16x8_t c128 = vdupq_n_s16(128);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t yy = vmulq_n_s16(vreinterpretq_s16_u16(vmovl_u8(vqsub_u8(vld1_u8(y + i), c16))), HV_YUV_CY);
+        int16x8_t uu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + i))), c128);
+        int16x8_t vv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + i))), c128);
+        uint8x8x3_t out;
+        out.val[0] = vqrshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(uu, HV_YUV_CUB)), 6);
+        out.val[1] = vqrshrun_n_s16(vmlsq_n_s16(vmlsq_n_s16(yy, vv, HV_YUV_CVG), uu, HV_YUV_CUG), 6);
+        out.val[2] = vqrshrun_n_s16(vmlaq_n_s16(yy, vv, HV_YUV_CVR), 6);
+        vst3_u8(bgr + 3 * i, out);
+    }
+#elif defined(HV_IMAGE_CONVERT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c16 = _mm_set1_epi8(16);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi16(32);
+    for (; i + 8 <= n; i += 8) {
+        __m128i yy = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_subs_epu8(_mm_loadl_epi64((const __m128i*)(y + i)), c16), zero),
+                                     _mm_set1_epi16(HV_YUV_CY));
+        __m128i uu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + i)), zero), c128);
+        __m128i vv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + i)), zero), c128);
+        __m128i b = _mm_adds_epi16(yy, _mm_mullo_epi16(uu, _mm_set1_epi16(HV_YUV_CUB)));
+        __m128i g = _mm_sub_epi16(_mm_sub_epi16(yy, _mm_mullo_epi16(vv, _mm_set1_epi16(HV_YUV_CVG))),
+                                  _mm_mullo_epi16(uu, _mm_set1_epi16(HV_YUV_CUG)));
+        __m128i r = _mm_add_epi16(yy, _mm_mullo_epi16(vv, _mm_set1_epi16(HV_YUV_CVR)));
+        b = _mm_srai_epi16(_mm_adds_epi16(b, round), 6);
+        g = _mm_srai_epi16(_mm_adds_epi16(g, round), 6);
+        r = _mm_srai_epi16(_mm_adds_epi16(r, round), 6);
+        /* SSE2没有三通道交织存储，经栈上缓冲逐像素交织 */
+        uint8_t planes[3][16];
+        _mm_storeu_si128((__m128i*)planes[0], _mm_packus_epi16(b, b));
+        _mm_storeu_si128((__m128i*)planes[1], _mm_packus_epi16(g, g));
+        _mm_storeu_si128((__m128i*)planes[2], _mm_packus_epi16(r, r));
+        uint8_t* dst = bgr + 3 * i;
+        for (int k = 0; k < 8; k++) {
+            dst[3 * k] = planes[0][k];
+            dst[3 * k + 1] = planes[1][k];
+            dst[3 * k + 2] = planes[2][k];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        const int yy = (y[i] > 16 ? y[i] - 16 : 0) * HV_YUV_CY;
+        const int uu = u[i] - 128;
+        const int vv = v[i] - 128;
+        bgr[3 * i] = hv_yuv_clamp((yy + HV_YUV_CUB * uu + 32) >> 6);
+        bgr[3 * i + 1] = hv_yuv_clamp((yy - HV_YUV_CVG * vv - HV_YUV_CUG * uu + 32) >> 6);
+        bgr[3 * i + 2] = hv_yuv_clamp((yy + HV_YUV_CVR * vv + 32) >> 6);
+    }
+}
+
+/**
+ * @brief NV12区域降采样并转换为BGR
+ * @param y_plane 亮度平面起始地址
+ * @param y_stride 亮度平面行字节数
+ * @param uv_plane 交织色度平面起始地址
+ * @param uv_stride 色度平面行字节数
+ * @param roi_x,roi_y,roi_width,roi_height 源区域（亮度坐标），须为factor的倍数
+ * @param factor 降采样倍数，2或4
+ * @param bgr 输出起始地址，(roi_height/factor) x (roi_width/factor) x 3
+ * @param bgr_stride 输出行字节数
+ * @param scratch 临时缓冲，至少 HV_IMAGE_SCALE_SCRATCH_BYTES(roi_width) 字节
+ */
+static inline void hv_nv12_to_bgr_scaled(const uint8_t* y_plane, size_t y_stride,
+                                         const uint8_t* uv_plane, size_t uv_stride,
+                                         int roi_x, int roi_y, int roi_width, int roi_height, int factor,
+                                         uint8_t* bgr, size_t bgr_stride, uint8_t* scratch)
+{
+    const int out_width = roi_width / factor;
+    const int out_height = roi_height / factor;
+    const int half_width = roi_width / 2;
+    uint8_t* ys = scratch;
+    uint8_t* us = ys + out_width;
+    uint8_t* vs = us + out_width;
+    uint8_t* tmp = vs + out_width;   /* 仅1/4：2行半宽亮度 + 4行半宽色度 */
+
+    for (int r = 0; r < out_height; r++) {
+        const uint8_t* y_row = y_plane + (size_t)(roi_y + r * factor) * y_stride + roi_x;
+        const uint8_t* uv_row = uv_plane + (size_t)(roi_y / 2 + r * factor / 2) * uv_stride + roi_x;
+        if (factor == 2) {
+            hv_image_average2x2_row(y_row, y_row + y_stride, ys, out_width);
+            hv_image_deinterleave_row(uv_row, us, vs, out_width);
+        } else {
+            uint8_t* h0 = tmp;
+            uint8_t* h1 = h0 + half_width;
+            uint8_t* u0 = h1 + half_width;
+            uint8_t* v0 = u0 + half_width;
+            uint8_t* u1 = v0 + half_width;
+            uint8_t* v1 = u1 + half_width;
+            hv_image_average2x2_row(y_row, y_row + y_stride, h0, half_width);
+            hv_image_average2x2_row(y_row + 2 * y_stride, y_row + 3 * y_stride, h1, half_width);
+            hv_image_average2x2_row(h0, h1, ys, out_width);
+            hv_image_deinterleave_row(uv_row, u0, v0, half_width);
+            hv_image_deinterleave_row(uv_row + uv_stride, u1, v1, half_width);
+            hv_image_average2x2_row(u0, u1, us, out_width);
+            hv_image_average2x2_row(v0, v1, vs, out_width);
+        }
+        hv_image_yuv_to_bgr_row(ys, us, vs, bgr + (size_t)r * bgr_stride, out_width);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HV_IMAGE_CONVERT_H
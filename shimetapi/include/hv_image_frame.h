@@ -0,0 +1,350 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_IMAGE_FRAME_H
+#define HV_IMAGE_FRAME_H
+
+/*
+ * APS图像帧池与零拷贝帧（仅头文件）
+ *
+ * USB传输直接写入池中预分配的NV12缓冲，ImageFrame以引用计数方式持有缓冲，
+ * Y/UV平面以cv::Mat视图访问，不复制；最后一个引用释放时缓冲归还帧池。
+ * 颜色转换只在调用toBGR/convert时进行。
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "hv_image_convert.h"
+
+namespace hv {
+
+/**
+ * APS图像输出格式
+ */
+enum class ImageOutputFormat {
+    BGR,         // 全分辨率BGR（默认）
+    Gray,        // 亮度平面，不做颜色转换
+    BGRHalf,     // 1/2分辨率BGR（2x2平均与颜色转换合并）
+    BGRQuarter   // 1/4分辨率BGR（4x4平均与颜色转换合并）
+};
+
+/**
+ * APS图像输出配置：格式和源区域
+ */
+struct ImageOutputConfig {
+    ImageOutputFormat format = ImageOutputFormat::BGR;
+    cv::Rect roi;    // 源图像中的区域，宽或高为0表示全幅
+
+    bool operator==(const ImageOutputConfig& other) const {
+        return format == other.format && roi.x == other.roi.x && roi.y == other.roi.y &&
+               roi.width == other.roi.width && roi.height == other.roi.height;
+    }
+
+    bool operator!=(const ImageOutputConfig& other) const {
+        return !(*this == other);
+    }
+
+    /**
+     * 降采样倍数（1、2或4）
+     */
+    int scale() const {
+        return format == ImageOutputFormat::BGRHalf ? 2 : (format == ImageOutputFormat::BGRQuarter ? 4 : 1);
+    }
+
+    /**
+     * 按图像尺寸规整：空区域展开为全幅，区域向内对齐到色度采样和降采样块（2或4像素）
+     * @return 区域超出图像范围或对齐后为空时返回false
+     */
+    bool normalize(int width, int height) {
+        if (roi.width <= 0 || roi.height <= 0) {
+            roi = cv::Rect(0, 0, width, height);
+        }
+        if (roi.x < 0 || roi.y < 0 || roi.x + roi.width > width || roi.y + roi.height > height) {
+            return false;
+        }
+        const int align = scale() > 2 ? scale() : 2;
+        const int x0 = (roi.x + align - 1) / align * align;
+        const int y0 = (roi.y + align - 1) / align * align;
+        const int x1 = (roi.x + roi.width) / align * align;
+        const int y1 = (roi.y + roi.height) / align * align;
+        if (x1 <= x0 || y1 <= y0) {
+            return false;
+        }
+        roi = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+        return true;
+    }
+
+    /**
+     * 输出图像尺寸（须先normalize）
+     */
+    cv::Size outputSize() const {
+        return cv::Size(roi.width / scale(), roi.height / scale());
+    }
+};
+
+/**
+ * 预分配的NV12缓冲池，线程安全
+ * 缓冲使用普通主机内存（而非USB设备内存），帧可以在设备关闭、相机析构之后继续持有
+ */
+class ImageBufferPool : public std::enable_shared_from_this<ImageBufferPool> {
+public:
+    /**
+     * @param width 图像宽度
+     * @param height 图像高度
+     * @param count 缓冲数量
+     */
+    static std::shared_ptr<ImageBufferPool> create(int width, int height, size_t count) {
+        std::shared_ptr<ImageBufferPool> pool(new ImageBufferPool(width, height));
+        for (size_t i = 0; i < count; ++i) {
+            void* buffer = nullptr;
+            if (posix_memalign(&buffer, 4096, pool->bytes()) != 0) {
+                return nullptr;
+            }
+            pool->buffers_.push_back(static_cast<uint8_t*>(buffer));
+            pool->free_.push_back(static_cast<uint8_t*>(buffer));
+        }
+        return pool;
+    }
+
+    ~ImageBufferPool() {
+        for (uint8_t* buffer : buffers_) {
+            free(buffer);
+        }
+    }
+
+    /**
+     * 取出一个空闲缓冲
+     * @return 没有空闲缓冲（全部被帧或传输占用）时返回nullptr
+     */
+    uint8_t* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            return nullptr;
+        }
+        uint8_t* buffer = free_.back();
+        free_.pop_back();
+        return buffer;
+    }
+
+    /**
+     * 归还缓冲
+     */
+    void release(uint8_t* buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+
+    /**
+     * 空闲缓冲数
+     */
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_.size();
+    }
+
+    size_t capacity() const {
+        return buffers_.size();
+    }
+
+    int width() const {
+        return width_;
+    }
+
+    int height() const {
+        return height_;
+    }
+
+    /**
+     * 一帧NV12数据的字节数
+     */
+    size_t bytes() const {
+        return static_cast<size_t>(width_) * height_ * 3 / 2;
+    }
+
+    /**
+     * 把缓冲的所有权转为引用计数，最后一个引用释放时归还本池
+     */
+    std::shared_ptr<const uint8_t> share(uint8_t* buffer) {
+        std::shared_ptr<ImageBufferPool> self = shared_from_this();
+        return std::shared_ptr<const uint8_t>(buffer, [self](const uint8_t* released) {
+            self->release(const_cast<uint8_t*>(released));
+        });
+    }
+
+private:
+    ImageBufferPool(int width, int height) : width_(width), height_(height) {}
+
+    const int width_;
+    const int height_;
+    std::vector<uint8_t*> buffers_;
+    std::vector<uint8_t*> free_;
+    mutable std::mutex mutex_;
+
+    ImageBufferPool(const ImageBufferPool&) = delete;
+    ImageBufferPool& operator=(const ImageBufferPool&) = delete;
+};
+
+/**
+ * 一帧APS图像（NV12），可复制，复制只增加引用计数
+ * nv12()/y()/uv()返回的cv::Mat是缓冲的只读视图，只在持有该ImageFrame（或其副本）期间有效，
+ * 需要长期保存时应clone()
+ */
+class ImageFrame {
+public:
+    ImageFrame() = default;
+
+    ImageFrame(std::shared_ptr<const uint8_t> data, int width, int height, uint64_t sequence, int64_t arrival_ns,
+               int64_t device_us = -1)
+        : data_(std::move(data)), width_(width), height_(height), sequence_(sequence), arrival_ns_(arrival_ns),
+          device_us_(device_us) {}
+
+    bool empty() const {
+        return !data_;
+    }
+
+    int width() const {
+        return width_;
+    }
+
+    int height() const {
+        return height_;
+    }
+
+    /**
+     * 帧序号，自相机创建起单调递增（丢弃的帧不占序号）
+     */
+    uint64_t sequence() const {
+        return sequence_;
+    }
+
+    /**
+     * 收齐该帧的USB传输完成时刻（CLOCK_MONOTONIC纳秒）
+     */
+    int64_t arrivalNs() const {
+        return arrival_ns_;
+    }
+
+    /**
+     * 曝光时刻的设备时间戳（微秒，与EventCD::t同一基准），设备时钟映射尚未建立时为-1
+     * APS数据不带时间戳，由arrivalNs()经事件流估计的时钟映射换算，并减去HV_Camera::setImageTimestampOffset设置的延迟
+     */
+    int64_t deviceTimestampUs() const {
+        return device_us_;
+    }
+
+    const uint8_t* data() const {
+        return data_.get();
+    }
+
+    /**
+     * 整帧NV12视图，(height*3/2) x width，CV_8UC1
+     */
+    cv::Mat nv12() const {
+        return view(height_ * 3 / 2, width_, CV_8UC1, 0);
+    }
+
+    /**
+     * 亮度平面视图，height x width，CV_8UC1
+     */
+    cv::Mat y() const {
+        return view(height_, width_, CV_8UC1, 0);
+    }
+
+    /**
+     * 交织色度平面视图，(height/2) x (width/2)，CV_8UC2
+     */
+    cv::Mat uv() const {
+        return view(height_ / 2, width_ / 2, CV_8UC2, static_cast<size_t>(width_) * height_);
+    }
+
+    /**
+     * 转换为BGR，out尺寸和类型匹配时复用其内存
+     */
+    void toBGR(cv::Mat& out) const {
+        if (empty()) {
+            out.release();
+            return;
+        }
+        cv::cvtColor(nv12(), out, cv::COLOR_YUV2BGR_NV12);
+    }
+
+    cv::Mat toBGR() const {
+        cv::Mat bgr;
+        toBGR(bgr);
+        return bgr;
+    }
+
+    /**
+     * 按输出配置转换，out尺寸和类型匹配时复用其内存
+     * Gray复制区域内的亮度平面（需要零拷贝时直接使用y()(roi)）；
+     * BGR区域转换只读取区域内的像素；BGRHalf/BGRQuarter由降采样与颜色转换合并的SIMD内核完成
+     * @param config 输出配置，须已按本帧尺寸normalize
+     */
+    void convert(const ImageOutputConfig& config, cv::Mat& out) const {
+        if (empty()) {
+            out.release();
+            return;
+        }
+        const cv::Rect& roi = config.roi;
+        const bool full = roi.x == 0 && roi.y == 0 && roi.width == width_ && roi.height == height_;
+        switch (config.format) {
+        case ImageOutputFormat::Gray:
+            y()(roi).copyTo(out);
+            break;
+        case ImageOutputFormat::BGR:
+            if (full) {
+                toBGR(out);
+            } else {
+                cv::cvtColorTwoPlane(y()(roi), uv()(cv::Rect(roi.x / 2, roi.y / 2, roi.width / 2, roi.height / 2)),
+                                     out, cv::COLOR_YUV2BGR_NV12);
+            }
+            break;
+        case ImageOutputFormat::BGRHalf:
+        case ImageOutputFormat::BGRQuarter: {
+            const cv::Size size = config.outputSize();
+            out.create(size.height, size.width, CV_8UC3);
+            std::vector<uint8_t> scratch(HV_IMAGE_SCALE_SCRATCH_BYTES(roi.width));
+            const uint8_t* base = data_.get();
+            hv_nv12_to_bgr_scaled(base, width_, base + static_cast<size_t>(width_) * height_, width_,
+                                  roi.x, roi.y, roi.width, roi.height, config.scale(),
+                                  out.data, static_cast<size_t>(out.step), scratch.data());
+            break;
+        }
+        }
+    }
+
+private:
+    cv::Mat view(int rows, int cols, int type, size_t offset) const {
+        if (empty()) {
+            return cv::Mat();
+        }
+        return cv::Mat(rows, cols, type, const_cast<uint8_t*>(data_.get()) + offset);
+    }
+
+    std::shared_ptr<const uint8_t> data_;
+    int width_ = 0;
+    int height_ = 0;
+    uint64_t sequence_ = 0;
+    int64_t arrival_ns_ = 0;
+    int64_t device_us_ = -1;
+};
+
+} // namespace hv
+
+#endif // HV_IMAGE_FRAME_H
@@ -0,0 +1,744 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_METRICS_H
+#define HV_METRICS_H
+
+/*
+ * 无锁指标注册表（仅头文件）
+ *
+ * 支持计数器、仪表和固定分桶的延迟直方图：
+ *   - 计数器和直方图按分片（shard）存储，每个写入线程在启动时取得自己的分片，
+ *     热路径上只对本分片做relaxed原子加，不同线程之间没有锁也没有缓存行争用；
+ *   - 仪表（队列深度等）只有一个值，直接原子写入；
+ *   - 读取快照时把所有分片求和，不阻塞写入线程。
+ * 直方图以纳秒为单位记录，第k个桶的上界为 2^(8+k) ns（256ns ~ 2.1s），另有+Inf桶。
+ *
+ * C代码（TCP接收端）直接使用 hv_metrics_* 函数；
+ * C++代码（HV_Camera、HV_EVS_Recorder）通过 hv::MetricsRegistry 使用同一份实现，
+ * 并可用 hv::MetricsExporter 定期写出Prometheus文本格式文件（供node_exporter textfile收集器读取）。
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HV_METRICS_MAX_METRICS       (64)    /* 每个注册表最多的计数器/仪表数（各自计） */
+#define HV_METRICS_MAX_HISTOGRAMS    (16)    /* 每个注册表最多的直方图数 */
+#define HV_METRICS_MAX_SHARDS        (32)    /* 分片数，超出后的写入线程共用最后一个分片 */
+#define HV_METRICS_HIST_MIN_SHIFT    (8)     /* 第一个桶上界为 2^8 ns */
+#define HV_METRICS_HIST_OCTAVES      (23)    /* 第一个桶之后的倍频程数，最后一个有限上界为 2^31 ns */
+#define HV_METRICS_HIST_SUB_BUCKETS  (4)     /* 每个倍频程等分的桶数 */
+#define HV_METRICS_HIST_BUCKETS      (1 + HV_METRICS_HIST_OCTAVES * HV_METRICS_HIST_SUB_BUCKETS) /* 有限上界的桶数，另有一个+Inf桶 */
+#define HV_METRICS_NAME_LEN          (64)
+#define HV_METRICS_HELP_LEN          (128)
+#define HV_METRICS_LABELS_LEN        (128)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 指标类型
+ */
+typedef enum {
+    HV_METRIC_COUNTER = 0,      /* 单调递增计数器 */
+    HV_METRIC_GAUGE = 1,        /* 仪表，可增可减 */
+    HV_METRIC_HISTOGRAM = 2     /* 延迟直方图（纳秒） */
+} hv_metric_type_t;
+
+/**
+ * @brief 直方图在一个分片中的数据
+ */
+typedef struct {
+    uint64_t buckets[HV_METRICS_HIST_BUCKETS + 1];  /* 各桶计数（非累积），最后一个为+Inf */
+    uint64_t sum_ns;                                /* 观测值总和 */
+} hv_metrics_hist_cell_t;
+
+/**
+ * @brief 一个写入线程的分片，按缓存行对齐
+ */
+typedef struct {
+    uint64_t counters[HV_METRICS_MAX_METRICS];
+    hv_metrics_hist_cell_t hists[HV_METRICS_MAX_HISTOGRAMS];
+} __attribute__((aligned(64))) hv_metrics_shard_t;
+
+/**
+ * @brief 指标描述
+ */
+typedef struct {
+    char name[HV_METRICS_NAME_LEN];
+    char help[HV_METRICS_HELP_LEN];
+    hv_metric_type_t type;
+    int id;                     /* 同类型内的编号 */
+} hv_metric_desc_t;
+
+/**
+ * @brief 直方图读数（所有分片之和）
+ */
+typedef struct {
+    uint64_t buckets[HV_METRICS_HIST_BUCKETS + 1];  /* 各桶计数（非累积） */
+    uint64_t count;                                 /* 总观测次数，等于各桶之和 */
+    uint64_t sum_ns;
+} hv_metrics_histogram_t;
+
+/**
+ * @brief 指标注册表
+ * 指标须在写入线程启动前注册完毕；之后的更新和读取都是无锁的
+ */
+typedef struct {
+    hv_metrics_shard_t shards[HV_METRICS_MAX_SHARDS];
+    int64_t gauges[HV_METRICS_MAX_METRICS];
+    hv_metric_desc_t descs[HV_METRICS_MAX_METRICS + HV_METRICS_MAX_HISTOGRAMS];
+    uint32_t metric_count;      /* 已注册的指标总数，按注册顺序输出 */
+    uint32_t counter_count;
+    uint32_t gauge_count;
+    uint32_t hist_count;
+    uint32_t shard_count;       /* 已分配的分片数 */
+    char labels[HV_METRICS_LABELS_LEN];  /* 附加到每个样本的标签，如 device="2-1.3" */
+} hv_metrics_registry_t;
+
+/**
+ * @brief 单调时钟（纳秒）
+ */
+static inline uint64_t hv_metrics_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 创建注册表
+ * @param labels 附加到每个样本的标签（Prometheus格式，不含花括号），可为NULL
+ * @return 注册表，内存不足时返回NULL
+ */
+static inline hv_metrics_registry_t* hv_metrics_create(const char* labels)
+{
+    void* memory = NULL;
+    if (posix_memalign(&memory, 64, sizeof(hv_metrics_registry_t)) != 0) {
+        return NULL;
+    }
+    hv_metrics_registry_t* reg = (hv_metrics_registry_t*)memory;
+    memset(reg, 0, sizeof(*reg));
+    if (labels) {
+        snprintf(reg->labels, sizeof(reg->labels), "%s", labels);
+    }
+    return reg;
+}
+
+/**
+ * @brief 销毁注册表，调用前须停止所有写入线程
+ */
+static inline void hv_metrics_destroy(hv_metrics_registry_t* reg)
+{
+    free(reg);
+}
+
+/**
+ * @brief 注册指标
+ * 只能在写入线程启动前调用，且不能与其他注册并发
+ * @param type 指标类型
+ * @param name 指标名（Prometheus命名，直方图以_seconds结尾）
+ * @param help 说明
+ * @return 同类型内的编号，数量超出上限时返回-1（对-1的更新被忽略）
+ */
+static inline int hv_metrics_register(hv_metrics_registry_t* reg, hv_metric_type_t type,
+                                      const char* name, const char* help)
+{
+    uint32_t* count;
+    uint32_t limit;
+    switch (type) {
+    case HV_METRIC_COUNTER:   count = &reg->counter_count; limit = HV_METRICS_MAX_METRICS; break;
+    case HV_METRIC_GAUGE:     count = &reg->gauge_count;   limit = HV_METRICS_MAX_METRICS; break;
+    default:                  count = &reg->hist_count;    limit = HV_METRICS_MAX_HISTOGRAMS; break;
+    }
+    if (*count >= limit) {
+        return -1;
+    }
+
+    const uint32_t index = reg->metric_count;
+    hv_metric_desc_t* desc = &reg->descs[index];
+    snprintf(desc->name, sizeof(desc->name), "%s", name);
+    snprintf(desc->help, sizeof(desc->help), "%s", help ? help : "");
+    desc->type = type;
+    desc->id = (int)(*count)++;
+
+    /* 描述写完后再发布，读取方先读metric_count */
+    __atomic_store_n(&reg->metric_count, index + 1, __ATOMIC_RELEASE);
+    return desc->id;
+}
+
+/**
+ * @brief 为写入线程分配分片，通常在线程启动时调用一次并保存
+ * 分片用完后返回最后一个分片，由多个线程共用（更新仍是原子的，只是会有争用）
+ */
+static inline hv_metrics_shard_t* hv_metrics_acquire_shard(hv_metrics_registry_t* reg)
+{
+    uint32_t index = __atomic_fetch_add(&reg->shard_count, 1, __ATOMIC_RELAXED);
+    if (index >= HV_METRICS_MAX_SHARDS) {
+        index = HV_METRICS_MAX_SHARDS - 1;
+    }
+    return &reg->shards[index];
+}
+
+/**
+ * @brief 计数器加值
+ */
+static inline void hv_metrics_counter_add(hv_metrics_shard_t* shard, int id, uint64_t value)
+{
+    if (id >= 0) {
+        __atomic_fetch_add(&shard->counters[id], value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 设置仪表值
+ */
+static inline void hv_metrics_gauge_set(hv_metrics_registry_t* reg, int id, int64_t value)
+{
+    if (id >= 0) {
+        __atomic_store_n(&reg->gauges[id], value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 仪表加减
+ */
+static inline void hv_metrics_gauge_add(hv_metrics_registry_t* reg, int id, int64_t delta)
+{
+    if (id >= 0) {
+        __atomic_fetch_add(&reg->gauges[id], delta, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 纳秒值所在的桶
+ */
+static inline int hv_metrics_bucket_index(uint64_t ns)
+{
+    if (ns <= (1ULL << HV_METRICS_HIST_MIN_SHIFT)) {
+        return 0;
+    }
+    /* ns位于(2^e, 2^(e+1)]，该倍频程等分为HV_METRICS_HIST_SUB_BUCKETS个桶 */
+    const int e = 63 - __builtin_clzll(ns - 1);
+    const int octave = e - HV_METRICS_HIST_MIN_SHIFT;
+    if (octave >= HV_METRICS_HIST_OCTAVES) {
+        return HV_METRICS_HIST_BUCKETS;
+    }
+    const int sub = (int)(((ns - 1) - (1ULL << e)) >> (e - 2));
+    return 1 + octave * HV_METRICS_HIST_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief 桶的上界（纳秒），+Inf桶返回UINT64_MAX
+ */
+static inline uint64_t hv_metrics_bucket_bound_ns(int index)
+{
+    if (index <= 0) {
+        return 1ULL << HV_METRICS_HIST_MIN_SHIFT;
+    }
+    if (index >= HV_METRICS_HIST_BUCKETS) {
+        return UINT64_MAX;
+    }
+    const int e = HV_METRICS_HIST_MIN_SHIFT + (index - 1) / HV_METRICS_HIST_SUB_BUCKETS;
+    const int sub = (index - 1) % HV_METRICS_HIST_SUB_BUCKETS;
+    return (1ULL << e) + (uint64_t)(sub + 1) * ((1ULL << e) / HV_METRICS_HIST_SUB_BUCKETS);
+}
+
+/**
+ * @brief 桶的上界是否为2的幂（倍频程边界），Prometheus导出只输出这些边界
+ */
+static inline int hv_metrics_bucket_is_octave_bound(int index)
+{
+    return index == 0 || index % HV_METRICS_HIST_SUB_BUCKETS == 0;
+}
+
+/**
+ * @brief 直方图记录一次观测
+ * @param ns 观测值（纳秒）
+ */
+static inline void hv_metrics_histogram_observe(hv_metrics_shard_t* shard, int id, uint64_t ns)
+{
+    if (id >= 0) {
+        hv_metrics_hist_cell_t* cell = &shard->hists[id];
+        __atomic_fetch_add(&cell->buckets[hv_metrics_bucket_index(ns)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cell->sum_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 读取计数器（所有分片之和）
+ */
+static inline uint64_t hv_metrics_counter_value(const hv_metrics_registry_t* reg, int id)
+{
+    uint64_t total = 0;
+    if (id >= 0) {
+        for (int s = 0; s < HV_METRICS_MAX_SHARDS; s++) {
+            total += __atomic_load_n(&reg->shards[s].counters[id], __ATOMIC_RELAXED);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief 读取仪表
+ */
+static inline int64_t hv_metrics_gauge_value(const hv_metrics_registry_t* reg, int id)
+{
+    return id >= 0 ? __atomic_load_n(&reg->gauges[id], __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * @brief 读取直方图（所有分片之和）
+ */
+static inline void hv_metrics_histogram_value(const hv_metrics_registry_t* reg, int id, hv_metrics_histogram_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    if (id < 0) {
+        return;
+    }
+    for (int s = 0; s < HV_METRICS_MAX_SHARDS; s++) {
+        const hv_metrics_hist_cell_t* cell = &reg->shards[s].hists[id];
+        for (int b = 0; b <= HV_METRICS_HIST_BUCKETS; b++) {
+            out->buckets[b] += __atomic_load_n(&cell->buckets[b], __ATOMIC_RELAXED);
+        }
+        out->sum_ns += __atomic_load_n(&cell->sum_ns, __ATOMIC_RELAXED);
+    }
+    for (int b = 0; b <= HV_METRICS_HIST_BUCKETS; b++) {
+        out->count += out->buckets[b];
+    }
+}
+
+/**
+ * @brief 由直方图各桶计数估算分位数（纳秒）
+ * 与Prometheus的histogram_quantile相同，在所在桶内线性插值，误差不超过桶宽（上界的1/5左右）；
+ * 落在+Inf桶时返回最后一个有限上界
+ * @param buckets 各桶计数（非累积），共HV_METRICS_HIST_BUCKETS + 1个
+ * @param q 分位（0-1），如0.99
+ * @return 分位数，没有观测时返回0
+ */
+static inline uint64_t hv_metrics_histogram_quantile_ns(const uint64_t* buckets, double q)
+{
+    uint64_t count = 0;
+    for (int b = 0; b <= HV_METRICS_HIST_BUCKETS; b++) {
+        count += buckets[b];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    const double rank = (q < 0 ? 0 : (q > 1 ? 1 : q)) * (double)count;
+    uint64_t seen = 0;
+    for (int b = 0; b < HV_METRICS_HIST_BUCKETS; b++) {
+        if (buckets[b] > 0 && (double)(seen + buckets[b]) >= rank) {
+            const double lower = b > 0 ? (double)hv_metrics_bucket_bound_ns(b - 1) : 0.0;
+            const double upper = (double)hv_metrics_bucket_bound_ns(b);
+            return (uint64_t)(lower + (upper - lower) * (rank - (double)seen) / (double)buckets[b]);
+        }
+        seen += buckets[b];
+    }
+    return hv_metrics_bucket_bound_ns(HV_METRICS_HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief 以Prometheus文本格式输出所有指标
+ * 直方图的桶上界和总和换算为秒，只输出倍频程边界（2^8 ~ 2^31 ns）的累积计数
+ * @return 0成功，-1写入失败
+ */
+static inline int hv_metrics_write_prometheus(const hv_metrics_registry_t* reg, FILE* out)
+{
+    const uint32_t count = __atomic_load_n(&reg->metric_count, __ATOMIC_ACQUIRE);
+    const char* labels = reg->labels;
+    const char* lbrace = labels[0] ? "{" : "";
+    const char* rbrace = labels[0] ? "}" : "";
+    const char* sep = labels[0] ? "," : "";
+
+    for (uint32_t i = 0; i < count; i++) {
+        const hv_metric_desc_t* desc = &reg->descs[i];
+        static const char* const type_names[] = { "counter", "gauge", "histogram" };
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", desc->name, desc->help, desc->name, type_names[desc->type]);
+
+        if (desc->type == HV_METRIC_COUNTER) {
+            fprintf(out, "%s%s%s%s %llu\n", desc->name, lbrace, labels, rbrace,
+                    (unsigned long long)hv_metrics_counter_value(reg, desc->id));
+        } else if (desc->type == HV_METRIC_GAUGE) {
+            fprintf(out, "%s%s%s%s %lld\n", desc->name, lbrace, labels, rbrace,
+                    (long long)hv_metrics_gauge_value(reg, desc->id));
+        } else {
+            hv_metrics_histogram_t hist;
+            hv_metrics_histogram_value(reg, desc->id, &hist);
+            uint64_t cumulative = 0;
+            for (int b = 0; b < HV_METRICS_HIST_BUCKETS; b++) {
+                cumulative += hist.buckets[b];
+                if (!hv_metrics_bucket_is_octave_bound(b)) {
+                    continue;
+                }
+                fprintf(out, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", desc->name, labels, sep,
+                        hv_metrics_bucket_bound_ns(b) / 1e9, (unsigned long long)cumulative);
+            }
+            fprintf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", desc->name, labels, sep,
+                    (unsigned long long)hist.count);
+            fprintf(out, "%s_sum%s%s%s %.9f\n", desc->name, lbrace, labels, rbrace, hist.sum_ns / 1e9);
+            fprintf(out, "%s_count%s%s%s %llu\n", desc->name, lbrace, labels, rbrace,
+                    (unsigned long long)hist.count);
+        }
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+/**
+ * @brief 将所有指标写入Prometheus文本文件
+ * 先写临时文件再重命名，读取方不会看到写了一半的文件
+ * @return 0成功，-1失败
+ */
+static inline int hv_metrics_write_prometheus_file(const hv_metrics_registry_t* reg, const char* path)
+{
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    FILE* out = fopen(tmp_path, "w");
+    if (!out) {
+        return -1;
+    }
+    int ret = hv_metrics_write_prometheus(reg, out);
+    if (fclose(out) != 0) {
+        ret = -1;
+    }
+    if (ret == 0 && rename(tmp_path, path) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        remove(tmp_path);
+    }
+    return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace hv {
+
+/**
+ * 指标类型
+ */
+enum class MetricType {
+    Counter = HV_METRIC_COUNTER,
+    Gauge = HV_METRIC_GAUGE,
+    Histogram = HV_METRIC_HISTOGRAM
+};
+
+/**
+ * 一个指标的快照
+ */
+struct MetricSample {
+    std::string name;
+    std::string help;
+    MetricType type = MetricType::Counter;
+    int64_t value = 0;                  // 计数器/仪表的值
+    std::vector<uint64_t> buckets;      // 直方图各桶计数（非累积），最后一个为+Inf
+    uint64_t count = 0;                 // 直方图观测次数
+    uint64_t sum_ns = 0;                // 直方图观测值总和（纳秒）
+
+    /**
+     * 直方图第index个桶的上界（纳秒），+Inf桶返回UINT64_MAX
+     */
+    static uint64_t bucketUpperBoundNs(size_t index) {
+        return hv_metrics_bucket_bound_ns(static_cast<int>(index));
+    }
+
+    /**
+     * 直方图分位数估计（纳秒），在桶内线性插值
+     * @param q 分位（0-1）
+     */
+    uint64_t quantileNs(double q) const {
+        if (buckets.size() != HV_METRICS_HIST_BUCKETS + 1) {
+            return 0;
+        }
+        return hv_metrics_histogram_quantile_ns(buckets.data(), q);
+    }
+};
+
+/**
+ * 注册表中所有指标的快照，按注册顺序排列
+ */
+struct MetricsSnapshot {
+    std::vector<MetricSample> metrics;
+
+    /**
+     * 按名称查找指标
+     * @return 找不到时返回nullptr
+     */
+    const MetricSample* find(const std::string& name) const {
+        for (const auto& metric : metrics) {
+            if (metric.name == name) {
+                return &metric;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * 写入线程持有的分片句柄，更新操作均为无锁的relaxed原子加
+ * 未分配分片时更新被忽略
+ */
+class MetricsShard {
+public:
+    MetricsShard() : shard_(nullptr) {}
+    explicit MetricsShard(hv_metrics_shard_t* shard) : shard_(shard) {}
+
+    void add(int counter, uint64_t value = 1) const {
+        if (shard_) {
+            hv_metrics_counter_add(shard_, counter, value);
+        }
+    }
+
+    void observe(int histogram, uint64_t ns) const {
+        if (shard_) {
+            hv_metrics_histogram_observe(shard_, histogram, ns);
+        }
+    }
+
+    void observe(int histogram, std::chrono::steady_clock::duration elapsed) const {
+        observe(histogram, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+private:
+    hv_metrics_shard_t* shard_;
+};
+
+/**
+ * 指标注册表
+ */
+class MetricsRegistry {
+public:
+    explicit MetricsRegistry(const std::string& labels = "")
+        : registry_(hv_metrics_create(labels.c_str())) {}
+
+    ~MetricsRegistry() {
+        hv_metrics_destroy(registry_);
+    }
+
+    int registerCounter(const std::string& name, const std::string& help) {
+        return registry_ ? hv_metrics_register(registry_, HV_METRIC_COUNTER, name.c_str(), help.c_str()) : -1;
+    }
+
+    int registerGauge(const std::string& name, const std::string& help) {
+        return registry_ ? hv_metrics_register(registry_, HV_METRIC_GAUGE, name.c_str(), help.c_str()) : -1;
+    }
+
+    int registerHistogram(const std::string& name, const std::string& help) {
+        return registry_ ? hv_metrics_register(registry_, HV_METRIC_HISTOGRAM, name.c_str(), help.c_str()) : -1;
+    }
+
+    /**
+     * 为一个写入线程分配分片
+     */
+    MetricsShard acquireShard() {
+        return MetricsShard(registry_ ? hv_metrics_acquire_shard(registry_) : nullptr);
+    }
+
+    void setGauge(int gauge, int64_t value) {
+        if (registry_) {
+            hv_metrics_gauge_set(registry_, gauge, value);
+        }
+    }
+
+    void addGauge(int gauge, int64_t delta) {
+        if (registry_) {
+            hv_metrics_gauge_add(registry_, gauge, delta);
+        }
+    }
+
+    /**
+     * 设置附加到每个样本的标签，如 device="2-1.3"
+     * 不能与Prometheus文件写出并发调用
+     */
+    void setLabels(const std::string& labels) {
+        if (registry_) {
+            snprintf(registry_->labels, sizeof(registry_->labels), "%s", labels.c_str());
+        }
+    }
+
+    /**
+     * 读取所有指标的快照，不阻塞写入线程
+     */
+    MetricsSnapshot snapshot() const {
+        MetricsSnapshot snapshot;
+        if (!registry_) {
+            return snapshot;
+        }
+        const uint32_t count = __atomic_load_n(&registry_->metric_count, __ATOMIC_ACQUIRE);
+        snapshot.metrics.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            const hv_metric_desc_t& desc = registry_->descs[i];
+            MetricSample sample;
+            sample.name = desc.name;
+            sample.help = desc.help;
+            sample.type = static_cast<MetricType>(desc.type);
+            if (desc.type == HV_METRIC_COUNTER) {
+                sample.value = static_cast<int64_t>(hv_metrics_counter_value(registry_, desc.id));
+            } else if (desc.type == HV_METRIC_GAUGE) {
+                sample.value = hv_metrics_gauge_value(registry_, desc.id);
+            } else {
+                hv_metrics_histogram_t hist;
+                hv_metrics_histogram_value(registry_, desc.id, &hist);
+                sample.buckets.assign(hist.buckets, hist.buckets + HV_METRICS_HIST_BUCKETS + 1);
+                sample.count = hist.count;
+                sample.sum_ns = hist.sum_ns;
+            }
+            snapshot.metrics.push_back(std::move(sample));
+        }
+        return snapshot;
+    }
+
+    /**
+     * 读取单个直方图（所有分片之和），不阻塞写入线程
+     * @param histogram registerHistogram返回的编号
+     */
+    MetricSample histogram(int histogram) const {
+        MetricSample sample;
+        sample.type = MetricType::Histogram;
+        if (!registry_ || histogram < 0) {
+            return sample;
+        }
+        hv_metrics_histogram_t hist;
+        hv_metrics_histogram_value(registry_, histogram, &hist);
+        sample.buckets.assign(hist.buckets, hist.buckets + HV_METRICS_HIST_BUCKETS + 1);
+        sample.count = hist.count;
+        sample.sum_ns = hist.sum_ns;
+        return sample;
+    }
+
+    /**
+     * 写出Prometheus文本文件（先写临时文件再重命名）
+     */
+    bool writePrometheus(const std::string& path) const {
+        return registry_ && hv_metrics_write_prometheus_file(registry_, path.c_str()) == 0;
+    }
+
+private:
+    hv_metrics_registry_t* registry_;
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+};
+
+/**
+ * 定期把注册表写出为Prometheus文本文件的后台线程
+ */
+class MetricsExporter {
+public:
+    MetricsExporter() : registry_(nullptr), interval_ms_(1000), running_(false) {}
+
+    ~MetricsExporter() {
+        stop();
+    }
+
+    /**
+     * 启动写出线程，已在运行时先停止
+     * @param registry 注册表，须在stop()之前保持有效
+     * @param path 输出文件路径
+     * @param interval_ms 写出间隔（毫秒）
+     */
+    void start(const MetricsRegistry* registry, const std::string& path, unsigned interval_ms) {
+        stop();
+        registry_ = registry;
+        path_ = path;
+        interval_ms_ = interval_ms > 0 ? interval_ms : 1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = true;
+        }
+        thread_ = std::thread(&MetricsExporter::run, this);
+    }
+
+    /**
+     * 停止写出线程，退出前再写出一次最终值
+     */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool isRunning() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return running_;
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+private:
+    void run() {
+        bool reported = false;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            const bool running = running_;
+            lock.unlock();
+            if (!registry_->writePrometheus(path_) && !reported) {
+                reported = true;
+                fprintf(stderr, "Failed to write metrics file: %s\n", path_.c_str());
+            }
+            lock.lock();
+            if (!running) {
+                break;
+            }
+            cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this] { return !running_; });
+        }
+    }
+
+    const MetricsRegistry* registry_;
+    std::string path_;
+    unsigned interval_ms_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+};
+
+} // namespace hv
+
+#endif // __cplusplus
+
+#endif // HV_METRICS_H
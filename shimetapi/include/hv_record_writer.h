@@ -0,0 +1,637 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_RECORD_WRITER_H
+#define HV_RECORD_WRITER_H
+
+/*
+ * 录制文件写入后端（仅头文件）
+ *
+ * 写入的数据先拼接到对齐的暂存块（默认4MB，即8个512KB的USB缓冲），块满后整块提交：
+ *   IoUring  : O_DIRECT + io_uring，最多queue_depth个块同时在途，提交不等待完成
+ *   Direct   : O_DIRECT + 同步pwrite，绕过页缓存
+ *   Buffered : 普通pwrite，每块提交后用sync_file_range启动回写，避免脏页堆积后集中回写
+ * Auto按IoUring -> Direct -> Buffered的顺序选择第一个可用的后端
+ * （内核不支持io_uring、文件系统不支持O_DIRECT如tmpfs时自动退回）。
+ * io_uring直接使用系统调用，不依赖liburing。
+ * 可按preallocate_bytes用fallocate预分配文件空间，rotate()切换到下一个文件时复用暂存块和io_uring。
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HV_RECORD_WRITER_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace hv {
+
+/**
+ * 录制文件写入后端
+ */
+enum class RecordWriteBackend {
+    Auto,       // 自动选择：IoUring -> Direct -> Buffered
+    Buffered,   // 经页缓存写入
+    Direct,     // O_DIRECT同步写入
+    IoUring     // O_DIRECT + io_uring异步写入
+};
+
+/**
+ * 录制文件写入配置
+ */
+struct RecordWriterOptions {
+    RecordWriteBackend backend = RecordWriteBackend::Auto;
+    size_t queue_depth = 8;                 // 暂存块数量，IoUring时即同时在途的写请求数（至少2）
+    size_t chunk_bytes = 4 * 1024 * 1024;   // 每个暂存块（一次提交）的字节数，向上对齐到4KB
+    uint64_t preallocate_bytes = 0;         // 每个文件打开后预分配的字节数（fallocate，不改变文件长度），0表示不预分配
+};
+
+inline const char* recordWriteBackendName(RecordWriteBackend backend) {
+    switch (backend) {
+    case RecordWriteBackend::Auto: return "auto";
+    case RecordWriteBackend::Buffered: return "buffered";
+    case RecordWriteBackend::Direct: return "direct";
+    case RecordWriteBackend::IoUring: return "io_uring";
+    }
+    return "unknown";
+}
+
+/**
+ * 顺序写入录制文件，单线程使用
+ */
+class RecordWriter {
+public:
+    static const size_t ALIGNMENT = 4096;   // O_DIRECT要求的缓冲、偏移和长度对齐
+
+    RecordWriter() {}
+
+    ~RecordWriter() {
+        close();
+    }
+
+    /**
+     * 创建（截断）并打开文件
+     * @param path 文件路径
+     * @param options 写入配置
+     * @return 是否成功打开
+     */
+    bool open(const std::string& path, const RecordWriterOptions& options = RecordWriterOptions()) {
+        close();
+        error_.clear();
+        chunk_bytes_ = (options.chunk_bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (chunk_bytes_ == 0) {
+            chunk_bytes_ = ALIGNMENT;
+        }
+        const size_t depth = options.queue_depth < 2 ? 2 : options.queue_depth;
+        for (size_t i = 0; i < depth; ++i) {
+            void* buffer = nullptr;
+            if (posix_memalign(&buffer, ALIGNMENT, chunk_bytes_) != 0) {
+                error_ = "failed to allocate write buffers";
+                close();
+                return false;
+            }
+            chunks_.push_back(Chunk{static_cast<uint8_t*>(buffer), 0, false});
+        }
+
+        preallocate_bytes_ = options.preallocate_bytes;
+
+#ifdef __linux__
+        const RecordWriteBackend requested = options.backend;
+        if (requested == RecordWriteBackend::Auto || requested == RecordWriteBackend::IoUring ||
+            requested == RecordWriteBackend::Direct) {
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+            if (fd_ >= 0) {
+                backend_ = RecordWriteBackend::Direct;
+                if (requested != RecordWriteBackend::Direct && setupRing(depth)) {
+                    backend_ = RecordWriteBackend::IoUring;
+                }
+            } else if (requested != RecordWriteBackend::Auto) {
+                error_ = std::string("O_DIRECT open failed: ") + strerror(errno) + ", using buffered writes";
+            }
+        }
+        if (fd_ < 0) {
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0) {
+                error_ = std::string("open failed: ") + strerror(errno);
+                close();
+                return false;
+            }
+            backend_ = RecordWriteBackend::Buffered;
+        }
+        preallocate();
+#else
+        error_ = "record writer is only implemented on Linux";
+        close();
+        return false;
+#endif
+        current_ = 0;
+        offset_ = 0;
+        bytes_ = 0;
+        submissions_ = 0;
+        return true;
+    }
+
+    /**
+     * 写完当前文件并关闭，再创建（截断）下一个文件继续写入
+     * 沿用打开时选定的后端、暂存块和io_uring，不重新分配；只等待当前文件的在途写请求
+     * @param path 下一个文件的路径
+     * @return 是否成功（当前文件写入失败或新文件无法创建时返回false，之后的写入都返回false）
+     */
+    bool rotate(const std::string& path) {
+        if (fd_ < 0) {
+            return false;
+        }
+#ifdef __linux__
+        if (!finishFile()) {
+            return false;
+        }
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | (backend_ == RecordWriteBackend::Buffered ? 0 : O_DIRECT);
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0) {
+            fail(std::string("open failed: ") + strerror(errno));
+            return false;
+        }
+        preallocate();
+        current_ = 0;
+        offset_ = 0;
+        bytes_ = 0;
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    bool isOpen() const {
+        return fd_ >= 0;
+    }
+
+    /**
+     * 追加数据，只在暂存块写满时提交；IoUring时只在所有暂存块都在途时等待最早的完成
+     * @return 是否成功（失败后错误信息见lastError()，之后的写入都返回false）
+     */
+    bool write(const void* data, size_t size) {
+        if (fd_ < 0 || failed_) {
+            return false;
+        }
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            Chunk& chunk = chunks_[current_];
+            const size_t n = size < chunk_bytes_ - chunk.used ? size : chunk_bytes_ - chunk.used;
+            memcpy(chunk.data + chunk.used, src, n);
+            chunk.used += n;
+            src += n;
+            size -= n;
+            bytes_ += n;
+            if (chunk.used == chunk_bytes_ && !submitCurrent()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * 写出剩余数据，等待全部完成后关闭文件
+     * O_DIRECT时最后一块补零到4KB写入，再截断到实际长度
+     * @return 是否全部写入成功
+     */
+    bool close() {
+        bool ok = !failed_;
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ok = finishFile();
+        }
+        teardownRing();
+#endif
+        for (Chunk& chunk : chunks_) {
+            free(chunk.data);
+        }
+        chunks_.clear();
+        failed_ = false;
+        return ok;
+    }
+
+    /**
+     * 实际使用的后端（打开后有效）
+     */
+    RecordWriteBackend backend() const {
+        return backend_;
+    }
+
+    /**
+     * 当前文件已接受的字节数（文件最终长度），rotate()后从0开始
+     */
+    uint64_t bytesWritten() const {
+        return bytes_;
+    }
+
+    /**
+     * 已提交的写请求数（每次提交一个暂存块），rotate()后继续累计
+     */
+    uint64_t submissions() const {
+        return submissions_;
+    }
+
+    /**
+     * 当前在途的写请求数（仅IoUring大于0）
+     */
+    size_t inFlight() const {
+        return in_flight_;
+    }
+
+    /**
+     * 最近一次错误或后端退回的说明
+     */
+    const std::string& lastError() const {
+        return error_;
+    }
+
+private:
+    struct Chunk {
+        uint8_t* data;
+        size_t used;
+        bool in_flight;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t chunk_bytes_ = 0;
+    size_t current_ = 0;
+    uint64_t offset_ = 0;        // 下一块的文件偏移
+    uint64_t bytes_ = 0;
+    uint64_t submissions_ = 0;
+    size_t in_flight_ = 0;
+    uint64_t preallocate_bytes_ = 0;
+    bool preallocated_ = false;   // 当前文件是否预分配成功，关闭时需截断释放未用的空间
+    int fd_ = -1;
+    RecordWriteBackend backend_ = RecordWriteBackend::Buffered;
+    bool failed_ = false;
+    std::string error_;
+
+    void fail(const std::string& message) {
+        failed_ = true;
+        error_ = message;
+    }
+
+#ifdef __linux__
+    // 预分配当前文件的空间；FALLOC_FL_KEEP_SIZE不改变文件长度，异常退出时文件长度仍是已写入的数据
+    void preallocate() {
+        preallocated_ = false;
+        if (preallocate_bytes_ == 0) {
+            return;
+        }
+        if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(preallocate_bytes_)) == 0) {
+            preallocated_ = true;
+        } else {
+            error_ = std::string("fallocate failed: ") + strerror(errno) + ", writing without preallocation";
+        }
+    }
+
+    // 写出暂存块中剩余的数据，等待全部完成后关闭当前文件
+    // O_DIRECT时最后一块补零到4KB写入，再截断到实际长度；预分配过的文件同样截断，释放未用的空间
+    bool finishFile() {
+        bool ok = !failed_;
+        Chunk& tail = chunks_[current_];
+        const size_t tail_bytes = tail.used;
+        if (ok && tail_bytes > 0) {
+            if (backend_ != RecordWriteBackend::Buffered) {
+                const size_t padded = (tail_bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+                memset(tail.data + tail_bytes, 0, padded - tail_bytes);
+                tail.used = padded;
+            }
+            ok = submitCurrent();
+        }
+        ok = waitAll() && ok;
+        if (ok && (backend_ != RecordWriteBackend::Buffered || preallocated_) &&
+            ftruncate(fd_, static_cast<off_t>(bytes_)) != 0) {
+            fail(std::string("ftruncate failed: ") + strerror(errno));
+            ok = false;
+        }
+        ::close(fd_);
+        fd_ = -1;
+        return ok;
+    }
+
+    // 同步写满一块（处理短写）
+    bool pwriteAll(const uint8_t* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            const ssize_t n = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fail(std::string("write failed: ") + strerror(errno));
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    // 提交当前块并切换到下一块
+    bool submitCurrent() {
+        Chunk& chunk = chunks_[current_];
+        const uint64_t offset = offset_;
+        offset_ += chunk.used;
+        submissions_++;
+        if (backend_ == RecordWriteBackend::IoUring) {
+            if (!ringSubmit(current_, offset)) {
+                return false;
+            }
+        } else {
+            if (!pwriteAll(chunk.data, chunk.used, offset)) {
+                return false;
+            }
+            if (backend_ == RecordWriteBackend::Buffered) {
+                // 立即启动这一块的回写，不等待完成
+                sync_file_range(fd_, static_cast<off_t>(offset), static_cast<off_t>(chunk.used), SYNC_FILE_RANGE_WRITE);
+            }
+            chunk.used = 0;
+        }
+        current_ = (current_ + 1) % chunks_.size();
+        // 下一块仍在途时等待完成（IoUring所有块都在途时才会发生）
+        while (chunks_[current_].in_flight) {
+            if (!ringReap(true)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 等待全部在途请求完成；出错后也要收割完，暂存块才能安全释放。
+    // 失败时未提交的请求已撤回，不计入in_flight_，没有在途请求时直接返回
+    bool waitAll() {
+        while (in_flight_ > 0) {
+            const size_t before = in_flight_;
+            ringReap(true);
+            if (in_flight_ == before && failed_) {
+                break;
+            }
+        }
+        return !failed_;
+    }
+#else
+    bool submitCurrent() {
+        return false;
+    }
+
+    bool waitAll() {
+        return !failed_;
+    }
+#endif
+
+#ifdef HV_RECORD_WRITER_HAVE_IO_URING
+    int ring_fd_ = -1;
+    void* sq_map_ = nullptr;
+    size_t sq_map_bytes_ = 0;
+    void* cq_map_ = nullptr;
+    size_t cq_map_bytes_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_bytes_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    std::vector<uint64_t> chunk_offsets_;    // 在途块的文件偏移，短写时用于补写
+
+    bool setupRing(size_t depth) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        const int fd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(depth), &params));
+        if (fd < 0) {
+            error_ = std::string("io_uring unavailable: ") + strerror(errno) + ", using O_DIRECT writes";
+            return false;
+        }
+        ring_fd_ = fd;
+        sq_map_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_map_bytes_ > sq_map_bytes_) {
+            sq_map_bytes_ = cq_map_bytes_;
+        }
+        sq_map_ = mmap(nullptr, sq_map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_map_ == MAP_FAILED) {
+            sq_map_ = nullptr;
+            teardownRing();
+            error_ = "io_uring mmap failed, using O_DIRECT writes";
+            return false;
+        }
+        if (single_mmap) {
+            cq_map_ = sq_map_;
+        } else {
+            cq_map_ = mmap(nullptr, cq_map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_map_ == MAP_FAILED) {
+                cq_map_ = nullptr;
+                teardownRing();
+                error_ = "io_uring mmap failed, using O_DIRECT writes";
+                return false;
+            }
+        }
+        sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            teardownRing();
+            error_ = "io_uring mmap failed, using O_DIRECT writes";
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+        uint8_t* sq = static_cast<uint8_t*>(sq_map_);
+        uint8_t* cq = static_cast<uint8_t*>(cq_map_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        chunk_offsets_.assign(chunks_.size(), 0);
+        return true;
+    }
+
+    void teardownRing() {
+        if (sqes_) {
+            munmap(sqes_, sqes_bytes_);
+            sqes_ = nullptr;
+        }
+        if (cq_map_ && cq_map_ != sq_map_) {
+            munmap(cq_map_, cq_map_bytes_);
+        }
+        cq_map_ = nullptr;
+        if (sq_map_) {
+            munmap(sq_map_, sq_map_bytes_);
+            sq_map_ = nullptr;
+        }
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+            ring_fd_ = -1;
+        }
+        in_flight_ = 0;
+    }
+
+    bool ringSubmit(size_t index, uint64_t offset) {
+        Chunk& chunk = chunks_[index];
+        const unsigned tail = *sq_tail_;
+        const unsigned slot = tail & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[slot];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd_;
+        sqe->off = offset;
+        sqe->addr = reinterpret_cast<uint64_t>(chunk.data);
+        sqe->len = static_cast<uint32_t>(chunk.used);
+        sqe->user_data = index;
+        sq_array_[slot] = slot;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        for (;;) {
+            const int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0));
+            if (ret >= 0) {
+                markInFlight(index, offset);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                fail(std::string("io_uring_enter failed: ") + strerror(errno));
+                ringUnsubmit(index, offset, tail);
+                return false;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            // 完成队列满或暂时资源不足：有在途请求时阻塞等待至少一个完成后重试，不空转
+            if (in_flight_ > 0) {
+                if (!ringReap(true)) {
+                    ringUnsubmit(index, offset, tail);
+                    return false;
+                }
+                continue;
+            }
+            // 没有在途请求可等待：撤回请求，本块改为同步写入
+            ringUnsubmit(index, offset, tail);
+            if (chunk.in_flight) {
+                return true;
+            }
+            if (!pwriteAll(chunk.data, chunk.used, offset)) {
+                return false;
+            }
+            chunk.used = 0;
+            return true;
+        }
+    }
+
+    void markInFlight(size_t index, uint64_t offset) {
+        chunks_[index].in_flight = true;
+        chunk_offsets_[index] = offset;
+        in_flight_++;
+    }
+
+    // 提交失败后撤回提交队列中的请求，使in_flight_只计入内核已接收的请求，waitAll不会等待永远不会完成的请求；
+    // 内核已经取走该请求时仍按在途处理，等待其完成后才能释放暂存块
+    void ringUnsubmit(size_t index, uint64_t offset, unsigned tail) {
+        if (__atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail) {
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+        } else {
+            markInFlight(index, offset);
+        }
+    }
+
+    // 收割完成事件；wait为true时至少等待一个
+    bool ringReap(bool wait) {
+        if (in_flight_ == 0) {
+            return !failed_;
+        }
+        unsigned head = *cq_head_;
+        if (wait && head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            const int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                                                     IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret < 0 && errno != EINTR) {
+                fail(std::string("io_uring_enter failed: ") + strerror(errno));
+                return false;
+            }
+        }
+        while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+            const size_t index = static_cast<size_t>(cqe->user_data);
+            const int res = cqe->res;
+            head++;
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            Chunk& chunk = chunks_[index];
+            in_flight_--;
+            if (res == -EINVAL || res == -EOPNOTSUPP) {
+                // 内核不支持IORING_OP_WRITE（5.6之前）：本块同步补写，之后改用Direct
+                error_ = "io_uring write not supported, using O_DIRECT writes";
+                backend_ = RecordWriteBackend::Direct;
+                if (!pwriteAll(chunk.data, chunk.used, chunk_offsets_[index])) {
+                    return false;
+                }
+            } else if (res < 0) {
+                fail(std::string("write failed: ") + strerror(-res));
+                return false;
+            } else if (static_cast<size_t>(res) < chunk.used) {
+                // 短写：剩余部分同步补写
+                if (!pwriteAll(chunk.data + res, chunk.used - res, chunk_offsets_[index] + res)) {
+                    return false;
+                }
+            }
+            chunk.used = 0;
+            chunk.in_flight = false;
+        }
+        return !failed_;
+    }
+#else
+    bool setupRing(size_t) {
+        error_ = "io_uring not available in this build, using O_DIRECT writes";
+        return false;
+    }
+
+    void teardownRing() {}
+
+    bool ringSubmit(size_t, uint64_t) {
+        return false;
+    }
+
+    bool ringReap(bool) {
+        return !failed_;
+    }
+#endif
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+};
+
+} // namespace hv
+
+#endif // HV_RECORD_WRITER_H
@@ -0,0 +1,881 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_SUBFRAME_DECODER_H
+#define HV_SUBFRAME_DECODER_H
+
+/*
+ * EVS原始子帧解码器（仅头文件）
+ *
+ * 子帧布局（32KB）：
+ *   word[0]   : bit0-23 头标志(0xFFFF)，bit24-63 40位时间戳（200个tick为1μs）
+ *   word[1]   : bit44-47 子帧编号(0-3)
+ *   word[2..] : 304行 × 12个64位字，每像素2bit（0=无事件，1=OFF，2/3=ON）
+ *   其余为填充
+ * 子帧编号决定其在768x608全幅中的位置：(x_offset, y_offset)，像素间隔为2。
+ *
+ * C代码通过 HV_SUBFRAME_DECODE_SPARSE 宏在调用处展开解码循环；
+ * C++代码通过 hv::decodeSubframe<Policy>() 使用编译期输出策略，
+ * 两者共用同一份行遍历实现。
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define HV_SUBFRAME_BYTE_SIZE        (32768)     /* 子帧完整字节数 */
+#define HV_SUBFRAME_WORDS            (HV_SUBFRAME_BYTE_SIZE / 8)
+#define HV_SUBFRAME_HEADER_WORDS     (2)         /* 头部64位字数 */
+#define HV_SUBFRAME_ROWS             (304)       /* 子帧高度 */
+#define HV_SUBFRAME_WORDS_PER_ROW    (12)        /* 384像素 × 2bit / 64bit */
+#define HV_SUBFRAME_GROUP_SIZE       (4)         /* 每组子帧数 */
+#define HV_SUBFRAME_GROUP_BYTE_SIZE  (HV_SUBFRAME_BYTE_SIZE * HV_SUBFRAME_GROUP_SIZE)
+#define HV_SUBFRAME_HEADER_MAGIC     (0xFFFF)
+#define HV_SUBFRAME_HEADER_BYTES     (HV_SUBFRAME_HEADER_WORDS * 8)
+#define HV_SUBFRAME_TICKS_PER_US     (200)
+#define HV_SUBFRAME_TIMESTAMP_MASK   (0xFFFFFFFFFFULL)   /* 时间戳为40位 */
+#define HV_SUBFRAME_MAX_GAP_TICKS    (1000000ULL * HV_SUBFRAME_TICKS_PER_US) /* 相邻子帧时间戳最大间隔（1秒） */
+
+#define HV_BITPLANE_WIDTH            (768)       /* 全幅位平面宽度 */
+#define HV_BITPLANE_HEIGHT           (608)       /* 全幅位平面高度 */
+#define HV_BITPLANE_WORDS_PER_ROW    (HV_BITPLANE_WIDTH / 64)
+#define HV_BITPLANE_WORDS            (HV_BITPLANE_WORDS_PER_ROW * HV_BITPLANE_HEIGHT)
+
+/* 每个2bit像素的低位掩码 */
+#define HV_SUBFRAME_PIXEL_LOW_BITS   (0x5555555555555555ULL)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 子帧头信息
+ */
+typedef struct {
+    uint64_t raw_timestamp;     /* 原始40位时间戳 */
+    uint64_t timestamp;         /* 时间戳（微秒） */
+    uint32_t subframe_id;       /* 子帧编号 */
+    int      header_valid;      /* 头标志是否为0xFFFF */
+    int      x_offset;          /* 全幅X偏移 */
+    int      y_offset;          /* 全幅Y偏移 */
+} hv_subframe_header_t;
+
+/**
+ * @brief 解析子帧头
+ * 子帧编号0-3映射到2x2交织位置，其他编号按(0,0)处理
+ * @param words 子帧起始地址
+ * @param hdr 输出头信息
+ */
+static inline void hv_subframe_parse_header(const uint64_t* words, hv_subframe_header_t* hdr)
+{
+    hdr->raw_timestamp = (words[0] >> 24) & 0xFFFFFFFFFFULL;
+    hdr->timestamp = hdr->raw_timestamp / HV_SUBFRAME_TICKS_PER_US;
+    hdr->header_valid = (words[0] & 0xFFFFFF) == HV_SUBFRAME_HEADER_MAGIC;
+    hdr->subframe_id = (uint32_t)((words[1] >> 44) & 0xF);
+    hdr->x_offset = (hdr->subframe_id < 4) ? (int)(hdr->subframe_id & 0x1) : 0;
+    hdr->y_offset = (hdr->subframe_id < 4) ? (int)(hdr->subframe_id >> 1) : 0;
+}
+
+/**
+ * @brief 子帧流同步状态与丢失统计
+ * 按子帧顺序调用 hv_subframe_stream_check 校验头部和子帧编号序列（0,1,2,3,0,...）
+ */
+typedef struct {
+    uint64_t subframes;                 /* 通过校验的子帧数 */
+    uint64_t lost_subframes;            /* 按子帧编号跳变推算的丢失子帧数 */
+    uint64_t discarded_subframes;       /* 所在子帧组不完整而丢弃的有效子帧数 */
+    uint64_t resyncs;                   /* 头部校验失败后重新同步的次数 */
+    uint64_t skipped_bytes;             /* 重新同步时跳过的字节数 */
+    uint64_t timestamp_discontinuities; /* 时间戳回退或跳变超过1秒的次数 */
+    int      have_prev;                 /* 以下为上一个子帧的状态 */
+    uint32_t prev_id;
+    uint64_t prev_raw_timestamp;
+} hv_subframe_stream_t;
+
+#define HV_SUBFRAME_ACCEPTED    (0)     /* 头部有效且编号连续 */
+#define HV_SUBFRAME_GAP         (1)     /* 头部有效，编号不连续 */
+#define HV_SUBFRAME_MISALIGNED  (-1)    /* 头部无效，数据未对齐 */
+
+static inline void hv_subframe_stream_init(hv_subframe_stream_t* s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+/**
+ * @brief 判断地址处是否像一个子帧头（头标志为0xFFFF且子帧编号为0-3）
+ * 只要求8字节对齐
+ */
+static inline int hv_subframe_header_plausible(const uint8_t* data)
+{
+    uint64_t words[HV_SUBFRAME_HEADER_WORDS];
+    memcpy(words, data, sizeof(words));
+    return (words[0] & 0xFFFFFF) == HV_SUBFRAME_HEADER_MAGIC && ((words[1] >> 44) & 0xF) < 4;
+}
+
+/**
+ * @brief 从offset开始以8字节为步长查找下一个子帧头
+ * 像素数据也可能恰好出现头标志，若其后32KB处仍在缓冲内，要求该处同样是子帧头
+ * @param data 缓冲起始地址
+ * @param bytes 缓冲字节数
+ * @param offset 查找起点
+ * @return 子帧头偏移，缓冲内没有完整的子帧头时返回bytes
+ */
+static inline size_t hv_subframe_find_header(const uint8_t* data, size_t bytes, size_t offset)
+{
+    for (; offset + HV_SUBFRAME_HEADER_BYTES <= bytes; offset += 8) {
+        if (!hv_subframe_header_plausible(data + offset)) {
+            continue;
+        }
+        if (offset + HV_SUBFRAME_BYTE_SIZE + HV_SUBFRAME_HEADER_BYTES > bytes ||
+            hv_subframe_header_plausible(data + offset + HV_SUBFRAME_BYTE_SIZE)) {
+            return offset;
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief 校验一个子帧头并更新序列和丢失统计
+ * 编号跳变时按模4计入丢失子帧数；时间戳按40位取模计算差值，回退或超过1秒计为一次不连续
+ * @return HV_SUBFRAME_ACCEPTED / HV_SUBFRAME_GAP / HV_SUBFRAME_MISALIGNED
+ */
+static inline int hv_subframe_stream_check(hv_subframe_stream_t* s, const hv_subframe_header_t* hdr)
+{
+    if (!hdr->header_valid || hdr->subframe_id >= 4) {
+        return HV_SUBFRAME_MISALIGNED;
+    }
+    int result = HV_SUBFRAME_ACCEPTED;
+    if (s->have_prev) {
+        const uint32_t expected = (s->prev_id + 1) & 0x3;
+        if (hdr->subframe_id != expected) {
+            s->lost_subframes += (hdr->subframe_id - expected) & 0x3;
+            result = HV_SUBFRAME_GAP;
+        }
+        const uint64_t delta = (hdr->raw_timestamp - s->prev_raw_timestamp) & HV_SUBFRAME_TIMESTAMP_MASK;
+        if (delta > HV_SUBFRAME_MAX_GAP_TICKS) {
+            s->timestamp_discontinuities++;
+        }
+    }
+    s->have_prev = 1;
+    s->prev_id = hdr->subframe_id;
+    s->prev_raw_timestamp = hdr->raw_timestamp;
+    s->subframes++;
+    return result;
+}
+
+/**
+ * @brief 判断一行（12个64位字）是否全为零
+ * aarch64使用NEON，x86使用SSE2，其他平台逐字或运算
+ */
+static inline int hv_subframe_row_is_zero(const uint64_t* row)
+{
+#if defined(__aarch64__)
+    uint64x2_t any = vorrq_u64(
+        vorrq_u64(vorrq_u64(vld1q_u64(row), vld1q_u64(row + 2)),
+                  vorrq_u64(vld1q_u64(row + 4), vld1q_u64(row + 6))),
+        vorrq_u64(vld1q_u64(row + 8), vld1q_u64(row + 10)));
+    return vmaxvq_u32(vreinterpretq_u32_u64(any)) == 0;
+#elif defined(__SSE2__)
+    const __m128i* v = (const __m128i*)row;
+    __m128i any = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_loadu_si128(v), _mm_loadu_si128(v + 1)),
+                     _mm_or_si128(_mm_loadu_si128(v + 2), _mm_loadu_si128(v + 3))),
+        _mm_or_si128(_mm_loadu_si128(v + 4), _mm_loadu_si128(v + 5)));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint64_t any = 0;
+    for (int j = 0; j < HV_SUBFRAME_WORDS_PER_ROW; j++) {
+        any |= row[j];
+    }
+    return any == 0;
+#endif
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief AVX2版本的行全零判断，调用方需先确认CPU支持AVX2/BMI
+ */
+__attribute__((target("avx2,bmi")))
+static inline int hv_subframe_row_is_zero_avx2(const uint64_t* row)
+{
+    const __m256i* v = (const __m256i*)row;
+    __m256i any = _mm256_or_si256(_mm256_loadu_si256(v),
+                  _mm256_or_si256(_mm256_loadu_si256(v + 1), _mm256_loadu_si256(v + 2)));
+    return _mm256_testz_si256(any, any);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief 稀疏解码子帧像素区
+ * 全零行由 ROW_IS_ZERO 批量跳过，非零字用ctz逐个定位事件像素，
+ * 对每个事件展开 EMIT(x, y, p)。第k位开始的像素对应 x = x_offset + j*64 + k，
+ * 输出顺序与逐像素扫描一致；子帧坐标最大为(767, 607)，无需逐像素边界检查。
+ * @param pixels 像素区起始地址（子帧头之后）
+ * @param x_offset 子帧X偏移
+ * @param y_offset 子帧Y偏移
+ * @param ROW_IS_ZERO 行全零判断函数
+ * @param EMIT 事件输出宏或函数
+ */
+#define HV_SUBFRAME_DECODE_SPARSE(pixels, x_offset, y_offset, ROW_IS_ZERO, EMIT)              \
+    do {                                                                                      \
+        const uint64_t* hv_row_ = (pixels);                                                   \
+        int hv_y_ = (y_offset);                                                               \
+        for (int hv_i_ = 0; hv_i_ < HV_SUBFRAME_ROWS; hv_i_++) {                              \
+            if (!ROW_IS_ZERO(hv_row_)) {                                                      \
+                for (int hv_j_ = 0; hv_j_ < HV_SUBFRAME_WORDS_PER_ROW; hv_j_++) {             \
+                    const uint64_t hv_w_ = hv_row_[hv_j_];                                    \
+                    uint64_t hv_m_ = (hv_w_ | (hv_w_ >> 1)) & HV_SUBFRAME_PIXEL_LOW_BITS;     \
+                    while (hv_m_) {                                                           \
+                        const int hv_b_ = __builtin_ctzll(hv_m_);                             \
+                        EMIT((x_offset) + hv_j_ * 64 + hv_b_, hv_y_,                          \
+                             (int)((hv_w_ >> (hv_b_ + 1)) & 0x1));                            \
+                        hv_m_ &= hv_m_ - 1;                                                   \
+                    }                                                                         \
+                }                                                                             \
+            }                                                                                 \
+            hv_row_ += HV_SUBFRAME_WORDS_PER_ROW;                                             \
+            hv_y_ += 2;                                                                       \
+        }                                                                                     \
+    } while (0)
+
+/**
+ * @brief 逐像素解码子帧像素区（标量回退路径）
+ * 参数同 HV_SUBFRAME_DECODE_SPARSE
+ */
+#define HV_SUBFRAME_DECODE_SCALAR(pixels, x_offset, y_offset, EMIT)                           \
+    do {                                                                                      \
+        const uint64_t* hv_row_ = (pixels);                                                   \
+        int hv_y_ = (y_offset);                                                               \
+        for (int hv_i_ = 0; hv_i_ < HV_SUBFRAME_ROWS; hv_i_++) {                              \
+            int hv_x_ = (x_offset);                                                           \
+            for (int hv_j_ = 0; hv_j_ < HV_SUBFRAME_WORDS_PER_ROW; hv_j_++) {                 \
+                const uint64_t hv_w_ = hv_row_[hv_j_];                                        \
+                for (int hv_k_ = 0; hv_k_ < 64; hv_k_ += 2) {                                 \
+                    const uint64_t hv_pix_ = (hv_w_ >> hv_k_) & 0x3;                          \
+                    if (hv_pix_ > 0) {                                                        \
+                        EMIT(hv_x_, hv_y_, (int)(hv_pix_ >> 1));                              \
+                    }                                                                         \
+                    hv_x_ += 2;                                                               \
+                }                                                                             \
+            }                                                                                 \
+            hv_row_ += HV_SUBFRAME_WORDS_PER_ROW;                                             \
+            hv_y_ += 2;                                                                       \
+        }                                                                                     \
+    } while (0)
+
+/**
+ * @brief 将子帧像素写入全幅ON/OFF位平面（768x608，每行12个64位字，bit i对应x=64*j+i）
+ * 子帧每个64位字的32个像素在全幅中间隔2列，恰好覆盖全幅一行中的一个64位字，
+ * 因此只需取出每个2bit像素的高/低位再按x偏移移位，不需要逐事件展开；
+ * 结果按位或写入，调用方负责预先清零
+ * @param pixels 子帧像素区起始地址（跳过头部）
+ * @param x_offset 全幅X偏移
+ * @param y_offset 全幅Y偏移
+ * @param on_plane ON位平面（像素值2/3）
+ * @param off_plane OFF位平面（像素值1）
+ */
+static inline void hv_subframe_to_bitplane(const uint64_t* pixels, int x_offset, int y_offset,
+                                           uint64_t* on_plane, uint64_t* off_plane)
+{
+    for (int r = 0; r < HV_SUBFRAME_ROWS; r++) {
+        const uint64_t* row = pixels + r * HV_SUBFRAME_WORDS_PER_ROW;
+        if (hv_subframe_row_is_zero(row)) {
+            continue;
+        }
+        uint64_t* on = on_plane + (size_t)(y_offset + 2 * r) * HV_BITPLANE_WORDS_PER_ROW;
+        uint64_t* off = off_plane + (size_t)(y_offset + 2 * r) * HV_BITPLANE_WORDS_PER_ROW;
+        for (int j = 0; j < HV_SUBFRAME_WORDS_PER_ROW; j++) {
+            const uint64_t hi = (row[j] >> 1) & HV_SUBFRAME_PIXEL_LOW_BITS;
+            const uint64_t lo = row[j] & HV_SUBFRAME_PIXEL_LOW_BITS;
+            on[j] |= hi << x_offset;
+            off[j] |= (lo & ~hi) << x_offset;
+        }
+    }
+}
+
+#ifdef __cplusplus
+
+#include <vector>
+#include <algorithm>
+
+namespace hv {
+
+using SubframeHeader = hv_subframe_header_t;
+
+/**
+ * 子帧解码路径
+ */
+enum class SubframeDecodePath {
+    Scalar,     // 逐像素扫描
+    Sparse,     // 全零行跳过（NEON / SSE2）+ ctz
+    AVX2        // 全零行跳过（AVX2）+ ctz，需运行时检测
+};
+
+/**
+ * 获取当前CPU支持的最快解码路径
+ */
+inline SubframeDecodePath bestSubframeDecodePath() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")) {
+        return SubframeDecodePath::AVX2;
+    }
+#endif
+    return SubframeDecodePath::Sparse;
+}
+
+/*
+ * 输出策略接口：
+ *   static constexpr bool kDecodePixels;        // false时只解析子帧头
+ *   bool beginSubframe(const SubframeHeader&);  // 返回false跳过该子帧像素
+ *   void emit(int x, int y, int p);             // 输出一个事件
+ */
+
+namespace detail {
+
+template <typename Policy>
+inline void decodeSubframePixelsSparse(const uint64_t* pixels, const SubframeHeader& hdr, Policy& policy) {
+    HV_SUBFRAME_DECODE_SPARSE(pixels, hdr.x_offset, hdr.y_offset, hv_subframe_row_is_zero, policy.emit);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <typename Policy>
+__attribute__((target("avx2,bmi")))
+inline void decodeSubframePixelsAVX2(const uint64_t* pixels, const SubframeHeader& hdr, Policy& policy) {
+    HV_SUBFRAME_DECODE_SPARSE(pixels, hdr.x_offset, hdr.y_offset, hv_subframe_row_is_zero_avx2, policy.emit);
+}
+#endif
+
+template <typename Policy>
+inline void decodeSubframePixelsScalar(const uint64_t* pixels, const SubframeHeader& hdr, Policy& policy) {
+    HV_SUBFRAME_DECODE_SCALAR(pixels, hdr.x_offset, hdr.y_offset, policy.emit);
+}
+
+} // namespace detail
+
+/**
+ * 解码单个子帧
+ * @param words 子帧起始地址（32KB）
+ * @param policy 输出策略
+ * @param path 解码路径
+ * @return 子帧头是否有效
+ */
+template <typename Policy>
+inline bool decodeSubframe(const uint64_t* words, Policy& policy,
+                           SubframeDecodePath path = SubframeDecodePath::Sparse) {
+    SubframeHeader hdr;
+    hv_subframe_parse_header(words, &hdr);
+    if (!policy.beginSubframe(hdr) || !Policy::kDecodePixels) {
+        return hdr.header_valid != 0;
+    }
+
+    const uint64_t* pixels = words + HV_SUBFRAME_HEADER_WORDS;
+    switch (path) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SubframeDecodePath::AVX2:
+        detail::decodeSubframePixelsAVX2(pixels, hdr, policy);
+        break;
+#endif
+    case SubframeDecodePath::Scalar:
+        detail::decodeSubframePixelsScalar(pixels, hdr, policy);
+        break;
+    default:
+        detail::decodeSubframePixelsSparse(pixels, hdr, policy);
+        break;
+    }
+    return hdr.header_valid != 0;
+}
+
+/**
+ * 解码一组子帧（4个子帧，128KB）
+ * @param data 子帧组起始地址
+ * @param policy 输出策略
+ * @param path 解码路径
+ * @return 头标志有效的子帧数
+ */
+template <typename Policy>
+inline int decodeSubframeGroup(const uint8_t* data, Policy& policy,
+                               SubframeDecodePath path = SubframeDecodePath::Sparse) {
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(data);
+    int valid = 0;
+    for (int sub = 0; sub < HV_SUBFRAME_GROUP_SIZE; sub++) {
+        valid += decodeSubframe(words + sub * HV_SUBFRAME_WORDS, policy, path) ? 1 : 0;
+    }
+    return valid;
+}
+
+/**
+ * 事件数组输出策略
+ * Event需支持 Event(x, y, p, t) 构造，如 Metavision::EventCD
+ */
+template <typename Event>
+struct EventVectorPolicy {
+    static constexpr bool kDecodePixels = true;
+
+    std::vector<Event>& events;
+    int64_t timestamp = 0;
+
+    explicit EventVectorPolicy(std::vector<Event>& out) : events(out) {}
+
+    bool beginSubframe(const SubframeHeader& hdr) {
+        timestamp = static_cast<int64_t>(hdr.timestamp);
+        return true;
+    }
+
+    void emit(int x, int y, int p) {
+        events.emplace_back(static_cast<unsigned short>(x), static_cast<unsigned short>(y),
+                            static_cast<short>(p), timestamp);
+    }
+};
+
+/**
+ * 事件计数输出策略
+ */
+struct EventCountPolicy {
+    static constexpr bool kDecodePixels = true;
+
+    uint64_t on_count = 0;
+    uint64_t off_count = 0;
+
+    bool beginSubframe(const SubframeHeader&) { return true; }
+
+    void emit(int, int, int p) {
+        if (p) {
+            ++on_count;
+        } else {
+            ++off_count;
+        }
+    }
+};
+
+/**
+ * 时间戳输出策略：只解析子帧头，不遍历像素
+ * 每个子帧头调用一次 Callback(const SubframeHeader&)
+ */
+template <typename Callback>
+struct TimestampPolicy {
+    static constexpr bool kDecodePixels = false;
+
+    Callback callback;
+
+    explicit TimestampPolicy(Callback cb) : callback(cb) {}
+
+    bool beginSubframe(const SubframeHeader& hdr) {
+        callback(hdr);
+        return false;
+    }
+
+    void emit(int, int, int) {}
+};
+
+template <typename Callback>
+inline TimestampPolicy<Callback> makeTimestampPolicy(Callback cb) {
+    return TimestampPolicy<Callback>(cb);
+}
+
+/**
+ * 按子帧分组的紧凑事件包（结构数组布局）
+ * 同一子帧内的事件共享一个时间戳，只在subframes中存储一次；
+ * events中每个事件打包为32位：x(bit 0-15) | y(bit 16-30) | p(bit 31)
+ * 第i个子帧的事件为events中紧随前i-1个子帧之后的subframes[i].count个元素
+ */
+struct EventPacket {
+    struct Subframe {
+        int64_t timestamp;      // 子帧时间戳（微秒）
+        uint32_t subframe_id;   // 子帧ID
+        uint32_t count;         // 该子帧的事件数
+    };
+
+    std::vector<Subframe> subframes;
+    std::vector<uint32_t> events;
+
+    static uint32_t pack(int x, int y, int p) {
+        return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 16) | (static_cast<uint32_t>(p) << 31);
+    }
+    static int x(uint32_t e) { return static_cast<int>(e & 0xFFFF); }
+    static int y(uint32_t e) { return static_cast<int>((e >> 16) & 0x7FFF); }
+    static int p(uint32_t e) { return static_cast<int>(e >> 31); }
+
+    void clear() {
+        subframes.clear();
+        events.clear();
+    }
+
+    bool empty() const {
+        return events.empty();
+    }
+
+    /**
+     * 展开为逐事件结构，Event需支持 Event(x, y, p, t) 构造，如 Metavision::EventCD
+     * @param out 输出数组（追加）
+     */
+    template <typename Event>
+    void toEvents(std::vector<Event>& out) const {
+        out.reserve(out.size() + events.size());
+        size_t index = 0;
+        for (const Subframe& sub : subframes) {
+            for (uint32_t i = 0; i < sub.count; ++i, ++index) {
+                const uint32_t e = events[index];
+                out.emplace_back(static_cast<unsigned short>(x(e)), static_cast<unsigned short>(y(e)),
+                                 static_cast<short>(p(e)), sub.timestamp);
+            }
+        }
+    }
+};
+
+/**
+ * 全幅ON/OFF位平面帧，对应一组4个交织子帧
+ * on/off各HV_BITPLANE_HEIGHT行，每行HV_BITPLANE_WORDS_PER_ROW个64位字，
+ * 像素(x, y)对应字 y*HV_BITPLANE_WORDS_PER_ROW + x/64 的 bit x%64
+ */
+struct EventBitplaneFrame {
+    SubframeHeader subframes[HV_SUBFRAME_GROUP_SIZE];   // 按到达顺序的子帧头
+    int subframe_count = 0;
+    std::vector<uint64_t> on;
+    std::vector<uint64_t> off;
+
+    EventBitplaneFrame() : on(HV_BITPLANE_WORDS, 0), off(HV_BITPLANE_WORDS, 0) {}
+
+    void clear() {
+        std::fill(on.begin(), on.end(), 0);
+        std::fill(off.begin(), off.end(), 0);
+        subframe_count = 0;
+    }
+
+    bool isOn(int x, int y) const {
+        return (on[static_cast<size_t>(y) * HV_BITPLANE_WORDS_PER_ROW + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    bool isOff(int x, int y) const {
+        return (off[static_cast<size_t>(y) * HV_BITPLANE_WORDS_PER_ROW + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    /**
+     * 获取像素(x, y)所属子帧的时间戳（微秒），该位置没有子帧时返回-1
+     */
+    int64_t timestampAt(int x, int y) const {
+        for (int i = subframe_count - 1; i >= 0; --i) {
+            if (subframes[i].x_offset == (x & 1) && subframes[i].y_offset == (y & 1)) {
+                return static_cast<int64_t>(subframes[i].timestamp);
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * 展开为逐事件结构（按行优先顺序，同一像素ON在前），Event需支持 Event(x, y, p, t) 构造
+     * 时间戳取像素所属子帧的时间戳，该位置没有子帧的像素不输出
+     * @param out 输出数组（追加）
+     */
+    template <typename Event>
+    void toEvents(std::vector<Event>& out) const {
+        int64_t parity_ts[4];
+        for (int parity = 0; parity < 4; ++parity) {
+            parity_ts[parity] = timestampAt(parity & 1, parity >> 1);
+        }
+        for (int y = 0; y < HV_BITPLANE_HEIGHT; ++y) {
+            for (int w = 0; w < HV_BITPLANE_WORDS_PER_ROW; ++w) {
+                const size_t index = static_cast<size_t>(y) * HV_BITPLANE_WORDS_PER_ROW + w;
+                uint64_t bits = on[index] | off[index];
+                while (bits) {
+                    const int bit = __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    const int x = w * 64 + bit;
+                    const int64_t t = parity_ts[(x & 1) | ((y & 1) << 1)];
+                    if (t < 0) {
+                        continue;
+                    }
+                    if ((on[index] >> bit) & 1) {
+                        out.emplace_back(static_cast<unsigned short>(x), static_cast<unsigned short>(y),
+                                         static_cast<short>(1), t);
+                    }
+                    if ((off[index] >> bit) & 1) {
+                        out.emplace_back(static_cast<unsigned short>(x), static_cast<unsigned short>(y),
+                                         static_cast<short>(0), t);
+                    }
+                }
+            }
+        }
+    }
+};
+
+/**
+ * 解码单个子帧到全幅位平面（不展开事件）
+ * @param words 子帧起始地址（32KB）
+ * @param frame 输出位平面帧，结果按位或写入
+ * @return 子帧头是否有效
+ */
+inline bool decodeSubframeBitplane(const uint64_t* words, EventBitplaneFrame& frame) {
+    SubframeHeader hdr;
+    hv_subframe_parse_header(words, &hdr);
+    if (frame.subframe_count < HV_SUBFRAME_GROUP_SIZE) {
+        frame.subframes[frame.subframe_count++] = hdr;
+    }
+    hv_subframe_to_bitplane(words + HV_SUBFRAME_HEADER_WORDS, hdr.x_offset, hdr.y_offset,
+                            frame.on.data(), frame.off.data());
+    return hdr.header_valid != 0;
+}
+
+/**
+ * 解码一组子帧（4个子帧，128KB）到全幅位平面
+ * @param data 子帧组起始地址
+ * @param frame 输出位平面帧，先清零再写入
+ * @return 头标志有效的子帧数
+ */
+inline int decodeSubframeGroupBitplane(const uint8_t* data, EventBitplaneFrame& frame) {
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(data);
+    frame.clear();
+    int valid = 0;
+    for (int sub = 0; sub < HV_SUBFRAME_GROUP_SIZE; sub++) {
+        valid += decodeSubframeBitplane(words + sub * HV_SUBFRAME_WORDS, frame) ? 1 : 0;
+    }
+    return valid;
+}
+
+/**
+ * 紧凑事件包输出策略
+ */
+struct EventPacketPolicy {
+    static constexpr bool kDecodePixels = true;
+
+    EventPacket& packet;
+
+    explicit EventPacketPolicy(EventPacket& out) : packet(out) {}
+
+    bool beginSubframe(const SubframeHeader& hdr) {
+        packet.subframes.push_back(EventPacket::Subframe{static_cast<int64_t>(hdr.timestamp), hdr.subframe_id, 0});
+        return true;
+    }
+
+    void emit(int x, int y, int p) {
+        packet.events.push_back(EventPacket::pack(x, y, p));
+        ++packet.subframes.back().count;
+    }
+};
+
+using SubframeStreamStats = hv_subframe_stream_t;
+
+/**
+ * 子帧流解析器：把连续到达的原始数据缓冲切分为完整的子帧组（编号0-3的4个连续子帧）
+ *
+ * - 逐个校验子帧头和编号序列；头部校验失败时以8字节为步长向后查找下一个子帧头，
+ *   不再按错位的数据解码
+ * - 编号不连续时丢弃未完成的子帧组，从下一个编号为0的子帧重新开始
+ * - 缓冲长度不必是子帧组的整数倍：完全位于缓冲内的子帧组直接传出缓冲内地址（不拷贝），
+ *   跨越缓冲边界的子帧组拷贝到内部缓冲拼接完整后传出，该地址只在回调期间有效
+ * 非线程安全，同一数据流只能由一个线程按顺序调用parse()
+ */
+class SubframeStreamParser {
+public:
+    SubframeStreamParser() : carry_(HV_SUBFRAME_GROUP_BYTE_SIZE / sizeof(uint64_t)) {
+        reset();
+    }
+
+    /**
+     * 清除统计和同步状态
+     */
+    void reset() {
+        group_count_ = 0;
+        restart();
+        hv_subframe_stream_init(&stats_);
+    }
+
+    /**
+     * 调用方主动丢弃数据后调用：丢弃未完成的子帧组，下一个缓冲重新查找子帧头，
+     * 且不把丢弃造成的编号和时间戳跳变计为丢失
+     */
+    void restart() {
+        stats_.discarded_subframes += group_count_;
+        stats_.have_prev = 0;
+        synced_ = false;
+        skip_ = 0;
+        group_count_ = 0;
+        carry_bytes_ = 0;
+        stash_bytes_ = 0;
+    }
+
+    /**
+     * 解析一个缓冲
+     * @param data 缓冲起始地址
+     * @param bytes 缓冲字节数
+     * @param on_group 每个完整子帧组按顺序回调一次 on_group(const uint8_t* group)，
+     *                 group位于[data, data + bytes)内时在缓冲被复用之前有效，否则只在回调期间有效
+     */
+    template <typename OnGroup>
+    void parse(const uint8_t* data, size_t bytes, OnGroup&& on_group) {
+        size_t pos = 0;
+        const uint8_t* group_start = nullptr;   // 本缓冲内的子帧组起点，为空表示子帧组在carry_中
+
+        // 上一缓冲末尾子帧的剩余部分
+        if (skip_ > 0) {
+            pos = std::min(skip_, bytes);
+            if (group_count_ > 0) {
+                appendCarry(data, pos);
+            }
+            skip_ -= pos;
+            if (skip_ == 0 && group_count_ == HV_SUBFRAME_GROUP_SIZE) {
+                emitCarry(on_group);
+            }
+        }
+
+        while (pos < bytes) {
+            if (!synced_) {
+                const size_t found = hv_subframe_find_header(data, bytes, pos);
+                stats_.skipped_bytes += found - pos;
+                pos = found;
+                if (pos >= bytes) {
+                    break;
+                }
+                synced_ = true;
+            }
+
+            // 读取子帧头，可能被上一缓冲截断
+            unsigned char header[HV_SUBFRAME_HEADER_BYTES];
+            const size_t header_need = HV_SUBFRAME_HEADER_BYTES - stash_bytes_;
+            if (bytes - pos < header_need) {
+                if (group_count_ > 0 && group_start) {
+                    moveToCarry(group_start, static_cast<size_t>(data + pos - group_start));
+                }
+                memcpy(stash_ + stash_bytes_, data + pos, bytes - pos);
+                stash_bytes_ += bytes - pos;
+                return;
+            }
+            memcpy(header, stash_, stash_bytes_);
+            memcpy(header + stash_bytes_, data + pos, header_need);
+            uint64_t words[HV_SUBFRAME_HEADER_WORDS];
+            memcpy(words, header, sizeof(words));
+            SubframeHeader hdr;
+            hv_subframe_parse_header(words, &hdr);
+
+            const int verdict = hv_subframe_stream_check(&stats_, &hdr);
+            if (verdict == HV_SUBFRAME_MISALIGNED) {
+                // 失去对齐：丢弃未完成的子帧组，向后查找下一个子帧头
+                stats_.resyncs++;
+                stats_.discarded_subframes += group_count_;
+                group_count_ = 0;
+                carry_bytes_ = 0;
+                group_start = nullptr;
+                synced_ = false;
+                if (stash_bytes_ > 0) {
+                    stats_.skipped_bytes += stash_bytes_;
+                    stash_bytes_ = 0;
+                } else {
+                    stats_.skipped_bytes += 8;
+                    pos += 8;
+                }
+                continue;
+            }
+            if (verdict == HV_SUBFRAME_GAP && group_count_ > 0) {
+                stats_.discarded_subframes += group_count_;
+                group_count_ = 0;
+                carry_bytes_ = 0;
+                group_start = nullptr;
+            }
+
+            // 子帧组从编号0开始，其余子帧丢弃
+            const size_t remaining = HV_SUBFRAME_BYTE_SIZE - stash_bytes_;   // 该子帧在本缓冲中的字节数（可能超出缓冲）
+            const bool in_group = group_count_ > 0 || hdr.subframe_id == 0;
+            if (!in_group) {
+                stats_.discarded_subframes++;
+            } else {
+                if (group_count_ == 0) {
+                    // 数据未按8字节对齐时也拷贝，保证按64位字访问
+                    const bool in_place = stash_bytes_ == 0 && (reinterpret_cast<uintptr_t>(data + pos) & 7) == 0;
+                    group_start = in_place ? data + pos : nullptr;
+                }
+                if (!group_start) {
+                    appendCarry(stash_, stash_bytes_);
+                    appendCarry(data + pos, std::min(remaining, bytes - pos));
+                }
+                group_count_++;
+            }
+            stash_bytes_ = 0;
+
+            if (remaining > bytes - pos) {
+                // 子帧延续到下一缓冲
+                skip_ = remaining - (bytes - pos);
+                if (group_count_ > 0 && group_start) {
+                    moveToCarry(group_start, static_cast<size_t>(data + bytes - group_start));
+                }
+                return;
+            }
+            pos += remaining;
+
+            if (group_count_ == HV_SUBFRAME_GROUP_SIZE) {
+                if (group_start) {
+                    group_count_ = 0;
+                    on_group(group_start);
+                    group_start = nullptr;
+                } else {
+                    emitCarry(on_group);
+                }
+            }
+        }
+
+        // 缓冲结束时未完成的子帧组转入carry_
+        if (group_count_ > 0 && group_start) {
+            moveToCarry(group_start, static_cast<size_t>(data + bytes - group_start));
+        }
+    }
+
+    /**
+     * 获取同步与丢失统计
+     */
+    const SubframeStreamStats& stats() const {
+        return stats_;
+    }
+
+private:
+    SubframeStreamStats stats_;
+    bool synced_ = false;           // 是否已知下一个子帧头的位置
+    size_t skip_ = 0;               // 下一缓冲开头属于上一子帧的剩余字节数
+    int group_count_ = 0;           // 当前子帧组已接收的子帧数
+    std::vector<uint64_t> carry_;   // 跨缓冲的子帧组
+    size_t carry_bytes_ = 0;
+    unsigned char stash_[HV_SUBFRAME_HEADER_BYTES];     // 被缓冲边界截断的子帧头
+    size_t stash_bytes_ = 0;
+
+    void appendCarry(const void* src, size_t n) {
+        memcpy(reinterpret_cast<unsigned char*>(carry_.data()) + carry_bytes_, src, n);
+        carry_bytes_ += n;
+    }
+
+    void moveToCarry(const uint8_t* group_start, size_t n) {
+        carry_bytes_ = 0;
+        appendCarry(group_start, n);
+    }
+
+    template <typename OnGroup>
+    void emitCarry(OnGroup& on_group) {
+        group_count_ = 0;
+        carry_bytes_ = 0;
+        on_group(reinterpret_cast<const uint8_t*>(carry_.data()));
+    }
+};
+
+} // namespace hv
+
+#endif // __cplusplus
+
+#endif // HV_SUBFRAME_DECODER_H
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2025 ShiMetaPi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HV_THREAD_PLACEMENT_H
+#define HV_THREAD_PLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace hv {
+
+/**
+ * 采集线程角色，用于按角色配置线程放置
+ */
+enum class ThreadRole {
+    UsbReceive,     // USB接收：异步传输的libusb事件线程（多台相机共享）或同步接收线程
+    Processing,     // 事件处理线程（取缓冲、分发解码任务）
+    Decode,         // 并行解码线程（全部解码线程使用同一配置）
+    Image,          // 图像接收与转换线程
+    Writer          // 录制写文件线程
+};
+
+/**
+ * 调度策略
+ */
+enum class SchedPolicy {
+    Unchanged,      // 不修改，沿用继承的策略
+    Other,          // SCHED_OTHER
+    Fifo,           // SCHED_FIFO，实时，需要CAP_SYS_NICE或root
+    RoundRobin      // SCHED_RR，实时，需要CAP_SYS_NICE或root
+};
+
+/**
+ * 线程放置配置，在线程启动时由线程自身应用
+ */
+struct ThreadPlacement {
+    static const int NICE_UNCHANGED = 100;
+
+    std::vector<int> cpus;                          // CPU亲和性，为空表示不修改
+    SchedPolicy policy = SchedPolicy::Unchanged;    // 调度策略
+    int priority = 0;                               // Fifo/RoundRobin的实时优先级（1-99）
+    int nice = NICE_UNCHANGED;                      // nice值（-20到19），仅对SCHED_OTHER有效
+
+    bool empty() const {
+        return cpus.empty() && policy == SchedPolicy::Unchanged && nice == NICE_UNCHANGED;
+    }
+};
+
+/**
+ * 线程实际生效的放置情况（应用后从内核读回）
+ */
+struct AppliedThreadPlacement {
+    std::string thread_name;    // 线程名（同时设置为内核线程名，便于top/htop中识别）
+    int tid = 0;                // 内核线程ID
+    std::vector<int> cpus;      // 实际的CPU亲和性
+    int policy = 0;             // 实际的调度策略（SCHED_OTHER/SCHED_FIFO/SCHED_RR）
+    int priority = 0;           // 实际的实时优先级
+    int nice = 0;               // 实际的nice值
+    std::string error;          // 应用失败的原因（如权限不足），为空表示配置全部生效
+};
+
+/**
+ * 对调用线程应用放置配置并读回实际生效的结果
+ * 部分设置失败（常见为没有实时调度权限）时继续应用其余设置，失败原因记录在error中
+ * @param name 线程名，超过15个字符时截断
+ * @param placement 放置配置
+ * @return 实际生效的放置情况
+ */
+inline AppliedThreadPlacement applyThreadPlacement(const std::string& name, const ThreadPlacement& placement) {
+    AppliedThreadPlacement applied;
+    applied.thread_name = name;
+#ifdef __linux__
+    const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    applied.tid = tid;
+    pthread_t self = pthread_self();
+    pthread_setname_np(self, name.substr(0, 15).c_str());
+
+    auto append_error = [&applied](const std::string& what, int err) {
+        if (!applied.error.empty()) {
+            applied.error += "; ";
+        }
+        applied.error += what + ": " + std::strerror(err);
+    };
+
+    if (!placement.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : placement.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = pthread_setaffinity_np(self, sizeof(set), &set);
+        if (ret) {
+            append_error("affinity", ret);
+        }
+    }
+
+    if (placement.policy != SchedPolicy::Unchanged) {
+        int policy = SCHED_OTHER;
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        if (placement.policy == SchedPolicy::Fifo || placement.policy == SchedPolicy::RoundRobin) {
+            policy = (placement.policy == SchedPolicy::Fifo) ? SCHED_FIFO : SCHED_RR;
+            int min_priority = sched_get_priority_min(policy);
+            int max_priority = sched_get_priority_max(policy);
+            param.sched_priority = placement.priority < min_priority ? min_priority
+                                 : (placement.priority > max_priority ? max_priority : placement.priority);
+        }
+        int ret = pthread_setschedparam(self, policy, &param);
+        if (ret) {
+            append_error("sched policy", ret);
+        }
+    }
+
+    // Linux上nice值按线程生效
+    if (placement.nice != ThreadPlacement::NICE_UNCHANGED) {
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), placement.nice) != 0) {
+            append_error("nice", errno);
+        }
+    }
+
+    // 读回实际生效的设置
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(self, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                applied.cpus.push_back(cpu);
+            }
+        }
+    }
+    sched_param param;
+    int policy = SCHED_OTHER;
+    if (pthread_getschedparam(self, &policy, &param) == 0) {
+        applied.policy = policy;
+        applied.priority = param.sched_priority;
+    }
+    errno = 0;
+    int nice_value = getpriority(PRIO_PROCESS, static_cast<id_t>(tid));
+    if (errno == 0) {
+        applied.nice = nice_value;
+    }
+#else
+    if (!placement.empty()) {
+        applied.error = "thread placement is only supported on Linux";
+    }
+#endif
+    return applied;
+}
+
+} // namespace hv
+
+#endif // HV_THREAD_PLACEMENT_H
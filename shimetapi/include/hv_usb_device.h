@@ -19,11 +19,351 @@
 #include <libusb-1.0/libusb.h>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <utility>
+#include <chrono>
+
+#include "hv_device_selector.h"
+#include "hv_thread_placement.h"
 
 namespace hv {
 
+/**
+ * 异步传输完成回调函数类型，在USB事件处理线程中调用
+ * @param buffer 完成传输的缓冲区
+ * @param actual_length 实际传输的字节数
+ * @param success 传输是否成功完成
+ * @return 下一次提交使用的缓冲区（可以是同一个缓冲区），返回nullptr则该传输不再提交
+ */
+typedef std::function<unsigned char*(unsigned char* buffer, int actual_length, bool success)> AsyncTransferCallback;
+
+/**
+ * libusb上下文 - 多个USB设备共享同一个libusb上下文和异步传输事件线程
+ * 事件线程在有异步传输时启动，所有设备的所有端点的传输完成回调都在该线程中执行
+ */
+class USBContext {
+public:
+    /**
+     * 获取进程内默认共享的上下文，最后一个使用者释放后销毁
+     * @return 上下文，初始化libusb失败返回nullptr
+     */
+    static std::shared_ptr<USBContext> getDefault();
+
+    /**
+     * 创建独立的上下文（例如需要将不同相机组的回调放在不同线程中）
+     * @return 上下文，初始化libusb失败返回nullptr
+     */
+    static std::shared_ptr<USBContext> create();
+
+    ~USBContext();
+
+    /**
+     * 获取libusb上下文
+     */
+    libusb_context* get() const;
+
+    /**
+     * 在设备的端点上启动异步批量传输，参数同USBDevice::startAsyncTransfer
+     */
+    bool startAsyncTransfer(libusb_device_handle* handle, uint8_t endpoint, const std::vector<unsigned char*>& buffers,
+                            int length, AsyncTransferCallback callback, unsigned int timeout);
+
+    /**
+     * 停止设备指定端点的异步传输，等待取消完成后返回
+     */
+    void stopAsyncTransfer(libusb_device_handle* handle, uint8_t endpoint);
+
+    /**
+     * 停止设备所有端点的异步传输，等待取消完成后返回
+     */
+    void stopAsyncTransfers(libusb_device_handle* handle);
+
+    /**
+     * 检查设备指定端点的异步传输是否在运行
+     */
+    bool isAsyncTransferRunning(libusb_device_handle* handle, uint8_t endpoint) const;
+
+    /**
+     * 检查设备是否有任一端点的异步传输在运行
+     */
+    bool isAsyncTransferRunning(libusb_device_handle* handle) const;
+
+    /**
+     * 获取使设备指定端点的异步传输终止的传输状态
+     * @return libusb_transfer_status（设备断开、端点持续出错），传输正常或未启动时为0
+     */
+    int getAsyncTransferError(libusb_device_handle* handle, uint8_t endpoint) const;
+
+    /**
+     * 设置事件线程的放置配置（CPU亲和性、调度策略），事件线程运行中时立即由其自身应用
+     * @param placement 放置配置
+     */
+    void setEventThreadPlacement(const ThreadPlacement& placement);
+
+    /**
+     * 获取事件线程最近一次实际生效的放置情况
+     * @return 放置情况，事件线程从未启动时tid为0
+     */
+    AppliedThreadPlacement getEventThreadPlacement() const;
+
+private:
+    explicit USBContext(libusb_context* ctx);
+
+    libusb_context* ctx_;
+
+    // 异步传输相关：每个设备端点一个传输流
+    typedef std::pair<libusb_device_handle*, uint8_t> StreamKey;
+    struct AsyncStream {
+        std::vector<libusb_transfer*> transfers;
+        AsyncTransferCallback callback;
+        libusb_device_handle* handle = nullptr;
+        uint8_t endpoint = 0;
+        std::atomic<bool> running{true};
+        std::atomic<bool> aborted{false};  // 启动时部分传输提交失败，已提交的传输结束时不再回调使用者
+        std::atomic<int> active{0};    // 已提交或等待重新提交、尚未结束的传输数
+        std::atomic<int> error{0};     // 使传输流终止的传输状态，0表示无
+        // 以下仅由事件线程访问
+        bool cancelled = false;
+        std::vector<libusb_transfer*> parked;          // 出错后等待退避重新提交的传输
+        std::chrono::steady_clock::time_point retry_at;
+        int consecutive_errors = 0;                    // 连续出错的传输数，成功一次后清零
+        int retry_rounds = 0;                          // 连续的退避重新提交轮数，成功一次后清零
+        bool clear_halt_pending = false;               // 端点STALL，重新提交前先清除halt
+    };
+    static const int RETRY_BASE_MS = 10;        // 出错后重新提交的退避时间，每轮连续出错加倍
+    static const int RETRY_MAX_MS = 1000;
+    static const int MAX_CONSECUTIVE_ERRORS = 32;   // 超过后终止传输流
+    std::map<StreamKey, std::unique_ptr<AsyncStream>> async_streams_;  // 由async_mutex_保护
+    mutable std::mutex async_mutex_;
+    std::condition_variable async_cv_;   // 传输流结束时通知
+    std::thread async_event_thread_;
+    bool async_thread_running_;          // 由async_mutex_保护
+    ThreadPlacement event_thread_placement_;            // 由async_mutex_保护
+    AppliedThreadPlacement applied_event_placement_;    // 由async_mutex_保护
+    bool placement_pending_;                            // 由async_mutex_保护
+
+    static void LIBUSB_CALL asyncTransferCallback(libusb_transfer* transfer);
+    void asyncEventLoop();
+    void retryParkedTransfers(AsyncStream& stream);
+    void wakeAsyncEventLoop();
+    static void freeAsyncTransfers(AsyncStream& stream);
+
+    // 禁止拷贝构造和赋值
+    USBContext(const USBContext&) = delete;
+    USBContext& operator=(const USBContext&) = delete;
+};
+
+/**
+ * USB传输接口 - USBDevice的底层实现，负责设备打开、端点传输和传输缓冲区管理
+ * LibusbTransport对接真实设备，ReplayTransport从录制文件回放，上层采集流程不感知两者差别
+ * 各方法的语义同USBDevice中的同名方法
+ */
+class USBTransport {
+public:
+    virtual ~USBTransport() {}
+
+    virtual bool open() = 0;
+    virtual bool isOpen() const = 0;
+    virtual void close() = 0;
+    virtual DeviceInfo getDeviceInfo() const = 0;
+    virtual uint8_t getEndpointAddress(int index) const = 0;
+    virtual bool bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred,
+                              unsigned int timeout) = 0;
+    virtual bool startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                                    AsyncTransferCallback callback, unsigned int timeout) = 0;
+    virtual void stopAsyncTransfer(uint8_t endpoint) = 0;
+    virtual void stopAsyncTransfer() = 0;
+    virtual bool isAsyncTransferRunning(uint8_t endpoint) const = 0;
+    virtual bool isAsyncTransferRunning() const = 0;
+    virtual int getAsyncTransferError(uint8_t endpoint) const { return 0; }
+    virtual int clearHalt(uint8_t endpoint) = 0;
+    virtual bool clearSharedMemory() = 0;
+    virtual unsigned char* allocTransferBuffer(size_t length, bool* device_memory) = 0;
+    virtual void freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) = 0;
+
+    /**
+     * 获取libusb设备句柄，非libusb实现返回nullptr
+     */
+    virtual libusb_device_handle* getHandle() const { return nullptr; }
+
+    /**
+     * 获取libusb上下文，非libusb实现返回nullptr
+     */
+    virtual std::shared_ptr<USBContext> getContext() const { return nullptr; }
+};
+
+/**
+ * 基于libusb的传输实现 - 按VID/PID及选择条件打开真实设备
+ */
+class LibusbTransport : public USBTransport {
+public:
+    /**
+     * 构造函数
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     * @param selector 设备选择条件
+     * @param context libusb上下文，为空时使用进程内默认共享的上下文
+     */
+    LibusbTransport(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+                    std::shared_ptr<USBContext> context = nullptr);
+    ~LibusbTransport();
+
+    bool open() override;
+    bool isOpen() const override;
+    void close() override;
+    DeviceInfo getDeviceInfo() const override;
+    uint8_t getEndpointAddress(int index) const override;
+    bool bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred,
+                      unsigned int timeout) override;
+    bool startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                            AsyncTransferCallback callback, unsigned int timeout) override;
+    void stopAsyncTransfer(uint8_t endpoint) override;
+    void stopAsyncTransfer() override;
+    bool isAsyncTransferRunning(uint8_t endpoint) const override;
+    bool isAsyncTransferRunning() const override;
+    int getAsyncTransferError(uint8_t endpoint) const override;
+    int clearHalt(uint8_t endpoint) override;
+    bool clearSharedMemory() override;
+    unsigned char* allocTransferBuffer(size_t length, bool* device_memory) override;
+    void freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) override;
+    libusb_device_handle* getHandle() const override;
+    std::shared_ptr<USBContext> getContext() const override;
+
+private:
+    const uint16_t vendor_id_;
+    const uint16_t product_id_;
+    const DeviceSelector selector_;
+    std::shared_ptr<USBContext> context_;   // 未指定时在首次打开设备时获取默认上下文
+    libusb_context* ctx_;
+    libusb_device* device_;
+    libusb_device_handle* handle_;
+    bool attached_;
+    uint8_t endpoints_[8]; // 存储端点地址
+    DeviceInfo info_;
+
+    // 禁止拷贝构造和赋值
+    LibusbTransport(const LibusbTransport&) = delete;
+    LibusbTransport& operator=(const LibusbTransport&) = delete;
+};
+
+/**
+ * 回放选项
+ */
+struct ReplayOptions {
+    double speed = 1.0;         // 回放速率：1为按录制时的原始速率，N为N倍速，0（或负数）为尽可能快、不限速
+    bool loop = false;          // 到达文件末尾后从头循环回放
+    bool preload = false;       // 打开时把整个文件读入内存，不限速回放时不受磁盘读取速度限制
+};
+
+/**
+ * 文件回放传输 - 把HV_EVS_Recorder录制的原始事件数据当作设备回放，用于无硬件的测试和性能评估
+ * 事件端点（索引1）按传输长度（通常为512KB）依次返回文件中的数据块，
+ * 原始速率和N倍速按每块首个子帧头的40位时间戳定速（时间戳回绕或跳变超过1秒时重新对齐），
+ * 文件末尾之后不再有数据，与设备停止发送时相同（同步传输超时返回，异步传输保持排队直到停止）；
+ * 图像端点（索引0）始终没有数据
+ */
+class ReplayTransport : public USBTransport {
+public:
+    static const uint8_t IMAGE_ENDPOINT = 0x81;
+    static const uint8_t EVENT_ENDPOINT = 0x82;
+
+    /**
+     * 构造函数
+     * @param path 录制文件路径
+     * @param options 回放选项
+     */
+    explicit ReplayTransport(const std::string& path, const ReplayOptions& options = ReplayOptions());
+    ~ReplayTransport();
+
+    bool open() override;
+    bool isOpen() const override;
+    void close() override;
+    DeviceInfo getDeviceInfo() const override;
+    uint8_t getEndpointAddress(int index) const override;
+    bool bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred,
+                      unsigned int timeout) override;
+    bool startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                            AsyncTransferCallback callback, unsigned int timeout) override;
+    void stopAsyncTransfer(uint8_t endpoint) override;
+    void stopAsyncTransfer() override;
+    bool isAsyncTransferRunning(uint8_t endpoint) const override;
+    bool isAsyncTransferRunning() const override;
+    int clearHalt(uint8_t endpoint) override;
+    bool clearSharedMemory() override;
+    unsigned char* allocTransferBuffer(size_t length, bool* device_memory) override;
+    void freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) override;
+
+    /**
+     * 检查是否已回放到文件末尾（循环回放时不会结束）
+     */
+    bool isFinished() const;
+
+    /**
+     * 获取已回放的数据块数和字节数
+     */
+    uint64_t getBlocksDelivered() const;
+    uint64_t getBytesDelivered() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // 异步回放：每个端点一个回放线程，轮流使用排队的缓冲区
+    struct ReplayStream {
+        std::thread thread;
+        std::vector<unsigned char*> buffers;
+        int length = 0;
+        unsigned int timeout = 0;
+        AsyncTransferCallback callback;
+        std::atomic<bool> running{true};
+    };
+
+    const std::string path_;
+    const ReplayOptions options_;
+    int fd_;
+    uint64_t file_size_;
+    std::vector<unsigned char> preloaded_;  // options_.preload时为整个文件内容
+
+    // 读取位置与定速状态，由read_mutex_保护
+    std::mutex read_mutex_;
+    uint64_t offset_;
+    bool due_valid_;                // due_是否已按offset_处的数据块计算
+    Clock::time_point due_;         // offset_处数据块的回放时刻
+    Clock::time_point start_;       // 回放起点
+    bool have_ticks_;
+    uint64_t last_ticks_;           // 上一块的原始40位时间戳
+    uint64_t media_ticks_;          // 从回放起点累计的录制时间（时间戳计数）
+
+    std::atomic<bool> finished_;
+    std::atomic<uint64_t> blocks_delivered_;
+    std::atomic<uint64_t> bytes_delivered_;
+
+    std::map<uint8_t, std::unique_ptr<ReplayStream>> streams_;   // 由stream_mutex_保护
+    mutable std::mutex stream_mutex_;
+    std::condition_variable stream_cv_;     // 停止回放时唤醒等待中的回放线程
+
+    bool readAt(uint64_t offset, void* data, size_t length);
+    bool atEndLocked();
+    Clock::time_point nextDueLocked();
+    bool readBlockLocked(unsigned char* data, int length, int* transferred);
+    void resetPacingLocked();
+    void replayThreadFunc(uint8_t endpoint, ReplayStream* stream);
+    bool waitStream(ReplayStream* stream, Clock::time_point until);
+
+    // 禁止拷贝构造和赋值
+    ReplayTransport(const ReplayTransport&) = delete;
+    ReplayTransport& operator=(const ReplayTransport&) = delete;
+};
+
 /**
  * USB设备管理类 - 负责USB设备的打开、关闭和数据传输
+ * 具体操作委托给USBTransport，默认使用libusb访问真实设备，也可以传入ReplayTransport从文件回放
  */
 class USBDevice {
 public:
@@ -33,6 +373,31 @@ public:
      * @param product_id USB设备产品ID
      */
     USBDevice(uint16_t vendor_id, uint16_t product_id);
+
+    /**
+     * 构造函数，按端口路径或序列号选择设备
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     * @param selector 设备选择条件
+     * @param context libusb上下文，为空时使用进程内默认共享的上下文
+     */
+    USBDevice(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+              std::shared_ptr<USBContext> context = nullptr);
+
+    /**
+     * 构造函数，使用指定的传输实现（如ReplayTransport）
+     * @param transport 传输实现
+     */
+    explicit USBDevice(std::unique_ptr<USBTransport> transport);
+
+    /**
+     * 枚举所有匹配VID/PID的设备
+     * 读取序列号需要短暂打开设备，已被其他进程占用或无权限时序列号为空
+     * @param vendor_id USB设备厂商ID
+     * @param product_id USB设备产品ID
+     * @return 设备信息列表
+     */
+    static std::vector<DeviceInfo> listDevices(uint16_t vendor_id, uint16_t product_id);
     
     /**
      * 析构函数
@@ -55,6 +420,12 @@ public:
      * 关闭USB设备
      */
     void close();
+
+    /**
+     * 获取已打开设备的信息
+     * @return 设备信息，设备未打开时各字段为空
+     */
+    DeviceInfo getDeviceInfo() const;
     
     /**
      * 获取端点地址
@@ -74,27 +445,108 @@ public:
      */
     bool bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout);
 
+    /**
+     * 启动异步批量传输
+     * 在端点上保持buffers.size()个传输同时排队，由专用线程运行libusb事件循环，
+     * 每个传输完成后调用回调并立即用回调返回的缓冲区重新提交，避免同步传输重新提交间隙中总线空闲。
+     * 不同端点、以及共享同一上下文的不同设备可以同时运行各自的异步传输，共用同一个事件线程。
+     * 传输出错（STALL/ERROR/OVERFLOW）时仍以success=false回调，之后由事件线程退避（10ms起加倍，至多1s）
+     * 再重新提交，STALL先清除端点halt状态；连续出错超过32次或设备断开时传输流终止，
+     * isAsyncTransferRunning返回false，getAsyncTransferError给出原因
+     * @param endpoint 端点地址
+     * @param buffers 初始缓冲区，每个缓冲区对应一个排队的传输
+     * @param length 每个传输的长度
+     * @param callback 传输完成回调
+     * @param timeout 单个传输超时时间(毫秒)，0表示不超时
+     * @return 是否启动成功；任一传输提交失败时取消已提交的传输并返回false，此时全部缓冲区都已不再使用
+     */
+    bool startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                            AsyncTransferCallback callback, unsigned int timeout = 0);
+
+    /**
+     * 停止指定端点的异步传输
+     * 取消该端点所有排队的传输，等待取消完成后返回，不能在传输完成回调中调用
+     * @param endpoint 端点地址
+     */
+    void stopAsyncTransfer(uint8_t endpoint);
+
+    /**
+     * 停止本设备所有端点的异步传输，等待取消完成后返回
+     */
+    void stopAsyncTransfer();
+
+    /**
+     * 检查指定端点的异步传输是否在运行
+     * @param endpoint 端点地址
+     * @return 异步传输是否在运行
+     */
+    bool isAsyncTransferRunning(uint8_t endpoint) const;
+
+    /**
+     * 检查是否有任一端点的异步传输在运行
+     * @return 异步传输是否在运行
+     */
+    bool isAsyncTransferRunning() const;
+
+    /**
+     * 获取使指定端点的异步传输终止的原因
+     * @param endpoint 端点地址
+     * @return libusb_transfer_status（LIBUSB_TRANSFER_NO_DEVICE、持续出错时最后一次的状态），
+     *         传输正常、已停止或未启动时为0
+     */
+    int getAsyncTransferError(uint8_t endpoint) const;
+
+    /**
+     * 清除端点的停止（halt）状态
+     * @param endpoint 端点地址
+     * @return libusb错误码，成功为0
+     */
+    int clearHalt(uint8_t endpoint);
+
     /**
      * 清除设备冗余数据
      * @return 是否清除成功
      */
     bool clearSharedMemory() ;
 
+    /**
+     * 分配USB传输缓冲区
+     * 优先使用libusb_dev_mem_alloc分配可直接DMA的内核内存（usbfs零拷贝），
+     * 不支持时退回到页对齐的普通内存
+     * @param length 缓冲区大小
+     * @param device_memory 输出：是否为设备内存
+     * @return 缓冲区指针，失败返回nullptr
+     */
+    unsigned char* allocTransferBuffer(size_t length, bool* device_memory);
+
+    /**
+     * 释放allocTransferBuffer分配的缓冲区，须在close()之前调用
+     * @param buffer 缓冲区指针
+     * @param length 缓冲区大小
+     * @param device_memory 是否为设备内存
+     */
+    void freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory);
+
     /**
      * 获取USB设备句柄
-     * @return USB设备句柄
+     * @return USB设备句柄，回放等非libusb传输为nullptr
      */
     libusb_device_handle* getHandle() const;
 
+    /**
+     * 获取设备使用的libusb上下文
+     * @return 上下文，设备从未打开且未指定上下文时、以及非libusb传输为nullptr
+     */
+    std::shared_ptr<USBContext> getContext() const;
+
+    /**
+     * 获取底层传输实现
+     * @return 传输实现
+     */
+    USBTransport* getTransport() const;
+
 private:
-    // USB设备相关成员
-    const uint16_t vendor_id_;
-    const uint16_t product_id_;
-    libusb_context* ctx_;
-    libusb_device* device_;
-    libusb_device_handle* handle_;
-    bool attached_;
-    uint8_t endpoints_[8]; // 存储端点地址
+    std::unique_ptr<USBTransport> transport_;
     
     // 禁止拷贝构造和赋值
     USBDevice(const USBDevice&) = delete;
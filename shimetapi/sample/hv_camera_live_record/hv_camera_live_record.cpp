@@ -12,6 +12,7 @@
 #include <opencv2/opencv.hpp>
 #include "hv_camera.h"
 #include "hv_event_writer.h"
+#include "hv_aps_recorder.h"
 
 // 全局控制标志
 std::atomic<bool> g_running(true);
@@ -175,80 +176,37 @@ private:
     mutable std::mutex mutex_;
 };
 
+// APS录制：编码和写文件在HV_APS_Recorder的写入线程中进行，不阻塞相机的图像线程
 class VideoRecorder {
 public:
-    VideoRecorder() : total_frames_(0), fps_(30.0), is_recording_(false) {}
-    
-    ~VideoRecorder() {
-        stopRecording();
-    }
-    
     bool startRecording(const std::string& output_filename, double fps = 30.0) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (is_recording_) {
+        if (aps_recorder_.isRecording()) {
             return true; // 已在录制中
         }
-        
-        fps_ = fps;
-        output_filename_ = output_filename;
-        
-        int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
-        video_writer_.open(output_filename, fourcc, fps, cv::Size(HV_APS_WIDTH, HV_APS_HEIGHT));
-        
-        if (!video_writer_.isOpened()) {
-            std::cerr << "无法创建视频文件: " << output_filename << std::endl;
-            return false;
-        }
-        
-        is_recording_ = true;
-        total_frames_ = 0;
-        std::cout << "开始录制视频到文件: " << output_filename << std::endl;
-        return true;
+        return aps_recorder_.startRecording(output_filename, hv::ApsRecordFormat::MJPG, fps);
     }
     
     void stopRecording() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (!is_recording_) {
-            return;
-        }
-        
-        if (video_writer_.isOpened()) {
-            video_writer_.release();
-            std::cout << "总共录制了 " << total_frames_ << " 帧视频" << std::endl;
-            std::cout << "视频文件已保存: " << output_filename_ << std::endl;
-        }
-        is_recording_ = false;
+        aps_recorder_.stopRecording();
     }
     
     bool isRecording() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return is_recording_;
+        return aps_recorder_.isRecording();
     }
     
-    // 图像回调函数
-    void onImageReceived(const cv::Mat& image) {
-        // 录制控制：只有在g_recording为true且正在录制时才写入文件
-        if (g_recording && is_recording_) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (video_writer_.isOpened()) {
-                video_writer_.write(image);
-                total_frames_++;
-            }
+    // 图像帧回调函数：只复制一次NV12数据后立即返回
+    void onFrameReceived(const hv::ImageFrame& frame) {
+        if (g_recording) {
+            aps_recorder_.pushFrame(frame);
         }
     }
     
     uint64_t getTotalFrames() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return total_frames_;
+        return aps_recorder_.getStats().frames_written;
     }
     
 private:
-    cv::VideoWriter video_writer_;
-    std::string output_filename_;
-    std::atomic<uint64_t> total_frames_;
-    std::atomic<bool> is_recording_;
-    double fps_;
-    mutable std::mutex mutex_;
+    hv::HV_APS_Recorder aps_recorder_;
 };
 
 // EVS帧生成器（简化版）
@@ -321,7 +279,7 @@ public:
         }
     }
     
-    void addImage(const cv::Mat& image) {
+    void addImage(const hv::ImageFrame& frame) {
         if (g_display_enabled) {
             // APS也采用频率控制，确保推入的是时间上最新的图像
             auto now = std::chrono::steady_clock::now();
@@ -330,7 +288,7 @@ public:
                 
                 std::lock_guard<std::mutex> lock(aps_data_mutex_);
                 APSDisplayData aps_data;
-                aps_data.aps_frame = image.clone();
+                aps_data.aps_frame = frame.toBGR();   // 只转换要显示的帧
                 aps_data.timestamp = now;
                 aps_display_queue_.push(aps_data);
                 last_aps_push_ = now;
@@ -565,12 +523,12 @@ int main(int argc, char* argv[]) {
     };
     
     // 绑定图像回调函数
-    auto image_callback = [&](const cv::Mat& image) {
+    auto image_callback = [&](const hv::ImageFrame& frame) {
         try {
             // 录制处理
-            video_recorder.onImageReceived(image);
+            video_recorder.onFrameReceived(frame);
             // 显示处理
-            display_manager.addImage(image);
+            display_manager.addImage(frame);
         } catch (const std::exception& e) {
             std::cerr << "图像处理错误: " << e.what() << std::endl;
         }
@@ -588,7 +546,7 @@ int main(int argc, char* argv[]) {
     
     // 启动图像采集
     std::cout << "正在启动图像采集..." << std::endl;
-    if (!camera.startImageCapture(image_callback)) {
+    if (!camera.startImageFrameCapture(image_callback)) {
         std::cerr << "错误: 无法启动图像采集" << std::endl;
         camera.stopEventCapture();
         g_running = false;
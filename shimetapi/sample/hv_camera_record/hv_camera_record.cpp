@@ -7,6 +7,7 @@
 #include <opencv2/opencv.hpp>
 #include "hv_camera.h"
 #include "hv_event_writer.h"
+#include "hv_aps_recorder.h"
 
 // 全局标志位用于控制录制停止
 std::atomic<bool> g_recording(false);
@@ -78,60 +79,36 @@ private:
     std::chrono::steady_clock::time_point last_flush_time_;
 };
 
+// APS录制：编码和写文件在HV_APS_Recorder的写入线程中进行，不阻塞相机的图像线程
 class VideoRecorder {
 public:
-    VideoRecorder() : total_frames_(0), fps_(30.0) {}
-    
-    ~VideoRecorder() {
-        stopRecording();
-    }
-    
-    bool startRecording(const std::string& output_filename, double fps = 30.0) {
-        fps_ = fps;
-        output_filename_ = output_filename;
-        
-        // 初始化VideoWriter，使用MJPG编码器
-        int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
-        video_writer_.open(output_filename, fourcc, fps, cv::Size(HV_APS_WIDTH, HV_APS_HEIGHT));
-        
-        if (!video_writer_.isOpened()) {
-            std::cerr << "无法创建视频文件: " << output_filename << std::endl;
-            return false;
-        }
-        
-        std::cout << "开始录制视频到文件: " << output_filename << std::endl;
-        return true;
+    bool startRecording(const std::string& output_filename, double fps = 30.0, bool raw_nv12 = false) {
+        return aps_recorder_.startRecording(output_filename,
+            raw_nv12 ? hv::ApsRecordFormat::RawNV12 : hv::ApsRecordFormat::MJPG, fps);
     }
     
     void stopRecording() {
-        if (video_writer_.isOpened()) {
-            video_writer_.release();
-            std::cout << "总共录制了 " << total_frames_ << " 帧视频" << std::endl;
-            std::cout << "视频文件已保存: " << output_filename_ << std::endl;
-        }
+        aps_recorder_.stopRecording();
     }
     
-    // 图像回调函数
-    void onImageReceived(const cv::Mat& image) {
-        if (!g_recording || !video_writer_.isOpened()) {
+    // 图像帧回调函数：只复制一次NV12数据后立即返回
+    void onFrameReceived(const hv::ImageFrame& frame) {
+        if (!g_recording) {
             return;
         }
-        
-        // 写入视频帧
-        video_writer_.write(image);
-        total_frames_++;
-        
+        aps_recorder_.pushFrame(frame);
     }
     
     uint64_t getTotalFrames() const {
-        return total_frames_;
+        return aps_recorder_.getStats().frames_written;
+    }
+    
+    uint64_t getDroppedFrames() const {
+        return aps_recorder_.getStats().frames_dropped;
     }
     
 private:
-    cv::VideoWriter video_writer_;
-    std::string output_filename_;
-    std::atomic<uint64_t> total_frames_;
-    double fps_;
+    hv::HV_APS_Recorder aps_recorder_;
 };
 
 int main(int argc, char* argv[]) {
@@ -155,6 +132,9 @@ int main(int argc, char* argv[]) {
     if (argc >= 5) {
         fps = std::atof(argv[4]);
     }
+    // 输出文件以.nv12结尾时不编码，原样保存NV12帧
+    const bool raw_nv12 = video_output_file.size() >= 5 &&
+        video_output_file.compare(video_output_file.size() - 5, 5, ".nv12") == 0;
     
     std::cout << "事件输出文件: " << event_output_file << std::endl;
     std::cout << "视频输出文件: " << video_output_file << std::endl;
@@ -192,7 +172,7 @@ int main(int argc, char* argv[]) {
         return -1;
     }
     
-    if (!video_recorder.startRecording(video_output_file, fps)) {
+    if (!video_recorder.startRecording(video_output_file, fps, raw_nv12)) {
         event_recorder.stopRecording();
         camera.close();
         return -1;
@@ -214,9 +194,9 @@ int main(int argc, char* argv[]) {
     };
     
     // 绑定图像回调函数
-    auto image_callback = [&video_recorder](const cv::Mat& image) {
+    auto image_callback = [&video_recorder](const hv::ImageFrame& frame) {
         try {
-            video_recorder.onImageReceived(image);
+            video_recorder.onFrameReceived(frame);
         } catch (const std::exception& e) {
             std::cerr << "图像处理错误: " << e.what() << std::endl;
         }
@@ -234,7 +214,7 @@ int main(int argc, char* argv[]) {
     
     // 启动图像采集
     std::cout << "正在启动图像采集..." << std::endl;
-    if (!camera.startImageCapture(image_callback)) {
+    if (!camera.startImageFrameCapture(image_callback)) {
         std::cerr << "错误: 无法启动图像采集" << std::endl;
         camera.stopEventCapture();
         event_recorder.stopRecording();
@@ -284,6 +264,7 @@ int main(int argc, char* argv[]) {
     std::cout << "视频文件: " << video_output_file << std::endl;
     std::cout << "总事件数: " << event_recorder.getTotalEvents() << std::endl;
     std::cout << "总视频帧数: " << video_recorder.getTotalFrames() << std::endl;
+    std::cout << "丢弃视频帧数: " << video_recorder.getDroppedFrames() << std::endl;
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+/*
+ * 子帧解码路径自检
+ *
+ * 生成合成子帧组（空组、稀疏、中等密度、满幅随机、逐字单像素、边界像素，填充区写入垃圾数据），
+ * 分别用各条解码路径解码，与逐像素扫描的标量路径逐事件比较：
+ *   - Sparse：全零行跳过 + ctz（x86为SSE2，aarch64为NEON，其他平台为逐字或运算）
+ *   - AVX2：仅在CPU支持AVX2/BMI时运行
+ *   - EventPacket：紧凑事件包展开后比较
+ *   - Bitplane：位平面与标量路径事件生成的位平面比较，并检查EventBitplaneFrame::toEvents
+ * 另外逐位检查行全零判断函数。任一比较失败时返回非零值，可用于在新平台或改动解码器后验证。
+ *
+ * 用法: ./hv_decoder_selfcheck [随机轮数] [随机种子]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hv_subframe_decoder.h"
+
+namespace {
+
+struct CheckEvent {
+    unsigned short x;
+    unsigned short y;
+    short p;
+    int64_t t;
+
+    CheckEvent(unsigned short x_, unsigned short y_, short p_, int64_t t_) : x(x_), y(y_), p(p_), t(t_) {}
+
+    bool operator==(const CheckEvent& other) const {
+        return x == other.x && y == other.y && p == other.p && t == other.t;
+    }
+    bool operator<(const CheckEvent& other) const {
+        if (y != other.y) return y < other.y;
+        if (x != other.x) return x < other.x;
+        return p > other.p;
+    }
+};
+
+using Group = std::vector<uint64_t>;
+using EventList = std::vector<CheckEvent>;
+
+// 一组4个子帧，子帧头之后的像素区按pixel_word生成，像素区之后的填充写入垃圾数据（解码器必须忽略）
+template <typename PixelWord>
+Group makeGroup(uint64_t raw_timestamp, std::mt19937_64& rng, PixelWord pixel_word) {
+    Group group(HV_SUBFRAME_GROUP_BYTE_SIZE / sizeof(uint64_t), 0);
+    for (int sub = 0; sub < HV_SUBFRAME_GROUP_SIZE; ++sub) {
+        uint64_t* words = group.data() + sub * HV_SUBFRAME_WORDS;
+        const uint64_t ts = (raw_timestamp + static_cast<uint64_t>(sub) * HV_SUBFRAME_TICKS_PER_US * 250) &
+                            HV_SUBFRAME_TIMESTAMP_MASK;
+        words[0] = HV_SUBFRAME_HEADER_MAGIC | (ts << 24);
+        words[1] = (static_cast<uint64_t>(sub) << 44) | (rng() & ~(0xFULL << 44));
+        uint64_t* pixels = words + HV_SUBFRAME_HEADER_WORDS;
+        for (int r = 0; r < HV_SUBFRAME_ROWS; ++r) {
+            for (int j = 0; j < HV_SUBFRAME_WORDS_PER_ROW; ++j) {
+                pixels[r * HV_SUBFRAME_WORDS_PER_ROW + j] = pixel_word(sub, r, j);
+            }
+        }
+        for (int w = HV_SUBFRAME_HEADER_WORDS + HV_SUBFRAME_ROWS * HV_SUBFRAME_WORDS_PER_ROW; w < HV_SUBFRAME_WORDS; ++w) {
+            words[w] = rng();
+        }
+    }
+    return group;
+}
+
+// 每个2bit像素以density的概率为事件（OFF=1，ON=2或3）
+uint64_t randomPixelWord(std::mt19937_64& rng, double density) {
+    if (density <= 0.0) {
+        return 0;
+    }
+    if (density >= 1.0) {
+        uint64_t w = rng();
+        // 保证每个像素非零：低位为0的像素强制设为ON
+        return w | ((~w & HV_SUBFRAME_PIXEL_LOW_BITS) << 1);
+    }
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t w = 0;
+    for (int k = 0; k < 64; k += 2) {
+        if (uniform(rng) < density) {
+            w |= static_cast<uint64_t>(1 + rng() % 3) << k;
+        }
+    }
+    return w;
+}
+
+EventList decodeEvents(const Group& group, hv::SubframeDecodePath path) {
+    EventList events;
+    hv::EventVectorPolicy<CheckEvent> policy(events);
+    hv::decodeSubframeGroup(reinterpret_cast<const uint8_t*>(group.data()), policy, path);
+    return events;
+}
+
+EventList decodePacketEvents(const Group& group) {
+    hv::EventPacket packet;
+    hv::EventPacketPolicy policy(packet);
+    hv::decodeSubframeGroup(reinterpret_cast<const uint8_t*>(group.data()), policy, hv::bestSubframeDecodePath());
+    EventList events;
+    packet.toEvents(events);
+    return events;
+}
+
+struct PathResult {
+    std::string name;
+    uint64_t groups = 0;
+    uint64_t events = 0;
+    uint64_t failures = 0;
+};
+
+bool reportMismatch(PathResult& result, const std::string& case_name, const EventList& expected, const EventList& actual) {
+    if (expected == actual) {
+        return true;
+    }
+    if (result.failures++ == 0) {
+        std::cerr << "[FAIL] " << result.name << " / " << case_name << ": 期望 " << expected.size()
+                  << " 个事件，实际 " << actual.size() << " 个" << std::endl;
+        const size_t n = std::min(expected.size(), actual.size());
+        for (size_t i = 0; i < n; ++i) {
+            if (!(expected[i] == actual[i])) {
+                std::cerr << "       第 " << i << " 个事件不同: 期望 (" << expected[i].x << ", " << expected[i].y
+                          << ", " << expected[i].p << ", " << expected[i].t << ")，实际 (" << actual[i].x << ", "
+                          << actual[i].y << ", " << actual[i].p << ", " << actual[i].t << ")" << std::endl;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+void checkGroup(const std::string& case_name, const Group& group, std::vector<PathResult>& results, bool have_avx2) {
+    const EventList reference = decodeEvents(group, hv::SubframeDecodePath::Scalar);
+
+    auto check = [&](PathResult& result, const EventList& actual) {
+        result.groups++;
+        result.events += actual.size();
+        reportMismatch(result, case_name, reference, actual);
+    };
+
+    check(results[0], decodeEvents(group, hv::SubframeDecodePath::Sparse));
+    if (have_avx2) {
+        check(results[1], decodeEvents(group, hv::SubframeDecodePath::AVX2));
+    }
+    check(results[2], decodePacketEvents(group));
+
+    // 位平面：与标量路径事件按像素置位的结果比较，再展开为事件（按行优先排列）与排序后的参考比较
+    hv::EventBitplaneFrame frame;
+    hv::decodeSubframeGroupBitplane(reinterpret_cast<const uint8_t*>(group.data()), frame);
+    std::vector<uint64_t> on(HV_BITPLANE_WORDS, 0), off(HV_BITPLANE_WORDS, 0);
+    for (const CheckEvent& e : reference) {
+        const size_t index = static_cast<size_t>(e.y) * HV_BITPLANE_WORDS_PER_ROW + (e.x >> 6);
+        (e.p ? on : off)[index] |= 1ULL << (e.x & 63);
+    }
+    PathResult& bitplane = results[3];
+    if (on != frame.on || off != frame.off) {
+        if (bitplane.failures++ == 0) {
+            std::cerr << "[FAIL] " << bitplane.name << " / " << case_name << ": 位平面与标量路径不一致" << std::endl;
+        }
+    }
+    EventList expanded;
+    frame.toEvents(expanded);
+    EventList sorted = reference;
+    std::sort(sorted.begin(), sorted.end());
+    bitplane.groups++;
+    bitplane.events += expanded.size();
+    reportMismatch(bitplane, case_name + " toEvents", sorted, expanded);
+}
+
+// 行全零判断：每个字的每一位单独置位时都必须判为非零
+bool checkRowIsZero(bool have_avx2) {
+    uint64_t row[HV_SUBFRAME_WORDS_PER_ROW] = {0};
+    bool ok = hv_subframe_row_is_zero(row) != 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (have_avx2) {
+        ok = ok && hv_subframe_row_is_zero_avx2(row) != 0;
+    }
+#endif
+    for (int j = 0; j < HV_SUBFRAME_WORDS_PER_ROW && ok; ++j) {
+        for (int bit = 0; bit < 64; ++bit) {
+            row[j] = 1ULL << bit;
+            if (hv_subframe_row_is_zero(row)) {
+                ok = false;
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            if (have_avx2 && hv_subframe_row_is_zero_avx2(row)) {
+                ok = false;
+            }
+#endif
+            row[j] = 0;
+        }
+    }
+    (void)have_avx2;
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << "行全零判断（逐位）" << std::endl;
+    return ok;
+}
+
+const char* sparsePathName() {
+#if defined(__aarch64__)
+    return "Sparse (NEON)";
+#elif defined(__SSE2__)
+    return "Sparse (SSE2)";
+#else
+    return "Sparse (generic)";
+#endif
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 50;
+    const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20250101ULL;
+    std::mt19937_64 rng(seed);
+
+#if defined(__x86_64__) || defined(__i386__)
+    const bool have_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi");
+#else
+    const bool have_avx2 = false;
+#endif
+
+    std::cout << "子帧解码路径自检：随机轮数 " << rounds << "，种子 " << seed << "，参考路径 Scalar" << std::endl;
+    if (!have_avx2) {
+        std::cout << "CPU不支持AVX2/BMI（或非x86平台），跳过AVX2路径" << std::endl;
+    }
+
+    std::vector<PathResult> results(4);
+    results[0].name = sparsePathName();
+    results[1].name = "AVX2";
+    results[2].name = "EventPacket";
+    results[3].name = "Bitplane";
+
+    bool ok = checkRowIsZero(have_avx2);
+
+    uint64_t ts = 1000 * HV_SUBFRAME_TICKS_PER_US;
+    auto next_ts = [&ts]() { ts += 1000 * HV_SUBFRAME_TICKS_PER_US; return ts; };
+
+    // 固定用例
+    checkGroup("empty", makeGroup(next_ts(), rng, [](int, int, int) -> uint64_t { return 0; }), results, have_avx2);
+    checkGroup("full", makeGroup(next_ts(), rng, [&rng](int, int, int) { return randomPixelWord(rng, 1.0); }),
+               results, have_avx2);
+    for (int j = 0; j < HV_SUBFRAME_WORDS_PER_ROW; ++j) {
+        // 每行只有第j个字非零，覆盖SIMD行判断的每个通道；像素取字内首、中、末位置
+        checkGroup("word" + std::to_string(j), makeGroup(next_ts(), rng, [j](int sub, int r, int w) -> uint64_t {
+            if (w != j) return 0;
+            const int k = ((r + sub) % 3) * 31 / 2 * 2;
+            return static_cast<uint64_t>(1 + (r % 3)) << k;
+        }), results, have_avx2);
+    }
+    checkGroup("edges", makeGroup(next_ts(), rng, [](int, int r, int w) -> uint64_t {
+        // 首行首像素与末行末像素（全幅(767, 607)）
+        if (r == 0 && w == 0) return 2;
+        if (r == HV_SUBFRAME_ROWS - 1 && w == HV_SUBFRAME_WORDS_PER_ROW - 1) return 1ULL << 62;
+        return 0;
+    }), results, have_avx2);
+    checkGroup("timestamp-wrap", makeGroup(HV_SUBFRAME_TIMESTAMP_MASK - 100, rng, [&rng](int, int, int) {
+        return randomPixelWord(rng, 0.01);
+    }), results, have_avx2);
+
+    // 随机用例：密度从极稀疏到较密，部分行全零
+    const double densities[] = {0.0001, 0.001, 0.01, 0.1, 0.5};
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int round = 0; round < rounds; ++round) {
+        const double density = densities[round % (sizeof(densities) / sizeof(densities[0]))];
+        const double empty_rows = uniform(rng);
+        std::vector<char> row_empty(HV_SUBFRAME_GROUP_SIZE * HV_SUBFRAME_ROWS);
+        for (char& e : row_empty) {
+            e = uniform(rng) < empty_rows;
+        }
+        checkGroup("random#" + std::to_string(round), makeGroup(next_ts(), rng, [&](int sub, int r, int) -> uint64_t {
+            return row_empty[sub * HV_SUBFRAME_ROWS + r] ? 0 : randomPixelWord(rng, density);
+        }), results, have_avx2);
+    }
+
+    for (const PathResult& result : results) {
+        if (result.groups == 0) {
+            std::cout << "[SKIP] " << result.name << std::endl;
+            continue;
+        }
+        std::cout << (result.failures == 0 ? "[ OK ] " : "[FAIL] ") << result.name << ": " << result.groups
+                  << " 组，" << result.events << " 个事件，" << result.failures << " 处不一致" << std::endl;
+        ok = ok && result.failures == 0;
+    }
+
+    std::cout << (ok ? "全部通过" : "存在不一致") << std::endl;
+    return ok ? 0 : 1;
+}
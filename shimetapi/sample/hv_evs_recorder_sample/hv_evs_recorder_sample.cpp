@@ -29,6 +29,9 @@ int main(int argc, char* argv[]) {
     std::string output_filename = "evs_data.raw";
     int recording_duration = 10; // 0表示无限录制
     bool enable_timestamp_analysis = false;
+    std::string metrics_filename;   // 为空时不写出运行指标
+    hv::RecordWriterOptions write_options;
+    hv::RecordSegmentOptions segment_options;
     
     if (argc > 1) {
         output_filename = argv[1];
@@ -39,9 +42,31 @@ int main(int argc, char* argv[]) {
     if (argc > 3) {
         enable_timestamp_analysis = (std::string(argv[3]) == "1" || std::string(argv[3]) == "true");
     }
+    if (argc > 4) {
+        metrics_filename = argv[4];
+    }
+    if (argc > 5) {
+        const std::string backend = argv[5];
+        if (backend == "io_uring") {
+            write_options.backend = hv::RecordWriteBackend::IoUring;
+        } else if (backend == "direct") {
+            write_options.backend = hv::RecordWriteBackend::Direct;
+        } else if (backend == "buffered") {
+            write_options.backend = hv::RecordWriteBackend::Buffered;
+        }
+    }
+    if (argc > 6) {
+        write_options.queue_depth = static_cast<size_t>(std::atoi(argv[6]));
+    }
+    if (argc > 7) {
+        segment_options.max_bytes = static_cast<uint64_t>(std::atoll(argv[7])) * 1024 * 1024;
+    }
+    if (argc > 8) {
+        segment_options.max_seconds = static_cast<unsigned>(std::atoi(argv[8]));
+    }
     
     std::cout << "EVS数据录制器示例程序" << std::endl;
-    std::cout << "使用方法: " << argv[0] << " [输出文件] [录制时长(秒)] [启用时间戳分析(1/0)]" << std::endl;
+    std::cout << "使用方法: " << argv[0] << " [输出文件] [录制时长(秒)] [启用时间戳分析(1/0)] [指标文件(.prom)] [写入后端(auto/io_uring/direct/buffered)] [在途写请求数] [分段大小(MB)] [分段时长(秒)]" << std::endl;
     std::cout << "输出文件: " << output_filename << std::endl;
     if (recording_duration > 0) {
         std::cout << "录制时长: " << recording_duration << " 秒" << std::endl;
@@ -72,7 +97,15 @@ int main(int argc, char* argv[]) {
     
     std::cout << "设备打开成功" << std::endl;
     
+    // 每秒写出一次Prometheus格式的运行指标
+    if (!metrics_filename.empty()) {
+        recorder.startMetricsExport(metrics_filename, 1000);
+        std::cout << "运行指标文件: " << metrics_filename << std::endl;
+    }
+    
     // 开始录制
+    recorder.setWriteOptions(write_options);
+    recorder.setSegmentOptions(segment_options);
     if (!recorder.startRecording(output_filename, enable_timestamp_analysis)) {
         std::cerr << "错误: 无法开始录制" << std::endl;
         recorder.close();
@@ -127,7 +160,9 @@ int main(int argc, char* argv[]) {
     
     // 停止录制
     std::cout << "正在停止录制..." << std::endl;
-    recorder.stopRecording();
+    if (!recorder.stopRecording()) {
+        std::cerr << "录制数据未能全部写入: " << recorder.getWriteError() << std::endl;
+    }
     
     // 输出最终统计信息
     uint64_t total_bytes, total_frames, avg_transfer_time;
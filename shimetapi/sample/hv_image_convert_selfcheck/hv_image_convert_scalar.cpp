@@ -0,0 +1,14 @@
+/*
+ * 逐像素路径：与hv_image_convert_selfcheck.cpp中的SIMD路径对比
+ * 头文件中的函数都是static inline，两个翻译单元各自展开一份，互不影响
+ */
+
+#define HV_IMAGE_CONVERT_SCALAR
+#include "hv_image_convert.h"
+
+void nv12ToBgrScaledScalar(const uint8_t* y_plane, size_t y_stride, const uint8_t* uv_plane, size_t uv_stride,
+                           int roi_x, int roi_y, int roi_width, int roi_height, int factor,
+                           uint8_t* bgr, size_t bgr_stride, uint8_t* scratch) {
+    hv_nv12_to_bgr_scaled(y_plane, y_stride, uv_plane, uv_stride, roi_x, roi_y, roi_width, roi_height, factor,
+                          bgr, bgr_stride, scratch);
+}
@@ -0,0 +1,221 @@
+/*
+ * NV12降采样转BGR自检（hv_image_convert.h）
+ *
+ * 对合成的768x608 NV12图像，按1/2、1/4分辨率和多个区域（全幅、奇数输出宽度、不足一个SIMD块的窄区域、
+ * 非零偏移）检查：
+ *   - SIMD路径（x86为SSE2，aarch64为NEON）与逐像素路径逐字节一致
+ *   - 与cv::cvtColorTwoPlane(COLOR_YUV2BGR_NV12)全分辨率转换后按INTER_AREA缩小的结果相差不超过4个灰度级
+ * 任一检查失败时返回非零值。
+ *
+ * 用法: ./hv_image_convert_selfcheck [随机种子]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "hv_image_convert.h"
+
+// hv_image_convert_scalar.cpp
+void nv12ToBgrScaledScalar(const uint8_t* y_plane, size_t y_stride, const uint8_t* uv_plane, size_t uv_stride,
+                           int roi_x, int roi_y, int roi_width, int roi_height, int factor,
+                           uint8_t* bgr, size_t bgr_stride, uint8_t* scratch);
+
+namespace {
+
+const int kWidth = 768;
+const int kHeight = 608;
+const int kMaxDiff = 4;     // hv_image_convert.h声明的误差上限
+
+struct Nv12Image {
+    std::string name;
+    cv::Mat y;      // kHeight x kWidth, CV_8UC1
+    cv::Mat uv;     // kHeight/2 x kWidth/2, CV_8UC2
+};
+
+// 随机全范围数据：只用于SIMD与逐像素路径对比（包含大量饱和）
+Nv12Image makeRandomImage(std::mt19937& rng) {
+    Nv12Image image{"random", cv::Mat(kHeight, kWidth, CV_8UC1), cv::Mat(kHeight / 2, kWidth / 2, CV_8UC2)};
+    for (int r = 0; r < image.y.rows; ++r) {
+        uint8_t* row = image.y.ptr<uint8_t>(r);
+        for (int c = 0; c < kWidth; ++c) {
+            row[c] = static_cast<uint8_t>(rng());
+        }
+    }
+    for (int r = 0; r < image.uv.rows; ++r) {
+        uint8_t* row = image.uv.ptr<uint8_t>(r);
+        for (int c = 0; c < kWidth; ++c) {
+            row[c] = static_cast<uint8_t>(rng());
+        }
+    }
+    return image;
+}
+
+// 4x4块内亮度、2x2色度块内色度相同：降采样没有取整误差，只比较颜色转换（全范围，含饱和）
+Nv12Image makeBlockImage(std::mt19937& rng) {
+    Nv12Image image{"block", cv::Mat(kHeight, kWidth, CV_8UC1), cv::Mat(kHeight / 2, kWidth / 2, CV_8UC2)};
+    for (int by = 0; by < kHeight / 4; ++by) {
+        for (int bx = 0; bx < kWidth / 4; ++bx) {
+            const uint8_t luma = static_cast<uint8_t>(rng());
+            const uint8_t u = static_cast<uint8_t>(rng());
+            const uint8_t v = static_cast<uint8_t>(rng());
+            for (int r = 0; r < 4; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    image.y.at<uint8_t>(by * 4 + r, bx * 4 + c) = luma;
+                }
+            }
+            for (int r = 0; r < 2; ++r) {
+                for (int c = 0; c < 2; ++c) {
+                    image.uv.at<cv::Vec2b>(by * 2 + r, bx * 2 + c) = cv::Vec2b(u, v);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+// 平滑渐变加轻微噪声，接近实际场景：降采样取整计入误差。
+// 亮度80-160、色度128±26，转换结果不饱和（块内部分像素饱和时先平均再转换与先转换再平均本就不同）
+Nv12Image makeSmoothImage(std::mt19937& rng) {
+    Nv12Image image{"smooth", cv::Mat(kHeight, kWidth, CV_8UC1), cv::Mat(kHeight / 2, kWidth / 2, CV_8UC2)};
+    std::uniform_int_distribution<int> noise(-6, 6);
+    for (int r = 0; r < kHeight; ++r) {
+        for (int c = 0; c < kWidth; ++c) {
+            const int luma = 80 + (70 * c) / kWidth + (10 * r) / kHeight + noise(rng);
+            image.y.at<uint8_t>(r, c) = static_cast<uint8_t>(luma);
+        }
+    }
+    for (int r = 0; r < kHeight / 2; ++r) {
+        for (int c = 0; c < kWidth / 2; ++c) {
+            const int u = 128 + (20 * (c - kWidth / 4)) / (kWidth / 4) + noise(rng);
+            const int v = 128 + (20 * (r - kHeight / 4)) / (kHeight / 4) + noise(rng);
+            image.uv.at<cv::Vec2b>(r, c) = cv::Vec2b(static_cast<uint8_t>(u), static_cast<uint8_t>(v));
+        }
+    }
+    return image;
+}
+
+cv::Mat convertSimd(const Nv12Image& image, const cv::Rect& roi, int factor) {
+    cv::Mat out(roi.height / factor, roi.width / factor, CV_8UC3);
+    std::vector<uint8_t> scratch(HV_IMAGE_SCALE_SCRATCH_BYTES(roi.width));
+    hv_nv12_to_bgr_scaled(image.y.data, image.y.step, image.uv.data, image.uv.step,
+                          roi.x, roi.y, roi.width, roi.height, factor, out.data, out.step, scratch.data());
+    return out;
+}
+
+cv::Mat convertScalar(const Nv12Image& image, const cv::Rect& roi, int factor) {
+    cv::Mat out(roi.height / factor, roi.width / factor, CV_8UC3);
+    std::vector<uint8_t> scratch(HV_IMAGE_SCALE_SCRATCH_BYTES(roi.width));
+    nv12ToBgrScaledScalar(image.y.data, image.y.step, image.uv.data, image.uv.step,
+                          roi.x, roi.y, roi.width, roi.height, factor, out.data, out.step, scratch.data());
+    return out;
+}
+
+// OpenCV参考：全分辨率转换后按面积平均缩小
+cv::Mat convertReference(const Nv12Image& image, const cv::Rect& roi, int factor) {
+    const cv::Rect uv_roi(roi.x / 2, roi.y / 2, roi.width / 2, roi.height / 2);
+    cv::Mat full;
+    cv::cvtColorTwoPlane(image.y(roi), image.uv(uv_roi), full, cv::COLOR_YUV2BGR_NV12);
+    cv::Mat scaled;
+    cv::resize(full, scaled, cv::Size(roi.width / factor, roi.height / factor), 0, 0, cv::INTER_AREA);
+    return scaled;
+}
+
+int maxAbsDiff(const cv::Mat& a, const cv::Mat& b) {
+    int max_diff = 0;
+    for (int r = 0; r < a.rows; ++r) {
+        const uint8_t* pa = a.ptr<uint8_t>(r);
+        const uint8_t* pb = b.ptr<uint8_t>(r);
+        for (int i = 0; i < a.cols * a.channels(); ++i) {
+            max_diff = std::max(max_diff, std::abs(static_cast<int>(pa[i]) - static_cast<int>(pb[i])));
+        }
+    }
+    return max_diff;
+}
+
+std::string describe(const std::string& image, int factor, const cv::Rect& roi) {
+    return image + " 1/" + std::to_string(factor) + " roi(" + std::to_string(roi.x) + "," + std::to_string(roi.y) +
+           " " + std::to_string(roi.width) + "x" + std::to_string(roi.height) + ")";
+}
+
+const char* simdPathName() {
+#if defined(HV_IMAGE_CONVERT_NEON)
+    return "NEON";
+#elif defined(HV_IMAGE_CONVERT_SSE2)
+    return "SSE2";
+#else
+    return "逐像素（本平台没有SIMD路径）";
+#endif
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const unsigned seed = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 20250101u;
+    std::mt19937 rng(seed);
+
+    std::cout << "NV12降采样转BGR自检：SIMD路径 " << simdPathName() << "，随机种子 " << seed << std::endl;
+
+    const std::vector<Nv12Image> images = {makeRandomImage(rng), makeBlockImage(rng), makeSmoothImage(rng)};
+
+    // 区域须为降采样倍数的整数倍（与ImageOutputConfig::normalize一致）；
+    // 输出宽度覆盖SIMD整块、整块加余数和不足一个SIMD块（8像素）的情况
+    struct RoiCase {
+        int factor;
+        cv::Rect roi;
+    };
+    const std::vector<RoiCase> cases = {
+        {2, cv::Rect(0, 0, kWidth, kHeight)},
+        {2, cv::Rect(2, 6, 34, 22)},        // 输出17像素宽：两个SIMD块加1像素
+        {2, cv::Rect(130, 2, 510, 302)},    // 输出255x151
+        {2, cv::Rect(762, 600, 6, 8)},      // 右下角，输出3像素宽，只走逐像素余数
+        {4, cv::Rect(0, 0, kWidth, kHeight)},
+        {4, cv::Rect(4, 8, 764, 596)},      // 输出191x149
+        {4, cv::Rect(124, 60, 68, 36)},     // 输出17像素宽
+        {4, cv::Rect(756, 596, 12, 12)},    // 右下角，输出3x3
+    };
+
+    bool paths_ok = true;
+    int simd_checked = 0;
+    int bound_checked = 0;
+    int worst_bound = 0;
+    for (const Nv12Image& image : images) {
+        for (const RoiCase& c : cases) {
+            const cv::Mat simd = convertSimd(image, c.roi, c.factor);
+            const cv::Mat scalar = convertScalar(image, c.roi, c.factor);
+            const int path_diff = maxAbsDiff(simd, scalar);
+            simd_checked++;
+            if (path_diff != 0) {
+                paths_ok = false;
+                std::cerr << "[FAIL] " << describe(image.name, c.factor, c.roi) << ": " << simdPathName()
+                          << "与逐像素路径最大相差 " << path_diff << std::endl;
+            }
+
+            // 随机全范围图像在块内饱和程度不同，先平均再转换与先转换再平均本就不同，不用于误差上限检查
+            if (image.name == "random") {
+                continue;
+            }
+            const int ref_diff = maxAbsDiff(simd, convertReference(image, c.roi, c.factor));
+            bound_checked++;
+            worst_bound = std::max(worst_bound, ref_diff);
+            if (ref_diff > kMaxDiff) {
+                std::cerr << "[FAIL] " << describe(image.name, c.factor, c.roi) << ": 与cv::cvtColor最大相差 "
+                          << ref_diff << "，超过 " << kMaxDiff << std::endl;
+            }
+        }
+    }
+
+    const bool ok = paths_ok && worst_bound <= kMaxDiff;
+    std::cout << "[" << (paths_ok ? " OK " : "FAIL") << "] " << simdPathName() << "与逐像素路径：" << simd_checked
+              << " 个用例" << std::endl;
+    std::cout << "[" << (worst_bound <= kMaxDiff ? " OK " : "FAIL") << "] 与cv::cvtColor + INTER_AREA：" << bound_checked
+              << " 个用例，最大相差 " << worst_bound << " 个灰度级（上限 " << kMaxDiff << "）" << std::endl;
+    std::cout << (ok ? "全部通过" : "存在不一致") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -14,6 +14,8 @@
 #include <metavision/sdk/base/events/event_cd.h>
 #include <metavision/sdk/base/events/event2d.h>
 
+#include "hv_subframe_decoder.h"
+
 // 定义常量（与hv_camera.h保持一致）
 #define HV_BUF_LEN (4096 * 128)
 #define HV_SUB_FULL_BYTE_SIZE (32768)
@@ -188,6 +190,24 @@ namespace evt2 {
     }
 }
 
+// 子帧解码输出策略：输出EventCD并记录每个子帧的时间戳元数据
+struct RawEventPolicy : hv::EventVectorPolicy<EventCD> {
+    std::vector<TimestampMetadata>* timestamp_metadata;
+    size_t block_index;
+    size_t sub_index = 0;
+
+    RawEventPolicy(std::vector<EventCD>& out, std::vector<TimestampMetadata>* metadata, size_t block)
+        : hv::EventVectorPolicy<EventCD>(out), timestamp_metadata(metadata), block_index(block) {}
+
+    bool beginSubframe(const hv::SubframeHeader& hdr) {
+        if (timestamp_metadata != nullptr) {
+            timestamp_metadata->emplace_back(hdr.timestamp, hdr.raw_timestamp, hdr.subframe_id, block_index, sub_index);
+        }
+        ++sub_index;
+        return hv::EventVectorPolicy<EventCD>::beginSubframe(hdr);
+    }
+};
+
 class RawDataProcessor {
 public:
     RawDataProcessor() {
@@ -217,134 +237,20 @@ public:
     // 处理单个子帧
     // 替换原有的 processSingleSubframe 和 processEventData 逻辑，采用 hv_camera.cpp 的实现方式
     std::vector<EventCD> processSingleSubframe(uint8_t* dataPtr, size_t block_index = 0, int subframe_idx = 0, std::vector<TimestampMetadata>* timestamp_metadata = nullptr) {
-        uint64_t* pixelBufferPtr = reinterpret_cast<uint64_t*>(dataPtr);
         std::vector<EventCD> eventArray;
         eventArray.reserve(HV_EVS_SUB_HEIGHT * HV_EVS_SUB_WIDTH);
-        uint64_t timestamp = 0;
-        uint64_t subframe = 0;
-        uint64_t buffer = pixelBufferPtr[0];
-        uint64_t raw_timestamp = (buffer >> 24) & 0xFFFFFFFFFF;
-        timestamp = raw_timestamp;
-        uint64_t header_vec = buffer & 0xFFFFFF;
-        if (header_vec != 0xFFFF) {
-            std::cerr << "bits process error" << std::endl;
-        }
-        buffer = pixelBufferPtr[1];
-        subframe = (buffer >> 44) & 0xF;
-        timestamp /= 200;
-        if (timestamp_metadata != nullptr) {
-            timestamp_metadata->emplace_back(timestamp, raw_timestamp, subframe, block_index, subframe_idx);
-        }
-        pixelBufferPtr += 2;
-        int x = 0, y = 0, x_offset = 0, y_offset = 0;
-        switch (subframe) {
-        case 0:
-            x_offset = 0;
-            y_offset = 0;
-            break;
-        case 1:
-            x_offset = 1;
-            y_offset = 0;
-            break;
-        case 2:
-            x_offset = 0;
-            y_offset = 1;
-            break;
-        case 3:
-            x_offset = 1;
-            y_offset = 1;
-            break;
-        }
-        y = y_offset;
-        for (int i = 0; i < HV_EVS_SUB_HEIGHT; i++) {
-            x = x_offset;
-            for (int j = 0; j < HV_EVS_SUB_WIDTH / 32; j++) {
-                buffer = pixelBufferPtr[j];
-                for (int k = 0; k < 64; k += 2) {
-                    uint64_t pix = (buffer >> k) & 0x3;
-                    if (x >= HV_EVS_WIDTH || y >= HV_EVS_HEIGHT) {
-                        x += 2;
-                        continue;
-                    }
-                    if (pix > 0) {
-                        pix >>= 1;
-                        EventCD event(static_cast<unsigned short>(x), static_cast<unsigned short>(y), static_cast<short>(pix), static_cast<Metavision::timestamp>(timestamp));
-                        eventArray.push_back(event);
-                    }
-                    x += 2;
-                }
-            }
-            pixelBufferPtr += HV_EVS_SUB_WIDTH / 32;
-            y += 2;
-        }
+        RawEventPolicy policy(eventArray, timestamp_metadata, block_index);
+        policy.sub_index = subframe_idx;
+        hv::decodeSubframe(reinterpret_cast<const uint64_t*>(dataPtr), policy);
         return eventArray;
     }
     
     // 处理单个数据块（等同于processEventData函数）
-    std::vector<EventCD> processEventData(uint8_t* dataPtr, size_t block_index = 0, std::vector<TimestampMetadata>* timestamp_metadata = nullptr) {
-        uint64_t* pixelBufferPtr = reinterpret_cast<uint64_t*>(dataPtr);
+    std::vector<EventCD> processEventData(const uint8_t* dataPtr, size_t block_index = 0, std::vector<TimestampMetadata>* timestamp_metadata = nullptr) {
         std::vector<EventCD> eventArray;
         eventArray.reserve(4 * HV_EVS_SUB_HEIGHT * HV_EVS_SUB_WIDTH);
-        for (int sub = 0; sub < 4; sub++) {
-            uint64_t timestamp = 0;
-            uint64_t subframe = 0;
-            uint64_t buffer = pixelBufferPtr[0];
-            uint64_t raw_timestamp = (buffer >> 24) & 0xFFFFFFFFFF;
-            timestamp = raw_timestamp;
-            uint64_t header_vec = buffer & 0xFFFFFF;
-            if (header_vec != 0xFFFF) {
-                std::cerr << "bits process error" << std::endl;
-            }
-            buffer = pixelBufferPtr[1];
-            subframe = (buffer >> 44) & 0xF;
-            timestamp /= 200;
-            if (timestamp_metadata != nullptr) {
-                timestamp_metadata->emplace_back(timestamp, raw_timestamp, subframe, block_index, sub);
-            }
-            pixelBufferPtr += 2;
-            int x = 0, y = 0, x_offset = 0, y_offset = 0;
-            switch (subframe) {
-            case 0:
-                x_offset = 0;
-                y_offset = 0;
-                break;
-            case 1:
-                x_offset = 1;
-                y_offset = 0;
-                break;
-            case 2:
-                x_offset = 0;
-                y_offset = 1;
-                break;
-            case 3:
-                x_offset = 1;
-                y_offset = 1;
-                break;
-            }
-            y = y_offset;
-            for (int i = 0; i < HV_EVS_SUB_HEIGHT; i++) {
-                x = x_offset;
-                for (int j = 0; j < HV_EVS_SUB_WIDTH / 32; j++) {
-                    buffer = pixelBufferPtr[j];
-                    for (int k = 0; k < 64; k += 2) {
-                        uint64_t pix = (buffer >> k) & 0x3;
-                        if (x >= HV_EVS_WIDTH || y >= HV_EVS_HEIGHT) {
-                            x += 2;
-                            continue;
-                        }
-                        if (pix > 0) {
-                            pix >>= 1;
-                            EventCD event(static_cast<unsigned short>(x), static_cast<unsigned short>(y), static_cast<short>(pix), static_cast<Metavision::timestamp>(timestamp));
-                            eventArray.push_back(event);
-                        }
-                        x += 2;
-                    }
-                }
-                pixelBufferPtr += HV_EVS_SUB_WIDTH / 32;
-                y += 2;
-            }
-            pixelBufferPtr += (HV_SUB_FULL_BYTE_SIZE - HV_SUB_VALID_BYTE_SIZE) / 8;
-        }
+        RawEventPolicy policy(eventArray, timestamp_metadata, block_index);
+        hv::decodeSubframeGroup(dataPtr, policy);
         return eventArray;
     }
     
@@ -434,43 +340,48 @@ public:
         
         size_t total_events = 0;
         size_t block_count = 0;
+        size_t group_count = 0;
         auto start_time = std::chrono::high_resolution_clock::now();
         
-        while (file.read(reinterpret_cast<char*>(buffer.data()), HV_BUF_LEN)) {
+        // 与hv_camera.cpp相同，由解析器校验子帧头和编号，数据错位时重新同步，跨数据块的子帧组拼接后解码
+        hv::SubframeStreamParser parser;
+        while (file.read(reinterpret_cast<char*>(buffer.data()), HV_BUF_LEN) || file.gcount() > 0) {
+            const size_t bytes = static_cast<size_t>(file.gcount());
             block_count++;
-            // 按照hv_camera.cpp的方式处理数据块：每个偏移量为HV_SUB_FULL_BYTE_SIZE * 4
-            for (size_t offset = 0; offset < HV_BUF_LEN; offset += HV_SUB_FULL_BYTE_SIZE * 4) {
-                auto events = processEventData(buffer.data() + offset, block_count, &all_timestamps);
+            if (bytes < HV_BUF_LEN) {
+                std::cout << "最后一个不完整的数据块大小: " << bytes << " 字节" << std::endl;
+            }
+            parser.parse(buffer.data(), bytes, [&](const uint8_t* group) {
+                auto events = processEventData(group, block_count, &all_timestamps);
                 total_events += events.size();
                 all_events.insert(all_events.end(), events.begin(), events.end());
-            }
+                group_count++;
+            });
             if (block_count % 100 == 0) {
                 auto current_time = std::chrono::high_resolution_clock::now();
                 auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
-                size_t total_subframes = block_count * 4;
+                size_t total_subframes = group_count * 4;
                 std::cout << "已处理 " << block_count << " 个数据块 (" << total_subframes << " 个子帧), 总事件数: " << total_events 
                          << ", 时间戳记录数: " << all_timestamps.size() << " (每个子帧一个时间戳)"
                          << ", 耗时: " << elapsed << "ms" << std::endl;
             }
         }
         
-        // 处理最后一个不完整的块（如果有）
-        size_t remaining = file.gcount();
-        if (remaining > 0) {
-            std::cout << "最后一个不完整的数据块大小: " << remaining << " 字节" << std::endl;
-        }
-        
         auto end_time = std::chrono::high_resolution_clock::now();
         auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
         
         std::cout << "\n处理完成!" << std::endl;
         std::cout << "总数据块数: " << block_count << std::endl;
-        std::cout << "总子帧数: " << (block_count * 4) << " (每块4个子帧)" << std::endl;
+        std::cout << "总子帧数: " << (group_count * 4) << " (" << group_count << " 个子帧组)" << std::endl;
+        const hv::SubframeStreamStats& stream_stats = parser.stats();
+        std::cout << "重新同步次数: " << stream_stats.resyncs << ", 跳过字节数: " << stream_stats.skipped_bytes
+                  << ", 丢失子帧数: " << stream_stats.lost_subframes << ", 丢弃子帧数: " << stream_stats.discarded_subframes
+                  << ", 时间戳不连续次数: " << stream_stats.timestamp_discontinuities << std::endl;
         std::cout << "总事件数: " << total_events << std::endl;
         std::cout << "总时间戳记录数: " << all_timestamps.size() << " (每个子帧一个时间戳)" << std::endl;
         std::cout << "总耗时: " << total_time << "ms" << std::endl;
         std::cout << "平均处理速度: " << (block_count * 1000.0 / total_time) << " 块/秒" << std::endl;
-        std::cout << "平均子帧处理速度: " << (block_count * 4 * 1000.0 / total_time) << " 子帧/秒" << std::endl;
+        std::cout << "平均子帧处理速度: " << (group_count * 4 * 1000.0 / total_time) << " 子帧/秒" << std::endl;
         
         // 写入EVT2文件（如果指定输出文件名）
         if (!output_filename.empty()) {
@@ -0,0 +1,287 @@
+#include "hv_aps_recorder.h"
+#include "hv_camera.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+namespace hv {
+
+HV_APS_Recorder::HV_APS_Recorder()
+    : recording_(false), format_(ApsRecordFormat::MJPG),
+      max_queued_frames_(0), size_mismatch_reported_(false),
+      frames_written_(0), frames_dropped_(0), bytes_written_(0) {
+    registerMetrics();
+}
+
+HV_APS_Recorder::~HV_APS_Recorder() {
+    stopRecording();
+}
+
+bool HV_APS_Recorder::startRecording(const std::string& filename, ApsRecordFormat format,
+                                     double fps, size_t queue_frames) {
+    if (recording_ || writer_thread_.joinable()) {
+        std::cerr << "APS recording already in progress" << std::endl;
+        return false;
+    }
+    if (queue_frames == 0) {
+        std::cerr << "APS recorder queue must hold at least one frame" << std::endl;
+        return false;
+    }
+
+    // 录制器缓冲池按队列深度预分配，提交时不再分配内存
+    std::shared_ptr<ImageBufferPool> pool = ImageBufferPool::create(HV_APS_WIDTH, HV_APS_HEIGHT, queue_frames);
+    if (!pool) {
+        std::cerr << "Failed to allocate APS recorder buffers" << std::endl;
+        return false;
+    }
+
+    format_ = format;
+    output_filename_ = filename;
+    if (format_ == ApsRecordFormat::MJPG) {
+        video_writer_.open(filename, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps,
+                           cv::Size(HV_APS_WIDTH, HV_APS_HEIGHT));
+        if (!video_writer_.isOpened()) {
+            std::cerr << "Failed to create video file: " << filename << std::endl;
+            return false;
+        }
+    } else {
+        raw_file_.open(filename, std::ios::binary | std::ios::trunc);
+        if (!raw_file_.is_open()) {
+            std::cerr << "Failed to create raw file: " << filename << std::endl;
+            return false;
+        }
+    }
+
+    // 索引文件：文件中的帧号 -> 相机帧序号和到达时刻，便于与事件流对齐
+    index_file_.open(filename + ".csv", std::ios::trunc);
+    if (index_file_.is_open()) {
+        index_file_ << "frame,sequence,arrival_ns\n";
+    } else {
+        std::cerr << "Failed to create index file: " << filename << ".csv" << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_.clear();
+        max_queued_frames_ = 0;
+    }
+    frames_written_ = 0;
+    frames_dropped_ = 0;
+    bytes_written_ = 0;
+    size_mismatch_reported_ = false;
+
+    std::atomic_store(&pool_, pool);
+    recording_ = true;
+    writer_thread_ = std::thread(&HV_APS_Recorder::writerThreadFunc, this);
+
+    std::cout << "APS recording started: " << filename
+              << (format_ == ApsRecordFormat::MJPG ? " (MJPG)" : " (raw NV12)") << std::endl;
+    return true;
+}
+
+void HV_APS_Recorder::stopRecording() {
+    {
+        // 在队列锁内清除标志，写入线程不会错过最后一次唤醒
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        recording_ = false;
+        queue_cv_.notify_all();
+    }
+    if (!writer_thread_.joinable()) {
+        return;
+    }
+    writer_thread_.join();
+
+    if (video_writer_.isOpened()) {
+        video_writer_.release();
+    }
+    if (raw_file_.is_open()) {
+        raw_file_.close();
+    }
+    if (index_file_.is_open()) {
+        index_file_.close();
+    }
+    bgr_.release();
+
+    std::cout << "APS recording stopped: " << frames_written_ << " frames written, "
+              << frames_dropped_ << " dropped, file: " << output_filename_ << std::endl;
+}
+
+bool HV_APS_Recorder::isRecording() const {
+    return recording_;
+}
+
+bool HV_APS_Recorder::pushFrame(const ImageFrame& frame) {
+    if (!recording_ || frame.empty()) {
+        return false;
+    }
+    std::shared_ptr<ImageBufferPool> pool = std::atomic_load(&pool_);
+    if (!pool) {
+        return false;
+    }
+    if (frame.width() != pool->width() || frame.height() != pool->height()) {
+        if (!size_mismatch_reported_.exchange(true)) {
+            std::cerr << "APS recorder expects " << pool->width() << "x" << pool->height()
+                      << " frames, got " << frame.width() << "x" << frame.height() << std::endl;
+        }
+        frames_dropped_++;
+        push_metrics_.add(metric_ids_.dropped_frames);
+        return false;
+    }
+
+    // 缓冲池空说明写入线程跟不上，丢弃新帧，不等待
+    uint8_t* buffer = pool->acquire();
+    if (!buffer) {
+        frames_dropped_++;
+        push_metrics_.add(metric_ids_.dropped_frames);
+        return false;
+    }
+    std::memcpy(buffer, frame.data(), pool->bytes());
+    ImageFrame copy(pool->share(buffer), frame.width(), frame.height(), frame.sequence(), frame.arrivalNs());
+
+    size_t depth;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!recording_) {
+            return false;
+        }
+        queue_.push_back(std::move(copy));
+        depth = queue_.size();
+        if (depth > max_queued_frames_) {
+            max_queued_frames_ = depth;
+        }
+    }
+    queue_cv_.notify_one();
+    metrics_.setGauge(metric_ids_.queued_frames, static_cast<int64_t>(depth));
+    return true;
+}
+
+std::function<void(const ImageFrame&)> HV_APS_Recorder::frameCallback() {
+    return [this](const ImageFrame& frame) {
+        pushFrame(frame);
+    };
+}
+
+ApsRecorderStats HV_APS_Recorder::getStats() const {
+    ApsRecorderStats stats;
+    stats.frames_written = frames_written_;
+    stats.frames_dropped = frames_dropped_;
+    stats.bytes_written = bytes_written_;
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stats.queued_frames = queue_.size();
+    stats.max_queued_frames = max_queued_frames_;
+    return stats;
+}
+
+void HV_APS_Recorder::writerThreadFunc() {
+    ThreadPlacement placement;
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        auto it = thread_placements_.find(ThreadRole::Writer);
+        if (it != thread_placements_.end()) {
+            placement = it->second;
+        }
+    }
+    AppliedThreadPlacement applied = applyThreadPlacement("hv-aps-writer", placement);
+    if (!applied.error.empty()) {
+        std::cerr << "Thread hv-aps-writer placement not fully applied: " << applied.error << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        applied_placements_["hv-aps-writer"] = applied;
+    }
+
+    while (true) {
+        ImageFrame frame;
+        size_t depth;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return !queue_.empty() || !recording_; });
+            // 停止后继续写完队列中的帧
+            if (queue_.empty()) {
+                break;
+            }
+            frame = std::move(queue_.front());
+            queue_.pop_front();
+            depth = queue_.size();
+        }
+        metrics_.setGauge(metric_ids_.queued_frames, static_cast<int64_t>(depth));
+        writeFrame(frame);
+    }
+}
+
+void HV_APS_Recorder::writeFrame(const ImageFrame& frame) {
+    const auto write_start = std::chrono::steady_clock::now();
+    const size_t bytes = static_cast<size_t>(frame.width()) * frame.height() * 3 / 2;
+    if (format_ == ApsRecordFormat::MJPG) {
+        frame.toBGR(bgr_);
+        video_writer_.write(bgr_);
+    } else {
+        raw_file_.write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(bytes));
+    }
+    if (index_file_.is_open()) {
+        index_file_ << frames_written_ << ',' << frame.sequence() << ',' << frame.arrivalNs() << '\n';
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - write_start;
+    writer_metrics_.observe(metric_ids_.write_time, elapsed);
+    if (std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() >
+        static_cast<int64_t>(WRITE_STALL_THRESHOLD_US)) {
+        writer_metrics_.add(metric_ids_.write_stalls);
+    }
+    frames_written_++;
+    bytes_written_ += bytes;
+    writer_metrics_.add(metric_ids_.written_frames);
+    writer_metrics_.add(metric_ids_.written_bytes, bytes);
+}
+
+bool HV_APS_Recorder::setThreadPlacement(ThreadRole role, const ThreadPlacement& placement) {
+    if (role != ThreadRole::Writer) {
+        std::cerr << "HV_APS_Recorder only has a Writer thread" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    thread_placements_[role] = placement;
+    return true;
+}
+
+std::vector<AppliedThreadPlacement> HV_APS_Recorder::getThreadPlacementReport() const {
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    std::vector<AppliedThreadPlacement> report;
+    for (const auto& entry : applied_placements_) {
+        report.push_back(entry.second);
+    }
+    return report;
+}
+
+MetricsSnapshot HV_APS_Recorder::getMetricsSnapshot() const {
+    return metrics_.snapshot();
+}
+
+void HV_APS_Recorder::startMetricsExport(const std::string& path, unsigned interval_ms) {
+    metrics_exporter_.start(&metrics_, path, interval_ms);
+}
+
+void HV_APS_Recorder::stopMetricsExport() {
+    metrics_exporter_.stop();
+}
+
+void HV_APS_Recorder::registerMetrics() {
+    MetricIds& ids = metric_ids_;
+    ids.written_frames = metrics_.registerCounter("hv_aps_recorder_written_frames_total",
+        "APS frames written to the output file");
+    ids.dropped_frames = metrics_.registerCounter("hv_aps_recorder_dropped_frames_total",
+        "APS frames dropped because the recorder queue was full");
+    ids.written_bytes = metrics_.registerCounter("hv_aps_recorder_written_bytes_total",
+        "NV12 bytes written or handed to the encoder");
+    ids.write_stalls = metrics_.registerCounter("hv_aps_recorder_write_stalls_total",
+        "Frame writes that took longer than one frame interval");
+    ids.queued_frames = metrics_.registerGauge("hv_aps_recorder_queue_frames",
+        "APS frames waiting in the recorder queue");
+    ids.write_time = metrics_.registerHistogram("hv_aps_recorder_write_seconds",
+        "Duration of encoding and writing one APS frame");
+
+    push_metrics_ = metrics_.acquireShard();
+    writer_metrics_ = metrics_.acquireShard();
+}
+
+} // namespace hv
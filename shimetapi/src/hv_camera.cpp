@@ -4,24 +4,72 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <algorithm>
 #include <metavision/sdk/base/events/event_cd.h>
 #include <metavision/sdk/base/events/event2d.h>
 
 namespace hv {
 
+// 类内初始化的静态常量成员的定义（std::min/std::max等按引用传参时会ODR使用）
+const size_t HV_Camera::IMAGE_TRANSFER_COUNT;
+const size_t HV_Camera::IMAGE_POOL_SIZE;
+const uint64_t HV_Camera::STREAM_CHECK_INTERVAL_NS;
+const size_t HV_Camera::MAX_TRANSFER_QUEUE_DEPTH;
+const size_t HV_Camera::DEFAULT_EVENT_SLAB_COUNT;
+const size_t HV_Camera::MIN_EVENT_SLAB_COUNT;
+const size_t HV_Camera::MAX_EVENT_SLAB_COUNT;
+const size_t HV_Camera::EVENT_GROUP_BYTES;
+const size_t HV_Camera::MAX_EVENT_TRANSFER_GROUPS;
+const size_t HV_Camera::ESTIMATED_EVENTS_PER_FRAME;
+const size_t HV_Camera::MAX_DECODE_TASKS_PER_THREAD;
+const size_t HV_Camera::MAX_POOLED_BATCHES;
+const int64_t HV_Camera::PAIR_NO_TICKS;
+const int HV_Camera::PAIR_WAIT_MS;
+
 HV_Camera::HV_Camera(uint16_t vendor_id, uint16_t product_id)
-    : usb_device_(std::make_unique<USBDevice>(vendor_id, product_id)),
+    : HV_Camera(vendor_id, product_id, DeviceSelector()) {
+}
+
+HV_Camera::HV_Camera(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+                     std::shared_ptr<USBContext> context)
+    : HV_Camera(std::unique_ptr<USBTransport>(new LibusbTransport(vendor_id, product_id, selector, context))) {
+}
+
+HV_Camera::HV_Camera(std::unique_ptr<USBTransport> transport)
+    : usb_device_(std::make_unique<USBDevice>(std::move(transport))),
       event_endpoint_(0), image_endpoint_(0),
       event_running_(false), image_running_(false),
-      event_processing_running_(false),
-      latest_image_(HV_APS_HEIGHT, HV_APS_WIDTH, CV_8UC3, cv::Scalar(0, 0, 0)) {
+      event_processing_running_(false) {
     // 性能优化：预分配事件数组容量
-    reusable_event_array_.reserve(ESTIMATED_EVENTS_PER_FRAME);
+    reusable_group_.events.reserve(ESTIMATED_EVENTS_PER_FRAME);
+    
+    // 根据CPU能力选择子帧解码路径
+    setSIMDDecodeEnabled(true);
+    
+    image_output_.normalize(HV_APS_WIDTH, HV_APS_HEIGHT);
+    
+    batch_pool_ = std::make_shared<EventBatchPool>();
+    
+    registerMetrics();
 }
 
 HV_Camera::~HV_Camera() {
     stopEventCapture();
     stopImageCapture();
+    
+    // 停止所有订阅者线程
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(subscribe_mutex_);
+        subscribers = std::atomic_load(&subscribers_);
+        std::atomic_store(&subscribers_, std::shared_ptr<const SubscriberList>());
+    }
+    if (subscribers) {
+        for (const auto& subscriber : *subscribers) {
+            stopSubscriber(subscriber);
+        }
+    }
+    
     close();
 }
 
@@ -38,17 +86,44 @@ bool HV_Camera::open() {
     return true;
 }
 
+std::vector<DeviceInfo> HV_Camera::listDevices(uint16_t vendor_id, uint16_t product_id) {
+    return USBDevice::listDevices(vendor_id, product_id);
+}
+
+DeviceInfo HV_Camera::getDeviceInfo() const {
+    return usb_device_->getDeviceInfo();
+}
+
 bool HV_Camera::isOpen() const {
     return usb_device_->isOpen();
 }
 
 void HV_Camera::close() {
+    // 先停止采集线程，设备内存必须在关闭设备句柄之前释放
+    stopEventCapture();
+    stopImageCapture();
+    freeEventSlabs();
+    freeImageBuffers();
     usb_device_->close();
 }
 
 bool HV_Camera::startEventCapture(EventCallback callback) {
+    return startEventStream(EventOutput::Events, callback, nullptr, nullptr);
+}
+
+bool HV_Camera::startEventPacketCapture(EventPacketCallback callback) {
+    return startEventStream(EventOutput::Packets, nullptr, callback, nullptr);
+}
+
+bool HV_Camera::startEventBitplaneCapture(EventBitplaneCallback callback) {
+    return startEventStream(EventOutput::Bitplanes, nullptr, nullptr, callback);
+}
+
+bool HV_Camera::startEventStream(EventOutput output, EventCallback callback,
+                                 EventPacketCallback packet_callback, EventBitplaneCallback bitplane_callback) {
     std::cout << "Starting event capture" << std::endl;
     std::cout <<"请确保USB为3.0以上版本，使用USB2.0可能导致丢帧。"<< std::endl;
+    const auto start_time = std::chrono::steady_clock::now();
     if (!isOpen()) {
         std::cerr << "Device not opened" << std::endl;
         return false;
@@ -59,20 +134,60 @@ bool HV_Camera::startEventCapture(EventCallback callback) {
         return false;
     }
 
+    // 预分配接收缓冲块（首次启动时分配，之后复用）
+    if (!allocateEventSlabs()) {
+        std::cerr << "Failed to allocate event buffers" << std::endl;
+        return false;
+    }
+    metrics_.setGauge(metric_ids_.transfer_bytes, static_cast<int64_t>(event_slab_bytes_));
+
+    event_output_ = output;
     event_callback_ = callback;
+    event_packet_callback_ = packet_callback;
+    event_bitplane_callback_ = bitplane_callback;
     event_running_ = true;
     event_processing_running_ = true;
+    event_start_time_ = start_time;
+    event_first_data_us_ = -1;
+    event_first_pending_ = true;
 
-    // 清空队列
+    // 清空队列和统计
+    resetEventSlabs();
+    std::cout << "Event queue cleared" << std::endl;
+    received_buffers_ = 0;
+    incomplete_buffers_ = 0;
+    dropped_newest_ = 0;
+    dropped_oldest_ = 0;
+    decimated_groups_ = 0;
+    invalid_subframes_ = 0;
+    lost_subframes_ = 0;
+    discarded_subframes_ = 0;
+    skipped_bytes_ = 0;
+    timestamp_discontinuities_ = 0;
+    event_async_ = false;
+    drop_oldest_reserve_ = 1;
+    event_stream_error_ = 0;
+    blocked_us_ = 0;
+    busy_poll_us_ = 0;
+    decimation_counter_ = 0;
+    receive_discontinuity_ = false;
+    stream_parser_.reset();
+    published_stream_stats_ = stream_parser_.stats();
+    clock_estimator_.reset();
     {
-        std::lock_guard<std::mutex> lock(event_queue_mutex_);
-        while (!event_data_queue_.empty()) {
-            event_data_queue_.pop();
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        clock_mapping_ = clock_estimator_.mapping();
+    }
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex_);
+        latency_baseline_.clear();
+        for (int id : {metric_ids_.queue_wait_time, metric_ids_.decode_group_time, metric_ids_.reorder_wait_time,
+                       metric_ids_.callback_time, metric_ids_.end_to_end_time}) {
+            latency_baseline_.push_back(metrics_.histogram(id));
         }
-        std::cout << "Event queue cleared" << std::endl;
     }
 
-    int result = libusb_clear_halt(usb_device_->getHandle(), event_endpoint_);
+    int result = usb_device_->clearHalt(event_endpoint_);
     if (result != 0) {
         std::cerr << "Failed to clear halt on endpoint: " << result << " (" << libusb_error_name(result) << ")" << std::endl;
     } else {
@@ -82,38 +197,114 @@ bool HV_Camera::startEventCapture(EventCallback callback) {
     std::cout << "Sending clear device shared memory request" << std::endl;
     usb_device_->clearSharedMemory();
 
-    // 启动USB数据接收线程
-    std::thread event_thread(&HV_Camera::eventThreadFunc, this);
-    event_thread.detach();
+    // 启动并行解码线程池（单线程解码时直接在处理线程中解码）
+    startDecodeWorkers();
     
     // 启动事件数据处理线程
-    std::thread processing_thread(&HV_Camera::eventProcessingThreadFunc, this);
-    processing_thread.detach();
+    processing_thread_ = std::thread(&HV_Camera::eventProcessingThreadFunc, this);
+
+    applyUsbThreadPlacement();
+    // Block策略需要在接收端等待空闲缓冲，不能在异步传输回调中等待：回调运行在共享的libusb事件线程上，
+    // 等待会暂停同一上下文上所有相机和图像端点的传输。此时改用本相机自己的同步接收线程
+    if (transfer_queue_depth_ > 0 && overflow_policy_ == QueueOverflowPolicy::Block) {
+        std::cout << "Block overflow policy uses the synchronous receive thread" << std::endl;
+    } else if (transfer_queue_depth_ > 0) {
+        // 异步传输：每个排队的传输占用一个缓冲块，至少保留一半缓冲块用于排队等待解码
+        const size_t depth = std::min(transfer_queue_depth_, event_slab_count_ / 2);
+        std::vector<unsigned char*> buffers;
+        uint32_t slab;
+        while (buffers.size() < depth && free_slabs_.pop(slab)) {
+            buffers.push_back(event_slabs_[slab].data);
+        }
+        last_event_transfer_ = std::chrono::steady_clock::now();
+        bool started = usb_device_->startAsyncTransfer(event_endpoint_, buffers, event_transfer_bytes_,
+            [this](unsigned char* buffer, int bytes, bool success) {
+                return onEventTransfer(buffer, bytes, success);
+            });
+        event_async_ = started;
+        if (started) {
+            drop_oldest_reserve_ = buffers.size() + 1;
+            std::cout << "Started async event transfer with " << buffers.size() << " queued transfers" << std::endl;
+            event_start_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_time).count();
+            return true;
+        }
+        
+        // 异步传输启动失败时退回同步传输
+        std::cerr << "Failed to start async event transfer, falling back to synchronous transfer" << std::endl;
+        for (unsigned char* buffer : buffers) {
+            free_slabs_.push(slab_lookup_[buffer]);
+        }
+    }
+
+    // 启动USB数据接收线程
+    event_thread_ = std::thread(&HV_Camera::eventThreadFunc, this);
+    event_start_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
 
     return true;
 }
 
 void HV_Camera::stopEventCapture() {
-    event_running_ = false;
-    event_processing_running_ = false;
+    const auto stop_start = std::chrono::steady_clock::now();
+    const bool was_running = event_running_.exchange(false);
     
-    // 通知处理线程退出
-    event_queue_cv_.notify_all();
+    // 唤醒Block策略下等待空闲缓冲的接收端，以及等待事件追上帧时间戳的图像线程
+    {
+        std::lock_guard<std::mutex> lock(free_slab_mutex_);
+        free_slab_cv_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pair_mutex_);
+        pair_cv_.notify_all();
+    }
     
-    // 给线程一些时间来退出
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // 取消排队的异步传输并等待全部结束；同步传输时等待当前传输完成或超时
+    usb_device_->stopAsyncTransfer(event_endpoint_);
+    if (event_thread_.joinable()) {
+        event_thread_.join();
+    }
     
-    // 清空队列
+    // 接收端已停止，处理线程处理完队列中的数据后退出
+    event_processing_running_ = false;
     {
         std::lock_guard<std::mutex> lock(event_queue_mutex_);
-        while (!event_data_queue_.empty()) {
-            event_data_queue_.pop();
-        }
+        event_queue_cv_.notify_all();
+    }
+    if (processing_thread_.joinable()) {
+        processing_thread_.join();
+    }
+    
+    // 等待解码线程处理完已分发的子帧组并退出
+    stopDecodeWorkers();
+    
+    // 缓冲块在下次启动时统一回收
+    if (was_running) {
+        event_stop_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - stop_start).count();
     }
 }
 
 bool HV_Camera::startImageCapture(ImageCallback callback) {
+    return startImageStream(callback, nullptr, nullptr, 0);
+}
+
+bool HV_Camera::startImageFrameCapture(ImageFrameCallback callback) {
+    return startImageStream(nullptr, callback, nullptr, 0);
+}
+
+bool HV_Camera::startImageEventPairCapture(ImageEventPairCallback callback, size_t history_batches) {
+    if (!callback) {
+        std::cerr << "Image/event pair callback is required" << std::endl;
+        return false;
+    }
+    return startImageStream(nullptr, nullptr, callback, history_batches);
+}
+
+bool HV_Camera::startImageStream(ImageCallback callback, ImageFrameCallback frame_callback,
+                                 ImageEventPairCallback pair_callback, size_t history_batches) {
     std::cout << "Starting image capture" << std::endl;
+    const auto start_time = std::chrono::steady_clock::now();
     if (!isOpen()) {
         std::cerr << "Device not opened" << std::endl;
         return false;
@@ -124,255 +315,1606 @@ bool HV_Camera::startImageCapture(ImageCallback callback) {
         return false;
     }
 
+    // 预分配图像缓冲池（首次启动时分配，之后复用）
+    if (!allocateImageBuffers()) {
+        std::cerr << "Failed to allocate image buffers" << std::endl;
+        return false;
+    }
+
     image_callback_ = callback;
+    image_frame_callback_ = frame_callback;
+    image_stream_error_ = 0;
+    image_pair_callback_ = pair_callback;
+    if (pair_callback) {
+        // 事件回调线程从此开始缓存已分发的批次
+        std::lock_guard<std::mutex> lock(pair_mutex_);
+        pair_history_.clear();
+        pair_history_capacity_ = std::max<size_t>(history_batches, 1);
+        pair_watermark_ticks_ = PAIR_NO_TICKS;
+        pair_evicted_ticks_ = PAIR_NO_TICKS;
+        pair_prev_ticks_ = PAIR_NO_TICKS;
+        pair_prev_us_ = -1;
+        pair_prev_epoch_ = pair_epoch_;
+        pair_enabled_ = true;
+    }
     image_running_ = true;
+    image_start_time_ = start_time;
+    image_first_frame_us_ = -1;
+    image_first_pending_ = true;
 
+    // 异步传输：图像端点上保持多个传输排队，停止时可立即取消
+    applyUsbThreadPlacement();
+    std::vector<unsigned char*> buffers;
+    for (size_t i = 0; i < IMAGE_TRANSFER_COUNT; ++i) {
+        unsigned char* buffer = image_pool_->acquire();
+        if (buffer) {
+            buffers.push_back(buffer);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(image_frame_mutex_);
+        ready_image_ = nullptr;
+        image_transfer_buffers_ = buffers;
+    }
+    image_async_ = !buffers.empty() && usb_device_->startAsyncTransfer(image_endpoint_, buffers, HV_APS_DATA_LEN,
+        [this](unsigned char* buffer, int bytes, bool success) {
+            return onImageTransfer(buffer, bytes, success);
+        });
+    if (!image_async_) {
+        // 异步传输启动失败时退回同步传输
+        std::cerr << "Failed to start async image transfer, falling back to synchronous transfer" << std::endl;
+        std::lock_guard<std::mutex> lock(image_frame_mutex_);
+        for (unsigned char* buffer : image_transfer_buffers_) {
+            image_pool_->release(buffer);
+        }
+        image_transfer_buffers_.clear();
+    }
 
     // 启动图像数据采集线程
-    std::thread image_thread(&HV_Camera::imageThreadFunc, this);
-    image_thread.detach();
+    image_thread_ = std::thread(&HV_Camera::imageThreadFunc, this);
+    image_start_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
 
     return true;
 }
 
 void HV_Camera::stopImageCapture() {
-    image_running_ = false;
-    // 给线程一些时间来退出
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto stop_start = std::chrono::steady_clock::now();
+    const bool was_running = image_running_.exchange(false);
+    
+    // 取消排队的异步传输，唤醒等待图像或等待事件配对的线程
+    usb_device_->stopAsyncTransfer(image_endpoint_);
+    {
+        std::lock_guard<std::mutex> lock(image_frame_mutex_);
+        image_frame_cv_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pair_mutex_);
+        pair_cv_.notify_all();
+    }
+    if (image_thread_.joinable()) {
+        image_thread_.join();
+    }
+    
+    // 停止缓存事件批次，释放缓存中的批次
+    pair_enabled_ = false;
+    {
+        std::lock_guard<std::mutex> lock(pair_mutex_);
+        pair_history_.clear();
+    }
+    
+    // 传输已全部结束，排队中的缓冲和未处理的帧归还缓冲池
+    {
+        std::lock_guard<std::mutex> lock(image_frame_mutex_);
+        if (image_pool_) {
+            for (unsigned char* buffer : image_transfer_buffers_) {
+                image_pool_->release(buffer);
+            }
+            if (ready_image_) {
+                image_pool_->release(ready_image_);
+            }
+        }
+        image_transfer_buffers_.clear();
+        ready_image_ = nullptr;
+    }
+    
+    if (was_running) {
+        image_stop_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - stop_start).count();
+    }
 }
 
 cv::Mat HV_Camera::getLatestImage() const {
+    std::lock_guard<std::mutex> lock(latest_bgr_mutex_);
+    ImageFrame frame;
+    ImageOutputConfig output;
+    {
+        std::lock_guard<std::mutex> frame_lock(image_mutex_);
+        frame = latest_frame_;
+        output = image_output_;
+    }
+    if (frame.empty()) {
+        const cv::Size size = output.outputSize();
+        return output.format == ImageOutputFormat::Gray
+            ? cv::Mat(size.height, size.width, CV_8UC1, cv::Scalar(0))
+            : cv::Mat(size.height, size.width, CV_8UC3, cv::Scalar(0, 0, 0));
+    }
+    
+    if (frame.sequence() == latest_bgr_sequence_ && output == latest_bgr_output_) {
+        return latest_bgr_;
+    }
+    
+    // 上一次的结果已经交给调用者，每个新帧都转换到新分配的图像中，不覆盖调用者持有的数据
+    cv::Mat image;
+    const auto convert_start = std::chrono::steady_clock::now();
+    frame.convert(output, image);
+    image_metrics_.observe(metric_ids_.image_convert_time, std::chrono::steady_clock::now() - convert_start);
+    latest_bgr_ = image;
+    latest_bgr_sequence_ = frame.sequence();
+    latest_bgr_output_ = output;
+    return image;
+}
+
+bool HV_Camera::setImageOutputFormat(ImageOutputFormat format, const cv::Rect& roi) {
+    ImageOutputConfig output;
+    output.format = format;
+    output.roi = roi;
+    if (!output.normalize(HV_APS_WIDTH, HV_APS_HEIGHT)) {
+        std::cerr << "Invalid image output region" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(image_mutex_);
+    image_output_ = output;
+    return true;
+}
+
+ImageOutputConfig HV_Camera::getImageOutputConfig() const {
+    std::lock_guard<std::mutex> lock(image_mutex_);
+    return image_output_;
+}
+
+void HV_Camera::setImageTimestampOffset(int64_t offset_us) {
+    image_timestamp_offset_us_ = offset_us;
+}
+
+ImageFrame HV_Camera::getLatestFrame() const {
     std::lock_guard<std::mutex> lock(image_mutex_);
-    return latest_image_.clone();
+    return latest_frame_;
 }
 
 void HV_Camera::clearEventQueue() {
-    std::lock_guard<std::mutex> lock(event_queue_mutex_);
-    while (!event_data_queue_.empty()) {
-        event_data_queue_.pop();
+    if (!event_processing_running_) {
+        resetEventSlabs();
+        std::cout << "Event queue cleared" << std::endl;
+        return;
+    }
+    
+    // filled_slabs_只能由处理线程消费，交给处理线程清空
+    clear_queue_requested_ = true;
+    event_queue_cv_.notify_one();
+}
+
+size_t HV_Camera::eventSlabCount() const {
+    return std::min(std::max(event_queue_budget_ / event_transfer_bytes_, MIN_EVENT_SLAB_COUNT), MAX_EVENT_SLAB_COUNT);
+}
+
+bool HV_Camera::allocateEventSlabs() {
+    const size_t slab_count = eventSlabCount();
+    const size_t slab_bytes = event_transfer_bytes_;
+    if (event_slabs_ && event_slab_count_ == slab_count && event_slab_bytes_ == slab_bytes) {
+        return true;
+    }
+    
+    // 内存预算或传输大小变化后重新分配
+    freeEventSlabs();
+    
+    std::unique_ptr<EventSlab[]> slabs(new EventSlab[slab_count + 1]);
+    size_t device_slabs = 0;
+    for (size_t i = 0; i <= slab_count; ++i) {
+        slabs[i].data = usb_device_->allocTransferBuffer(slab_bytes, &slabs[i].device_memory);
+        if (!slabs[i].data) {
+            for (size_t j = 0; j < i; ++j) {
+                usb_device_->freeTransferBuffer(slabs[j].data, slab_bytes, slabs[j].device_memory);
+            }
+            return false;
+        }
+        if (slabs[i].device_memory) {
+            device_slabs++;
+        }
+    }
+    event_slabs_ = std::move(slabs);
+    event_slab_count_ = slab_count;
+    event_slab_bytes_ = slab_bytes;
+    
+    slab_lookup_.clear();
+    for (uint32_t i = 0; i <= event_slab_count_; ++i) {
+        slab_lookup_[event_slabs_[i].data] = i;
+    }
+    
+    std::cout << "Allocated " << event_slab_count_ + 1 << " event buffers of " << slab_bytes / 1024 << "KB ("
+              << device_slabs << " in USB device memory)" << std::endl;
+    return true;
+}
+
+bool HV_Camera::allocateImageBuffers() {
+    if (image_pool_) {
+        return true;
+    }
+    // 缓冲池使用主机内存：交付出去的帧可能在设备关闭后仍被持有，不能使用随设备句柄释放的USB设备内存
+    image_pool_ = ImageBufferPool::create(HV_APS_WIDTH, HV_APS_HEIGHT, IMAGE_POOL_SIZE);
+    return image_pool_ != nullptr;
+}
+
+void HV_Camera::freeImageBuffers() {
+    // 仍被持有的帧保持缓冲池存活，最后一帧释放后池随之释放
+    {
+        std::lock_guard<std::mutex> lock(image_mutex_);
+        latest_frame_ = ImageFrame();
+    }
+    image_pool_.reset();
+}
+
+void HV_Camera::freeEventSlabs() {
+    if (!event_slabs_) {
+        return;
+    }
+    for (size_t i = 0; i <= event_slab_count_; ++i) {
+        usb_device_->freeTransferBuffer(event_slabs_[i].data, event_slab_bytes_, event_slabs_[i].device_memory);
+    }
+    event_slabs_.reset();
+    event_slab_count_ = 0;
+    event_slab_bytes_ = 0;
+    slab_lookup_.clear();
+}
+
+void HV_Camera::resetEventSlabs() {
+    // 仅在接收线程和处理线程都未运行时调用
+    filled_slabs_.reset();
+    free_slabs_.reset();
+    if (!event_slabs_) {
+        return;
+    }
+    for (uint32_t i = 0; i < event_slab_count_; ++i) {
+        event_slabs_[i].pending_groups = 0;
+        free_slabs_.push(i);
+    }
+}
+
+void HV_Camera::releaseEventSlab(uint32_t slab) {
+    {
+        std::lock_guard<std::mutex> lock(slab_release_mutex_);
+        free_slabs_.push(slab);
+    }
+    
+    // Block策略下接收线程正在等待空闲缓冲时才需要通知
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producer_waiting_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(free_slab_mutex_);
+        free_slab_cv_.notify_one();
+    }
+}
+
+bool HV_Camera::acquireEventSlab(uint32_t& slab) {
+    if (free_slabs_.pop(slab)) {
+        return true;
+    }
+    if (overflow_policy_ != QueueOverflowPolicy::Block) {
+        return false;
+    }
+    
+    // 阻塞接收，等待处理线程归还缓冲块
+    auto wait_start = std::chrono::steady_clock::now();
+    bool acquired = false;
+    {
+        std::unique_lock<std::mutex> lock(free_slab_mutex_);
+        producer_waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (event_running_) {
+            if (free_slabs_.pop(slab)) {
+                acquired = true;
+                break;
+            }
+            free_slab_cv_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        producer_waiting_.store(false, std::memory_order_relaxed);
     }
+    const auto wait_time = std::chrono::steady_clock::now() - wait_start;
+    blocked_us_ += std::chrono::duration_cast<std::chrono::microseconds>(wait_time).count();
+    usb_metrics_.observe(metric_ids_.block_wait_time, wait_time);
+    return acquired;
+}
+
+void HV_Camera::drainFilledSlabs() {
+    uint32_t slab;
+    while (filled_slabs_.pop(slab)) {
+        releaseEventSlab(slab);
+    }
+    stream_parser_.restart();
     std::cout << "Event queue cleared" << std::endl;
 }
 
+bool HV_Camera::setEventQueueMemoryBudget(size_t bytes) {
+    if (event_running_) {
+        std::cerr << "Cannot change event queue budget while event capture is running" << std::endl;
+        return false;
+    }
+    // 块数在分配时按当前传输大小计算，之后修改传输大小时预算不变
+    event_queue_budget_ = bytes;
+    return true;
+}
+
+size_t HV_Camera::getEventQueueMemoryBudget() const {
+    return eventSlabCount() * event_transfer_bytes_;
+}
+
+bool HV_Camera::setEventTransferSize(size_t bytes) {
+    if (event_running_) {
+        std::cerr << "Cannot change event transfer size while event capture is running" << std::endl;
+        return false;
+    }
+    const size_t groups = std::min(std::max<size_t>(bytes / EVENT_GROUP_BYTES, 1), MAX_EVENT_TRANSFER_GROUPS);
+    event_transfer_bytes_ = groups * EVENT_GROUP_BYTES;
+    return true;
+}
+
+size_t HV_Camera::getEventTransferSize() const {
+    return event_transfer_bytes_;
+}
+
+bool HV_Camera::setLowLatencyMode(bool enable) {
+    if (event_running_) {
+        std::cerr << "Cannot change low latency mode while event capture is running" << std::endl;
+        return false;
+    }
+    low_latency_ = enable;
+    event_transfer_bytes_ = enable ? EVENT_GROUP_BYTES : HV_BUF_LEN;
+    return true;
+}
+
+bool HV_Camera::isLowLatencyMode() const {
+    return low_latency_;
+}
+
+bool HV_Camera::setQueueOverflowPolicy(QueueOverflowPolicy policy, size_t decimation) {
+    if (event_running_) {
+        std::cerr << "Cannot change queue overflow policy while event capture is running" << std::endl;
+        return false;
+    }
+    overflow_policy_ = policy;
+    decimation_ = std::max<size_t>(decimation, 2);
+    return true;
+}
+
+QueueOverflowPolicy HV_Camera::getQueueOverflowPolicy() const {
+    return overflow_policy_;
+}
+
+bool HV_Camera::setEventTimeCallback(EventTimeCallback callback) {
+    if (event_running_) {
+        std::cerr << "Cannot change event time callback while event capture is running" << std::endl;
+        return false;
+    }
+    event_time_callback_ = callback;
+    return true;
+}
+
+ClockMapping HV_Camera::getClockMapping() const {
+    std::lock_guard<std::mutex> lock(clock_mutex_);
+    return clock_mapping_;
+}
+
+EventQueueStats HV_Camera::getEventQueueStats() const {
+    EventQueueStats stats;
+    stats.received_buffers = received_buffers_;
+    stats.incomplete_buffers = incomplete_buffers_;
+    stats.dropped_newest = dropped_newest_;
+    stats.dropped_oldest = dropped_oldest_;
+    stats.decimated_groups = decimated_groups_;
+    stats.invalid_subframes = invalid_subframes_;
+    stats.lost_subframes = lost_subframes_;
+    stats.discarded_subframes = discarded_subframes_;
+    stats.skipped_bytes = skipped_bytes_;
+    stats.timestamp_discontinuities = timestamp_discontinuities_;
+    stats.blocked_us = blocked_us_;
+    stats.queued_buffers = filled_slabs_.size();
+    stats.busy_poll_us = busy_poll_us_;
+    stats.capacity_buffers = eventSlabCount();
+    stats.usb_stream_error = event_stream_error_;
+    return stats;
+}
+
+EventLatencyStats HV_Camera::getEventLatencyStats() const {
+    const int ids[] = {metric_ids_.queue_wait_time, metric_ids_.decode_group_time, metric_ids_.reorder_wait_time,
+                       metric_ids_.callback_time, metric_ids_.end_to_end_time};
+    EventLatencyStats stats;
+    LatencyPercentiles* stages[] = {&stats.queue_wait, &stats.decode, &stats.reorder_wait,
+                                    &stats.callback, &stats.end_to_end};
+    
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    for (size_t i = 0; i < 5; ++i) {
+        // 减去启动采集时的读数，只统计本次采集
+        MetricSample hist = metrics_.histogram(ids[i]);
+        if (i < latency_baseline_.size() && latency_baseline_[i].buckets.size() == hist.buckets.size()) {
+            for (size_t b = 0; b < hist.buckets.size(); ++b) {
+                hist.buckets[b] -= latency_baseline_[i].buckets[b];
+            }
+            hist.count -= latency_baseline_[i].count;
+            hist.sum_ns -= latency_baseline_[i].sum_ns;
+        }
+        LatencyPercentiles& stage = *stages[i];
+        stage.count = hist.count;
+        if (hist.count > 0) {
+            stage.mean_us = hist.sum_ns / 1000.0 / hist.count;
+            stage.p50_us = hist.quantileNs(0.5) / 1000.0;
+            stage.p99_us = hist.quantileNs(0.99) / 1000.0;
+            stage.p999_us = hist.quantileNs(0.999) / 1000.0;
+        }
+    }
+    return stats;
+}
+
+bool HV_Camera::setDecodeThreads(size_t num_threads) {
+    if (event_running_) {
+        std::cerr << "Cannot change decode threads while event capture is running" << std::endl;
+        return false;
+    }
+    decode_threads_ = std::max<size_t>(num_threads, 1);
+    return true;
+}
+
+bool HV_Camera::setTransferQueueDepth(size_t depth) {
+    if (event_running_) {
+        std::cerr << "Cannot change transfer queue depth while event capture is running" << std::endl;
+        return false;
+    }
+    transfer_queue_depth_ = std::min(depth, MAX_TRANSFER_QUEUE_DEPTH);
+    return true;
+}
+
+size_t HV_Camera::getTransferQueueDepth() const {
+    return transfer_queue_depth_;
+}
+
+size_t HV_Camera::getDecodeThreads() const {
+    return decode_threads_;
+}
+
+bool HV_Camera::setSIMDDecodeEnabled(bool enable) {
+    decode_path_ = enable ? bestSubframeDecodePath() : SubframeDecodePath::Scalar;
+    return decode_path_ != SubframeDecodePath::Scalar;
+}
+
+bool HV_Camera::isSIMDDecodeEnabled() const {
+    return decode_path_ != SubframeDecodePath::Scalar;
+}
+
 void HV_Camera::eventThreadFunc() {
-    int usb_transfer_count = 0;  // USB传输计数器
-    const size_t CLEAR_THRESHOLD = MAX_QUEUE_SIZE / 2;  // 清空阈值，例如队列一半满时清空
+    applyThreadPlacement(ThreadRole::UsbReceive, "hv-usb-recv");
+    
+    const uint32_t discard_slab = static_cast<uint32_t>(event_slab_count_);
+    uint32_t slab = discard_slab;  // 当前持有的缓冲块，未发布前一直复用
     
     while (event_running_ && isOpen()) {
-        unsigned char* buffer = new unsigned char[HV_BUF_LEN];
+        // 获取空闲缓冲块；全部被占用时写入丢弃缓冲，保持端点持续读取（Block策略下等待空闲缓冲）
+        if (slab == discard_slab && !acquireEventSlab(slab)) {
+            slab = discard_slab;
+        }
         int bytes;
         
-        // 记录USB传输开始时间
-        auto usb_start_time = std::chrono::high_resolution_clock::now();
-        
-        // 使用USB设备类进行数据传输
-        bool success = usb_device_->bulkTransfer(event_endpoint_, buffer, HV_BUF_LEN, &bytes, 500);
-        
-        // 记录USB传输结束时间并计算耗时
-        auto usb_end_time = std::chrono::high_resolution_clock::now();
-        auto usb_duration = std::chrono::duration_cast<std::chrono::microseconds>(usb_end_time - usb_start_time);
+        // 使用USB设备类直接传输到缓冲块，耗时计入指标
+        auto usb_start_time = std::chrono::steady_clock::now();
+        bool success = usb_device_->bulkTransfer(event_endpoint_, event_slabs_[slab].data,
+                                                 static_cast<int>(event_transfer_bytes_), &bytes, 500);
+        const int64_t completed_ns = hv_metrics_now_ns();
+        usb_metrics_.observe(metric_ids_.usb_transfer_time, std::chrono::steady_clock::now() - usb_start_time);
+        usb_metrics_.add(metric_ids_.usb_transfers);
         
-        usb_transfer_count++;
-        
-        // 每100次USB传输输出一次平均耗时
-        if (usb_transfer_count % 100 == 0) {
-            std::cout << "[USB Event] Transfer #" << usb_transfer_count 
-                     << ", last transfer time: " << usb_duration.count() << " μs" 
-                     << ", success: " << (success ? "true" : "false") << std::endl;
-        }
-        if (success) {
+        if (success && bytes > 0) {
+            usb_metrics_.add(metric_ids_.usb_bytes, bytes);
+            // 短传输同样交给处理线程，由解析器按子帧头重新对齐
             if (bytes < HV_SUB_FULL_BYTE_SIZE * 4) {
-                std::cerr << "Incomplete data received: " << bytes << " bytes" << std::endl;
-                delete[] buffer;
-                continue;
+                incomplete_buffers_++;
+                usb_metrics_.add(metric_ids_.incomplete_buffers);
             }
+            received_buffers_++;
             
-            // 将数据放入队列中，而不是直接处理
-            {
-                std::unique_lock<std::mutex> lock(event_queue_mutex_);
-                
-                // 如果队列已满，丢弃最老的数据
-                if (event_data_queue_.size() >= MAX_QUEUE_SIZE) {
-                    event_data_queue_.pop();
-                    std::cerr << "Event queue full, dropping oldest data" << std::endl;
-                }
-                
-                // 创建缓存对象并复制数据
-                auto data_buffer = std::make_unique<EventDataBuffer>(HV_BUF_LEN);
-                std::memcpy(data_buffer->data.get(), buffer, HV_BUF_LEN);
-                event_data_queue_.push(std::move(data_buffer));
+            // 队列已满，丢弃本次数据
+            if (slab == discard_slab) {
+                dropped_newest_++;
+                usb_metrics_.add(metric_ids_.dropped_newest);
+                receive_discontinuity_ = true;
+                continue;
             }
             
-            // 通知处理线程有新数据
-            event_queue_cv_.notify_one();
+            // 发布缓冲块索引，处理线程解码完成后归还
+            publishEventSlab(slab, bytes, completed_ns);
+            slab = discard_slab;
             
         } else {
+            usb_metrics_.add(metric_ids_.usb_transfer_errors);
+            
             // 如果传输失败，等待一段时间再重试
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
-        delete[] buffer;
     }
 }
 
-void HV_Camera::imageThreadFunc() {
-    while (image_running_ && isOpen()) {
-        unsigned char* image_buffer = new unsigned char[HV_APS_DATA_LEN];
-        int bytes;
-        
-        // 使用USB设备类进行数据传输
-        bool success = usb_device_->bulkTransfer(image_endpoint_, image_buffer, HV_APS_DATA_LEN, &bytes, 500);  
-
-        if (success) {
-            // 将YUV数据转换为BGR
-            cv::Mat yuv(HV_APS_HEIGHT * 3 / 2, HV_APS_WIDTH, CV_8UC1, image_buffer);
-            cv::Mat bgr;
-            cv::cvtColor(yuv, bgr, cv::COLOR_YUV2BGR_NV12);
-            
-            // 更新最新的图像
-            {
-                std::lock_guard<std::mutex> lock(image_mutex_);
-                bgr.copyTo(latest_image_);
-            }
-            
-            // 调用回调函数
-            if (image_callback_) {
-                image_callback_(bgr);
-            }
-            
-            delete[] image_buffer;
-        } else {
-            delete[] image_buffer;
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
+unsigned char* HV_Camera::onEventTransfer(unsigned char* buffer, int bytes, bool success) {
+    // 多个传输排队时单次传输耗时无法直接测得，记录相邻两次完成的间隔
+    const int64_t completed_ns = hv_metrics_now_ns();
+    const auto now = std::chrono::steady_clock::now();
+    usb_metrics_.observe(metric_ids_.usb_transfer_time, now - last_event_transfer_);
+    last_event_transfer_ = now;
+    usb_metrics_.add(metric_ids_.usb_transfers);
+    
+    // 失败的传输归还同一缓冲块，由USB事件线程退避后重新提交（持续出错时终止，见checkAsyncStream）
+    if (!success) {
+        usb_metrics_.add(metric_ids_.usb_transfer_errors);
+        return buffer;
     }
-}
-
-void HV_Camera::eventProcessingThreadFunc() {
-    static int process_count = 0;  // 处理计数器
+    if (bytes <= 0) {
+        return buffer;
+    }
+    usb_metrics_.add(metric_ids_.usb_bytes, bytes);
+    // 短传输同样交给处理线程，由解析器按子帧头重新对齐
+    if (bytes < HV_SUB_FULL_BYTE_SIZE * 4) {
+        incomplete_buffers_++;
+        usb_metrics_.add(metric_ids_.incomplete_buffers);
+    }
+    received_buffers_++;
     
-    while (event_processing_running_) {
-        std::vector<std::unique_ptr<EventDataBuffer>> batch_buffers;
-        size_t current_queue_size = 0;
-        
-        // 批量获取多个缓冲区
-        {
-            std::unique_lock<std::mutex> lock(event_queue_mutex_);
+    // 没有空闲缓冲块时丢弃本次数据，继续使用当前缓冲块；回调中从不等待（Block策略不使用异步传输）
+    uint32_t next;
+    if (!acquireEventSlab(next)) {
+        dropped_newest_++;
+        usb_metrics_.add(metric_ids_.dropped_newest);
+        receive_discontinuity_ = true;
+        return buffer;
+    }
+    
+    publishEventSlab(slab_lookup_.at(buffer), bytes, completed_ns);
+    return event_slabs_[next].data;
+}
+
+void HV_Camera::publishEventSlab(uint32_t slab, int bytes, int64_t completed_ns) {
+    event_slabs_[slab].bytes = bytes;
+    event_slabs_[slab].completed_ns = completed_ns;
+    event_slabs_[slab].discontinuity = receive_discontinuity_;
+    receive_discontinuity_ = false;
+    filled_slabs_.push(slab);
+    
+    // 处理线程正在等待时才需要通知
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (processing_waiting_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(event_queue_mutex_);
+        event_queue_cv_.notify_one();
+    }
+}
+
+void HV_Camera::imageThreadFunc() {
+    applyThreadPlacement(ThreadRole::Image, "hv-image");
+    
+    if (!image_async_) {
+        // 同步传输：停止时需等待当前传输完成或超时
+        while (image_running_ && isOpen()) {
+            unsigned char* buffer = image_pool_->acquire();
+            if (!buffer) {
+                // 所有缓冲都被调用者持有，暂停读取（设备端丢帧）
+                image_metrics_.add(metric_ids_.image_dropped_frames);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            int bytes;
             
-            // 等待数据或退出信号
-            event_queue_cv_.wait(lock, [this] {
-                return !event_data_queue_.empty() || !event_processing_running_;
+            // 使用USB设备类进行数据传输
+            bool success = usb_device_->bulkTransfer(image_endpoint_, buffer, HV_APS_DATA_LEN, &bytes, 500);
+            const int64_t completed_ns = static_cast<int64_t>(hv_metrics_now_ns());
+
+            if (success && bytes >= HV_APS_DATA_LEN) {
+                processImageFrame(ImageFrame(image_pool_->share(buffer), HV_APS_WIDTH, HV_APS_HEIGHT,
+                                             image_sequence_++, completed_ns, imageDeviceUs(completed_ns)));
+            } else {
+                image_pool_->release(buffer);
+                if (!success) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+        }
+        return;
+    }
+    
+    while (true) {
+        unsigned char* buffer = nullptr;
+        int64_t completed_ns = 0;
+        {
+            std::unique_lock<std::mutex> lock(image_frame_mutex_);
+            const bool ready = image_frame_cv_.wait_for(lock, std::chrono::nanoseconds(static_cast<int64_t>(STREAM_CHECK_INTERVAL_NS)), [this] {
+                return ready_image_ != nullptr || !image_running_;
             });
-            
+            if (!image_running_) {
+                break;
+            }
+            if (!ready) {
+                // 没有新帧时检查异步传输是否已终止
+                lock.unlock();
+                checkAsyncStream(image_endpoint_, image_stream_error_, image_metrics_, "image");
+                continue;
+            }
+            buffer = ready_image_;
+            completed_ns = ready_image_ns_;
+            ready_image_ = nullptr;
+        }
+        
+        // 帧析构（包括调用者持有的副本全部释放）时缓冲归还缓冲池
+        processImageFrame(ImageFrame(image_pool_->share(buffer), HV_APS_WIDTH, HV_APS_HEIGHT,
+                                     image_sequence_++, completed_ns, imageDeviceUs(completed_ns)));
+    }
+}
+
+unsigned char* HV_Camera::onImageTransfer(unsigned char* buffer, int bytes, bool success) {
+    // 失败或不完整的帧直接用同一缓冲重新提交
+    if (!success || bytes < HV_APS_DATA_LEN) {
+        return buffer;
+    }
+    const int64_t completed_ns = static_cast<int64_t>(hv_metrics_now_ns());
+    
+    std::lock_guard<std::mutex> lock(image_frame_mutex_);
+    unsigned char* next;
+    if (ready_image_) {
+        // 图像线程来不及处理，丢弃较旧的待处理帧
+        next = ready_image_;
+        usb_metrics_.add(metric_ids_.image_dropped_frames);
+    } else if ((next = image_pool_->acquire()) == nullptr) {
+        // 调用者持有了所有空闲缓冲，丢弃本帧
+        usb_metrics_.add(metric_ids_.image_dropped_frames);
+        return buffer;
+    }
+    ready_image_ = buffer;
+    ready_image_ns_ = completed_ns;
+    std::replace(image_transfer_buffers_.begin(), image_transfer_buffers_.end(), buffer, next);
+    image_frame_cv_.notify_one();
+    return next;
+}
+
+void HV_Camera::processImageFrame(const ImageFrame& frame) {
+    image_metrics_.add(metric_ids_.image_frames);
+    
+    // 更新最新帧：只交换引用，不复制
+    ImageOutputConfig output;
+    {
+        std::lock_guard<std::mutex> lock(image_mutex_);
+        latest_frame_ = frame;
+        output = image_output_;
+    }
+    
+    if (image_frame_callback_) {
+        image_frame_callback_(frame);
+    }
+    
+    if (image_pair_callback_) {
+        deliverImageEventPair(frame);
+    }
+    
+    // 图像回调：只在需要时转换，Gray也复制出亮度区域，回调得到的图像不引用帧池缓冲；
+    // 回调可能保留图像，每帧转换到新分配的图像中。零拷贝访问使用startImageFrameCapture
+    if (image_callback_) {
+        cv::Mat image;
+        const auto convert_start = std::chrono::steady_clock::now();
+        frame.convert(output, image);
+        image_metrics_.observe(metric_ids_.image_convert_time, std::chrono::steady_clock::now() - convert_start);
+        image_callback_(image);
+    }
+    
+    if (image_first_pending_.exchange(false)) {
+        image_first_frame_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - image_start_time_).count();
+    }
+}
+
+void HV_Camera::checkAsyncStream(uint8_t endpoint, std::atomic<int>& error, MetricsShard& metrics, const char* name) {
+    if (error != 0) {
+        return;
+    }
+    const int status = usb_device_->getAsyncTransferError(endpoint);
+    if (status != 0) {
+        // 只报告一次；传输流保留到停止采集时移除
+        error = status;
+        metrics.add(metric_ids_.usb_stream_failures);
+        std::cerr << "Async " << name << " transfer stopped (libusb transfer status " << status
+                  << "), restart capture to recover" << std::endl;
+    }
+}
+
+int64_t HV_Camera::imageDeviceUs(int64_t completed_ns) const {
+    // APS数据不带时间戳：传输完成时刻减去曝光到传输完成的延迟，再经事件流的时钟映射换算为设备时间
+    const int64_t offset_ns = image_timestamp_offset_us_.load(std::memory_order_relaxed) * 1000;
+    return getClockMapping().hostNsToDeviceUs(completed_ns - offset_ns);
+}
+
+void HV_Camera::deliverImageEventPair(const ImageFrame& frame) {
+    ImageEventPair pair;
+    pair.frame = frame;
+    pair.end_us = frame.deviceTimestampUs();
+    if (pair.end_us < 0) {
+        // 时钟映射尚未建立，无法确定本帧对应的事件
+        image_metrics_.add(metric_ids_.image_incomplete_pairs);
+        image_pair_callback_(pair);
+        return;
+    }
+    
+    // 帧时间戳展开到与事件批次相同的tick基准，跨40位回绕仍可比较
+    const int64_t end_ticks = getClockMapping().unwrap(static_cast<uint64_t>(pair.end_us) * HV_SUBFRAME_TICKS_PER_US);
+    bool complete = false;
+    {
+        std::unique_lock<std::mutex> lock(pair_mutex_);
+        // 设备时间倒退后缓存已清空，上一帧的时间戳不再可比，按启动后第一帧处理
+        int64_t begin_ticks = pair_prev_ticks_;
+        if (pair_prev_epoch_ == pair_epoch_ && begin_ticks != PAIR_NO_TICKS) {
+            pair.begin_us = pair_prev_us_;
+        } else {
+            begin_ticks = PAIR_NO_TICKS;
+        }
+        
+        // 等待事件处理追上本帧时间戳
+        pair_cv_.wait_for(lock, std::chrono::milliseconds(PAIR_WAIT_MS), [this, end_ticks] {
+            return (pair_watermark_ticks_ != PAIR_NO_TICKS && pair_watermark_ticks_ >= end_ticks) ||
+                   !image_running_ || !event_running_;
+        });
+        complete = begin_ticks != PAIR_NO_TICKS && end_ticks > begin_ticks &&
+                   pair_watermark_ticks_ != PAIR_NO_TICKS && pair_watermark_ticks_ >= end_ticks &&
+                   pair_evicted_ticks_ <= begin_ticks;
+        
+        // 区间为(begin, end]；映射重新估计导致区间为空时不附带事件
+        if (begin_ticks == PAIR_NO_TICKS || end_ticks > begin_ticks) {
+            for (const PairHistoryEntry& entry : pair_history_) {
+                if (entry.first_ticks > end_ticks) {
+                    break;
+                }
+                if (entry.last_ticks <= begin_ticks) {
+                    continue;
+                }
+                const std::vector<EventCD>& events = *entry.batch;
+                size_t first = 0;
+                size_t last = events.size();
+                if (entry.sorted) {
+                    const int64_t ref_ticks = entry.ref_ticks;
+                    auto after = [ref_ticks](int64_t ticks, const EventCD& event) {
+                        return ticks < unwrapTicks(static_cast<uint64_t>(event.t) * HV_SUBFRAME_TICKS_PER_US, ref_ticks);
+                    };
+                    if (begin_ticks != PAIR_NO_TICKS) {
+                        first = std::upper_bound(events.begin(), events.end(), begin_ticks, after) - events.begin();
+                    }
+                    last = std::upper_bound(events.begin(), events.end(), end_ticks, after) - events.begin();
+                } else if (entry.last_ticks > end_ticks) {
+                    // 未排序的批次整批归入包含其最晚事件的帧
+                    continue;
+                }
+                if (last > first) {
+                    EventSlice slice;
+                    slice.batch = entry.batch;
+                    slice.offset = first;
+                    slice.count = last - first;
+                    pair.events.push_back(std::move(slice));
+                }
+            }
+        }
+        
+        // 已全部交付的批次不再需要
+        while (!pair_history_.empty() && pair_history_.front().last_ticks <= end_ticks) {
+            pair_history_.pop_front();
+        }
+        pair_prev_epoch_ = pair_epoch_;
+    }
+    
+    pair_prev_ticks_ = end_ticks;
+    pair_prev_us_ = pair.end_us;
+    pair.complete = complete;
+    if (!complete) {
+        image_metrics_.add(metric_ids_.image_incomplete_pairs);
+    }
+    image_pair_callback_(pair);
+}
+
+void HV_Camera::recordPairBatch(const EventBatch& batch, const EventBatchTime& time) {
+    // 事件时间戳展开为距批次首个子帧最近的值；空批次也推进水位：该子帧组之前的事件都已分发
+    PairHistoryEntry entry;
+    entry.ref_ticks = time.device_ticks;
+    int64_t watermark = time.device_ticks;
+    if (batch && !batch->empty()) {
+        entry.batch = batch;
+        entry.first_ticks = INT64_MAX;
+        entry.last_ticks = INT64_MIN;
+        int64_t prev = INT64_MIN;
+        for (const EventCD& event : *batch) {
+            const int64_t ticks = unwrapTicks(static_cast<uint64_t>(event.t) * HV_SUBFRAME_TICKS_PER_US, entry.ref_ticks);
+            entry.sorted = entry.sorted && ticks >= prev;
+            entry.first_ticks = std::min(entry.first_ticks, ticks);
+            entry.last_ticks = std::max(entry.last_ticks, ticks);
+            prev = ticks;
+        }
+        watermark = std::max(watermark, entry.last_ticks);
+    }
+    
+    std::lock_guard<std::mutex> lock(pair_mutex_);
+    if (pair_watermark_ticks_ != PAIR_NO_TICKS &&
+        time.device_ticks + static_cast<int64_t>(HV_SUBFRAME_MAX_GAP_TICKS) < pair_watermark_ticks_) {
+        // 设备时间倒退（设备重启、重新启动采集后重新估计时钟）：缓存的批次与之后的帧不可比
+        pair_history_.clear();
+        pair_evicted_ticks_ = PAIR_NO_TICKS;
+        pair_epoch_++;
+    }
+    if (entry.batch) {
+        pair_history_.push_back(std::move(entry));
+        if (pair_history_.size() > pair_history_capacity_) {
+            pair_evicted_ticks_ = std::max(pair_evicted_ticks_, pair_history_.front().last_ticks);
+            pair_history_.pop_front();
+        }
+    }
+    pair_watermark_ticks_ = watermark;
+    pair_cv_.notify_all();
+}
+
+void HV_Camera::eventProcessingThreadFunc() {
+    applyThreadPlacement(ThreadRole::Processing, "hv-event-proc");
+    
+    while (true) {
+        if (clear_queue_requested_.exchange(false)) {
+            drainFilledSlabs();
+        }
+        
+        // 一次性取出多个缓冲块（最多5个）进行批量处理
+        uint32_t batch_slabs[5];
+        size_t batch_size = 0;
+        while (batch_size < 5 && filled_slabs_.pop(batch_slabs[batch_size])) {
+            batch_size++;
+        }
+        
+        if (batch_size == 0) {
             // 如果收到退出信号且队列为空，则退出
-            if (!event_processing_running_ && event_data_queue_.empty()) {
+            if (!event_processing_running_) {
                 break;
             }
             
-            // 一次性取出多个缓冲区（最多5个）进行批量处理
-            while (!event_data_queue_.empty() && batch_buffers.size() < 5) {
-                batch_buffers.push_back(std::move(event_data_queue_.front()));
-                event_data_queue_.pop();
+            // 没有数据时检查异步传输是否已因设备断开或端点持续出错而终止
+            if (event_async_) {
+                checkAsyncStream(event_endpoint_, event_stream_error_, processing_metrics_, "event");
             }
-            current_queue_size = event_data_queue_.size();
+            
+            // 低延迟模式：忙等待，数据一发布即开始解码，省去唤醒延迟；每100ms回到上面检查一次传输状态
+            if (low_latency_) {
+                const uint64_t poll_start = hv_metrics_now_ns();
+                while (filled_slabs_.empty() && event_processing_running_ && !clear_queue_requested_ &&
+                       hv_metrics_now_ns() - poll_start < STREAM_CHECK_INTERVAL_NS) {
+                    spinPause();
+                }
+                const uint64_t poll_us = (hv_metrics_now_ns() - poll_start) / 1000;
+                busy_poll_us_ += poll_us;
+                processing_metrics_.add(metric_ids_.busy_poll_us, poll_us);
+                continue;
+            }
+            
+            // 等待数据或退出信号
+            std::unique_lock<std::mutex> lock(event_queue_mutex_);
+            processing_waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            event_queue_cv_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+                return !filled_slabs_.empty() || !event_processing_running_ || clear_queue_requested_;
+            });
+            processing_waiting_.store(false, std::memory_order_relaxed);
+            continue;
         }
+        metrics_.setGauge(metric_ids_.queued_buffers, static_cast<int64_t>(filled_slabs_.size()));
+        metrics_.setGauge(metric_ids_.free_buffers, static_cast<int64_t>(free_slabs_.size()));
+        processing_metrics_.add(metric_ids_.processed_buffers, batch_size);
         
-        // 批量处理数据（在锁外进行，避免阻塞USB接收线程）
-        for (auto& data_buffer : batch_buffers) {
-            if (data_buffer) {
-                for (size_t offset = 0; offset < HV_BUF_LEN; offset += HV_SUB_FULL_BYTE_SIZE * 4) {
-                    processEventData(data_buffer->data.get() + offset);
+        // 批量处理数据，按到达顺序解析
+        for (size_t i = 0; i < batch_size; ++i) {
+            processEventSlab(batch_slabs[i]);
+        }
+        publishStreamStats();
+    }
+}
+
+void HV_Camera::processEventSlab(uint32_t slab) {
+    EventSlab& source = event_slabs_[slab];
+    if (source.discontinuity) {
+        stream_parser_.restart();
+    }
+    const size_t free_slabs = free_slabs_.size();
+    
+    // 接收端即将没有空闲缓冲时丢弃最老的数据（当前缓冲块即为最老的），为新数据腾出空间。
+    // 异步传输时保留的空闲缓冲覆盖所有排队的传输，避免接收端先于处理线程用尽空闲缓冲而丢弃新数据
+    if (overflow_policy_ == QueueOverflowPolicy::DropOldest &&
+        free_slabs <= drop_oldest_reserve_.load(std::memory_order_relaxed)) {
+        dropped_oldest_++;
+        processing_metrics_.add(metric_ids_.dropped_oldest);
+        stream_parser_.restart();
+        releaseEventSlab(slab);
+        return;
+    }
+    
+    // 空闲缓冲不足1/4时开始抽取解码
+    const bool decimate = overflow_policy_ == QueueOverflowPolicy::Decimate && free_slabs < event_slab_count_ / 4;
+    const bool parallel = decode_threads_ > 1;
+    
+    // 并行解码时处理线程在解析期间持有一个计数，最后一个解码完成的子帧组负责归还缓冲块
+    source.pending_groups.store(1, std::memory_order_relaxed);
+    
+    const uint8_t* begin = source.data;
+    const uint8_t* end = source.data + source.bytes;
+    stream_parser_.parse(begin, static_cast<size_t>(source.bytes), [&](const uint8_t* group) {
+        // 抽取掉的子帧组同样作为时钟样本
+        const EventBatchTime time = timeEventGroup(group, source.completed_ns);
+        if (decimate && (decimation_counter_++ % decimation_) != 0) {
+            decimated_groups_++;
+            processing_metrics_.add(metric_ids_.decimated_groups);
+            return;
+        }
+        if (!parallel) {
+            processEventData(group, time);
+        } else if (group >= begin && group < end) {
+            dispatchEventGroup(slab, static_cast<size_t>(group - begin), time);
+        } else {
+            // 跨缓冲拼接的子帧组只在回调期间有效，在处理线程中解码并按序号回调
+            decodeEventGroupInOrder(group, time);
+        }
+    });
+    
+    const ClockMapping& mapping = clock_estimator_.mapping();
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        clock_mapping_ = mapping;
+    }
+    metrics_.setGauge(metric_ids_.clock_drift, static_cast<int64_t>(mapping.drift_ppm * 1000.0));
+    metrics_.setGauge(metric_ids_.clock_jitter, static_cast<int64_t>(mapping.jitter_ns));
+    
+    if (source.pending_groups.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        releaseEventSlab(slab);
+    }
+}
+
+void HV_Camera::publishStreamStats() {
+    const SubframeStreamStats& stats = stream_parser_.stats();
+    SubframeStreamStats& published = published_stream_stats_;
+    const uint64_t invalid = stats.resyncs - published.resyncs;
+    const uint64_t lost = stats.lost_subframes - published.lost_subframes;
+    const uint64_t discarded = stats.discarded_subframes - published.discarded_subframes;
+    const uint64_t skipped = stats.skipped_bytes - published.skipped_bytes;
+    const uint64_t discontinuities = stats.timestamp_discontinuities - published.timestamp_discontinuities;
+    if (invalid | lost | discarded | skipped | discontinuities) {
+        invalid_subframes_ += invalid;
+        lost_subframes_ += lost;
+        discarded_subframes_ += discarded;
+        skipped_bytes_ += skipped;
+        timestamp_discontinuities_ += discontinuities;
+        processing_metrics_.add(metric_ids_.invalid_subframes, invalid);
+        processing_metrics_.add(metric_ids_.lost_subframes, lost);
+        processing_metrics_.add(metric_ids_.discarded_subframes, discarded);
+        processing_metrics_.add(metric_ids_.skipped_bytes, skipped);
+        processing_metrics_.add(metric_ids_.timestamp_discontinuities, discontinuities);
+        published = stats;
+    }
+}
+
+EventBatchTime HV_Camera::timeEventGroup(const uint8_t* dataPtr, int64_t completed_ns) {
+    uint64_t word0;
+    memcpy(&word0, dataPtr, sizeof(word0));
+    const uint64_t raw_ticks = (word0 >> 24) & HV_SUBFRAME_TIMESTAMP_MASK;
+    
+    // 同一传输中越靠后的子帧组传输延迟越小，估计器按桶保留延迟最小的样本
+    EventBatchTime time;
+    time.device_ticks = clock_estimator_.addSample(raw_ticks, completed_ns);
+    time.device_us = time.device_ticks / HV_SUBFRAME_TICKS_PER_US;
+    time.host_ns = clock_estimator_.mapping().toHostNs(time.device_ticks);
+    time.arrival_ns = completed_ns;
+    return time;
+}
+
+void HV_Camera::processEventData(const uint8_t* dataPtr, const EventBatchTime& time) {
+    // 性能优化：重用预分配的事件数组，避免频繁内存分配
+    reusable_group_.time = time;
+    decodeTimed(dataPtr, reusable_group_, processing_metrics_);
+    processing_metrics_.add(metric_ids_.decoded_groups);
+    
+    // 处理完所有子帧后，一次性发送所有事件
+    deliverEventGroup(reusable_group_);
+}
+
+void HV_Camera::decodeTimed(const uint8_t* dataPtr, DecodedGroup& group, const MetricsShard& metrics) const {
+    group.decode_start_ns = static_cast<int64_t>(hv_metrics_now_ns());
+    decodeEventGroup(dataPtr, group);
+    group.decode_end_ns = static_cast<int64_t>(hv_metrics_now_ns());
+    metrics.observe(metric_ids_.decode_subframe_time,
+                    static_cast<uint64_t>(group.decode_end_ns - group.decode_start_ns) / HV_SUBFRAME_GROUP_SIZE);
+}
+
+void HV_Camera::decodeEventGroup(const uint8_t* dataPtr, DecodedGroup& group) const {
+    // 子帧头和编号已由解析器校验
+    switch (event_output_) {
+    case EventOutput::Bitplanes: {
+        if (!group.bitplane) {
+            group.bitplane.reset(new EventBitplaneFrame());
+        }
+        decodeSubframeGroupBitplane(dataPtr, *group.bitplane);
+        break;
+    }
+    case EventOutput::Packets: {
+        group.packet.clear(); // 清空但保留容量
+        EventPacketPolicy policy(group.packet);
+        decodeSubframeGroup(dataPtr, policy, decode_path_);
+        break;
+    }
+    default: {
+        group.events.clear(); // 清空但保留容量
+        EventVectorPolicy<EventCD> policy(group.events);
+        decodeSubframeGroup(dataPtr, policy, decode_path_);
+        break;
+    }
+    }
+}
+
+void HV_Camera::deliverEventGroup(DecodedGroup& group) {
+    if (event_first_pending_.load(std::memory_order_relaxed) && event_first_pending_.exchange(false)) {
+        event_first_data_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - event_start_time_).count();
+    }
+    
+    const int64_t callback_start_ns = static_cast<int64_t>(hv_metrics_now_ns());
+    if (event_time_callback_) {
+        event_time_callback_(group.time);
+    }
+    
+    std::shared_ptr<const SubscriberList> subscribers = std::atomic_load(&subscribers_);
+    const bool has_subscribers = subscribers && !subscribers->empty();
+    const bool pairing = pair_enabled_.load(std::memory_order_relaxed);
+    const bool need_batch = has_subscribers || pairing;
+    switch (event_output_) {
+    case EventOutput::Bitplanes:
+        // 位平面帧同时携带时间戳，即使没有事件也回调
+        if (event_bitplane_callback_ && group.bitplane) {
+            event_bitplane_callback_(*group.bitplane);
+        }
+        // 订阅者和图像配对总是使用EventCD批次，只在需要时展开
+        if (need_batch && group.bitplane) {
+            group.events.clear();
+            group.bitplane->toEvents(group.events);
+        }
+        break;
+    case EventOutput::Packets:
+        if (event_packet_callback_ && !group.packet.empty()) {
+            event_packet_callback_(group.packet);
+        }
+        if (need_batch) {
+            group.events.clear();
+            group.packet.toEvents(group.events);
+        }
+        break;
+    default:
+        if (event_callback_ && !group.events.empty()) {
+            event_callback_(group.events);
+        }
+        break;
+    }
+    
+    // 分发给订阅者和图像配对缓存：事件数组整体移入共享批次，不复制
+    EventBatch batch;
+    if (need_batch && !group.events.empty()) {
+        batch = makeEventBatch(group.events);
+    }
+    if (pairing) {
+        recordPairBatch(batch, group.time);
+    }
+    if (has_subscribers && batch) {
+        publishEventBatch(*subscribers, batch);
+    }
+    
+    // 各阶段延迟均以USB传输完成时刻为起点，回调串行执行，共用一个分片
+    const int64_t callback_end_ns = static_cast<int64_t>(hv_metrics_now_ns());
+    const int64_t arrival_ns = group.time.arrival_ns;
+    if (arrival_ns > 0 && group.decode_start_ns >= arrival_ns) {
+        delivery_metrics_.observe(metric_ids_.queue_wait_time, static_cast<uint64_t>(group.decode_start_ns - arrival_ns));
+        delivery_metrics_.observe(metric_ids_.decode_group_time,
+                                  static_cast<uint64_t>(group.decode_end_ns - group.decode_start_ns));
+        delivery_metrics_.observe(metric_ids_.reorder_wait_time,
+                                  static_cast<uint64_t>(std::max<int64_t>(callback_start_ns - group.decode_end_ns, 0)));
+        delivery_metrics_.observe(metric_ids_.callback_time, static_cast<uint64_t>(callback_end_ns - callback_start_ns));
+        delivery_metrics_.observe(metric_ids_.end_to_end_time, static_cast<uint64_t>(callback_end_ns - arrival_ns));
+    }
+}
+
+HV_Camera::EventBatch HV_Camera::makeEventBatch(std::vector<EventCD>& events) {
+    std::vector<EventCD>* batch = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(batch_pool_->mutex);
+        if (!batch_pool_->free.empty()) {
+            batch = batch_pool_->free.back();
+            batch_pool_->free.pop_back();
+        }
+    }
+    if (!batch) {
+        batch = new std::vector<EventCD>();
+    }
+    
+    // 交换后events得到池中的空数组（保留容量），批次持有解码结果
+    batch->swap(events);
+    
+    std::weak_ptr<EventBatchPool> weak_pool = batch_pool_;
+    return EventBatch(batch, [weak_pool](const std::vector<EventCD>* released) {
+        std::vector<EventCD>* events = const_cast<std::vector<EventCD>*>(released);
+        std::shared_ptr<EventBatchPool> pool = weak_pool.lock();
+        if (pool) {
+            events->clear();
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (pool->free.size() < MAX_POOLED_BATCHES) {
+                pool->free.push_back(events);
+                return;
+            }
+        }
+        delete events;
+    });
+}
+
+void HV_Camera::publishEventBatch(const SubscriberList& subscribers, const EventBatch& batch) {
+    for (const auto& subscriber : subscribers) {
+        {
+            std::unique_lock<std::mutex> lock(subscriber->mutex);
+            if (subscriber->mode == DeliveryMode::Lossless) {
+                subscriber->space_cv.wait(lock, [&subscriber] {
+                    return subscriber->queue.size() < subscriber->capacity || !subscriber->running;
+                });
+                if (!subscriber->running) {
+                    continue;
                 }
-                process_count++;
+            } else if (!subscriber->running) {
+                continue;
+            } else if (subscriber->queue.size() >= subscriber->capacity) {
+                subscriber->queue.pop_front();
+                subscriber->dropped++;
             }
+            subscriber->queue.push_back(batch);
+        }
+        subscriber->data_cv.notify_one();
+    }
+}
+
+SubscriptionId HV_Camera::subscribeEvents(EventCallback callback, DeliveryMode mode, size_t queue_batches) {
+    if (!callback) {
+        return 0;
+    }
+    
+    auto subscriber = std::make_shared<EventSubscriber>();
+    subscriber->callback = callback;
+    subscriber->mode = mode;
+    subscriber->capacity = std::max<size_t>(queue_batches, 1);
+    
+    std::lock_guard<std::mutex> lock(subscribe_mutex_);
+    subscriber->id = next_subscription_id_++;
+    subscriber->thread = std::thread(&HV_Camera::subscriberThreadFunc, this, subscriber);
+    
+    // 写时复制，解码线程读取订阅列表时无需加锁
+    std::shared_ptr<const SubscriberList> current = std::atomic_load(&subscribers_);
+    auto updated = std::make_shared<SubscriberList>();
+    if (current) {
+        *updated = *current;
+    }
+    updated->push_back(subscriber);
+    std::atomic_store(&subscribers_, std::shared_ptr<const SubscriberList>(updated));
+    
+    return subscriber->id;
+}
+
+bool HV_Camera::unsubscribeEvents(SubscriptionId id) {
+    std::shared_ptr<EventSubscriber> removed;
+    {
+        std::lock_guard<std::mutex> lock(subscribe_mutex_);
+        std::shared_ptr<const SubscriberList> current = std::atomic_load(&subscribers_);
+        if (!current) {
+            return false;
+        }
+        auto updated = std::make_shared<SubscriberList>();
+        for (const auto& subscriber : *current) {
+            if (subscriber->id == id) {
+                removed = subscriber;
+            } else {
+                updated->push_back(subscriber);
+            }
+        }
+        if (!removed) {
+            return false;
+        }
+        std::atomic_store(&subscribers_, std::shared_ptr<const SubscriberList>(updated));
+    }
+    
+    stopSubscriber(removed);
+    return true;
+}
+
+bool HV_Camera::getSubscriberStats(SubscriptionId id, SubscriberStats& stats) const {
+    std::shared_ptr<const SubscriberList> current = std::atomic_load(&subscribers_);
+    if (!current) {
+        return false;
+    }
+    for (const auto& subscriber : *current) {
+        if (subscriber->id == id) {
+            std::lock_guard<std::mutex> lock(subscriber->mutex);
+            stats.delivered_batches = subscriber->delivered;
+            stats.dropped_batches = subscriber->dropped;
+            stats.queued_batches = subscriber->queue.size();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HV_Camera::setThreadPlacement(ThreadRole role, const ThreadPlacement& placement) {
+    if (role == ThreadRole::Writer) {
+        std::cerr << "HV_Camera has no writer thread" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    thread_placements_[role] = placement;
+    return true;
+}
+
+std::vector<AppliedThreadPlacement> HV_Camera::getThreadPlacementReport() const {
+    std::vector<AppliedThreadPlacement> report;
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        for (const auto& entry : applied_placements_) {
+            report.push_back(entry.second);
+        }
+    }
+    
+    // 异步传输的事件线程属于共享的libusb上下文
+    std::shared_ptr<USBContext> context = usb_device_->getContext();
+    if (context) {
+        AppliedThreadPlacement usb = context->getEventThreadPlacement();
+        if (usb.tid != 0) {
+            report.push_back(usb);
         }
+    }
+    return report;
+}
+
+void HV_Camera::applyThreadPlacement(ThreadRole role, const std::string& name) {
+    ThreadPlacement placement;
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        auto it = thread_placements_.find(role);
+        if (it != thread_placements_.end()) {
+            placement = it->second;
+        }
+    }
+    
+    AppliedThreadPlacement applied = hv::applyThreadPlacement(name, placement);
+    if (!applied.error.empty()) {
+        std::cerr << "Thread placement for " << name << ": " << applied.error << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    applied_placements_[name] = applied;
+}
+
+void HV_Camera::applyUsbThreadPlacement() {
+    // 只在配置过时设置，避免覆盖共享上下文上其他相机的配置
+    std::shared_ptr<USBContext> context = usb_device_->getContext();
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    auto it = thread_placements_.find(ThreadRole::UsbReceive);
+    if (context && it != thread_placements_.end()) {
+        context->setEventThreadPlacement(it->second);
+    }
+}
+
+CaptureTimingStats HV_Camera::getCaptureTimingStats() const {
+    CaptureTimingStats stats;
+    stats.event_start_us = event_start_us_;
+    stats.event_first_data_us = event_first_data_us_;
+    stats.event_stop_us = event_stop_us_;
+    stats.image_start_us = image_start_us_;
+    stats.image_first_frame_us = image_first_frame_us_;
+    stats.image_stop_us = image_stop_us_;
+    return stats;
+}
+
+MetricsSnapshot HV_Camera::getMetricsSnapshot() const {
+    return metrics_.snapshot();
+}
+
+void HV_Camera::startMetricsExport(const std::string& path, unsigned interval_ms) {
+    // 标签只在写出线程停止时修改
+    metrics_exporter_.stop();
+    const std::string port_path = usb_device_->getDeviceInfo().port_path;
+    metrics_.setLabels(port_path.empty() ? std::string() : "device=\"" + port_path + "\"");
+    metrics_exporter_.start(&metrics_, path, interval_ms);
+}
+
+void HV_Camera::stopMetricsExport() {
+    metrics_exporter_.stop();
+}
+
+void HV_Camera::registerMetrics() {
+    MetricIds& ids = metric_ids_;
+    ids.usb_transfers = metrics_.registerCounter("hv_camera_usb_transfers_total",
+        "Completed USB event transfers");
+    ids.usb_stream_failures = metrics_.registerCounter("hv_camera_usb_stream_failures_total",
+        "Async USB transfer streams stopped by device removal or persistent endpoint errors");
+    ids.usb_transfer_errors = metrics_.registerCounter("hv_camera_usb_transfer_errors_total",
+        "Failed or timed out USB event transfers");
+    ids.busy_poll_us = metrics_.registerCounter("hv_camera_busy_poll_microseconds_total",
+        "Time the processing thread spent spinning for data in low latency mode");
+    ids.usb_bytes = metrics_.registerCounter("hv_camera_usb_bytes_total",
+        "Bytes received on the event endpoint");
+    ids.incomplete_buffers = metrics_.registerCounter("hv_camera_incomplete_buffers_total",
+        "Event transfers shorter than one subframe group (still parsed)");
+    ids.dropped_newest = metrics_.registerCounter("hv_camera_dropped_newest_buffers_total",
+        "Received buffers dropped because no free buffer was available");
+    ids.dropped_oldest = metrics_.registerCounter("hv_camera_dropped_oldest_buffers_total",
+        "Queued buffers dropped by the DropOldest policy");
+    ids.decimated_groups = metrics_.registerCounter("hv_camera_decimated_groups_total",
+        "Subframe groups skipped by the Decimate policy");
+    ids.processed_buffers = metrics_.registerCounter("hv_camera_processed_buffers_total",
+        "Event buffers taken from the queue by the processing thread");
+    ids.decoded_groups = metrics_.registerCounter("hv_camera_decoded_groups_total",
+        "Decoded subframe groups");
+    ids.invalid_subframes = metrics_.registerCounter("hv_camera_invalid_subframe_headers_total",
+        "Subframe header checks that failed and triggered a resync");
+    ids.lost_subframes = metrics_.registerCounter("hv_camera_lost_subframes_total",
+        "Subframes missing from the stream, inferred from subframe id gaps");
+    ids.discarded_subframes = metrics_.registerCounter("hv_camera_discarded_subframes_total",
+        "Valid subframes not decoded because their group was incomplete");
+    ids.skipped_bytes = metrics_.registerCounter("hv_camera_resync_skipped_bytes_total",
+        "Bytes skipped while searching for the next subframe header");
+    ids.timestamp_discontinuities = metrics_.registerCounter("hv_camera_timestamp_discontinuities_total",
+        "Subframe timestamps that went backwards or jumped by more than 1 s");
+    ids.image_frames = metrics_.registerCounter("hv_camera_image_frames_total",
+        "Converted APS frames");
+    ids.image_dropped_frames = metrics_.registerCounter("hv_camera_image_dropped_frames_total",
+        "APS frames replaced before the image thread picked them up");
+    ids.image_incomplete_pairs = metrics_.registerCounter("hv_camera_image_incomplete_pairs_total",
+        "APS frames delivered with an incomplete event slice");
+    ids.queued_buffers = metrics_.registerGauge("hv_camera_event_queue_buffers",
+        "Event buffers waiting to be decoded");
+    ids.transfer_bytes = metrics_.registerGauge("hv_camera_event_transfer_bytes",
+        "Size of one USB event transfer");
+    ids.free_buffers = metrics_.registerGauge("hv_camera_event_free_buffers",
+        "Event buffers available to the USB receiver");
+    ids.clock_drift = metrics_.registerGauge("hv_camera_clock_drift_ppb",
+        "Estimated device clock frequency error relative to the host (parts per billion)");
+    ids.clock_jitter = metrics_.registerGauge("hv_camera_clock_jitter_nanoseconds",
+        "Residual of the device-to-host clock fit, mostly USB delivery jitter");
+    ids.usb_transfer_time = metrics_.registerHistogram("hv_camera_usb_transfer_seconds",
+        "USB event transfer time (sync: bulk call duration, async: interval between completions)");
+    ids.decode_subframe_time = metrics_.registerHistogram("hv_camera_decode_subframe_seconds",
+        "Decode time per subframe");
+    ids.block_wait_time = metrics_.registerHistogram("hv_camera_block_wait_seconds",
+        "USB receiver wait for a free buffer under the Block policy");
+    ids.image_convert_time = metrics_.registerHistogram("hv_camera_image_convert_seconds",
+        "NV12 to BGR conversion time per APS frame");
+    ids.queue_wait_time = metrics_.registerHistogram("hv_camera_event_queue_wait_seconds",
+        "Time from USB transfer completion to the start of decoding, per subframe group");
+    ids.decode_group_time = metrics_.registerHistogram("hv_camera_event_decode_seconds",
+        "Decode time per subframe group");
+    ids.reorder_wait_time = metrics_.registerHistogram("hv_camera_event_reorder_wait_seconds",
+        "Time from end of decoding to the start of the callback (waiting for earlier groups)");
+    ids.callback_time = metrics_.registerHistogram("hv_camera_event_callback_seconds",
+        "Time spent in user callbacks and subscriber hand-off, per subframe group");
+    ids.end_to_end_time = metrics_.registerHistogram("hv_camera_event_latency_seconds",
+        "Time from USB transfer completion to callback return, per subframe group");
+    
+    usb_metrics_ = metrics_.acquireShard();
+    processing_metrics_ = metrics_.acquireShard();
+    image_metrics_ = metrics_.acquireShard();
+    delivery_metrics_ = metrics_.acquireShard();
+}
+
+void HV_Camera::stopSubscriber(const std::shared_ptr<EventSubscriber>& subscriber) {
+    {
+        std::lock_guard<std::mutex> lock(subscriber->mutex);
+        subscriber->running = false;
+    }
+    subscriber->data_cv.notify_all();
+    subscriber->space_cv.notify_all();
+    
+    // 在自己的回调中取消订阅时不能join自身
+    if (subscriber->thread.get_id() == std::this_thread::get_id()) {
+        subscriber->thread.detach();
+    } else if (subscriber->thread.joinable()) {
+        subscriber->thread.join();
+    }
+}
+
+void HV_Camera::subscriberThreadFunc(std::shared_ptr<EventSubscriber> subscriber) {
+    while (true) {
+        EventBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(subscriber->mutex);
+            subscriber->data_cv.wait(lock, [&subscriber] {
+                return !subscriber->queue.empty() || !subscriber->running;
+            });
+            
+            // 退出前处理完已排队的批次
+            if (subscriber->queue.empty()) {
+                break;
+            }
+            batch = std::move(subscriber->queue.front());
+            subscriber->queue.pop_front();
+        }
+        subscriber->space_cv.notify_one();
+        
+        subscriber->callback(*batch);
+        batch.reset();
         
-        // 性能优化：降低调试输出频率，从每100次改为每1000次
-        if (process_count % 1000 == 0 && process_count > 0) {
-            std::cout << "[HV_Camera] Processed " << process_count 
-                     << " buffers, current queue size: " << current_queue_size 
-                     << ", batch size: " << batch_buffers.size() << std::endl;
+        std::lock_guard<std::mutex> lock(subscriber->mutex);
+        subscriber->delivered++;
+    }
+}
+
+void HV_Camera::startDecodeWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(decode_task_mutex_);
+        decode_tasks_.clear();
+        decode_next_seq_ = 0;
+        decode_in_flight_ = 0;
+        decode_workers_running_ = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(reorder_mutex_);
+        reorder_results_.clear();
+        reorder_next_seq_ = 0;
+        reorder_delivering_ = false;
+    }
+    
+    if (decode_threads_ <= 1) {
+        return;
+    }
+    while (decode_metrics_.size() < decode_threads_) {
+        decode_metrics_.push_back(metrics_.acquireShard());
+    }
+    for (size_t i = 0; i < decode_threads_; ++i) {
+        decode_workers_.emplace_back(&HV_Camera::decodeWorkerFunc, this, i);
+    }
+    std::cout << "Started " << decode_threads_ << " event decode threads" << std::endl;
+}
+
+void HV_Camera::stopDecodeWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(decode_task_mutex_);
+        decode_workers_running_ = false;
+    }
+    decode_task_cv_.notify_all();
+    decode_space_cv_.notify_all();
+    
+    for (auto& worker : decode_workers_) {
+        if (worker.joinable()) {
+            worker.join();
         }
     }
+    decode_workers_.clear();
 }
 
-void HV_Camera::processEventData(uint8_t* dataPtr) {
-    uint64_t* pixelBufferPtr = reinterpret_cast<uint64_t*>(dataPtr);
+bool HV_Camera::reserveDecodeSeq(std::unique_lock<std::mutex>& lock, uint64_t& seq) {
+    const size_t max_in_flight = decode_threads_ * MAX_DECODE_TASKS_PER_THREAD;
     
-    // 性能优化：重用预分配的事件数组，避免频繁内存分配
-    reusable_event_array_.clear(); // 清空但保留容量
+    // 限制未回调的子帧组数量，避免重排缓存无限增长
+    decode_space_cv_.wait(lock, [this, max_in_flight] {
+        return decode_in_flight_ < max_in_flight || !decode_workers_running_;
+    });
+    if (!decode_workers_running_) {
+        return false;
+    }
+    seq = decode_next_seq_++;
+    ++decode_in_flight_;
+    return true;
+}
+
+void HV_Camera::dispatchEventGroup(uint32_t slab, size_t offset, const EventBatchTime& time) {
+    {
+        std::unique_lock<std::mutex> lock(decode_task_mutex_);
+        uint64_t seq;
+        if (!reserveDecodeSeq(lock, seq)) {
+            return;
+        }
+        event_slabs_[slab].pending_groups.fetch_add(1, std::memory_order_relaxed);
+        decode_tasks_.push_back(DecodeTask{seq, slab, offset, time});
+    }
+    decode_task_cv_.notify_one();
+}
+
+void HV_Camera::decodeEventGroupInOrder(const uint8_t* dataPtr, const EventBatchTime& time) {
+    uint64_t seq;
+    {
+        std::unique_lock<std::mutex> lock(decode_task_mutex_);
+        if (!reserveDecodeSeq(lock, seq)) {
+            return;
+        }
+    }
+    DecodedGroup group = acquireDecodedGroup();
+    group.time = time;
+    decodeTimed(dataPtr, group, processing_metrics_);
+    processing_metrics_.add(metric_ids_.decoded_groups);
+    deliverInOrder(seq, std::move(group));
+}
+
+HV_Camera::DecodedGroup HV_Camera::acquireDecodedGroup() {
+    // 复用已回调完成的事件数组
+    DecodedGroup group;
+    {
+        std::lock_guard<std::mutex> lock(reorder_mutex_);
+        if (!reorder_pool_.empty()) {
+            group = std::move(reorder_pool_.back());
+            reorder_pool_.pop_back();
+        }
+    }
+    if (group.events.capacity() == 0 && event_output_ == EventOutput::Events) {
+        group.events.reserve(ESTIMATED_EVENTS_PER_FRAME);
+    }
+    return group;
+}
+
+void HV_Camera::decodeWorkerFunc(size_t index) {
+    applyThreadPlacement(ThreadRole::Decode, "hv-decode-" + std::to_string(index));
+    const MetricsShard metrics = decode_metrics_[index];
     
-    for (int sub = 0; sub < 4; sub++) {
-        uint64_t timestamp = 0;
-        uint64_t subframe = 0;
+    while (true) {
+        DecodeTask task;
+        {
+            std::unique_lock<std::mutex> lock(decode_task_mutex_);
+            decode_task_cv_.wait(lock, [this] {
+                return !decode_tasks_.empty() || !decode_workers_running_;
+            });
+            
+            // 退出前处理完已分发的任务，保证序号连续
+            if (decode_tasks_.empty()) {
+                break;
+            }
+            task = std::move(decode_tasks_.front());
+            decode_tasks_.pop_front();
+        }
         
-        uint64_t buffer = pixelBufferPtr[0];
-        timestamp = (buffer >> 24) & 0xFFFFFFFFFF;
-        uint64_t header_vec = buffer & 0xFFFFFF;
-        if (header_vec != 0xFFFF) {
-            std::cerr << "bits process error" << std::endl;
+        DecodedGroup group = acquireDecodedGroup();
+        group.time = task.time;
+        decodeTimed(event_slabs_[task.slab].data + task.offset, group, metrics);
+        metrics.add(metric_ids_.decoded_groups);
+        if (event_slabs_[task.slab].pending_groups.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            releaseEventSlab(task.slab);
         }
         
-        buffer = pixelBufferPtr[1];
-        subframe = (buffer >> 44) & 0xF;
-        timestamp /= 200;
+        deliverInOrder(task.seq, std::move(group));
+    }
+}
 
-        pixelBufferPtr += 2;
-        int x = 0, y = 0, x_offset = 0, y_offset = 0;
-        
-        switch (subframe) {
-        case 0:
-            x_offset = 0;
-            y_offset = 0;
-            break;
-        case 1:
-            x_offset = 1;
-            y_offset = 0;
-            break;
-        case 2:
-            x_offset = 0;
-            y_offset = 1;
-            break;
-        case 3:
-            x_offset = 1;
-            y_offset = 1;
+void HV_Camera::deliverInOrder(uint64_t seq, DecodedGroup&& group) {
+    std::unique_lock<std::mutex> lock(reorder_mutex_);
+    reorder_results_.emplace(seq, std::move(group));
+    
+    // 同一时刻只有一个线程负责回调，保证回调串行且按序号顺序执行
+    if (reorder_delivering_) {
+        return;
+    }
+    reorder_delivering_ = true;
+    
+    while (true) {
+        auto it = reorder_results_.find(reorder_next_seq_);
+        if (it == reorder_results_.end()) {
             break;
         }
+        DecodedGroup ready = std::move(it->second);
+        reorder_results_.erase(it);
+        ++reorder_next_seq_;
+        lock.unlock();
         
-        y = y_offset;
-
-        for (int i = 0; i < HV_EVS_SUB_HEIGHT; i++) {
-            x = x_offset;
-            for (int j = 0; j < HV_EVS_SUB_WIDTH / 32; j++) {
-                buffer = pixelBufferPtr[j];
-                for (int k = 0; k < 64; k += 2) {
-                    uint64_t pix = (buffer >> k) & 0x3;
-                    if (x >= HV_EVS_WIDTH || y >= HV_EVS_HEIGHT) {
-                        x += 2;
-                        continue;
-                    }
-                    
-                    if (pix > 0) {
-                        // 性能优化：使用emplace_back直接构造，避免临时对象
-                        reusable_event_array_.emplace_back(
-                            static_cast<unsigned short>(x), 
-                            static_cast<unsigned short>(y), 
-                            static_cast<short>(pix >> 1), 
-                            static_cast<Metavision::timestamp>(timestamp)
-                        );
-                    }
-                    x += 2;
-                }
-            }
-            pixelBufferPtr += HV_EVS_SUB_WIDTH / 32;
-            y += 2;
+        deliverEventGroup(ready);
+        
+        {
+            std::lock_guard<std::mutex> task_lock(decode_task_mutex_);
+            --decode_in_flight_;
         }
-        pixelBufferPtr += (HV_SUB_FULL_BYTE_SIZE - HV_SUB_VALID_BYTE_SIZE) / 8;
+        decode_space_cv_.notify_one();
+        
+        lock.lock();
+        reorder_pool_.push_back(std::move(ready));
     }
     
-    // 处理完所有子帧后，一次性发送所有事件
-    if (event_callback_ && !reusable_event_array_.empty()) {
-        event_callback_(reusable_event_array_);
-    }
+    reorder_delivering_ = false;
 }
 
 } // namespace hv
@@ -1,10 +1,13 @@
 #include "hv_evs_recorder.h"
 #include "hv_usb_device.h"
+#include "hv_subframe_decoder.h"
+#include "hv_spsc_ring.h"
 #include <iostream>
 #include <fstream>
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <cstdio>
 #include <iomanip>
 #include <algorithm>
 
@@ -19,19 +22,20 @@ struct TimestampMetadata {
 
 namespace hv {
 
-// BufferPool 实现（复用原有实现）
+// USB接收缓冲池
+// 空闲缓冲经无锁单生产者单消费者环形队列流转：只有录制线程取出（acquire），只有写入线程归还（release）；
+// 录制线程丢弃数据或传输失败时保留手中的缓冲重复使用，不归还，因此两端各只有一个线程
 class BufferPool {
 public:
-    BufferPool(size_t buffer_size, size_t pool_size) 
-        : buffer_size_(buffer_size) {
+    BufferPool(size_t buffer_size, size_t pool_size)
+        : buffer_size_(buffer_size), free_buffers_(pool_size), consumer_waiting_(false) {
         buffers_.reserve(pool_size);
         
         // 预分配所有缓冲区
         for (size_t i = 0; i < pool_size; ++i) {
-            unsigned char* buffer = new unsigned char[buffer_size_];
-            buffers_.push_back(buffer);
-            available_buffers_.push(buffer);
+            buffers_.push_back(new unsigned char[buffer_size_]);
         }
+        reset();
     }
 
     ~BufferPool() {
@@ -40,40 +44,66 @@ public:
         }
     }
 
-    unsigned char* acquire() {
-        std::lock_guard<std::mutex> lock(pool_mutex_);
-        if (available_buffers_.empty()) {
-            // 如果池中没有可用缓冲区，创建新的（应该避免这种情况）
-            return new unsigned char[buffer_size_];
+    /**
+     * 取出一个空闲缓冲（录制线程），缓冲池空时等待写入线程归还
+     * @param running 等待期间变为false时放弃
+     * @param waited 输出：是否发生了等待
+     * @return 缓冲，放弃时返回nullptr
+     */
+    unsigned char* acquire(const std::atomic<bool>& running, bool& waited) {
+        unsigned char* buffer;
+        waited = false;
+        if (free_buffers_.pop(buffer)) {
+            return buffer;
         }
         
-        unsigned char* buffer = available_buffers_.front();
-        available_buffers_.pop();
-        return buffer;
+        waited = true;
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        consumer_waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (running) {
+            if (free_buffers_.pop(buffer)) {
+                consumer_waiting_.store(false, std::memory_order_relaxed);
+                return buffer;
+            }
+            wait_cv_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+        return nullptr;
     }
 
+    /**
+     * 归还缓冲（写入线程）
+     */
     void release(unsigned char* buffer) {
-        if (!buffer) return;
+        free_buffers_.push(buffer);
         
-        std::lock_guard<std::mutex> lock(pool_mutex_);
-        
-        // 检查是否是池中的缓冲区
-        bool is_pool_buffer = false;
-        for (auto* pool_buffer : buffers_) {
-            if (pool_buffer == buffer) {
-                is_pool_buffer = true;
-                break;
-            }
+        // 录制线程正在等待空闲缓冲时才需要通知
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            wait_cv_.notify_one();
         }
-        
-        if (is_pool_buffer) {
-            available_buffers_.push(buffer);
-        } else {
-            // 如果不是池中的缓冲区，直接删除
-            delete[] buffer;
+    }
+
+    /**
+     * 所有缓冲重新放回空闲队列，仅在录制线程和写入线程都未运行时调用
+     */
+    void reset() {
+        free_buffers_.reset();
+        for (auto* buffer : buffers_) {
+            free_buffers_.push(buffer);
         }
     }
 
+    size_t available() const {
+        return free_buffers_.size();
+    }
+
+    size_t capacity() const {
+        return buffers_.size();
+    }
+
     void warmup() {
         // 预热：访问所有缓冲区的内存页面
         for (auto* buffer : buffers_) {
@@ -88,19 +118,30 @@ public:
 private:
     size_t buffer_size_;
     std::vector<unsigned char*> buffers_;
-    std::queue<unsigned char*> available_buffers_;
-    std::mutex pool_mutex_;
+    SPSCRing<unsigned char*> free_buffers_;
+    std::atomic<bool> consumer_waiting_;
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
 };
 
 HV_EVS_Recorder::HV_EVS_Recorder(uint16_t vendor_id, uint16_t product_id)
-    : usb_device_(std::make_unique<USBDevice>(vendor_id, product_id)),
+    : HV_EVS_Recorder(std::unique_ptr<USBTransport>(new LibusbTransport(vendor_id, product_id, DeviceSelector()))) {
+}
+
+HV_EVS_Recorder::HV_EVS_Recorder(std::unique_ptr<USBTransport> transport)
+    : usb_device_(std::make_unique<USBDevice>(std::move(transport))),
       event_endpoint_(0),
       recording_(false),
       writer_running_(false),
-      timestamp_analysis_enabled_(false) {
+      timestamp_analysis_enabled_(false),
+      buffer_count_(DEFAULT_BUFFER_COUNT),
+      write_backend_(RecordWriteBackend::Auto),
+      write_failed_(false),
+      flight_mode_(false),
+      trigger_requested_(false) {
     
-    // 初始化USB缓冲池：预分配8个缓冲区用于高速数据传输
-    usb_buffer_pool_ = std::make_unique<BufferPool>(HV_BUF_LEN, 8);
+    // 初始化USB缓冲池：缓冲直接经写入队列交给写入线程，数量即写入队列的最大深度
+    usb_buffer_pool_ = std::make_unique<BufferPool>(HV_BUF_LEN, buffer_count_);
     
     // 预热内存池
     usb_buffer_pool_->warmup();
@@ -111,6 +152,8 @@ HV_EVS_Recorder::HV_EVS_Recorder(uint16_t vendor_id, uint16_t product_id)
     stats_.total_transfer_time.store(0);
     stats_.max_transfer_time.store(0);
     stats_.min_transfer_time.store(UINT64_MAX);
+
+    registerMetrics();
 }
 
 HV_EVS_Recorder::~HV_EVS_Recorder() {
@@ -153,14 +196,60 @@ bool HV_EVS_Recorder::startRecording(const std::string& filename, bool enable_ti
         return false;
     }
 
-    // 打开输出文件
+    // 打开输出文件；分段时第一个文件为第0段。触发录制时预先创建第一个片段文件，
+    // 每个片段结束时由写入线程rotate()到下一个，暂存块和io_uring在整个录制期间只分配一次
     output_filename_ = filename;
-    output_file_.open(output_filename_, std::ios::binary | std::ios::out);
-    if (!output_file_.is_open()) {
-        std::cerr << "Failed to open output file: " << output_filename_ << std::endl;
-        return false;
+    flight_mode_ = flight_options_.enabled;
+    flight_ = FlightState();
+    trigger_requested_ = false;
+    write_failed_ = false;
+    {
+        std::lock_guard<std::mutex> lock(write_error_mutex_);
+        write_error_.clear();
+    }
+    {
+        RecordWriterOptions options = write_options_;
+        if (segment_options_.preallocate_bytes > 0) {
+            options.preallocate_bytes = segment_options_.preallocate_bytes;
+        } else if (segment_options_.max_bytes > 0 && !flight_mode_) {
+            options.preallocate_bytes = segment_options_.max_bytes;
+        }
+        beginSegment(0);
+        if (!output_writer_.open(segment_.filename, options)) {
+            std::cerr << "Failed to open output file: " << segment_.filename << " (" << output_writer_.lastError() << ")" << std::endl;
+            return false;
+        }
+        segment_.opened = true;
+        write_backend_ = output_writer_.backend();
+        std::cout << "[Main] 写入后端: " << recordWriteBackendName(output_writer_.backend()) << std::endl;
+        if (!output_writer_.lastError().empty()) {
+            std::cout << "[Main] " << output_writer_.lastError() << std::endl;
+        }
+    }
+    if (flight_mode_ || segment_options_.enabled()) {
+        size_t dot_pos = output_filename_.find_last_of('.');
+        manifest_filename_ = (dot_pos != std::string::npos ? output_filename_.substr(0, dot_pos) : output_filename_) +
+                             (flight_mode_ ? "_triggers.csv" : "_segments.csv");
+        manifest_file_.open(manifest_filename_, std::ios::trunc);
+        if (manifest_file_.is_open()) {
+            manifest_file_ << "segment,file,bytes,buffers,first_timestamp_us,last_timestamp_us\n";
+            manifest_file_.flush();
+        } else {
+            std::cerr << "[Main] 无法创建分段清单: " << manifest_filename_ << std::endl;
+        }
     }
 
+    // 按配置重建缓冲池，上次录制结束时录制线程手中的缓冲一并收回
+    // 触发录制时内存环中的缓冲也来自缓冲池，另加ring_buffers个
+    const size_t pool_buffers = buffer_count_ + (flight_mode_ ? flight_options_.ring_buffers : 0);
+    if (usb_buffer_pool_->capacity() != pool_buffers) {
+        usb_buffer_pool_ = std::make_unique<BufferPool>(HV_BUF_LEN, pool_buffers);
+        usb_buffer_pool_->warmup();
+    } else {
+        usb_buffer_pool_->reset();
+    }
+    metrics_.setGauge(metric_ids_.free_buffers, static_cast<int64_t>(usb_buffer_pool_->available()));
+
     // 重置统计信息
     stats_.total_bytes = 0;
     stats_.total_frames = 0;
@@ -184,15 +273,21 @@ bool HV_EVS_Recorder::startRecording(const std::string& filename, bool enable_ti
     recording_thread_ = std::thread(&HV_EVS_Recorder::recordingThreadFunc, this);
     std::cout << "[Main] 录制线程已启动" << std::endl;
 
-    std::cout << "[Main] 开始录制到文件: " << output_filename_ << std::endl;
+    if (flight_mode_) {
+        std::cout << "[Main] 触发录制已启用，保留触发前 " << flight_options_.pre_trigger_seconds << " 秒（最多 "
+                  << flight_options_.ring_buffers << " 个缓冲），触发后写入 " << flight_options_.post_trigger_seconds
+                  << " 秒，片段清单: " << manifest_filename_ << std::endl;
+    } else {
+        std::cout << "[Main] 开始录制到文件: " << output_filename_ << std::endl;
+    }
     std::cout << "[Main] 队列健康监控已启用，将实时显示调试信息" << std::endl;
     return true;
 }
 
-void HV_EVS_Recorder::stopRecording() {
+bool HV_EVS_Recorder::stopRecording() {
     if (!recording_) {
         std::cout << "[Main] 录制未在进行中，无需停止" << std::endl;
-        return;
+        return !write_failed_;
     }
 
     std::cout << "[Main] 开始停止录制..." << std::endl;
@@ -224,13 +319,29 @@ void HV_EVS_Recorder::stopRecording() {
         }
     }
 
-    // 关闭文件
-    {
-        std::lock_guard<std::mutex> lock(file_mutex_);
-        if (output_file_.is_open()) {
-            output_file_.close();
-            std::cout << "[Main] 输出文件已关闭" << std::endl;
+    // 写出暂存块中剩余的数据，等待在途写请求完成后关闭文件（写入线程已退出）
+    // 切换分段失败后文件已关闭，同样要释放暂存块和io_uring
+    const bool was_open = output_writer_.isOpen();
+    if (!output_writer_.close()) {
+        writer_metrics_.add(metric_ids_.write_errors);
+        reportWriteError("关闭输出文件失败: " + output_writer_.lastError());
+    } else if (was_open) {
+        std::cout << "[Main] 输出文件已关闭" << std::endl;
+    }
+    
+    // 最后一段写入清单（触发录制的片段由写入线程在退出前写入清单；未能创建的段不写入）
+    if (flight_mode_) {
+        std::cout << "[Main] 共写入 " << flight_.next_clip << " 个触发片段，清单: " << manifest_filename_ << std::endl;
+    } else if (segment_options_.enabled()) {
+        if (segment_.opened) {
+            writeManifestEntry();
+            writer_metrics_.add(metric_ids_.segments);
         }
+        std::cout << "[Main] 共 " << (segment_.index + (segment_.opened ? 1 : 0)) << " 个分段，清单: "
+                  << manifest_filename_ << std::endl;
+    }
+    if (manifest_file_.is_open()) {
+        manifest_file_.close();
     }
     
     // 关闭时间戳文件
@@ -239,8 +350,11 @@ void HV_EVS_Recorder::stopRecording() {
     }
 
     // 输出最终统计信息
+    if (write_failed_) {
+        std::cerr << "[Main] 录制结束，但数据未能全部写入: " << getWriteError() << std::endl;
+    }
     double total_mb = (double)stats_.total_bytes / (1024 * 1024);
-    std::cout << "[Main] 录制完成! 总字节数: " << stats_.total_bytes 
+    std::cout << (write_failed_ ? "[Main] 录制结束。总字节数: " : "[Main] 录制完成! 总字节数: ") << stats_.total_bytes 
               << " (" << std::fixed << std::setprecision(2) << total_mb << " MB)" 
               << ", 总帧数: " << stats_.total_frames << std::endl;
     
@@ -250,101 +364,261 @@ void HV_EVS_Recorder::stopRecording() {
                   << ", 最小: " << stats_.min_transfer_time << "μs" 
                   << ", 最大: " << stats_.max_transfer_time << "μs" << std::endl;
     }
+    return !write_failed_;
 }
 
 bool HV_EVS_Recorder::isRecording() const {
     return recording_;
 }
 
+bool HV_EVS_Recorder::hasWriteError() const {
+    return write_failed_;
+}
+
+std::string HV_EVS_Recorder::getWriteError() const {
+    std::lock_guard<std::mutex> lock(write_error_mutex_);
+    return write_error_;
+}
+
 void HV_EVS_Recorder::getRecordingStats(uint64_t& total_bytes, uint64_t& total_frames, uint64_t& avg_transfer_time) const {
     total_bytes = stats_.total_bytes;
     total_frames = stats_.total_frames;
     avg_transfer_time = (total_frames > 0) ? (stats_.total_transfer_time / total_frames) : 0;
 }
 
+bool HV_EVS_Recorder::setWriteOptions(const RecordWriterOptions& options) {
+    if (recording_ || writer_running_) {
+        std::cerr << "Cannot change write options while recording" << std::endl;
+        return false;
+    }
+    write_options_ = options;
+    return true;
+}
+
+RecordWriteBackend HV_EVS_Recorder::getWriteBackend() const {
+    return write_backend_;
+}
+
+bool HV_EVS_Recorder::setSegmentOptions(const RecordSegmentOptions& options) {
+    if (recording_ || writer_running_) {
+        std::cerr << "Cannot change segment options while recording" << std::endl;
+        return false;
+    }
+    segment_options_ = options;
+    return true;
+}
+
+bool HV_EVS_Recorder::setFlightRecorderOptions(const FlightRecorderOptions& options) {
+    if (recording_ || writer_running_) {
+        std::cerr << "Cannot change flight recorder options while recording" << std::endl;
+        return false;
+    }
+    if (options.enabled && (options.ring_buffers == 0 || options.pre_trigger_seconds < 0 || options.post_trigger_seconds < 0)) {
+        std::cerr << "Invalid flight recorder options" << std::endl;
+        return false;
+    }
+    flight_options_ = options;
+    return true;
+}
+
+bool HV_EVS_Recorder::trigger() {
+    if (!recording_ || !flight_mode_) {
+        return false;
+    }
+    {
+        // 在队列锁内置位，写入线程不会错过唤醒
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        trigger_requested_ = true;
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+bool HV_EVS_Recorder::setBufferCount(size_t buffers) {
+    if (recording_ || writer_running_) {
+        std::cerr << "Cannot change buffer count while recording" << std::endl;
+        return false;
+    }
+    if (buffers < 2) {
+        std::cerr << "HV_EVS_Recorder needs at least 2 buffers" << std::endl;
+        return false;
+    }
+    buffer_count_ = buffers;
+    return true;
+}
+
+bool HV_EVS_Recorder::setThreadPlacement(ThreadRole role, const ThreadPlacement& placement) {
+    if (role != ThreadRole::UsbReceive && role != ThreadRole::Writer) {
+        std::cerr << "HV_EVS_Recorder only has UsbReceive and Writer threads" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    thread_placements_[role] = placement;
+    return true;
+}
+
+std::vector<AppliedThreadPlacement> HV_EVS_Recorder::getThreadPlacementReport() const {
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    std::vector<AppliedThreadPlacement> report;
+    for (const auto& entry : applied_placements_) {
+        report.push_back(entry.second);
+    }
+    return report;
+}
+
+void HV_EVS_Recorder::applyThreadPlacement(ThreadRole role, const std::string& name) {
+    ThreadPlacement placement;
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        auto it = thread_placements_.find(role);
+        if (it != thread_placements_.end()) {
+            placement = it->second;
+        }
+    }
+
+    AppliedThreadPlacement applied = hv::applyThreadPlacement(name, placement);
+    if (!applied.error.empty()) {
+        std::cerr << "[Main] 线程 " << name << " 放置配置未完全生效: " << applied.error << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    applied_placements_[name] = applied;
+}
+
+MetricsSnapshot HV_EVS_Recorder::getMetricsSnapshot() const {
+    return metrics_.snapshot();
+}
+
+void HV_EVS_Recorder::startMetricsExport(const std::string& path, unsigned interval_ms) {
+    metrics_exporter_.start(&metrics_, path, interval_ms);
+}
+
+void HV_EVS_Recorder::stopMetricsExport() {
+    metrics_exporter_.stop();
+}
+
+void HV_EVS_Recorder::registerMetrics() {
+    MetricIds& ids = metric_ids_;
+    ids.usb_transfers = metrics_.registerCounter("hv_recorder_usb_transfers_total",
+        "Completed USB event transfers");
+    ids.usb_transfer_errors = metrics_.registerCounter("hv_recorder_usb_transfer_errors_total",
+        "Failed or timed out USB event transfers");
+    ids.usb_bytes = metrics_.registerCounter("hv_recorder_usb_bytes_total",
+        "Bytes received on the event endpoint");
+    ids.pool_exhausted = metrics_.registerCounter("hv_recorder_pool_exhausted_total",
+        "Times the receive thread found no free buffer and waited for the writer to return one");
+    ids.written_buffers = metrics_.registerCounter("hv_recorder_written_buffers_total",
+        "Buffers written to the output file");
+    ids.written_bytes = metrics_.registerCounter("hv_recorder_written_bytes_total",
+        "Bytes written to the output file");
+    ids.write_stalls = metrics_.registerCounter("hv_recorder_write_stalls_total",
+        "Writes that took longer than 10 ms");
+    ids.write_submissions = metrics_.registerCounter("hv_recorder_write_submissions_total",
+        "Aligned chunks submitted to the file (several buffers per submission)");
+    ids.write_errors = metrics_.registerCounter("hv_recorder_write_errors_total",
+        "Buffers that could not be written because the file writer failed");
+    ids.segments = metrics_.registerCounter("hv_recorder_segments_total",
+        "Recording segments completed and listed in the manifest");
+    ids.triggers = metrics_.registerCounter("hv_recorder_triggers_total",
+        "Flight recorder triggers from trigger() or the event-rate threshold, including ones that extended a clip");
+    ids.trigger_clips = metrics_.registerCounter("hv_recorder_trigger_clips_total",
+        "Flight recorder clips written and listed in the manifest");
+    ids.queued_buffers = metrics_.registerGauge("hv_recorder_write_queue_buffers",
+        "Buffers waiting in the write queue");
+    ids.free_buffers = metrics_.registerGauge("hv_recorder_free_buffers",
+        "Receive buffers neither queued nor being written");
+    ids.flight_ring_buffers = metrics_.registerGauge("hv_recorder_flight_ring_buffers",
+        "Buffers held in the flight recorder ring");
+    ids.event_rate = metrics_.registerGauge("hv_recorder_event_rate",
+        "Events per second measured for the flight recorder rate trigger");
+    ids.usb_transfer_time = metrics_.registerHistogram("hv_recorder_usb_transfer_seconds",
+        "USB bulk transfer duration");
+    ids.pool_wait_time = metrics_.registerHistogram("hv_recorder_pool_wait_seconds",
+        "Time the receive thread waited for a free buffer while the pool was exhausted");
+    ids.write_time = metrics_.registerHistogram("hv_recorder_write_seconds",
+        "Duration of handing one buffer to the file writer, including any wait for a free chunk");
+    ids.segment_switch_time = metrics_.registerHistogram("hv_recorder_segment_switch_seconds",
+        "Time the writer spent finishing one segment and opening the next");
+
+    usb_metrics_ = metrics_.acquireShard();
+    writer_metrics_ = metrics_.acquireShard();
+}
+
 void HV_EVS_Recorder::recordingThreadFunc() {
+    applyThreadPlacement(ThreadRole::UsbReceive, "hv-rec-usb");
+    
     int frame_drop_count = 0;
     uint64_t failed_transfers = 0;
     uint64_t successful_transfers = 0;
-    uint64_t queue_full_warnings = 0;
+    uint64_t pool_exhausted_count = 0;
+    bool exhausted_reported = false;
+    unsigned char* buffer = nullptr;     // 手中的接收缓冲，入队后交给写入线程
     auto thread_start_time = std::chrono::high_resolution_clock::now();
     
     std::cout << "[Recording Thread] 录制线程已启动" << std::endl;
     
-    // 缓存预热：进行几次空跑来预热缓存和分支预测器
-    if (frame_drop_count == 0) {
-        std::cout << "[Recording Thread] 正在进行缓存预热..." << std::endl;
-        for (int warmup = 0; warmup < 3; ++warmup) {
-            unsigned char* warmup_buffer = usb_buffer_pool_->acquire();
-            // 模拟数据处理来预热缓存
-            std::memset(warmup_buffer, 0x55, std::min(size_t(HV_BUF_LEN), size_t(65536)));
-            usb_buffer_pool_->release(warmup_buffer);
-        }
-        std::cout << "[Recording Thread] 缓存预热完成" << std::endl;
-    }
-    
     while (recording_ && isOpen()) {
-        // 从内存池获取缓冲区
-        unsigned char* buffer = usb_buffer_pool_->acquire();
+        // 从内存池获取缓冲区；丢弃数据或传输失败时继续使用手中的缓冲区
+        if (!buffer) {
+            bool waited;
+            auto wait_start = std::chrono::steady_clock::now();
+            buffer = usb_buffer_pool_->acquire(recording_, waited);
+            if (waited) {
+                // 所有缓冲都在写入队列中：写入线程跟不上，接收暂停直到有缓冲归还
+                pool_exhausted_count++;
+                usb_metrics_.add(metric_ids_.pool_exhausted);
+                usb_metrics_.observe(metric_ids_.pool_wait_time, std::chrono::steady_clock::now() - wait_start);
+                if (!exhausted_reported) {
+                    exhausted_reported = true;
+                    std::cout << "[Recording Thread] 警告: 接收缓冲已全部排队等待写入，接收暂停等待写入线程" << std::endl;
+                }
+            } else {
+                exhausted_reported = false;
+            }
+            if (!buffer) {
+                break;
+            }
+            metrics_.setGauge(metric_ids_.free_buffers, static_cast<int64_t>(usb_buffer_pool_->available()));
+        }
         int bytes;
         
         // 开始计时USB数据传输
-        auto usb_start_time = std::chrono::high_resolution_clock::now();
+        auto usb_start_time = std::chrono::steady_clock::now();
         
         // 使用USB设备类进行数据传输
         bool success = usb_device_->bulkTransfer(event_endpoint_, buffer, HV_BUF_LEN, &bytes, 500);
         
         // 结束计时USB数据传输
-        auto usb_end_time = std::chrono::high_resolution_clock::now();
-        auto usb_duration = std::chrono::duration_cast<std::chrono::microseconds>(usb_end_time - usb_start_time);
+        auto usb_elapsed = std::chrono::steady_clock::now() - usb_start_time;
+        auto usb_duration = std::chrono::duration_cast<std::chrono::microseconds>(usb_elapsed);
+        usb_metrics_.observe(metric_ids_.usb_transfer_time, usb_elapsed);
+        usb_metrics_.add(metric_ids_.usb_transfers);
         
         if (success && bytes > 0) {
             successful_transfers++;
+            usb_metrics_.add(metric_ids_.usb_bytes, bytes);
             
             // 跳过前4帧以确保数据稳定（与hv_camera.cpp保持一致）
             if (frame_drop_count < 4) {
                 ++frame_drop_count;
                 std::cout << "[Recording Thread] 跳过第 " << frame_drop_count << " 帧 (数据稳定期)" << std::endl;
-                usb_buffer_pool_->release(buffer);
                 continue;
             }
             
-            // 检查队列大小，防止内存积压
-            size_t current_queue_size;
-            {
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                current_queue_size = write_queue_.size();
-            }
-            
-            // 如果队列过大，发出警告
-            if (current_queue_size > 100) {
-                queue_full_warnings++;
-                std::cout << "[Recording Thread] 警告: 写入队列积压严重! 当前大小: " << current_queue_size 
-                          << " (警告次数: " << queue_full_warnings << ")" << std::endl;
-                
-                // 如果队列过大，可以选择丢弃当前帧或等待
-                if (current_queue_size > 200) {
-                    std::cout << "[Recording Thread] 严重警告: 队列过载，丢弃当前帧!" << std::endl;
-                    usb_buffer_pool_->release(buffer);
-                    continue;
-                }
-            }
-            
             // 时间戳分析（如果启用）
             if (timestamp_analysis_enabled_) {
                 analyzeTimestamps(buffer, stats_.total_frames + 1);
             }
             
-            // 创建数据副本用于异步写入
-            unsigned char* data_copy = new unsigned char[bytes];
-            std::memcpy(data_copy, buffer, bytes);
-            
-            // 将数据加入写入队列
+            // 缓冲区本身加入写入队列，由写入线程写完后归还内存池
+            size_t current_queue_size;
             {
                 std::lock_guard<std::mutex> lock(queue_mutex_);
-                write_queue_.emplace(data_copy, bytes);
+                write_queue_.emplace(buffer, bytes, usb_start_time + usb_elapsed);
+                current_queue_size = write_queue_.size();
             }
             queue_cv_.notify_one();
+            buffer = nullptr;
+            metrics_.setGauge(metric_ids_.queued_buffers, static_cast<int64_t>(current_queue_size));
             
             // 更新性能统计
             stats_.total_frames++;
@@ -363,23 +637,9 @@ void HV_EVS_Recorder::recordingThreadFunc() {
                    !stats_.min_transfer_time.compare_exchange_weak(expected_min, current_time)) {
                 expected_min = stats_.min_transfer_time;
             }
-            
-            // 输出传输统计信息
-            std::cout << "[Recording Thread] Frame " << stats_.total_frames << ": USB: " << usb_duration.count() 
-                      << "μs, Bytes: " << bytes << ", Queue: " << current_queue_size;
-            
-            // 每100帧输出一次详细统计信息
-            if (stats_.total_frames % 100 == 0) {
-                uint64_t avg_transfer = stats_.total_transfer_time / stats_.total_frames;
-                double success_rate = (double)successful_transfers / (successful_transfers + failed_transfers) * 100.0;
-                std::cout << " | Avg: " << avg_transfer << "μs | Min: " << stats_.min_transfer_time 
-                          << "μs | Max: " << stats_.max_transfer_time << "μs | Total MB: " 
-                          << (stats_.total_bytes / 1024 / 1024) << " | Success Rate: " << std::fixed << std::setprecision(2) << success_rate << "%";
-            }
-            std::cout << std::endl;
         } else {
             failed_transfers++;
-            std::cout << "[Recording Thread] USB Transfer FAILED: " << usb_duration.count() << "μs (失败次数: " << failed_transfers << ")" << std::endl;
+            usb_metrics_.add(metric_ids_.usb_transfer_errors);
             
             // 连续失败过多时发出严重警告
             if (failed_transfers % 10 == 0) {
@@ -389,9 +649,6 @@ void HV_EVS_Recorder::recordingThreadFunc() {
             // 如果传输失败，等待一段时间再重试
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
-        
-        // 将缓冲区归还到内存池
-        usb_buffer_pool_->release(buffer);
     }
     
     // 输出录制线程退出统计信息
@@ -403,14 +660,16 @@ void HV_EVS_Recorder::recordingThreadFunc() {
     std::cout << "[Recording Thread] 线程退出 - 成功传输: " << successful_transfers 
               << ", 失败传输: " << failed_transfers 
               << ", 成功率: " << std::fixed << std::setprecision(2) << success_rate << "%" 
-              << ", 队列警告次数: " << queue_full_warnings 
+              << ", 缓冲耗尽次数: " << pool_exhausted_count 
               << ", 总运行时间: " << total_thread_duration.count() << "s" << std::endl;
 }
 
 void HV_EVS_Recorder::writerThreadFunc() {
-    uint64_t processed_buffers = 0;
-    uint64_t total_write_time = 0;
+    applyThreadPlacement(ThreadRole::Writer, "hv-rec-writer");
+    
+    WriterLoopStats loop_stats;
     uint64_t max_queue_size = 0;
+    const bool flight_mode = flight_mode_;
     auto thread_start_time = std::chrono::high_resolution_clock::now();
     
     std::cout << "[Writer Thread] 写入线程已启动" << std::endl;
@@ -418,15 +677,14 @@ void HV_EVS_Recorder::writerThreadFunc() {
     while (writer_running_ || !write_queue_.empty()) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
         
-        // 记录等待开始时间
-        auto wait_start_time = std::chrono::high_resolution_clock::now();
-        
-        // 等待数据或停止信号
-        queue_cv_.wait(lock, [this] { return !write_queue_.empty() || !writer_running_; });
-        
-        // 记录等待结束时间
-        auto wait_end_time = std::chrono::high_resolution_clock::now();
-        auto wait_duration = std::chrono::duration_cast<std::chrono::microseconds>(wait_end_time - wait_start_time);
+        // 等待数据或停止信号；触发录制时还要定期淘汰过期缓冲、结束片段，并响应trigger()
+        if (flight_mode) {
+            queue_cv_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+                return !write_queue_.empty() || !writer_running_ || trigger_requested_;
+            });
+        } else {
+            queue_cv_.wait(lock, [this] { return !write_queue_.empty() || !writer_running_; });
+        }
         
         // 记录当前队列大小
         size_t current_queue_size = write_queue_.size();
@@ -440,94 +698,318 @@ void HV_EVS_Recorder::writerThreadFunc() {
             break;
         }
         
-        // 输出队列状态调试信息
-        if (current_queue_size > 0) {
-            std::cout << "[Writer Thread] 队列大小: " << current_queue_size 
-                      << ", 等待时间: " << wait_duration.count() << "μs";
-            
-            // 队列过大时发出警告
-            if (current_queue_size > 50) {
-                std::cout << " [警告: 队列积压严重!]";
-            }
-            std::cout << std::endl;
-        }
-        
         // 处理队列中的所有数据
-        uint32_t batch_count = 0;
-        auto batch_start_time = std::chrono::high_resolution_clock::now();
-        
         while (!write_queue_.empty()) {
             DataBuffer data_buffer = write_queue_.front();
             write_queue_.pop();
             lock.unlock();
             
-            // 记录单次写入开始时间
-            auto write_start_time = std::chrono::high_resolution_clock::now();
-            
-            // 写入文件
-            {
-                std::lock_guard<std::mutex> file_lock(file_mutex_);
-                if (output_file_.is_open()) {
-                    output_file_.write(reinterpret_cast<const char*>(data_buffer.data), data_buffer.size);
-                    output_file_.flush(); // 确保数据立即写入磁盘
-                } else {
-                    std::cerr << "[Writer Thread] 错误: 输出文件未打开!" << std::endl;
-                }
+            if (flight_mode) {
+                flightPush(data_buffer, loop_stats);
+                lock.lock();
+                continue;
             }
             
-            // 记录单次写入结束时间
-            auto write_end_time = std::chrono::high_resolution_clock::now();
-            auto write_duration = std::chrono::duration_cast<std::chrono::microseconds>(write_end_time - write_start_time);
-            total_write_time += write_duration.count();
-            
-            // 释放数据副本
-            delete[] data_buffer.data;
-            
-            processed_buffers++;
-            batch_count++;
-            
-            // 如果单次写入时间过长，发出警告
-            if (write_duration.count() > 10000) { // 超过10ms
-                std::cout << "[Writer Thread] 警告: 写入耗时过长 " << write_duration.count() << "μs" << std::endl;
+            // 当前段已满时先切换到下一段，缓冲不跨段；切换失败后不再写入，也不再记录分段
+            if (segment_options_.enabled() && segment_.opened && segment_.buffers > 0 &&
+                segmentFull(data_buffer.size) && !rotateSegment()) {
+                reportWriteError("切换分段失败: " + output_writer_.lastError());
             }
+            if (segment_options_.enabled() && segment_.opened) {
+                trackSegment(data_buffer.data, data_buffer.size);
+            }
+            
+            writeBuffer(data_buffer, loop_stats);
             
             lock.lock();
         }
+        lock.unlock();
         
-        // 输出批处理统计信息
-        if (batch_count > 0) {
-            auto batch_end_time = std::chrono::high_resolution_clock::now();
-            auto batch_duration = std::chrono::duration_cast<std::chrono::microseconds>(batch_end_time - batch_start_time);
-            
-            std::cout << "[Writer Thread] 批处理完成: " << batch_count << " 个缓冲区, "
-                      << "耗时: " << batch_duration.count() << "μs, "
-                      << "平均: " << (batch_duration.count() / batch_count) << "μs/缓冲区" << std::endl;
-        }
-        
-        // 每处理1000个缓冲区输出一次总体统计
-        if (processed_buffers % 1000 == 0 && processed_buffers > 0) {
-            auto current_time = std::chrono::high_resolution_clock::now();
-            auto total_duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - thread_start_time);
-            uint64_t avg_write_time = total_write_time / processed_buffers;
-            
-            std::cout << "[Writer Thread] 统计信息 - 已处理: " << processed_buffers << " 个缓冲区, "
-                      << "运行时间: " << total_duration.count() << "s, "
-                      << "平均写入时间: " << avg_write_time << "μs, "
-                      << "最大队列大小: " << max_queue_size << std::endl;
+        if (flight_mode) {
+            flightService(std::chrono::steady_clock::now(), loop_stats);
         }
     }
     
+    if (flight_mode) {
+        flightFinish(loop_stats);
+    }
+    
     // 输出线程退出统计信息
     auto thread_end_time = std::chrono::high_resolution_clock::now();
     auto total_thread_duration = std::chrono::duration_cast<std::chrono::seconds>(thread_end_time - thread_start_time);
-    uint64_t avg_write_time = (processed_buffers > 0) ? (total_write_time / processed_buffers) : 0;
+    uint64_t avg_write_time = (loop_stats.processed_buffers > 0) ? (loop_stats.total_write_time / loop_stats.processed_buffers) : 0;
     
-    std::cout << "[Writer Thread] 线程退出 - 总处理: " << processed_buffers << " 个缓冲区, "
+    std::cout << "[Writer Thread] 线程退出 - 总处理: " << loop_stats.processed_buffers << " 个缓冲区, "
               << "总运行时间: " << total_thread_duration.count() << "s, "
               << "平均写入时间: " << avg_write_time << "μs, "
+              << "写入卡顿: " << loop_stats.write_stalls << " 次, "
               << "最大队列大小: " << max_queue_size << std::endl;
 }
 
+void HV_EVS_Recorder::writeBuffer(const DataBuffer& buffer, WriterLoopStats& loop_stats) {
+    // 记录单次写入开始时间
+    auto write_start_time = std::chrono::steady_clock::now();
+    
+    // 写入文件：拼入暂存块，块满时整块提交，不逐缓冲flush
+    const uint64_t submissions_before = output_writer_.submissions();
+    const bool written = output_writer_.write(buffer.data, buffer.size);
+    if (!written) {
+        writer_metrics_.add(metric_ids_.write_errors);
+        reportWriteError("写入失败: " + output_writer_.lastError());
+    }
+    writer_metrics_.add(metric_ids_.write_submissions, output_writer_.submissions() - submissions_before);
+    
+    // 记录单次写入结束时间，超过阈值计为一次写入卡顿
+    auto write_elapsed = std::chrono::steady_clock::now() - write_start_time;
+    auto write_duration = std::chrono::duration_cast<std::chrono::microseconds>(write_elapsed);
+    loop_stats.total_write_time += write_duration.count();
+    writer_metrics_.observe(metric_ids_.write_time, write_elapsed);
+    if (written) {
+        writer_metrics_.add(metric_ids_.written_buffers);
+        writer_metrics_.add(metric_ids_.written_bytes, buffer.size);
+    }
+    if (static_cast<uint64_t>(write_duration.count()) > WRITE_STALL_THRESHOLD_US) {
+        loop_stats.write_stalls++;
+        writer_metrics_.add(metric_ids_.write_stalls);
+    }
+    
+    // 缓冲区内容已复制到写入器的暂存块，归还内存池
+    usb_buffer_pool_->release(buffer.data);
+    
+    loop_stats.processed_buffers++;
+}
+
+void HV_EVS_Recorder::flightPush(const DataBuffer& buffer, WriterLoopStats& loop_stats) {
+    // 事件率触发：按到达时刻每100ms统计一次事件率，升至阈值时触发，降回阈值以下后重新武装
+    if (flight_options_.event_rate_threshold > 0) {
+        EventCountPolicy counter;
+        for (size_t offset = 0; offset + HV_SUBFRAME_GROUP_BYTE_SIZE <= buffer.size; offset += HV_SUBFRAME_GROUP_BYTE_SIZE) {
+            decodeSubframeGroup(buffer.data + offset, counter);
+        }
+        if (flight_.rate_window_start == std::chrono::steady_clock::time_point()) {
+            flight_.rate_window_start = buffer.arrival;
+        }
+        flight_.rate_window_events += counter.on_count + counter.off_count;
+        const auto window = buffer.arrival - flight_.rate_window_start;
+        if (window >= std::chrono::milliseconds(100)) {
+            const double seconds = std::chrono::duration<double>(window).count();
+            const uint64_t rate = static_cast<uint64_t>(flight_.rate_window_events / seconds);
+            metrics_.setGauge(metric_ids_.event_rate, static_cast<int64_t>(rate));
+            if (rate >= flight_options_.event_rate_threshold) {
+                if (!flight_.rate_above) {
+                    flight_.rate_above = true;
+                    flightTrigger(buffer.arrival, "event rate");
+                }
+            } else {
+                flight_.rate_above = false;
+            }
+            flight_.rate_window_start = buffer.arrival;
+            flight_.rate_window_events = 0;
+        }
+    }
+    
+    flight_.ring.push_back(buffer);
+    flightService(std::chrono::steady_clock::now(), loop_stats);
+}
+
+void HV_EVS_Recorder::flightService(std::chrono::steady_clock::time_point now, WriterLoopStats& loop_stats) {
+    if (trigger_requested_.exchange(false)) {
+        flightTrigger(now, "api");
+    }
+    
+    if (flight_.clip_active) {
+        // 片段写入期间环中的缓冲边写边归还，新到达的缓冲排在后面，接收不受影响
+        while (!flight_.ring.empty() && flight_.ring.front().arrival <= flight_.clip_end) {
+            trackSegment(flight_.ring.front().data, flight_.ring.front().size);
+            writeBuffer(flight_.ring.front(), loop_stats);
+            flight_.ring.pop_front();
+        }
+        // 已收到触发窗口之后的数据（或1秒内没有新数据）时结束片段
+        const bool passed_end = !flight_.ring.empty() ||
+                                now > flight_.clip_end + std::chrono::seconds(1);
+        if (passed_end) {
+            flightCloseClip(false);
+        }
+    }
+    
+    if (!flight_.clip_active) {
+        // 只保留触发前窗口内、且不超过内存环容量的缓冲
+        const auto cutoff = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(flight_options_.pre_trigger_seconds));
+        while (!flight_.ring.empty() &&
+               (flight_.ring.front().arrival < cutoff || flight_.ring.size() > flight_options_.ring_buffers)) {
+            usb_buffer_pool_->release(flight_.ring.front().data);
+            flight_.ring.pop_front();
+        }
+    }
+    metrics_.setGauge(metric_ids_.flight_ring_buffers, static_cast<int64_t>(flight_.ring.size()));
+}
+
+void HV_EVS_Recorder::flightTrigger(std::chrono::steady_clock::time_point now, const char* source) {
+    writer_metrics_.add(metric_ids_.triggers);
+    const auto clip_end = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(flight_options_.post_trigger_seconds));
+    
+    // 片段写入期间再次触发：从本次触发起延长
+    if (flight_.clip_active) {
+        if (clip_end > flight_.clip_end) {
+            flight_.clip_end = clip_end;
+        }
+        return;
+    }
+    
+    // 片段文件已在上一个片段结束时创建；创建失败后错误已报告，不再写入片段
+    if (!segment_.opened) {
+        return;
+    }
+    segment_.start = now;
+    flight_.clip_active = true;
+    flight_.clip_end = clip_end;
+    std::cout << "[Writer Thread] 触发（" << source << "），写入片段: " << segment_.filename
+              << "，触发前缓冲 " << flight_.ring.size() << " 个" << std::endl;
+}
+
+void HV_EVS_Recorder::flightCloseClip(bool last) {
+    // 写完当前片段并切换到（预先创建、预分配的）下一个片段文件；停止录制时直接关闭
+    const uint32_t next = flight_.next_clip + 1;
+    const bool ok = last ? output_writer_.close() : output_writer_.rotate(segmentFilename(next));
+    if (!ok) {
+        writer_metrics_.add(metric_ids_.write_errors);
+        reportWriteError((last ? "关闭触发片段失败: " : "切换触发片段失败: ") + output_writer_.lastError());
+    }
+    writeManifestEntry();
+    writer_metrics_.add(metric_ids_.trigger_clips);
+    std::cout << "[Writer Thread] 触发片段已写入: " << segment_.filename << " (" << segment_.bytes << " 字节)" << std::endl;
+    flight_.clip_active = false;
+    flight_.next_clip = next;
+    if (!last) {
+        beginSegment(next);
+        segment_.opened = ok;
+    }
+}
+
+void HV_EVS_Recorder::flightFinish(WriterLoopStats& loop_stats) {
+    // 停止录制时写完当前片段中已到达的数据，其余缓冲归还内存池
+    if (flight_.clip_active) {
+        while (!flight_.ring.empty() && flight_.ring.front().arrival <= flight_.clip_end) {
+            trackSegment(flight_.ring.front().data, flight_.ring.front().size);
+            writeBuffer(flight_.ring.front(), loop_stats);
+            flight_.ring.pop_front();
+        }
+        flightCloseClip(true);
+    } else if (segment_.opened) {
+        // 预先创建的下一个片段没有用到，删除空文件
+        output_writer_.close();
+        std::remove(segment_.filename.c_str());
+    }
+    while (!flight_.ring.empty()) {
+        usb_buffer_pool_->release(flight_.ring.front().data);
+        flight_.ring.pop_front();
+    }
+    metrics_.setGauge(metric_ids_.flight_ring_buffers, 0);
+}
+
+std::string HV_EVS_Recorder::segmentFilename(uint32_t index) const {
+    if (!flight_mode_ && !segment_options_.enabled()) {
+        return output_filename_;
+    }
+    char suffix[24];
+    snprintf(suffix, sizeof(suffix), flight_mode_ ? "_trigger_%04u" : "_%04u", index);
+    size_t dot_pos = output_filename_.find_last_of('.');
+    if (dot_pos != std::string::npos) {
+        return output_filename_.substr(0, dot_pos) + suffix + output_filename_.substr(dot_pos);
+    }
+    return output_filename_ + suffix;
+}
+
+bool HV_EVS_Recorder::segmentFull(size_t next_bytes) const {
+    if (segment_options_.max_bytes > 0 && segment_.bytes + next_bytes > segment_options_.max_bytes) {
+        return true;
+    }
+    if (segment_options_.max_seconds > 0 &&
+        std::chrono::steady_clock::now() - segment_.start >= std::chrono::seconds(segment_options_.max_seconds)) {
+        return true;
+    }
+    return false;
+}
+
+void HV_EVS_Recorder::beginSegment(uint32_t index) {
+    segment_ = SegmentState();
+    segment_.index = index;
+    segment_.filename = segmentFilename(index);
+    segment_.start = std::chrono::steady_clock::now();
+}
+
+void HV_EVS_Recorder::trackSegment(const unsigned char* data, size_t size) {
+    // 只解析子帧头：段内第一个有效子帧头取一次，每个缓冲的最后一个有效子帧头更新末时间戳
+    const size_t subframes = size / HV_SUBFRAME_BYTE_SIZE;
+    hv_subframe_header_t hdr;
+    if (!segment_.have_timestamp) {
+        for (size_t i = 0; i < subframes; ++i) {
+            hv_subframe_parse_header(reinterpret_cast<const uint64_t*>(data + i * HV_SUBFRAME_BYTE_SIZE), &hdr);
+            if (hdr.header_valid) {
+                segment_.have_timestamp = true;
+                segment_.first_timestamp = hdr.timestamp;
+                break;
+            }
+        }
+    }
+    for (size_t i = subframes; i > 0; --i) {
+        hv_subframe_parse_header(reinterpret_cast<const uint64_t*>(data + (i - 1) * HV_SUBFRAME_BYTE_SIZE), &hdr);
+        if (hdr.header_valid) {
+            segment_.last_timestamp = hdr.timestamp;
+            break;
+        }
+    }
+    segment_.bytes += size;
+    segment_.buffers++;
+}
+
+bool HV_EVS_Recorder::rotateSegment() {
+    auto switch_start = std::chrono::steady_clock::now();
+    const uint32_t next = segment_.index + 1;
+    const bool ok = output_writer_.rotate(segmentFilename(next));
+    writeManifestEntry();
+    writer_metrics_.add(metric_ids_.segments);
+    beginSegment(next);
+    segment_.opened = ok;
+    writer_metrics_.observe(metric_ids_.segment_switch_time, std::chrono::steady_clock::now() - switch_start);
+    return ok;
+}
+
+void HV_EVS_Recorder::writeManifestEntry() {
+    if (!manifest_file_.is_open() || !segment_.opened) {
+        return;
+    }
+    // 清单中只记录文件名，与分段文件放在同一目录
+    size_t slash_pos = segment_.filename.find_last_of('/');
+    manifest_file_ << segment_.index << ","
+                   << (slash_pos != std::string::npos ? segment_.filename.substr(slash_pos + 1) : segment_.filename) << ","
+                   << segment_.bytes << ","
+                   << segment_.buffers << ",";
+    if (segment_.have_timestamp) {
+        manifest_file_ << segment_.first_timestamp << "," << segment_.last_timestamp;
+    } else {
+        manifest_file_ << ",";
+    }
+    manifest_file_ << "\n";
+    // 每段结束即刷新，异常退出时已完成的段仍在清单中
+    manifest_file_.flush();
+}
+
+void HV_EVS_Recorder::reportWriteError(const std::string& message) {
+    // 只保留并打印第一个错误，之后的失败只计数
+    {
+        std::lock_guard<std::mutex> lock(write_error_mutex_);
+        if (write_failed_) {
+            return;
+        }
+        write_error_ = message;
+        write_failed_ = true;
+    }
+    std::cerr << "[Writer Thread] 错误: " << message << std::endl;
+}
+
 void HV_EVS_Recorder::analyzeTimestamps(const unsigned char* buffer, size_t block_index) {
     if (!timestamp_analysis_enabled_ || !timestamp_file_.is_open()) {
         return;
@@ -537,48 +1019,35 @@ void HV_EVS_Recorder::analyzeTimestamps(const unsigned char* buffer, size_t bloc
     
     // 按照hv_camera.cpp的方式处理数据块：每个偏移量为HV_SUB_FULL_BYTE_SIZE * 4
     for (size_t offset = 0; offset < HV_BUF_LEN; offset += HV_SUB_FULL_BYTE_SIZE * 4) {
-        const uint64_t* pixelBufferPtr = reinterpret_cast<const uint64_t*>(buffer + offset);
-        
-        // 处理4个子帧
-        for (int sub = 0; sub < 4; sub++) {
-            const uint64_t* subPtr = pixelBufferPtr + (sub * HV_SUB_FULL_BYTE_SIZE / 8);
+        // 只解析子帧头，不遍历像素
+        auto policy = makeTimestampPolicy([&](const SubframeHeader& hdr) {
+            if (!hdr.header_valid) {
+                return;
+            }
             
-            uint64_t timestamp = 0;
-            uint64_t subframe = 0;
+            // 创建时间戳元数据
+            TimestampMetadata ts_meta;
+            ts_meta.block_index = block_index;
+            ts_meta.sub_index = offset / (HV_SUB_FULL_BYTE_SIZE * 4);
+            ts_meta.subframe = hdr.subframe_id;
+            ts_meta.raw_timestamp = hdr.raw_timestamp;
+            ts_meta.timestamp = hdr.timestamp;
             
-            // 提取时间戳（与hv_camera.cpp中的processEventData保持一致）
-            uint64_t buffer_data = subPtr[0];
-            uint64_t raw_timestamp = (buffer_data >> 24) & 0xFFFFFFFFFF;
-            uint64_t header_vec = buffer_data & 0xFFFFFF;
+            // 计算与前一个时间戳的差值（微秒）
+            static uint64_t prev_timestamp = 0;
+            uint64_t timestamp_diff = (prev_timestamp > 0) ? (ts_meta.timestamp - prev_timestamp) : 0;
             
-            if (header_vec == 0xFFFF) {
-                buffer_data = subPtr[1];
-                subframe = (buffer_data >> 44) & 0xF;
-                timestamp = raw_timestamp / 200;  // 与hv_camera.cpp保持一致
-                
-                // 创建时间戳元数据
-                TimestampMetadata ts_meta;
-                ts_meta.block_index = block_index;
-                ts_meta.sub_index = offset / (HV_SUB_FULL_BYTE_SIZE * 4);
-                ts_meta.subframe = subframe;
-                ts_meta.raw_timestamp = raw_timestamp;
-                ts_meta.timestamp = timestamp;
-                
-                // 计算与前一个时间戳的差值（微秒）
-                static uint64_t prev_timestamp = 0;
-                uint64_t timestamp_diff = (prev_timestamp > 0) ? (timestamp - prev_timestamp) : 0;
-                
-                // 写入CSV格式
-                timestamp_file_ << ts_meta.block_index << ","
-                               << ts_meta.sub_index << ","
-                               << ts_meta.subframe << ","
-                               << ts_meta.raw_timestamp << ","
-                               << ts_meta.timestamp << ","
-                               << timestamp_diff << "\n";
-                
-                prev_timestamp = timestamp;
-            }
-        }
+            // 写入CSV格式
+            timestamp_file_ << ts_meta.block_index << ","
+                           << ts_meta.sub_index << ","
+                           << ts_meta.subframe << ","
+                           << ts_meta.raw_timestamp << ","
+                           << ts_meta.timestamp << ","
+                           << timestamp_diff << "\n";
+            
+            prev_timestamp = ts_meta.timestamp;
+        });
+        decodeSubframeGroup(buffer + offset, policy);
     }
     
     // 定期刷新文件
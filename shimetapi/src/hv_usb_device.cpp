@@ -1,9 +1,424 @@
 #include "hv_usb_device.h"
+#include "hv_subframe_decoder.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 namespace hv {
 
-USBDevice::USBDevice(uint16_t vendor_id, uint16_t product_id)
-    : vendor_id_(vendor_id), product_id_(product_id),
+namespace {
+
+// 设备的物理端口路径，格式与sysfs设备名一致，如"2-1.3"
+std::string devicePortPath(libusb_device* device) {
+    std::string path = std::to_string(libusb_get_bus_number(device));
+    uint8_t ports[8];
+    int count = libusb_get_port_numbers(device, ports, 8);
+    for (int i = 0; i < count; ++i) {
+        path += (i == 0 ? "-" : ".");
+        path += std::to_string(ports[i]);
+    }
+    return path;
+}
+
+std::string deviceSerialNumber(libusb_device_handle* handle, const libusb_device_descriptor& desc) {
+    if (desc.iSerialNumber == 0) {
+        return std::string();
+    }
+    unsigned char serial[256];
+    int ret = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial));
+    if (ret < 0) {
+        return std::string();
+    }
+    return std::string(reinterpret_cast<char*>(serial), ret);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// USBContext
+// ---------------------------------------------------------------------------
+
+std::shared_ptr<USBContext> USBContext::getDefault() {
+    static std::mutex default_mutex;
+    static std::weak_ptr<USBContext> default_context;
+
+    std::lock_guard<std::mutex> lock(default_mutex);
+    std::shared_ptr<USBContext> context = default_context.lock();
+    if (!context) {
+        context = create();
+        default_context = context;
+    }
+    return context;
+}
+
+std::shared_ptr<USBContext> USBContext::create() {
+    libusb_context* ctx = nullptr;
+    int ret = libusb_init(&ctx);
+    if (ret) {
+        std::cerr << "Cannot initialize libusb: " << libusb_error_name(ret) << std::endl;
+        return nullptr;
+    }
+    return std::shared_ptr<USBContext>(new USBContext(ctx));
+}
+
+// 类内初始化的静态常量成员的定义（按引用传参等ODR使用时需要）
+const int USBContext::RETRY_BASE_MS;
+const int USBContext::RETRY_MAX_MS;
+const int USBContext::MAX_CONSECUTIVE_ERRORS;
+const uint8_t ReplayTransport::IMAGE_ENDPOINT;
+const uint8_t ReplayTransport::EVENT_ENDPOINT;
+
+USBContext::USBContext(libusb_context* ctx)
+    : ctx_(ctx), async_thread_running_(false), placement_pending_(false) {
+}
+
+USBContext::~USBContext() {
+    // 使用该上下文的设备都已关闭，事件线程已经或即将自行退出
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        for (auto& entry : async_streams_) {
+            entry.second->running = false;
+        }
+        wakeAsyncEventLoop();
+    }
+    if (async_event_thread_.joinable()) {
+        async_event_thread_.join();
+    }
+    libusb_exit(ctx_);
+}
+
+libusb_context* USBContext::get() const {
+    return ctx_;
+}
+
+bool USBContext::startAsyncTransfer(libusb_device_handle* handle, uint8_t endpoint,
+                                    const std::vector<unsigned char*>& buffers, int length,
+                                    AsyncTransferCallback callback, unsigned int timeout) {
+    if (buffers.empty() || !callback) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(async_mutex_);
+    const StreamKey key(handle, endpoint);
+    if (async_streams_.count(key)) {
+        std::cerr << "Async transfer already running on endpoint " << static_cast<int>(endpoint) << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<AsyncStream> stream(new AsyncStream());
+    stream->callback = callback;
+    stream->handle = handle;
+    stream->endpoint = endpoint;
+    for (unsigned char* buffer : buffers) {
+        libusb_transfer* transfer = libusb_alloc_transfer(0);
+        if (!transfer) {
+            std::cerr << "Cannot allocate USB transfer" << std::endl;
+            freeAsyncTransfers(*stream);
+            return false;
+        }
+        libusb_fill_bulk_transfer(transfer, handle, endpoint, buffer, length,
+                                  &USBContext::asyncTransferCallback, stream.get(), timeout);
+        stream->transfers.push_back(transfer);
+    }
+
+    // 提交全部传输。事件线程可能已在处理其他端点，提交期间持有libusb事件锁，
+    // 已提交的传输在确定全部提交成功（或标记为放弃）之前不会回调
+    wakeAsyncEventLoop();
+    libusb_lock_events(ctx_);
+    bool submitted_all = true;
+    for (libusb_transfer* transfer : stream->transfers) {
+        stream->active++;
+        int ret = libusb_submit_transfer(transfer);
+        if (ret) {
+            std::cerr << "Cannot submit USB transfer: " << libusb_error_name(ret) << std::endl;
+            stream->active--;
+            submitted_all = false;
+            break;
+        }
+    }
+    if (!submitted_all) {
+        stream->aborted = true;
+        stream->running = false;
+    }
+    libusb_unlock_events(ctx_);
+    if (stream->active == 0) {
+        freeAsyncTransfers(*stream);
+        return false;
+    }
+    AsyncStream* started = stream.get();
+    async_streams_[key] = std::move(stream);
+
+    // 事件线程在没有传输流时自行退出，此时它已不再需要锁，可以直接回收
+    if (!async_thread_running_) {
+        if (async_event_thread_.joinable()) {
+            async_event_thread_.join();
+        }
+        async_thread_running_ = true;
+        placement_pending_ = true;
+        async_event_thread_ = std::thread(&USBContext::asyncEventLoop, this);
+    }
+    if (!submitted_all) {
+        // 由事件线程取消已提交的部分，结束后调用者可以收回全部缓冲区
+        wakeAsyncEventLoop();
+        async_cv_.wait(lock, [this, &key, started] {
+            auto found = async_streams_.find(key);
+            return found == async_streams_.end() || found->second.get() != started;
+        });
+        return false;
+    }
+    return true;
+}
+
+void USBContext::stopAsyncTransfer(libusb_device_handle* handle, uint8_t endpoint) {
+    std::unique_lock<std::mutex> lock(async_mutex_);
+    const StreamKey key(handle, endpoint);
+    auto it = async_streams_.find(key);
+    if (it == async_streams_.end()) {
+        return;
+    }
+    AsyncStream* stream = it->second.get();
+    stream->running = false;
+    wakeAsyncEventLoop();
+    
+    // 等待事件线程取消该端点的传输并移除传输流
+    async_cv_.wait(lock, [this, &key, stream] {
+        auto found = async_streams_.find(key);
+        return found == async_streams_.end() || found->second.get() != stream;
+    });
+}
+
+void USBContext::stopAsyncTransfers(libusb_device_handle* handle) {
+    std::unique_lock<std::mutex> lock(async_mutex_);
+    bool found = false;
+    for (auto& entry : async_streams_) {
+        if (entry.first.first == handle) {
+            entry.second->running = false;
+            found = true;
+        }
+    }
+    if (!found) {
+        return;
+    }
+    wakeAsyncEventLoop();
+    
+    async_cv_.wait(lock, [this, handle] {
+        for (const auto& entry : async_streams_) {
+            if (entry.first.first == handle) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+bool USBContext::isAsyncTransferRunning(libusb_device_handle* handle, uint8_t endpoint) const {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    auto it = async_streams_.find(StreamKey(handle, endpoint));
+    return it != async_streams_.end() && it->second->running && it->second->error == 0 && it->second->active > 0;
+}
+
+bool USBContext::isAsyncTransferRunning(libusb_device_handle* handle) const {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    for (const auto& entry : async_streams_) {
+        if (entry.first.first == handle && entry.second->running && entry.second->error == 0 &&
+            entry.second->active > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int USBContext::getAsyncTransferError(libusb_device_handle* handle, uint8_t endpoint) const {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    auto it = async_streams_.find(StreamKey(handle, endpoint));
+    return it != async_streams_.end() ? it->second->error.load() : 0;
+}
+
+void USBContext::asyncTransferCallback(libusb_transfer* transfer) {
+    AsyncStream* stream = static_cast<AsyncStream*>(transfer->user_data);
+
+    if (transfer->status == LIBUSB_TRANSFER_CANCELLED || stream->aborted) {
+        stream->active--;
+        return;
+    }
+    if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+        // 设备已断开，传输流终止，由使用者通过getAsyncTransferError得知
+        stream->error = LIBUSB_TRANSFER_NO_DEVICE;
+        stream->active--;
+        return;
+    }
+
+    bool success = (transfer->status == LIBUSB_TRANSFER_COMPLETED);
+    unsigned char* next = stream->callback(transfer->buffer, transfer->actual_length, success);
+
+    // 停止或终止后不再重新提交，避免与取消操作竞争
+    if (!next || !stream->running || stream->error != 0) {
+        stream->active--;
+        return;
+    }
+    transfer->buffer = next;
+
+    // STALL/ERROR/OVERFLOW：立即重新提交在端点持续出错时会使共享的事件线程空转，
+    // 改由事件循环退避后重新提交（STALL先清除halt，不在回调中进行同步控制传输）；超时仍立即重新提交
+    if (success) {
+        stream->consecutive_errors = 0;
+        stream->retry_rounds = 0;
+    } else if (transfer->status != LIBUSB_TRANSFER_TIMED_OUT) {
+        if (++stream->consecutive_errors > MAX_CONSECUTIVE_ERRORS) {
+            std::cerr << "USB transfer on endpoint " << static_cast<int>(stream->endpoint)
+                      << " keeps failing (status " << transfer->status << "), stopping the stream" << std::endl;
+            stream->error = transfer->status;
+            stream->active--;
+            return;
+        }
+        if (transfer->status == LIBUSB_TRANSFER_STALL) {
+            stream->clear_halt_pending = true;
+        }
+        if (stream->parked.empty()) {
+            // 同一轮出错的传输一起重新提交，每轮退避时间加倍
+            const int shift = std::min(stream->retry_rounds++, 7);
+            const int backoff_ms = RETRY_BASE_MS << shift;
+            const int delay_ms = backoff_ms < RETRY_MAX_MS ? backoff_ms : RETRY_MAX_MS;
+            stream->retry_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+        }
+        stream->parked.push_back(transfer);
+        return;
+    }
+
+    int ret = libusb_submit_transfer(transfer);
+    if (ret) {
+        std::cerr << "Cannot resubmit USB transfer: " << libusb_error_name(ret) << std::endl;
+        stream->active--;
+    }
+}
+
+void USBContext::retryParkedTransfers(AsyncStream& stream) {
+    // 在事件线程中、回调之外执行；清除halt期间libusb可能处理其他完成事件，新出错的传输留待下一轮
+    std::vector<libusb_transfer*> transfers;
+    transfers.swap(stream.parked);
+    if (stream.clear_halt_pending) {
+        stream.clear_halt_pending = false;
+        int ret = libusb_clear_halt(stream.handle, stream.endpoint);
+        if (ret) {
+            std::cerr << "Cannot clear halt on endpoint " << static_cast<int>(stream.endpoint) << ": "
+                      << libusb_error_name(ret) << std::endl;
+        }
+    }
+    for (libusb_transfer* transfer : transfers) {
+        int ret = libusb_submit_transfer(transfer);
+        if (ret) {
+            std::cerr << "Cannot resubmit USB transfer: " << libusb_error_name(ret) << std::endl;
+            stream.active--;
+        }
+    }
+}
+
+void USBContext::asyncEventLoop() {
+    while (true) {
+        std::vector<AsyncStream*> retry;
+        auto wait = std::chrono::milliseconds(100);
+        {
+            std::lock_guard<std::mutex> lock(async_mutex_);
+            bool finished = false;
+            const auto now = std::chrono::steady_clock::now();
+            for (auto it = async_streams_.begin(); it != async_streams_.end();) {
+                AsyncStream& stream = *it->second;
+                // 取消操作在事件线程中进行，回调也在此线程中执行，不会出现取消后又重新提交的情况；
+                // 终止的传输流同样取消其余传输，保留到使用者停止，以便查询原因
+                if ((!stream.running || stream.error != 0) && !stream.cancelled) {
+                    for (libusb_transfer* transfer : stream.transfers) {
+                        libusb_cancel_transfer(transfer);
+                    }
+                    stream.active -= static_cast<int>(stream.parked.size());
+                    stream.parked.clear();
+                    stream.cancelled = true;
+                }
+                if (!stream.running && stream.active == 0) {
+                    freeAsyncTransfers(stream);
+                    it = async_streams_.erase(it);
+                    finished = true;
+                    continue;
+                }
+                if (!stream.parked.empty()) {
+                    if (now >= stream.retry_at) {
+                        retry.push_back(&stream);
+                    } else {
+                        wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(
+                            stream.retry_at - now) + std::chrono::milliseconds(1));
+                    }
+                }
+                ++it;
+            }
+            if (finished) {
+                async_cv_.notify_all();
+            }
+            if (async_streams_.empty()) {
+                async_thread_running_ = false;
+                return;
+            }
+            
+            // 放置配置只能由线程自身应用
+            if (placement_pending_) {
+                applied_event_placement_ = applyThreadPlacement("hv-usb-events", event_thread_placement_);
+                placement_pending_ = false;
+                if (!applied_event_placement_.error.empty()) {
+                    std::cerr << "USB event thread placement: " << applied_event_placement_.error << std::endl;
+                }
+            }
+        }
+
+        // 传输流只由本线程移除，不持锁也可以访问；停止请求在下一轮取消这里重新提交的传输
+        for (AsyncStream* stream : retry) {
+            retryParkedTransfers(*stream);
+        }
+
+        // 停止请求通过libusb_interrupt_event_handler立即唤醒，超时只作为兜底，有待重新提交的传输时提前醒来
+        struct timeval tv = {0, static_cast<long>(wait.count()) * 1000};
+        int ret = libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+        if (ret && ret != LIBUSB_ERROR_INTERRUPTED) {
+            std::cerr << "libusb event handling failed: " << libusb_error_name(ret) << std::endl;
+        }
+    }
+}
+
+void USBContext::setEventThreadPlacement(const ThreadPlacement& placement) {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    event_thread_placement_ = placement;
+    if (async_thread_running_) {
+        placement_pending_ = true;
+        wakeAsyncEventLoop();
+    }
+}
+
+AppliedThreadPlacement USBContext::getEventThreadPlacement() const {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    return applied_event_placement_;
+}
+
+void USBContext::wakeAsyncEventLoop() {
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    libusb_interrupt_event_handler(ctx_);
+#endif
+}
+
+void USBContext::freeAsyncTransfers(AsyncStream& stream) {
+    for (libusb_transfer* transfer : stream.transfers) {
+        libusb_free_transfer(transfer);
+    }
+    stream.transfers.clear();
+}
+
+// ---------------------------------------------------------------------------
+// LibusbTransport
+// ---------------------------------------------------------------------------
+
+LibusbTransport::LibusbTransport(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+                                 std::shared_ptr<USBContext> context)
+    : vendor_id_(vendor_id), product_id_(product_id), selector_(selector), context_(context),
       ctx_(nullptr), device_(nullptr), handle_(nullptr), attached_(false) {
     // 初始化端点地址数组
     for (int i = 0; i < 8; ++i) {
@@ -11,30 +426,31 @@ USBDevice::USBDevice(uint16_t vendor_id, uint16_t product_id)
     }
 }
 
-USBDevice::~USBDevice() {
+LibusbTransport::~LibusbTransport() {
     close();
 }
 
-bool USBDevice::open() {
+bool LibusbTransport::open() {
     int ret;
 
-    // 初始化 libusb
-    ret = libusb_init(&ctx_);
-    if (ret) {
-        std::cerr << "Cannot initialize libusb: " << libusb_error_name(ret) << std::endl;
-        return false;
+    // 获取libusb上下文（多个设备共享）
+    if (!context_) {
+        context_ = USBContext::getDefault();
+        if (!context_) {
+            return false;
+        }
     }
+    ctx_ = context_->get();
 
     // 获取设备列表
     libusb_device** list;
     ssize_t cnt = libusb_get_device_list(ctx_, &list);
     if (cnt < 0) {
         std::cerr << "No devices found" << std::endl;
-        libusb_exit(ctx_);
         return false;
     }
 
-    // 查找目标设备
+    // 查找目标设备：匹配VID/PID，并按端口路径、序列号筛选
     for (ssize_t i = 0; i < cnt; ++i) {
         struct libusb_device_descriptor desc;
         ret = libusb_get_device_descriptor(list[i], &desc);
@@ -43,24 +459,44 @@ bool USBDevice::open() {
             libusb_free_device_list(list, 1);
             return false;
         }
-        if (desc.idVendor == vendor_id_ && desc.idProduct == product_id_) {
-            device_ = list[i];
-            break;
+        if (desc.idVendor != vendor_id_ || desc.idProduct != product_id_) {
+            continue;
+        }
+        std::string port_path = devicePortPath(list[i]);
+        if (!selector_.port_path.empty() && port_path != selector_.port_path) {
+            continue;
+        }
+
+        // 打开设备（按序列号选择时需要先打开才能读取序列号）
+        ret = libusb_open(list[i], &handle_);
+        if (ret) {
+            if (!selector_.serial_number.empty()) {
+                continue;
+            }
+            std::cerr << "Cannot open device: " << libusb_error_name(ret) << std::endl;
+            libusb_free_device_list(list, 1);
+            return false;
+        }
+        std::string serial = deviceSerialNumber(handle_, desc);
+        if (!selector_.serial_number.empty() && serial != selector_.serial_number) {
+            libusb_close(handle_);
+            handle_ = nullptr;
+            continue;
         }
+
+        device_ = libusb_ref_device(list[i]);
+        info_.vendor_id = desc.idVendor;
+        info_.product_id = desc.idProduct;
+        info_.bus = libusb_get_bus_number(device_);
+        info_.address = libusb_get_device_address(device_);
+        info_.port_path = port_path;
+        info_.serial_number = serial;
+        break;
     }
+    libusb_free_device_list(list, 1);
 
     if (!device_) {
         std::cerr << "No matching devices found" << std::endl;
-        libusb_free_device_list(list, 1);
-        return false;
-    }
-
-    // 打开设备
-    ret = libusb_open(device_, &handle_);
-    if (ret) {
-        std::cerr << "Cannot open device: " << libusb_error_name(ret) << std::endl;
-        libusb_free_device_list(list, 1);
-        libusb_exit(ctx_);
         return false;
     }
 
@@ -72,8 +508,9 @@ bool USBDevice::open() {
         } else if (ret) {
             std::cerr << "Unable to detach kernel driver: " << libusb_error_name(ret) << std::endl;
             libusb_close(handle_);
-            libusb_free_device_list(list, 1);
-            libusb_exit(ctx_);
+            handle_ = nullptr;
+            libusb_unref_device(device_);
+            device_ = nullptr;
             return false;
         }
         attached_ = true;
@@ -85,10 +522,12 @@ bool USBDevice::open() {
         std::cerr << "Cannot claim interface: " << libusb_error_name(ret) << std::endl;
         if (attached_) {
             libusb_attach_kernel_driver(handle_, 0);
+            attached_ = false;
         }
         libusb_close(handle_);
-        libusb_free_device_list(list, 1);
-        libusb_exit(ctx_);
+        handle_ = nullptr;
+        libusb_unref_device(device_);
+        device_ = nullptr;
         return false;
     }
 
@@ -103,36 +542,49 @@ bool USBDevice::open() {
     }
     libusb_free_config_descriptor(conf);
 
+    std::cout << "Opened device at USB port " << info_.port_path;
+    if (!info_.serial_number.empty()) {
+        std::cout << ", serial " << info_.serial_number;
+    }
+    std::cout << std::endl;
     return true;
 }
 
-bool USBDevice::isOpen() const {
+bool LibusbTransport::isOpen() const {
     return handle_ != nullptr;
 }
 
-void USBDevice::close() {
+void LibusbTransport::close() {
+    stopAsyncTransfer();
     if (handle_) {
         libusb_release_interface(handle_, 0);
         if (attached_) {
             libusb_attach_kernel_driver(handle_, 0);
+            attached_ = false;
         }
         libusb_close(handle_);
         handle_ = nullptr;
     }
-    if (ctx_) {
-        libusb_exit(ctx_);
-        ctx_ = nullptr;
+    if (device_) {
+        libusb_unref_device(device_);
+        device_ = nullptr;
     }
+    ctx_ = nullptr;
+    info_ = DeviceInfo();
 }
 
-uint8_t USBDevice::getEndpointAddress(int index) const {
+DeviceInfo LibusbTransport::getDeviceInfo() const {
+    return info_;
+}
+
+uint8_t LibusbTransport::getEndpointAddress(int index) const {
     if (index >= 0 && index < 8) {
         return endpoints_[index];
     }
     return 0;
 }
 
-bool USBDevice::bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+bool LibusbTransport::bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
     if (!isOpen()) {
         return false;
     }
@@ -141,7 +593,46 @@ bool USBDevice::bulkTransfer(uint8_t endpoint, unsigned char* data, int length,
     return (ret == LIBUSB_SUCCESS);
 }
 
-bool USBDevice::clearSharedMemory() {
+bool LibusbTransport::startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                                   AsyncTransferCallback callback, unsigned int timeout) {
+    if (!isOpen()) {
+        return false;
+    }
+    return context_->startAsyncTransfer(handle_, endpoint, buffers, length, callback, timeout);
+}
+
+void LibusbTransport::stopAsyncTransfer(uint8_t endpoint) {
+    if (isOpen()) {
+        context_->stopAsyncTransfer(handle_, endpoint);
+    }
+}
+
+void LibusbTransport::stopAsyncTransfer() {
+    if (isOpen()) {
+        context_->stopAsyncTransfers(handle_);
+    }
+}
+
+bool LibusbTransport::isAsyncTransferRunning(uint8_t endpoint) const {
+    return isOpen() && context_->isAsyncTransferRunning(handle_, endpoint);
+}
+
+bool LibusbTransport::isAsyncTransferRunning() const {
+    return isOpen() && context_->isAsyncTransferRunning(handle_);
+}
+
+int LibusbTransport::getAsyncTransferError(uint8_t endpoint) const {
+    return isOpen() ? context_->getAsyncTransferError(handle_, endpoint) : 0;
+}
+
+int LibusbTransport::clearHalt(uint8_t endpoint) {
+    if (!isOpen()) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return libusb_clear_halt(handle_, endpoint);
+}
+
+bool LibusbTransport::clearSharedMemory() {
     if (!isOpen()) {
         return false;
     }
@@ -150,8 +641,572 @@ bool USBDevice::clearSharedMemory() {
     return true;
 }
 
-libusb_device_handle* USBDevice::getHandle() const {
+unsigned char* LibusbTransport::allocTransferBuffer(size_t length, bool* device_memory) {
+    *device_memory = false;
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    if (isOpen()) {
+        unsigned char* buffer = libusb_dev_mem_alloc(handle_, length);
+        if (buffer) {
+            *device_memory = true;
+            return buffer;
+        }
+    }
+#endif
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, length) != 0) {
+        return nullptr;
+    }
+    return static_cast<unsigned char*>(buffer);
+}
+
+void LibusbTransport::freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) {
+    if (!buffer) {
+        return;
+    }
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    if (device_memory) {
+        if (isOpen()) {
+            libusb_dev_mem_free(handle_, buffer, length);
+        }
+        return;
+    }
+#else
+    (void)length;
+    (void)device_memory;
+#endif
+    free(buffer);
+}
+
+libusb_device_handle* LibusbTransport::getHandle() const {
     return handle_;
 }
 
+std::shared_ptr<USBContext> LibusbTransport::getContext() const {
+    return context_;
+}
+
+// ---------------------------------------------------------------------------
+// ReplayTransport
+// ---------------------------------------------------------------------------
+
+ReplayTransport::ReplayTransport(const std::string& path, const ReplayOptions& options)
+    : path_(path), options_(options), fd_(-1), file_size_(0),
+      offset_(0), due_valid_(false), have_ticks_(false), last_ticks_(0), media_ticks_(0),
+      finished_(false), blocks_delivered_(0), bytes_delivered_(0) {
+}
+
+ReplayTransport::~ReplayTransport() {
+    close();
+}
+
+bool ReplayTransport::open() {
+    if (isOpen()) {
+        return true;
+    }
+
+    int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Cannot open replay file " << path_ << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Cannot stat replay file " << path_ << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    file_size_ = static_cast<uint64_t>(st.st_size);
+    fd_ = fd;
+
+    if (options_.preload) {
+        std::vector<unsigned char> data(file_size_);
+        if (!readAt(0, data.data(), data.size())) {
+            close();
+            return false;
+        }
+        preloaded_.swap(data);
+    } else {
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(read_mutex_);
+        offset_ = 0;
+        resetPacingLocked();
+    }
+    finished_ = (file_size_ == 0);
+    blocks_delivered_ = 0;
+    bytes_delivered_ = 0;
+
+    std::cout << "Opened replay file " << path_ << " (" << file_size_ << " bytes)" << std::endl;
+    return true;
+}
+
+bool ReplayTransport::isOpen() const {
+    return fd_ >= 0;
+}
+
+void ReplayTransport::close() {
+    stopAsyncTransfer();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    std::vector<unsigned char>().swap(preloaded_);
+    file_size_ = 0;
+}
+
+DeviceInfo ReplayTransport::getDeviceInfo() const {
+    DeviceInfo info;
+    if (isOpen()) {
+        info.port_path = "replay:" + path_;
+    }
+    return info;
+}
+
+uint8_t ReplayTransport::getEndpointAddress(int index) const {
+    if (index == 0) {
+        return IMAGE_ENDPOINT;
+    }
+    if (index == 1) {
+        return EVENT_ENDPOINT;
+    }
+    return 0;
+}
+
+bool ReplayTransport::bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred,
+                                   unsigned int timeout) {
+    *transferred = 0;
+    if (!isOpen() || length <= 0) {
+        return false;
+    }
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+
+    if (endpoint == EVENT_ENDPOINT) {
+        std::lock_guard<std::mutex> lock(read_mutex_);
+        if (!atEndLocked()) {
+            // 数据块在超时前到期才返回，否则与设备无数据时一样超时，下次调用仍返回该块
+            const Clock::time_point due = nextDueLocked();
+            if (timeout == 0 || due <= deadline) {
+                std::this_thread::sleep_until(due);
+                return readBlockLocked(data, length, transferred);
+            }
+        }
+    }
+
+    // 没有数据
+    if (timeout > 0) {
+        std::this_thread::sleep_until(deadline);
+    }
+    return false;
+}
+
+bool ReplayTransport::startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                                         AsyncTransferCallback callback, unsigned int timeout) {
+    if (!isOpen() || buffers.empty() || !callback || length <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    if (streams_.count(endpoint)) {
+        std::cerr << "Async transfer already running on endpoint " << static_cast<int>(endpoint) << std::endl;
+        return false;
+    }
+    std::unique_ptr<ReplayStream> stream(new ReplayStream());
+    stream->buffers = buffers;
+    stream->length = length;
+    stream->timeout = timeout;
+    stream->callback = callback;
+    stream->thread = std::thread(&ReplayTransport::replayThreadFunc, this, endpoint, stream.get());
+    streams_[endpoint] = std::move(stream);
+    return true;
+}
+
+void ReplayTransport::stopAsyncTransfer(uint8_t endpoint) {
+    std::unique_ptr<ReplayStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        auto it = streams_.find(endpoint);
+        if (it == streams_.end()) {
+            return;
+        }
+        it->second->running = false;
+        stream = std::move(it->second);
+        streams_.erase(it);
+    }
+    stream_cv_.notify_all();
+    if (stream->thread.joinable()) {
+        stream->thread.join();
+    }
+}
+
+void ReplayTransport::stopAsyncTransfer() {
+    std::map<uint8_t, std::unique_ptr<ReplayStream>> streams;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        for (auto& entry : streams_) {
+            entry.second->running = false;
+        }
+        streams.swap(streams_);
+    }
+    stream_cv_.notify_all();
+    for (auto& entry : streams) {
+        if (entry.second->thread.joinable()) {
+            entry.second->thread.join();
+        }
+    }
+}
+
+bool ReplayTransport::isAsyncTransferRunning(uint8_t endpoint) const {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    auto it = streams_.find(endpoint);
+    return it != streams_.end() && it->second->running;
+}
+
+bool ReplayTransport::isAsyncTransferRunning() const {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    for (const auto& entry : streams_) {
+        if (entry.second->running) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ReplayTransport::clearHalt(uint8_t endpoint) {
+    (void)endpoint;
+    return isOpen() ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE;
+}
+
+bool ReplayTransport::clearSharedMemory() {
+    return isOpen();
+}
+
+unsigned char* ReplayTransport::allocTransferBuffer(size_t length, bool* device_memory) {
+    *device_memory = false;
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, length) != 0) {
+        return nullptr;
+    }
+    return static_cast<unsigned char*>(buffer);
+}
+
+void ReplayTransport::freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) {
+    (void)length;
+    (void)device_memory;
+    free(buffer);
+}
+
+bool ReplayTransport::isFinished() const {
+    return finished_;
+}
+
+uint64_t ReplayTransport::getBlocksDelivered() const {
+    return blocks_delivered_;
+}
+
+uint64_t ReplayTransport::getBytesDelivered() const {
+    return bytes_delivered_;
+}
+
+bool ReplayTransport::readAt(uint64_t offset, void* data, size_t length) {
+    if (!preloaded_.empty()) {
+        memcpy(data, preloaded_.data() + offset, length);
+        return true;
+    }
+    unsigned char* dst = static_cast<unsigned char*>(data);
+    while (length > 0) {
+        ssize_t ret = pread(fd_, dst, length, static_cast<off_t>(offset));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            std::cerr << "Cannot read replay file " << path_ << ": "
+                      << (ret < 0 ? strerror(errno) : "unexpected end of file") << std::endl;
+            return false;
+        }
+        dst += ret;
+        offset += static_cast<uint64_t>(ret);
+        length -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool ReplayTransport::atEndLocked() {
+    if (offset_ < file_size_) {
+        return false;
+    }
+    if (options_.loop && file_size_ > 0) {
+        offset_ = 0;
+        resetPacingLocked();
+        return false;
+    }
+    finished_ = true;
+    return true;
+}
+
+void ReplayTransport::resetPacingLocked() {
+    due_valid_ = false;
+    have_ticks_ = false;
+    last_ticks_ = 0;
+    media_ticks_ = 0;
+}
+
+ReplayTransport::Clock::time_point ReplayTransport::nextDueLocked() {
+    if (due_valid_) {
+        return due_;
+    }
+    const Clock::time_point now = Clock::now();
+    due_valid_ = true;
+    due_ = now;
+    if (options_.speed <= 0) {
+        return due_;
+    }
+
+    // 以数据块首个子帧的时间戳定速
+    hv_subframe_header_t hdr;
+    hdr.header_valid = 0;
+    if (file_size_ - offset_ >= HV_SUBFRAME_HEADER_WORDS * sizeof(uint64_t)) {
+        uint64_t words[HV_SUBFRAME_HEADER_WORDS];
+        if (readAt(offset_, words, sizeof(words))) {
+            hv_subframe_parse_header(words, &hdr);
+        }
+    }
+    if (!have_ticks_) {
+        // 回放起点（或循环回到文件开头）：从当前时刻开始计时
+        if (hdr.header_valid) {
+            have_ticks_ = true;
+            last_ticks_ = hdr.raw_timestamp;
+            media_ticks_ = 0;
+            start_ = now;
+        }
+        return due_;
+    }
+    if (hdr.header_valid) {
+        // 40位时间戳按模计算差值，回退或跳变过大视为录制中断，不等待
+        const uint64_t delta = (hdr.raw_timestamp - last_ticks_) & HV_SUBFRAME_TIMESTAMP_MASK;
+        if (delta <= HV_SUBFRAME_MAX_GAP_TICKS) {
+            media_ticks_ += delta;
+        }
+        last_ticks_ = hdr.raw_timestamp;
+    }
+    due_ = start_ + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::micro>(media_ticks_ / (HV_SUBFRAME_TICKS_PER_US * options_.speed)));
+
+    // 读取方落后过多（如采集暂停后重新开始）时重新对齐，避免一次性补发积压的数据
+    if (now - due_ > std::chrono::seconds(1)) {
+        start_ += now - due_;
+        due_ = now;
+    }
+    return due_;
+}
+
+bool ReplayTransport::readBlockLocked(unsigned char* data, int length, int* transferred) {
+    const size_t bytes = static_cast<size_t>(std::min<uint64_t>(static_cast<uint64_t>(length), file_size_ - offset_));
+    if (!readAt(offset_, data, bytes)) {
+        return false;
+    }
+    offset_ += bytes;
+    due_valid_ = false;
+    *transferred = static_cast<int>(bytes);
+    blocks_delivered_++;
+    bytes_delivered_ += bytes;
+    return true;
+}
+
+bool ReplayTransport::waitStream(ReplayStream* stream, Clock::time_point until) {
+    std::unique_lock<std::mutex> lock(stream_mutex_);
+    auto stopped = [stream] { return !stream->running; };
+    if (until == Clock::time_point::max()) {
+        stream_cv_.wait(lock, stopped);
+    } else {
+        stream_cv_.wait_until(lock, until, stopped);
+    }
+    return stream->running;
+}
+
+void ReplayTransport::replayThreadFunc(uint8_t endpoint, ReplayStream* stream) {
+    hv::applyThreadPlacement("hv-replay", ThreadPlacement());
+
+    // 排队的缓冲区按提交顺序轮流完成，与设备上的传输队列一致
+    size_t next = 0;
+    while (stream->running && !stream->buffers.empty()) {
+        if (next >= stream->buffers.size()) {
+            next = 0;
+        }
+        unsigned char* buffer = stream->buffers[next];
+        int transferred = 0;
+        bool delivered = false;
+
+        if (endpoint == EVENT_ENDPOINT) {
+            bool available = false;
+            Clock::time_point due;
+            {
+                std::lock_guard<std::mutex> lock(read_mutex_);
+                if (!atEndLocked()) {
+                    due = nextDueLocked();
+                    available = true;
+                }
+            }
+            if (available) {
+                if (due > Clock::now() && !waitStream(stream, due)) {
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(read_mutex_);
+                delivered = readBlockLocked(buffer, stream->length, &transferred);
+            }
+        }
+
+        if (!delivered) {
+            // 没有数据：不超时的传输一直排队到停止，否则超时后以失败完成
+            const Clock::time_point until = stream->timeout > 0
+                ? Clock::now() + std::chrono::milliseconds(stream->timeout)
+                : Clock::time_point::max();
+            if (!waitStream(stream, until)) {
+                break;
+            }
+        }
+
+        unsigned char* result = stream->callback(buffer, transferred, delivered);
+        if (result) {
+            stream->buffers[next++] = result;
+        } else {
+            stream->buffers.erase(stream->buffers.begin() + next);
+        }
+    }
+    stream->running = false;
+}
+
+// ---------------------------------------------------------------------------
+// USBDevice
+// ---------------------------------------------------------------------------
+
+USBDevice::USBDevice(uint16_t vendor_id, uint16_t product_id)
+    : USBDevice(vendor_id, product_id, DeviceSelector()) {
+}
+
+USBDevice::USBDevice(uint16_t vendor_id, uint16_t product_id, const DeviceSelector& selector,
+                     std::shared_ptr<USBContext> context)
+    : transport_(new LibusbTransport(vendor_id, product_id, selector, context)) {
+}
+
+USBDevice::USBDevice(std::unique_ptr<USBTransport> transport)
+    : transport_(std::move(transport)) {
+}
+
+USBDevice::~USBDevice() {
+    close();
+}
+
+std::vector<DeviceInfo> USBDevice::listDevices(uint16_t vendor_id, uint16_t product_id) {
+    std::vector<DeviceInfo> devices;
+    std::shared_ptr<USBContext> context = USBContext::getDefault();
+    if (!context) {
+        return devices;
+    }
+
+    libusb_device** list;
+    ssize_t cnt = libusb_get_device_list(context->get(), &list);
+    if (cnt < 0) {
+        return devices;
+    }
+    for (ssize_t i = 0; i < cnt; ++i) {
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(list[i], &desc) || desc.idVendor != vendor_id || desc.idProduct != product_id) {
+            continue;
+        }
+        DeviceInfo info;
+        info.vendor_id = desc.idVendor;
+        info.product_id = desc.idProduct;
+        info.bus = libusb_get_bus_number(list[i]);
+        info.address = libusb_get_device_address(list[i]);
+        info.port_path = devicePortPath(list[i]);
+        libusb_device_handle* handle;
+        if (libusb_open(list[i], &handle) == 0) {
+            info.serial_number = deviceSerialNumber(handle, desc);
+            libusb_close(handle);
+        }
+        devices.push_back(info);
+    }
+    libusb_free_device_list(list, 1);
+    return devices;
+}
+
+bool USBDevice::open() {
+    return transport_->open();
+}
+
+bool USBDevice::isOpen() const {
+    return transport_->isOpen();
+}
+
+void USBDevice::close() {
+    transport_->close();
+}
+
+DeviceInfo USBDevice::getDeviceInfo() const {
+    return transport_->getDeviceInfo();
+}
+
+uint8_t USBDevice::getEndpointAddress(int index) const {
+    return transport_->getEndpointAddress(index);
+}
+
+bool USBDevice::bulkTransfer(uint8_t endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+    return transport_->bulkTransfer(endpoint, data, length, transferred, timeout);
+}
+
+bool USBDevice::startAsyncTransfer(uint8_t endpoint, const std::vector<unsigned char*>& buffers, int length,
+                                   AsyncTransferCallback callback, unsigned int timeout) {
+    return transport_->startAsyncTransfer(endpoint, buffers, length, callback, timeout);
+}
+
+void USBDevice::stopAsyncTransfer(uint8_t endpoint) {
+    transport_->stopAsyncTransfer(endpoint);
+}
+
+void USBDevice::stopAsyncTransfer() {
+    transport_->stopAsyncTransfer();
+}
+
+bool USBDevice::isAsyncTransferRunning(uint8_t endpoint) const {
+    return transport_->isAsyncTransferRunning(endpoint);
+}
+
+bool USBDevice::isAsyncTransferRunning() const {
+    return transport_->isAsyncTransferRunning();
+}
+
+int USBDevice::getAsyncTransferError(uint8_t endpoint) const {
+    return transport_->getAsyncTransferError(endpoint);
+}
+
+int USBDevice::clearHalt(uint8_t endpoint) {
+    return transport_->clearHalt(endpoint);
+}
+
+bool USBDevice::clearSharedMemory() {
+    return transport_->clearSharedMemory();
+}
+
+unsigned char* USBDevice::allocTransferBuffer(size_t length, bool* device_memory) {
+    return transport_->allocTransferBuffer(length, device_memory);
+}
+
+void USBDevice::freeTransferBuffer(unsigned char* buffer, size_t length, bool device_memory) {
+    transport_->freeTransferBuffer(buffer, length, device_memory);
+}
+
+libusb_device_handle* USBDevice::getHandle() const {
+    return transport_->getHandle();
+}
+
+std::shared_ptr<USBContext> USBDevice::getContext() const {
+    return transport_->getContext();
+}
+
+USBTransport* USBDevice::getTransport() const {
+    return transport_.get();
+}
+
 } // namespace hv
@@ -80,22 +80,73 @@ PYBIND11_MODULE(hv_camera_python, m) {
         .def("close", &hv::USBDevice::close)
         .def("bulkTransfer", &hv::USBDevice::bulkTransfer);
 
+    // 绑定设备选择相关结构
+    py::class_<hv::DeviceSelector>(m, "DeviceSelector")
+        .def(py::init<>())
+        .def_readwrite("port_path", &hv::DeviceSelector::port_path)
+        .def_readwrite("serial_number", &hv::DeviceSelector::serial_number)
+        .def_static("byPortPath", &hv::DeviceSelector::byPortPath)
+        .def_static("bySerialNumber", &hv::DeviceSelector::bySerialNumber);
+
+    py::class_<hv::DeviceInfo>(m, "DeviceInfo")
+        .def_readonly("vendor_id", &hv::DeviceInfo::vendor_id)
+        .def_readonly("product_id", &hv::DeviceInfo::product_id)
+        .def_readonly("bus", &hv::DeviceInfo::bus)
+        .def_readonly("address", &hv::DeviceInfo::address)
+        .def_readonly("port_path", &hv::DeviceInfo::port_path)
+        .def_readonly("serial_number", &hv::DeviceInfo::serial_number);
+
+    py::enum_<hv::ImageOutputFormat>(m, "ImageOutputFormat")
+        .value("BGR", hv::ImageOutputFormat::BGR)
+        .value("Gray", hv::ImageOutputFormat::Gray)
+        .value("BGRHalf", hv::ImageOutputFormat::BGRHalf)
+        .value("BGRQuarter", hv::ImageOutputFormat::BGRQuarter);
+
+    // 绑定延迟统计结构
+    py::class_<hv::LatencyPercentiles>(m, "LatencyPercentiles")
+        .def_readonly("count", &hv::LatencyPercentiles::count)
+        .def_readonly("mean_us", &hv::LatencyPercentiles::mean_us)
+        .def_readonly("p50_us", &hv::LatencyPercentiles::p50_us)
+        .def_readonly("p99_us", &hv::LatencyPercentiles::p99_us)
+        .def_readonly("p999_us", &hv::LatencyPercentiles::p999_us);
+
+    py::class_<hv::EventLatencyStats>(m, "EventLatencyStats")
+        .def_readonly("queue_wait", &hv::EventLatencyStats::queue_wait)
+        .def_readonly("decode", &hv::EventLatencyStats::decode)
+        .def_readonly("reorder_wait", &hv::EventLatencyStats::reorder_wait)
+        .def_readonly("callback", &hv::EventLatencyStats::callback)
+        .def_readonly("end_to_end", &hv::EventLatencyStats::end_to_end);
+
     // 绑定 HV_Camera 类
     py::class_<hv::HV_Camera>(m, "HV_Camera")
         // 构造函数
         .def(py::init<uint16_t, uint16_t>())
+        .def(py::init([](uint16_t vendor_id, uint16_t product_id, const hv::DeviceSelector& selector) {
+            return new hv::HV_Camera(vendor_id, product_id, selector);
+        }))
+        .def_static("listDevices", &hv::HV_Camera::listDevices)
         
         // 基本操作
         .def("open", &hv::HV_Camera::open)
         .def("isOpen", &hv::HV_Camera::isOpen)
         .def("close", &hv::HV_Camera::close)
+        .def("getDeviceInfo", &hv::HV_Camera::getDeviceInfo)
         
         // 事件采集
         .def("startEventCapture", &hv::HV_Camera::startEventCapture)
         .def("stopEventCapture", &hv::HV_Camera::stopEventCapture)
+        .def("getEventLatencyStats", &hv::HV_Camera::getEventLatencyStats)
+        .def("setEventTransferSize", &hv::HV_Camera::setEventTransferSize)
+        .def("getEventTransferSize", &hv::HV_Camera::getEventTransferSize)
+        .def("setLowLatencyMode", &hv::HV_Camera::setLowLatencyMode)
+        .def("isLowLatencyMode", &hv::HV_Camera::isLowLatencyMode)
         
         // 图像采集
         .def("startImageCapture", &hv::HV_Camera::startImageCapture)
         .def("stopImageCapture", &hv::HV_Camera::stopImageCapture)
-        .def("getLatestImage", &hv::HV_Camera::getLatestImage);
+        .def("getLatestImage", &hv::HV_Camera::getLatestImage)
+        .def("setImageOutputFormat", [](hv::HV_Camera& camera, hv::ImageOutputFormat format,
+                                        int x, int y, int width, int height) {
+            return camera.setImageOutputFormat(format, cv::Rect(x, y, width, height));
+        }, py::arg("format"), py::arg("x") = 0, py::arg("y") = 0, py::arg("width") = 0, py::arg("height") = 0);
 }